@@ -0,0 +1,32 @@
+#include "capability_matrix.h"
+
+#include "log.h"
+
+namespace flexasio {
+
+	CapabilityMatrix::State& CapabilityMatrix::GetState() {
+		static State state;
+		return state;
+	}
+
+	std::optional<bool> CapabilityMatrix::Find(uint64_t deviceTopology, const Key& key) {
+		auto& state = GetState();
+		std::scoped_lock lock(state.mutex);
+		if (state.deviceTopology != deviceTopology) return std::nullopt;
+		const auto entry = state.entries.find(key);
+		if (entry == state.entries.end()) return std::nullopt;
+		return entry->second;
+	}
+
+	void CapabilityMatrix::Store(uint64_t deviceTopology, const Key& key, bool supported) {
+		auto& state = GetState();
+		std::scoped_lock lock(state.mutex);
+		if (state.deviceTopology != deviceTopology) {
+			if (!state.entries.empty()) Log() << "Device topology changed, discarding " << state.entries.size() << " capability matrix entries";
+			state.entries.clear();
+			state.deviceTopology = deviceTopology;
+		}
+		state.entries.insert_or_assign(key, supported);
+	}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <portaudio.h>
+
+#include <windows.h>
+
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace flexasio {
+
+	// Process-wide record of which stream formats are supported, so that the format checks that canSampleRate() and sample type
+	// negotiation rely on only touch the device once per process, even across driver instances.
+	//
+	// Everything that can affect the answer is part of the key, so that entries recorded under a different configuration are
+	// never used. The whole matrix is discarded when the device topology changes.
+	class CapabilityMatrix final {
+	public:
+		struct Key final {
+			PaHostApiTypeId hostApiType;
+			std::string device;
+			bool output;
+			double sampleRate;
+			int channelCount;
+			PaSampleFormat sampleFormat;
+			unsigned long wasapiFlags;
+			DWORD channelMask;
+			bool exclusive;
+
+			auto operator<=>(const Key&) const = default;
+		};
+
+		static std::optional<bool> Find(uint64_t deviceTopology, const Key&);
+		static void Store(uint64_t deviceTopology, const Key&, bool supported);
+
+	private:
+		CapabilityMatrix() = delete;
+
+		struct State final {
+			std::mutex mutex;
+			uint64_t deviceTopology = 0;
+			std::map<Key, bool> entries;
+		};
+		static State& GetState();
+	};
+
+}
@@ -127,12 +127,7 @@ namespace flexasio {
 					flexASIO->ControlPanel();
 				});
 			}
-			ASIOError future(long selector, void *) throw() final {
-				return Enter("future()", [&] {
-					Log() << "Requested future selector: " << ::dechamps_ASIOUtil::GetASIOFutureSelectorString(selector);
-					throw ASIOException(ASE_InvalidParameter, "future() is not supported");
-				});
-			}
+			ASIOError future(long selector, void* opt) throw() final;
 
 			ASIOError outputReady() throw() final {
 				return EnterWithMethod("outputReady()", &FlexASIO::OutputReady);
@@ -190,6 +185,42 @@ namespace flexasio {
 			return EnterInitialized(context, [&] { return ((*flexASIO).*method)(std::forward<Args>(args)...); });
 		}
 
+		ASIOError CFlexASIO::future(long selector, void* opt) throw() {
+			const auto handleSelector = [&] {
+				Log() << "Requested future selector: " << ::dechamps_ASIOUtil::GetASIOFutureSelectorString(selector);
+				switch (selector) {
+				case kAsioCanInputMonitor:
+				case kAsioCanInputGain:
+				case kAsioCanInputMeter:
+				case kAsioCanOutputGain:
+				case kAsioCanOutputMeter:
+					break;
+				case kAsioSetInputMonitor:
+					if (opt == nullptr) throw ASIOException(ASE_InvalidParameter, "kAsioSetInputMonitor called without parameters");
+					flexASIO->SetInputMonitor(*static_cast<const ASIOInputMonitor*>(opt));
+					break;
+				case kAsioSetInputGain:
+				case kAsioSetOutputGain:
+					if (opt == nullptr) throw ASIOException(ASE_InvalidParameter, "gain set without parameters");
+					flexASIO->SetGain(selector == kAsioSetInputGain, *static_cast<const ASIOChannelControls*>(opt));
+					break;
+				case kAsioGetInputMeter:
+				case kAsioGetOutputMeter:
+					if (opt == nullptr) throw ASIOException(ASE_InvalidParameter, "meter requested without parameters");
+					flexASIO->GetMeter(selector == kAsioGetInputMeter, *static_cast<ASIOChannelControls*>(opt));
+					break;
+				default:
+					throw ASIOException(ASE_InvalidParameter, "future() selector is not supported");
+				}
+			};
+			// Capability queries can be answered at any time, but the other selectors act on the driver.
+			const auto requiresInitialization = selector == kAsioSetInputMonitor || selector == kAsioSetInputGain || selector == kAsioSetOutputGain ||
+				selector == kAsioGetInputMeter || selector == kAsioGetOutputMeter;
+			const auto error = requiresInitialization ? EnterInitialized("future()", handleSelector) : Enter("future()", handleSelector);
+			// Note future() uses ASE_SUCCESS, not ASE_OK, to indicate success.
+			return error == ASE_OK ? ASE_SUCCESS : error;
+		}
+
 		ASIOError CFlexASIO::getClockSources(ASIOClockSource* clocks, long* numSources) throw()
 		{
 			return Enter("getClockSources()", [&] {
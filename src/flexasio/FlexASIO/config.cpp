@@ -5,9 +5,15 @@
 #include <dechamps_cpputil/exception.h>
 #include <toml/toml.h>
 
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
 #include "log.h"
+#include "../FlexASIOUtil/biquad.h"
 #include "../FlexASIOUtil/shell.h"
 #include "../FlexASIOUtil/variant.h"
+#include "../FlexASIOUtil/windows_string.h"
 
 namespace flexasio {
 
@@ -15,7 +21,7 @@ namespace flexasio {
 
 		constexpr auto configFileName = L"FlexASIO.toml";
 
-		toml::Value LoadConfigToml(const std::filesystem::path& path) {
+		toml::Value LoadConfigToml(const std::filesystem::path& path, std::string& text) {
 			Log() << "Attempting to load configuration file: " << path;
 
 			std::ifstream stream;
@@ -25,13 +31,16 @@ namespace flexasio {
 			}
 			catch (const std::exception& exception) {
 				Log() << "Unable to open configuration file: " << exception.what();
+				text.clear();
 				return toml::Table();
 			}
 			stream.exceptions(stream.badbit);
+			text.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
 
 			const auto parseResult = [&] {
 				try {
-					const auto parseResult = toml::parse(stream);
+					std::istringstream textStream(text);
+					const auto parseResult = toml::parse(textStream);
 					if (!parseResult.valid()) throw std::runtime_error(parseResult.errorReason);
 					return parseResult;
 				}
@@ -77,6 +86,18 @@ namespace flexasio {
 			if (channelCount <= 0) throw std::runtime_error("channel count must be strictly positive - to disable a stream direction, set the 'device' option to the empty string \"\" instead");
 		}
 
+		void ValidateLatencyCalibrationChannel(const int& channel) {
+			if (channel < 0) throw std::runtime_error("latency calibration channel cannot be negative");
+		}
+
+		void ValidateChannelIndex(const int& channel) {
+			if (channel < 0) throw std::runtime_error("channel index cannot be negative");
+		}
+
+		void ValidateEqualizerFilterType(const std::string& type) {
+			if (!ParseBiquadType(type).has_value()) throw std::runtime_error("invalid equalizer filter type '" + type + "' - valid types are peaking, lowShelf, highShelf, lowPass and highPass");
+		}
+
 		void ValidateSuggestedLatency(const double& suggestedLatencySeconds) {
 			if (!(suggestedLatencySeconds >= 0 && suggestedLatencySeconds <= 3600)) throw std::runtime_error("suggested latency must be between 0 and 3600 seconds");
 		}
@@ -105,24 +126,103 @@ namespace flexasio {
 
 			SetOption(table, "channels", stream.channels, ValidateChannelCount);
 			SetOption(table, "sampleType", stream.sampleType);
+			SetOption(table, "deviceSampleType", stream.deviceSampleType);
+			SetOption(table, "dither", stream.dither);
+			SetOption(table, "interleaved", stream.interleaved);
 			SetOption(table, "suggestedLatencySeconds", stream.suggestedLatencySeconds, ValidateSuggestedLatency);
 			SetOption(table, "wasapiExclusiveMode", stream.wasapiExclusiveMode);
 			SetOption(table, "wasapiAutoConvert", stream.wasapiAutoConvert);
 			SetOption(table, "wasapiExplicitSampleFormat", stream.wasapiExplicitSampleFormat);
+			SetOption(table, "latencyCalibrationChannel", stream.latencyCalibrationChannel, ValidateLatencyCalibrationChannel);
+			ProcessTypedOption<toml::Array>(table, "mutedChannels", [&](const toml::Array& channels) {
+				stream.mutedChannels.clear();
+				for (const auto& channel : channels) {
+					const auto channelIndex = channel.as<int>();
+					ValidateChannelIndex(channelIndex);
+					stream.mutedChannels.push_back(channelIndex);
+				}
+			});
+			ProcessTypedOption<toml::Array>(table, "channelMap", [&](const toml::Array& channels) {
+				stream.channelMap.clear();
+				for (const auto& channel : channels) {
+					const auto channelIndex = channel.as<int>();
+					ValidateChannelIndex(channelIndex);
+					if (std::find(stream.channelMap.begin(), stream.channelMap.end(), channelIndex) != stream.channelMap.end())
+						throw std::runtime_error("device channel " + std::to_string(channelIndex) + " appears more than once in the channel map");
+					stream.channelMap.push_back(channelIndex);
+				}
+			});
+			ProcessTypedOption<toml::Array>(table, "mixingMatrix", [&](const toml::Array& rows) {
+				stream.mixingMatrix.clear();
+				for (const auto& row : rows) {
+					auto& gains = stream.mixingMatrix.emplace_back();
+					for (const auto& gain : row.as<toml::Array>()) gains.push_back(gain.asNumber());
+					if (gains.size() != stream.mixingMatrix.front().size()) throw std::runtime_error("all rows of the mixing matrix must have the same number of gains");
+				}
+				if (!stream.mixingMatrix.empty() && stream.mixingMatrix.front().empty()) throw std::runtime_error("the rows of the mixing matrix cannot be empty");
+			});
+			SetOption(table, "mixingChannels", stream.mixingChannels, ValidateChannelCount);
+			ProcessTypedOption<toml::Array>(table, "equalizer", [&](const toml::Array& filters) {
+				stream.equalizer.clear();
+				for (const auto& filterValue : filters) {
+					const auto& filterTable = filterValue.as<toml::Table>();
+					auto& filter = stream.equalizer.emplace_back();
+					SetOption(filterTable, "type", filter.type, ValidateEqualizerFilterType);
+					if (filter.type.empty()) throw std::runtime_error("equalizer filters must have a type");
+					ProcessOption(filterTable, "frequency", [&](const toml::Value& frequency) { filter.frequency = frequency.asNumber(); });
+					if (!(filter.frequency > 0)) throw std::runtime_error("equalizer filters must have a strictly positive frequency");
+					ProcessOption(filterTable, "q", [&](const toml::Value& q) { filter.q = q.asNumber(); });
+					if (!(filter.q > 0)) throw std::runtime_error("equalizer filter Q must be strictly positive");
+					ProcessOption(filterTable, "gain", [&](const toml::Value& gain) { filter.gain = gain.asNumber(); });
+					ProcessTypedOption<toml::Array>(filterTable, "channels", [&](const toml::Array& channels) {
+						for (const auto& channel : channels) {
+							const auto channelIndex = channel.as<int>();
+							ValidateChannelIndex(channelIndex);
+							filter.channels.push_back(channelIndex);
+						}
+					});
+				}
+			});
 		}
 
 		void SetConfig(const toml::Table& table, Config& config) {
 			SetOption(table, "backend", config.backend);
 			SetOption(table, "bufferSizeSamples", config.bufferSizeSamples, ValidateBufferSize);
+			SetOption(table, "hotStandby", config.hotStandby);
 			ProcessTypedOption<toml::Table>(table, "input", [&](const toml::Table& table) { SetStream(table, config.input); });
 			ProcessTypedOption<toml::Table>(table, "output", [&](const toml::Table& table) { SetStream(table, config.output); });
 		}
 
 
-		Config LoadConfig(const std::filesystem::path& path) {
+		// Profiles are merged on top of the global configuration, following the same rules as the global configuration itself.
+		// All profiles are validated, not just the one that applies, so that mistakes are caught regardless of the application.
+		std::optional<std::string> ApplyProfile(const toml::Table& table, const std::wstring& executableName, Config& config) {
+			std::optional<std::string> activeProfile;
+			std::optional<Config> activeProfileConfig;
+			ProcessTypedOption<toml::Table>(table, "profile", [&](const toml::Table& profiles) {
+				for (const auto& [profile, profileTable] : profiles) {
+					try {
+						Config profileConfig = config;
+						SetConfig(profileTable.as<toml::Table>(), profileConfig);
+						// Executable file names are case-insensitive.
+						if (executableName.empty() || ::CompareStringOrdinal(ConvertFromUTF8(profile).c_str(), -1, executableName.c_str(), -1, TRUE) != CSTR_EQUAL) continue;
+						if (activeProfile.has_value()) throw std::runtime_error("profile '" + *activeProfile + "' also applies to the same application");
+						activeProfile = profile;
+						activeProfileConfig = std::move(profileConfig);
+					}
+					catch (const std::exception& exception) {
+						throw std::runtime_error("in profile '" + profile + "': " + exception.what());
+					}
+				}
+			});
+			if (activeProfileConfig.has_value()) config = std::move(*activeProfileConfig);
+			return activeProfile;
+		}
+
+		Config LoadConfig(const std::filesystem::path& path, const std::wstring& executableName, std::string& text, std::optional<std::string>& profile) {
 			toml::Value tomlValue;
 			try {
-				tomlValue = LoadConfigToml(path);
+				tomlValue = LoadConfigToml(path, text);
 			}
 			catch (...) {
 				std::throw_with_nested(std::runtime_error("Unable to load configuration file"));
@@ -130,7 +230,10 @@ namespace flexasio {
 
 			try {
 				Config config;
-				SetConfig(tomlValue.as<toml::Table>(), config);
+				const auto& table = tomlValue.as<toml::Table>();
+				SetConfig(table, config);
+				profile = ApplyProfile(table, executableName, config);
+				if (profile.has_value()) Log() << "Using configuration profile: " << *profile;
 				return config;
 			}
 			catch (...) {
@@ -138,6 +241,26 @@ namespace flexasio {
 			}
 		}
 
+		// Returns the file name of the host application executable, or an empty string if it cannot be determined.
+		std::wstring GetExecutableName() {
+			std::wstring path(MAX_PATH, L'\0');
+			for (;;) {
+				const auto size = ::GetModuleFileNameW(NULL, path.data(), DWORD(path.size()));
+				if (size == 0) {
+					Log() << "Unable to get executable path, error " << ::GetLastError() << "; configuration profiles will not be used";
+					return {};
+				}
+				if (size < path.size()) {
+					path.resize(size);
+					break;
+				}
+				path.resize(path.size() * 2);
+			}
+			const auto executableName = std::filesystem::path(path).filename().wstring();
+			Log() << "Host application executable: " << ConvertToUTF8(executableName);
+			return executableName;
+		}
+
 		struct HandleCloser {
 			void operator()(HANDLE handle) {
 				if (::CloseHandle(handle) == 0)
@@ -164,9 +287,10 @@ namespace flexasio {
 
 	}
 
-	ConfigLoader::Watcher::Watcher(const ConfigLoader& configLoader, std::function<void()> onConfigChange) :
+	ConfigLoader::Watcher::Watcher(const ConfigLoader& configLoader, std::function<void(const Config&)> onConfigChange) :
 		configLoader(configLoader),
-		onConfigChange(std::move(onConfigChange)) {
+		onConfigChange(std::move(onConfigChange)),
+		currentConfig(configLoader.Initial()) {
 		// Trigger an initial event so that if the config has already changed we fire the callback immediately inline.
 		OnConfigFileEvent();
 
@@ -371,25 +495,29 @@ namespace flexasio {
 
 	ConfigLoader::ConfigLoader() :
 		configDirectory(GetUserDirectory()),
-		initialConfig(LoadConfig(configDirectory / configFileName)) {}
+		executableName(GetExecutableName()),
+		initialConfig(LoadConfig(configDirectory / configFileName, executableName, initialText, initialProfile)) {}
 
 	void ConfigLoader::Watcher::OnConfigFileEvent() {
 		Log() << "Handling config file event";
 
 		Config newConfig;
 		try {
-			newConfig = LoadConfig(configLoader.configDirectory / configFileName);
+			std::string text;
+			std::optional<std::string> profile;
+			newConfig = LoadConfig(configLoader.configDirectory / configFileName, configLoader.executableName, text, profile);
 		}
 		catch (const std::exception& exception) {
 			Log() << "Unable to load config, ignoring event: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
 			return;
 		}
-		if (newConfig == configLoader.Initial()) {
-			Log() << "New config is identical to initial config, not taking any action";
+		if (newConfig == currentConfig) {
+			Log() << "New config is identical to current config, not taking any action";
 			return;
 		}
 
-		onConfigChange();
+		onConfigChange(newConfig);
+		currentConfig = std::move(newConfig);
 	}
 
 }
\ No newline at end of file
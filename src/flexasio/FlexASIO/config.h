@@ -40,25 +40,58 @@ namespace flexasio {
 
 		std::optional<std::string> backend;
 		std::optional<int64_t> bufferSizeSamples;
+		bool hotStandby = false;
 
 		struct Stream {			
 			Device device;
 			std::optional<int> channels;
 			std::optional<std::string> sampleType;
+			std::optional<std::string> deviceSampleType;
+			bool dither = false;
+			bool interleaved = false;
 			std::optional<double> suggestedLatencySeconds;
 			bool wasapiExclusiveMode = false;
 			bool wasapiAutoConvert = true;
 			bool wasapiExplicitSampleFormat = true;
+			std::optional<int> latencyCalibrationChannel;
+			std::vector<int> mutedChannels;
+			// Device channel for each ASIO channel. Empty means ASIO channels map to device channels one to one.
+			std::vector<int> channelMap;
+			// One row of gains per destination channel, i.e. per device channel for output and per ASIO channel for input.
+			std::vector<std::vector<double>> mixingMatrix;
+			// Number of ASIO channels to mix from/to device channels, using conventional speaker layouts.
+			std::optional<int> mixingChannels;
+			struct EqualizerFilter final {
+				std::string type;
+				double frequency = 0;
+				double q = 0.7071;
+				double gain = 0;
+				// ASIO channels the filter applies to. Empty means all channels.
+				std::vector<int> channels;
+
+				bool operator==(const EqualizerFilter&) const = default;
+			};
+			// Applied in order.
+			std::vector<EqualizerFilter> equalizer;
 
 			bool operator==(const Stream& other) const {
 				return
 					device == other.device &&
 					channels == other.channels &&
 					sampleType == other.sampleType &&
+					deviceSampleType == other.deviceSampleType &&
+					dither == other.dither &&
+					interleaved == other.interleaved &&
 					suggestedLatencySeconds == other.suggestedLatencySeconds &&
 					wasapiExclusiveMode == other.wasapiExclusiveMode &&
 					wasapiAutoConvert == other.wasapiAutoConvert &&
-					wasapiExplicitSampleFormat == other.wasapiExplicitSampleFormat;
+					wasapiExplicitSampleFormat == other.wasapiExplicitSampleFormat &&
+					latencyCalibrationChannel == other.latencyCalibrationChannel &&
+					mutedChannels == other.mutedChannels &&
+					channelMap == other.channelMap &&
+					mixingMatrix == other.mixingMatrix &&
+					mixingChannels == other.mixingChannels &&
+					equalizer == other.equalizer;
 			}
 		};
 		Stream input;
@@ -68,6 +101,7 @@ namespace flexasio {
 			return
 				backend == other.backend &&
 				bufferSizeSamples == other.bufferSizeSamples &&
+				hotStandby == other.hotStandby &&
 				input == other.input &&
 				output == other.output;
 		}
@@ -78,10 +112,16 @@ namespace flexasio {
 		ConfigLoader();
 
 		const Config& Initial() const { return initialConfig; }
+		// The raw contents of the configuration file Initial() was parsed from (empty if there is no such file).
+		const std::string& InitialText() const { return initialText; }
+		// The name of the profile that was merged into Initial(), if any.
+		const std::optional<std::string>& InitialProfile() const { return initialProfile; }
 
 		class Watcher {
 		public:
-			Watcher(const ConfigLoader& configLoader, std::function<void()> onConfigChange);
+			// onConfigChange is called with the new config whenever the config file changes to something that differs from the
+			// config the previous call was made with (or the initial config, for the first call).
+			Watcher(const ConfigLoader& configLoader, std::function<void(const Config&)> onConfigChange);
 			~Watcher() noexcept(false);
 
 		private:
@@ -117,7 +157,8 @@ namespace flexasio {
 			void OnConfigFileEvent();
 
 			const ConfigLoader& configLoader;
-			const std::function<void()> onConfigChange;
+			const std::function<void(const Config&)> onConfigChange;
+			Config currentConfig;
 			
 			std::binary_semaphore stopSemaphore{0};
 			std::mutex directoryMutex;
@@ -128,6 +169,10 @@ namespace flexasio {
 
 	private:
 		const std::filesystem::path configDirectory;
+		// Used to select the profile that applies. Empty if unknown.
+		const std::wstring executableName;
+		std::string initialText;
+		std::optional<std::string> initialProfile;
 		const Config initialConfig;
 	};
 
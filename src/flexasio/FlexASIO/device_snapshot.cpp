@@ -0,0 +1,169 @@
+#define _CRT_SECURE_NO_WARNINGS  // Avoid issues with toml.h
+
+#include "device_snapshot.h"
+
+#include <dechamps_cpputil/exception.h>
+#include <toml/toml.h>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "log.h"
+#include "../FlexASIOUtil/toml.h"
+
+namespace flexasio {
+
+	namespace {
+
+		// Bump this whenever the file format changes in an incompatible way.
+		constexpr int64_t formatVersion = 1;
+
+		const toml::Value& GetTableValue(const toml::Table& table, const std::string& key) {
+			const auto value = table.find(key);
+			if (value == table.end()) throw std::runtime_error("missing '" + key + "' key");
+			return value->second;
+		}
+
+		std::string FormatHash(uint64_t hash) {
+			std::stringstream result;
+			result << std::hex << std::setw(16) << std::setfill('0') << hash;
+			return result.str();
+		}
+
+		uint64_t ParseHash(const std::string& hash) {
+			return std::stoull(hash, nullptr, 16);
+		}
+
+		std::optional<DeviceSnapshot::Stream> ParseStream(const toml::Table& root, const std::string& key) {
+			const auto value = root.find(key);
+			if (value == root.end()) return std::nullopt;
+			const auto& table = value->second.as<toml::Table>();
+			return DeviceSnapshot::Stream{
+				.channelCount = long(GetTableValue(table, "channels").as<int64_t>()),
+				.sampleType = ASIOSampleType(GetTableValue(table, "asioSampleType").as<int64_t>()),
+				.channelMask = DWORD(GetTableValue(table, "channelMask").as<int64_t>()),
+			};
+		}
+
+		DeviceCapabilities ParseCapabilities(const toml::Table& root) {
+			DeviceCapabilities capabilities;
+			if (const auto sampleRates = root.find("sampleRates"); sampleRates != root.end())
+				for (const auto& entry : sampleRates->second.as<toml::Array>()) {
+					const auto& table = entry.as<toml::Table>();
+					capabilities.sampleRates.emplace(GetTableValue(table, "sampleRate").as<double>(), DeviceCapabilities::SampleRateSupport{
+						.input = GetTableValue(table, "input").as<bool>(),
+						.output = GetTableValue(table, "output").as<bool>(),
+					});
+				}
+			if (const auto probedLatencies = root.find("probedLatencies"); probedLatencies != root.end())
+				for (const auto& entry : probedLatencies->second.as<toml::Array>()) {
+					const auto& table = entry.as<toml::Table>();
+					const auto getLatency = [&](const std::string& key) -> std::optional<long> {
+						const auto value = table.find(key);
+						if (value == table.end()) return std::nullopt;
+						return long(value->second.as<int64_t>());
+					};
+					capabilities.probedLatencies.emplace(
+						std::make_pair(GetTableValue(table, "sampleRate").as<double>(), long(GetTableValue(table, "bufferSizeInFrames").as<int64_t>())),
+						DeviceCapabilities::ProbedLatencies{ .input = getLatency("input"), .output = getLatency("output") });
+				}
+			return capabilities;
+		}
+
+		void WriteCapabilities(std::ostream& stream, const DeviceCapabilities& capabilities) {
+			for (const auto& [sampleRate, support] : capabilities.sampleRates) {
+				stream << std::endl << "[[sampleRates]]" << std::endl;
+				stream << "sampleRate = " << std::showpoint << sampleRate << std::noshowpoint << std::endl;
+				stream << "input = " << (support.input ? "true" : "false") << std::endl;
+				stream << "output = " << (support.output ? "true" : "false") << std::endl;
+			}
+			for (const auto& [parameters, latencies] : capabilities.probedLatencies) {
+				stream << std::endl << "[[probedLatencies]]" << std::endl;
+				stream << "sampleRate = " << std::showpoint << parameters.first << std::noshowpoint << std::endl;
+				stream << "bufferSizeInFrames = " << parameters.second << std::endl;
+				if (latencies.input.has_value()) stream << "input = " << *latencies.input << std::endl;
+				if (latencies.output.has_value()) stream << "output = " << *latencies.output << std::endl;
+			}
+		}
+
+		void WriteStream(std::ostream& stream, std::string_view key, const std::optional<DeviceSnapshot::Stream>& snapshotStream) {
+			if (!snapshotStream.has_value()) return;
+			stream << std::endl << "[" << key << "]" << std::endl;
+			stream << "channels = " << snapshotStream->channelCount << std::endl;
+			stream << "asioSampleType = " << snapshotStream->sampleType << std::endl;
+			stream << "channelMask = " << snapshotStream->channelMask << std::endl;
+		}
+
+	}
+
+	std::optional<DeviceCache> LoadDeviceCache(const std::filesystem::path& path, const DeviceSnapshotKey& key) {
+		Log() << "Loading device cache from " << path;
+
+		std::ifstream stream(path);
+		if (!stream.is_open()) {
+			Log() << "Unable to open device cache file";
+			return std::nullopt;
+		}
+
+		try {
+			const auto parseResult = toml::parse(stream);
+			if (!parseResult.valid()) throw std::runtime_error(parseResult.errorReason);
+			const auto& root = parseResult.value.as<toml::Table>();
+
+			if (GetTableValue(root, "formatVersion").as<int64_t>() != formatVersion) {
+				Log() << "Device cache uses a different format version";
+				return std::nullopt;
+			}
+			const DeviceSnapshotKey snapshotKey = {
+				.driverVersion = GetTableValue(root, "driverVersion").as<std::string>(),
+				.configuration = ParseHash(GetTableValue(root, "configuration").as<std::string>()),
+				.deviceTopology = ParseHash(GetTableValue(root, "deviceTopology").as<std::string>()),
+			};
+			if (snapshotKey != key) {
+				Log() << "Device cache is stale (driver version, configuration or device topology changed)";
+				return std::nullopt;
+			}
+
+			return DeviceCache{
+				.snapshot = {
+					.hostApiType = PaHostApiTypeId(GetTableValue(root, "hostApiType").as<int64_t>()),
+					.input = ParseStream(root, "input"),
+					.output = ParseStream(root, "output"),
+					.defaultSampleRate = GetTableValue(root, "defaultSampleRate").as<double>(),
+				},
+				.capabilities = ParseCapabilities(root),
+			};
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to parse device cache, ignoring it: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			return std::nullopt;
+		}
+	}
+
+	void SaveDeviceCache(const std::filesystem::path& path, const DeviceSnapshotKey& key, const DeviceCache& cache) {
+		Log() << "Saving device cache to " << path;
+
+		// Write to a temporary file first, so that a concurrent reader never observes a partially written file.
+		auto temporaryPath = path;
+		temporaryPath += L".tmp";
+		{
+			std::ofstream stream;
+			stream.exceptions(stream.badbit | stream.failbit);
+			stream.open(temporaryPath);
+			stream << "# FlexASIO device cache. This file is generated automatically and can be safely deleted." << std::endl;
+			stream << std::setprecision(17);
+			stream << "formatVersion = " << formatVersion << std::endl;
+			stream << "driverVersion = " << EscapeTomlString(key.driverVersion) << std::endl;
+			stream << "configuration = " << EscapeTomlString(FormatHash(key.configuration)) << std::endl;
+			stream << "deviceTopology = " << EscapeTomlString(FormatHash(key.deviceTopology)) << std::endl;
+			stream << "hostApiType = " << int(cache.snapshot.hostApiType) << std::endl;
+			stream << "defaultSampleRate = " << std::showpoint << cache.snapshot.defaultSampleRate << std::noshowpoint << std::endl;
+			WriteStream(stream, "input", cache.snapshot.input);
+			WriteStream(stream, "output", cache.snapshot.output);
+			WriteCapabilities(stream, cache.capabilities);
+		}
+		std::filesystem::rename(temporaryPath, path);
+	}
+
+}
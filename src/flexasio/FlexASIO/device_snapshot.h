@@ -0,0 +1,77 @@
+#pragma once
+
+#include <dechamps_ASIOUtil/asiosdk/asiosys.h>
+#include <dechamps_ASIOUtil/asiosdk/asio.h>
+
+#include <portaudio.h>
+
+#include <windows.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace flexasio {
+
+	// The outcome of device and format selection for a given configuration, i.e. everything needed to answer the queries that ASIO
+	// host applications make when they merely scan installed drivers (channel counts and names, sample types, buffer sizes, sample
+	// rate). It is persisted so that subsequent driver instances can answer these without initializing PortAudio.
+	struct DeviceSnapshot final {
+		struct Stream final {
+			long channelCount;
+			ASIOSampleType sampleType;
+			DWORD channelMask;
+
+			bool operator==(const Stream&) const = default;
+		};
+
+		PaHostApiTypeId hostApiType;
+		// nullopt if there is no device in that direction.
+		std::optional<Stream> input;
+		std::optional<Stream> output;
+		double defaultSampleRate;
+
+		bool operator==(const DeviceSnapshot&) const = default;
+	};
+
+	// A snapshot can only be reused if all of these are the same as when it was taken.
+	struct DeviceSnapshotKey final {
+		std::string driverVersion;
+		uint64_t configuration;
+		uint64_t deviceTopology;
+
+		bool operator==(const DeviceSnapshotKey&) const = default;
+	};
+
+	// Results of the expensive queries that the driver makes on the devices described by a DeviceSnapshot. These are only ever
+	// added to, so unlike the snapshot itself they are not expected to be known in full.
+	struct DeviceCapabilities final {
+		struct SampleRateSupport final {
+			bool input;
+			bool output;
+		};
+		// Stream latencies reported by PortAudio when probing each direction on its own, in frames. nullopt if the probe failed.
+		struct ProbedLatencies final {
+			std::optional<long> input;
+			std::optional<long> output;
+		};
+
+		std::map<double, SampleRateSupport> sampleRates;
+		// Keyed by sample rate and buffer size in frames.
+		std::map<std::pair<double, long>, ProbedLatencies> probedLatencies;
+	};
+
+	// What is persisted to disk.
+	struct DeviceCache final {
+		DeviceSnapshot snapshot;
+		DeviceCapabilities capabilities;
+	};
+
+	// Returns nullopt if there is no cache for this key.
+	std::optional<DeviceCache> LoadDeviceCache(const std::filesystem::path&, const DeviceSnapshotKey&);
+	void SaveDeviceCache(const std::filesystem::path&, const DeviceSnapshotKey&, const DeviceCache&);
+
+}
@@ -1,15 +1,23 @@
 #include "flexasio.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <numbers>
+#include <numeric>
 #include <string>
 #include <sstream>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <MMReg.h>
 
+#include <dechamps_CMakeUtils/version.h>
+
 #include <dechamps_cpputil/endian.h>
 #include <dechamps_cpputil/exception.h>
 #include <dechamps_cpputil/string.h>
@@ -19,27 +27,16 @@
 #include "portaudio.h"
 #include "pa_win_wasapi.h"
 
+#include "capability_matrix.h"
 #include "control_panel.h"
 #include "log.h"
+#include "realtime_sanitizer.h"
+#include "../FlexASIOUtil/device_topology.h"
+#include "../FlexASIOUtil/shell.h"
+#include "../FlexASIOUtil/windows_com.h"
 
 namespace flexasio {
 
-	FlexASIO::PortAudioHandle::PortAudioHandle() {
-		Log() << "Initializing PortAudio";
-		PaError error = Pa_Initialize();
-		if (error != paNoError)
-			throw ASIOException(ASE_HWMalfunction, std::string("could not initialize PortAudio: ") + Pa_GetErrorText(error));
-		Log() << "PortAudio initialization successful";
-	}
-	FlexASIO::PortAudioHandle::~PortAudioHandle() {
-		Log() << "Terminating PortAudio";
-		PaError error = Pa_Terminate();
-		if (error != paNoError)
-			Log() << "PortAudio termination failed with " << Pa_GetErrorText(error);
-		else
-			Log() << "PortAudio terminated successfully";
-	}
-
 	FlexASIO::Win32HighResolutionTimer::Win32HighResolutionTimer() {
 		Log() << "Starting high resolution timer";
 		timeBeginPeriod(1);
@@ -156,16 +153,7 @@ namespace flexasio {
 				});
 		}
 
-		ASIOSampleRate GetDefaultSampleRate(const std::optional<Device>& inputDevice, const std::optional<Device>& outputDevice) {
-			if (previousSampleRate.has_value()) {
-				// Work around a REW bug. See https://github.com/dechamps/FlexASIO/issues/31
-				// Another way of doing this would have been to only pick this sample rate if the application
-				// didn't enquire about sample rate at createBuffers() time, but that doesn't work as well because
-				// the default buffer size would be wrong.
-				Log() << "Using default sample rate " << *previousSampleRate << " Hz from a previous instance of the driver";
-				return *previousSampleRate;
-			}
-
+		ASIOSampleRate GetDeviceDefaultSampleRate(const std::optional<Device>& inputDevice, const std::optional<Device>& outputDevice) {
 			ASIOSampleRate sampleRate = 0;
 			if (inputDevice.has_value()) {
 				sampleRate = (std::max)(sampleRate, inputDevice->info.defaultSampleRate);
@@ -174,10 +162,23 @@ namespace flexasio {
 				sampleRate = (std::max)(sampleRate, outputDevice->info.defaultSampleRate);
 			}
 			if (sampleRate == 0) sampleRate = 44100;
-			Log() << "Default sample rate: " << sampleRate;
 			return sampleRate;
 		}
 
+		ASIOSampleRate GetDefaultSampleRate(ASIOSampleRate deviceDefaultSampleRate) {
+			if (previousSampleRate.has_value()) {
+				// Work around a REW bug. See https://github.com/dechamps/FlexASIO/issues/31
+				// Another way of doing this would have been to only pick this sample rate if the application
+				// didn't enquire about sample rate at createBuffers() time, but that doesn't work as well because
+				// the default buffer size would be wrong.
+				Log() << "Using default sample rate " << *previousSampleRate << " Hz from a previous instance of the driver";
+				return *previousSampleRate;
+			}
+
+			Log() << "Default sample rate: " << deviceDefaultSampleRate;
+			return deviceDefaultSampleRate;
+		}
+
 		long Message(decltype(ASIOCallbacks::asioMessage) asioMessage, long selector, long value, void* message, double* opt) {
 			Log() << "Sending message: selector = " << ::dechamps_ASIOUtil::GetASIOMessageSelectorString(selector) << ", value = " << value << ", message = " << message << ", opt = " << opt;
 			const auto result = asioMessage(selector, value, message, opt);
@@ -200,6 +201,15 @@ namespace flexasio {
 				case kAsioEngineVersion:
 					Message(asioMessage, kAsioEngineVersion, 0, nullptr, nullptr);
 					break;
+				case kAsioSupportsInputMonitor:
+				case kAsioSupportsInputGain:
+				case kAsioSupportsInputMeter:
+				case kAsioSupportsOutputGain:
+				case kAsioSupportsOutputMeter:
+					// FlexASIO implements all of these, so it is useful to know if the host application would make use of them.
+					if (Message(asioMessage, selector, 0, nullptr, nullptr) == 1)
+						Log() << "Host supports " << ::dechamps_ASIOUtil::GetASIOMessageSelectorString(selector);
+					break;
 				}
 			}
 		}
@@ -210,6 +220,41 @@ namespace flexasio {
 			return paContinue;
 		}
 
+		// Returns the number of channels, starting from the first one, that covers every input or output channel the host application
+		// created buffers for.
+		size_t GetBufferInfosChannelSpan(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input) {
+			long channelSpan = 0;
+			for (const auto& bufferInfo : bufferInfos)
+				if (!bufferInfo.isInput == !input) channelSpan = (std::max)(channelSpan, bufferInfo.channelNum + 1);
+			return size_t(channelSpan);
+		}
+
+		// One cascade per channel, containing the filters that apply to that channel, in order.
+		// Filters that cannot exist at the current sample rate are left out, so that changing the sample rate never prevents the stream
+		// from starting.
+		std::vector<std::vector<BiquadCoefficients>> GetEqualizerCascades(const std::vector<Config::Stream::EqualizerFilter>& filters, const size_t channelCount, const ASIOSampleRate sampleRate) {
+			std::vector<std::vector<BiquadCoefficients>> cascades(channelCount);
+			for (size_t filterIndex = 0; filterIndex < filters.size(); ++filterIndex) {
+				const auto& filter = filters[filterIndex];
+				if (!(filter.frequency < sampleRate / 2)) {
+					Log() << "Skipping equalizer filter #" << filterIndex << " because its frequency (" << filter.frequency << " Hz) is not below half the sample rate (" << sampleRate << " Hz)";
+					continue;
+				}
+				const auto coefficients = [&] {
+					try {
+						return DesignBiquad(ParseBiquadType(filter.type).value(), sampleRate, filter.frequency, filter.q, filter.gain);
+					}
+					catch (...) {
+						std::throw_with_nested(std::runtime_error("unable to set up equalizer filter #" + std::to_string(filterIndex)));
+					}
+				}();
+				for (size_t channel = 0; channel < channelCount; ++channel)
+					if (filter.channels.empty() || std::find(filter.channels.begin(), filter.channels.end(), int(channel)) != filter.channels.end())
+						cascades[channel].push_back(coefficients);
+			}
+			return cascades;
+		}
+
 		long GetBufferInfosChannelCount(const ASIOBufferInfo* asioBufferInfos, const long numChannels, const bool input) {
 			long result = 0;
 			for (long channelIndex = 0; channelIndex < numChannels; ++channelIndex)
@@ -218,21 +263,127 @@ namespace flexasio {
 			return result;
 		}
 
-		void CopyFromPortAudioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const std::byte* const* portAudioBuffers, const size_t bufferSizeInBytes) {
+		// Returns the number of device channels, starting from the first one, that covers every device channel an active ASIO channel is routed to.
+		int GetDeviceChannelSpan(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input, const std::vector<int>& channelMap) {
+			int channelSpan = 0;
+			for (const auto& bufferInfo : bufferInfos)
+				if (!bufferInfo.isInput == !input)
+					channelSpan = (std::max)(channelSpan, channelMap[bufferInfo.channelNum] + 1);
+			return channelSpan;
+		}
+
+		// Keeps the speaker positions of the first `channelCount` channels.
+		DWORD GetFirstChannelsMask(const DWORD channelMask, int channelCount) {
+			DWORD firstChannelsMask = 0;
+			for (DWORD speaker = 1; speaker != 0 && channelCount > 0; speaker <<= 1) {
+				if ((channelMask & speaker) == 0) continue;
+				firstChannelsMask |= speaker;
+				--channelCount;
+			}
+			return firstChannelsMask;
+		}
+
+		// Same as GetDeviceChannelSpan(), for channels that are mixed. Device channels that active ASIO channels are not mixed from/to do
+		// not need to be covered.
+		int GetMixingDeviceChannelSpan(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input, const MixingMatrix& mixingMatrix) {
+			int channelSpan = 0;
+			for (const auto& bufferInfo : bufferInfos) {
+				if (!bufferInfo.isInput != !input) continue;
+				// The stream still needs to be opened if all gains are zero.
+				channelSpan = (std::max)(channelSpan, 1);
+				const auto asioChannel = size_t(bufferInfo.channelNum);
+				const auto deviceChannelCount = input ? mixingMatrix.GetInputChannelCount() : mixingMatrix.GetOutputChannelCount();
+				for (size_t deviceChannel = 0; deviceChannel < deviceChannelCount; ++deviceChannel)
+					if ((input ? mixingMatrix.GetGain(asioChannel, deviceChannel) : mixingMatrix.GetGain(deviceChannel, asioChannel)) != 0.0f)
+						channelSpan = (std::max)(channelSpan, int(deviceChannel) + 1);
+			}
+			return channelSpan;
+		}
+
+		std::optional<MixingMatrix> SelectMixingMatrix(const Config::Stream& streamConfig, const bool output, const int deviceChannelCount, const DWORD deviceChannelMask) {
+			if (!streamConfig.mixingMatrix.empty() && streamConfig.mixingChannels.has_value()) throw std::runtime_error("the mixingMatrix and mixingChannels options cannot be used at the same time");
+			if (streamConfig.mixingMatrix.empty() && !streamConfig.mixingChannels.has_value()) return std::nullopt;
+			if (!streamConfig.channelMap.empty()) throw std::runtime_error("the channelMap option cannot be used at the same time as mixing");
+
+			MixingGains gains;
+			if (streamConfig.mixingChannels.has_value()) {
+				const auto asioChannelMask = GetDefaultChannelMask(*streamConfig.mixingChannels);
+				if (asioChannelMask == 0) throw std::runtime_error("there is no conventional speaker layout for " + std::to_string(*streamConfig.mixingChannels) + " channels, use the mixingMatrix option instead");
+				// The device channel mask is only known with WASAPI, if the channel count is not set explicitly.
+				const auto deviceSpeakers = deviceChannelMask != 0 ? deviceChannelMask : GetDefaultChannelMask(deviceChannelCount);
+				if (deviceSpeakers == 0) throw std::runtime_error("the speaker layout of the device is unknown, use the mixingMatrix option instead");
+				Log() << "Mixing between ASIO channel layout " << GetWaveFormatChannelMaskString(asioChannelMask) << " and device channel layout " << GetWaveFormatChannelMaskString(deviceSpeakers);
+				gains = output ? GetDefaultMixingGains(asioChannelMask, deviceSpeakers) : GetDefaultMixingGains(deviceSpeakers, asioChannelMask);
+			}
+			else {
+				for (const auto& row : streamConfig.mixingMatrix) {
+					auto& rowGains = gains.emplace_back();
+					for (const auto gain : row) rowGains.push_back(static_cast<float>(gain));
+				}
+			}
+
+			MixingMatrix mixingMatrix(std::move(gains));
+			const auto matrixDeviceChannelCount = output ? mixingMatrix.GetOutputChannelCount() : mixingMatrix.GetInputChannelCount();
+			if (matrixDeviceChannelCount != size_t(deviceChannelCount))
+				throw std::runtime_error("the mixing matrix is for " + std::to_string(matrixDeviceChannelCount) + " device channels, but the device has " + std::to_string(deviceChannelCount) + " channels");
+			for (size_t row = 0; row < mixingMatrix.GetOutputChannelCount(); ++row) {
+				std::stringstream rowString;
+				for (size_t column = 0; column < mixingMatrix.GetInputChannelCount(); ++column) rowString << (column == 0 ? "" : " ") << mixingMatrix.GetGain(row, column);
+				Log() << "Mixing matrix row " << row << ": " << rowString.str();
+			}
+			return mixingMatrix;
+		}
+
+		std::vector<int> SelectChannelMap(const Config::Stream& streamConfig, const int deviceChannelCount) {
+			if (streamConfig.channelMap.empty()) {
+				std::vector<int> channelMap(size_t(deviceChannelCount));
+				std::iota(channelMap.begin(), channelMap.end(), 0);
+				return channelMap;
+			}
+			std::stringstream channelMapString;
+			for (size_t channel = 0; channel < streamConfig.channelMap.size(); ++channel) {
+				const auto deviceChannel = streamConfig.channelMap[channel];
+				if (deviceChannel >= deviceChannelCount)
+					throw std::runtime_error("channel map routes ASIO channel " + std::to_string(channel) + " to device channel " + std::to_string(deviceChannel) + ", but the device only has " + std::to_string(deviceChannelCount) + " channels");
+				channelMapString << (channel == 0 ? "" : ", ") << channel << " -> " << deviceChannel;
+			}
+			Log() << "Routing ASIO channels to device channels: " << channelMapString.str();
+			return streamConfig.channelMap;
+		}
+
+		// The sample format conversion is done as part of the copy, so that samples only go through the cache once.
+		void CopyFromPortAudioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, const long doubleBufferIndex, const std::byte* const* portAudioBuffers, const size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters) {
 			for (const auto& bufferInfo : bufferInfos)
 			{
 				if (!bufferInfo.isInput) continue;
-				memcpy(bufferInfo.buffers[doubleBufferIndex], portAudioBuffers[bufferInfo.channelNum], bufferSizeInBytes);
+				const auto asioBuffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+				if (liveParameters.IsMuted(bufferInfo.channelNum)) memset(asioBuffer, 0, frameCount * GetSampleFormatSize(converter.GetOutputFormat()));
+				else converter.Convert(portAudioBuffers[channelMap[bufferInfo.channelNum]], asioBuffer, frameCount);
 			}
 		}
-		void CopyToPortAudioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, std::byte* const* portAudioBuffers, const size_t bufferSizeInBytes) {
+		// Converts a buffer of samples, applying the gain of its channel on the way.
+		void ConvertWithGain(SampleConverter& converter, const std::byte* input, std::byte* output, const size_t frameCount, const GainChange& gain) {
+			if (gain.IsUnity()) converter.Convert(input, output, frameCount);
+			else converter.Convert(input, output, frameCount, gain.startGain, gain.endGain);
+		}
+
+		// Note: the PortAudio buffers are expected to be filled with silence beforehand.
+		void CopyToPortAudioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, const long doubleBufferIndex, std::byte* const* portAudioBuffers, const size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>& gains) {
 			for (const auto& bufferInfo : bufferInfos)
 			{
-				if (bufferInfo.isInput) continue;
-				memcpy(portAudioBuffers[bufferInfo.channelNum], bufferInfo.buffers[doubleBufferIndex], bufferSizeInBytes);
+				if (bufferInfo.isInput || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+				ConvertWithGain(converter, static_cast<const std::byte*>(bufferInfo.buffers[doubleBufferIndex]), portAudioBuffers[channelMap[bufferInfo.channelNum]], frameCount, gains[size_t(bufferInfo.channelNum)]);
 			}
 		}
 
+		SampleConverter MakeSampleConverter(std::string_view direction, SampleFormat inputFormat, SampleFormat outputFormat, bool dither) {
+			SampleConverter converter(inputFormat, outputFormat, dither);
+			Log() << "Converting " << direction << " samples from " << GetSampleFormatName(inputFormat) << " to " << GetSampleFormatName(outputFormat)
+				<< (converter.IsIdentity() ? " (no conversion)" : " using " + std::string(GetSimdImplementationName(converter.GetImplementation())) + " implementation")
+				<< (converter.IsDithering() ? ", with dither" : "");
+			return converter;
+		}
+
 		template <typename Enum> void IncrementEnum(Enum& value) {
 			value = static_cast<Enum>(std::underlying_type_t<Enum>(value) + 1);
 		}
@@ -241,17 +392,114 @@ namespace flexasio {
 			return 3 * bufferSizeInFrames / sampleRate;
 		}
 
+		// Long enough to avoid clicks when the host application changes gains, short enough to feel immediate.
+		constexpr double gainRampLengthInSeconds = 0.01;
+
+		constexpr auto latencyCalibrationCacheFileName = L"FlexASIO.latency.toml";
+		constexpr auto deviceCacheFileName = L"FlexASIO.devices.toml";
+
+		std::filesystem::path GetDeviceCachePath() {
+			return std::filesystem::path(GetUserDirectory()) / deviceCacheFileName;
+		}
+
+		std::optional<bool> GetForcedConcurrentFormatChecks() {
+#ifndef FLEXASIO_FORMAT_CHECKS
+			return std::nullopt;
+#else
+			char mode[16];
+			const auto modeSize = ::GetEnvironmentVariableA("FLEXASIO_FORMAT_CHECKS", mode, DWORD(std::size(mode)));
+			if (modeSize == 0 || modeSize >= std::size(mode)) return std::nullopt;
+			const std::string_view value(mode, modeSize);
+			Log() << "FLEXASIO_FORMAT_CHECKS is set to " << value << ", sample rate checks will bypass caches";
+			if (value == "concurrent") return true;
+			if (value == "sequential") return false;
+			Log() << "Unknown FLEXASIO_FORMAT_CHECKS value, ignoring";
+			return std::nullopt;
+#endif
+		}
+
+		std::optional<DeviceSnapshotKey> GetDeviceSnapshotKey(std::string_view configText, const std::optional<std::string>& profile) {
+			try {
+				return DeviceSnapshotKey{
+					.driverVersion = std::string(::dechamps_CMakeUtils_gitDescriptionDirty) + " " + BUILD_PLATFORM + " " + ::dechamps_CMakeUtils_buildTime,
+					// Applications that use different profiles end up with different configurations despite reading the same file.
+					.configuration = std::hash<std::string>()(std::string(configText) + '\0' + profile.value_or("")),
+					.deviceTopology = GetDeviceTopologyFingerprint(),
+				};
+			}
+			catch (const std::exception& exception) {
+				Log() << "Unable to compute device snapshot key, not using device snapshots: " << exception.what();
+				return std::nullopt;
+			}
+		}
+
+		// Checks a single stream direction at the device default sample rate. Results are recorded in the capability matrix, so that
+		// the device is only asked once per process.
+		bool IsNativeSampleFormatSupported(const PaHostApiTypeId hostApiTypeId, const Device& device, const bool output, const int channelCount, const PaSampleFormat sampleFormat, const unsigned long wasapiFlags, const DWORD channelMask, const std::optional<uint64_t> deviceTopology) {
+			PaStreamParameters parameters = { 0 };
+			parameters.device = device.index;
+			parameters.channelCount = channelCount;
+			parameters.sampleFormat = sampleFormat | paNonInterleaved;
+			PaWasapiStreamInfo wasapiStreamInfo = { 0 };
+			if (hostApiTypeId == paWASAPI) {
+				wasapiStreamInfo.size = sizeof(wasapiStreamInfo);
+				wasapiStreamInfo.hostApiType = paWASAPI;
+				wasapiStreamInfo.version = 1;
+				wasapiStreamInfo.flags = wasapiFlags;
+				wasapiStreamInfo.channelMask = channelMask;
+				parameters.hostApiSpecificStreamInfo = &wasapiStreamInfo;
+			}
+
+			const CapabilityMatrix::Key key = {
+				.hostApiType = hostApiTypeId,
+				.device = device.info.name,
+				.output = output,
+				.sampleRate = device.info.defaultSampleRate,
+				.channelCount = channelCount,
+				.sampleFormat = parameters.sampleFormat,
+				.wasapiFlags = wasapiFlags,
+				.channelMask = hostApiTypeId == paWASAPI ? channelMask : 0,
+				.exclusive = hostApiTypeId == paWDMKS || (wasapiFlags & paWinWasapiExclusive) != 0,
+			};
+			if (deviceTopology.has_value())
+				if (const auto supported = CapabilityMatrix::Find(*deviceTopology, key); supported.has_value()) {
+					Log() << "Using format support from capability matrix";
+					return *supported;
+				}
+
+			bool supported = true;
+			try {
+				CheckFormatSupported({
+					.inputParameters = output ? nullptr : &parameters,
+					.outputParameters = output ? &parameters : nullptr,
+					.sampleRate = device.info.defaultSampleRate,
+				});
+			}
+			catch (const std::exception& exception) {
+				Log() << "Format is not supported: " << exception.what();
+				supported = false;
+			}
+			if (deviceTopology.has_value()) CapabilityMatrix::Store(*deviceTopology, key, supported);
+			return supported;
+		}
+
 	}
 
-	constexpr FlexASIO::SampleType FlexASIO::float32 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTFloat32LSB : ASIOSTFloat32MSB, paFloat32, 4, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT };
-	constexpr FlexASIO::SampleType FlexASIO::int32 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt32LSB : ASIOSTInt32MSB, paInt32, 4, KSDATAFORMAT_SUBTYPE_PCM };
-	constexpr FlexASIO::SampleType FlexASIO::int24 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt24LSB : ASIOSTInt24MSB, paInt24, 3, KSDATAFORMAT_SUBTYPE_PCM };
-	constexpr FlexASIO::SampleType FlexASIO::int16 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt16LSB : ASIOSTInt16MSB, paInt16, 2, KSDATAFORMAT_SUBTYPE_PCM };
+	constexpr FlexASIO::SampleType FlexASIO::float32 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTFloat32LSB : ASIOSTFloat32MSB, paFloat32, 4, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, SampleFormat::FLOAT32 };
+	constexpr FlexASIO::SampleType FlexASIO::int32 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt32LSB : ASIOSTInt32MSB, paInt32, 4, KSDATAFORMAT_SUBTYPE_PCM, SampleFormat::INT32 };
+	constexpr FlexASIO::SampleType FlexASIO::int24 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt24LSB : ASIOSTInt24MSB, paInt24, 3, KSDATAFORMAT_SUBTYPE_PCM, SampleFormat::INT24 };
+	constexpr FlexASIO::SampleType FlexASIO::int16 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt16LSB : ASIOSTInt16MSB, paInt16, 2, KSDATAFORMAT_SUBTYPE_PCM, SampleFormat::INT16 };
+	constexpr FlexASIO::SampleType FlexASIO::int32LSB24 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt32LSB24 : ASIOSTInt32MSB24, 0, 4, KSDATAFORMAT_SUBTYPE_PCM, SampleFormat::INT32_LSB24 };
+	constexpr FlexASIO::SampleType FlexASIO::int32LSB16 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTInt32LSB16 : ASIOSTInt32MSB16, 0, 4, KSDATAFORMAT_SUBTYPE_PCM, SampleFormat::INT32_LSB16 };
+	constexpr FlexASIO::SampleType FlexASIO::float64 = { ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::LITTLE ? ASIOSTFloat64LSB : ASIOSTFloat64MSB, 0, 8, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, SampleFormat::FLOAT64 };
 	constexpr std::pair<std::string_view, FlexASIO::SampleType> FlexASIO::sampleTypes[] = {
 			{"Float32", float32},
 			{"Int32", int32},
 			{"Int24", int24},
 			{"Int16", int16},
+			{"Int32LSB24", int32LSB24},
+			{"Int32LSB16", int32LSB16},
+			{"Float64", float64},
 	};
 
 	FlexASIO::SampleType FlexASIO::ParseSampleType(const std::string_view str) {
@@ -263,31 +511,92 @@ namespace flexasio {
 	}
 
 	FlexASIO::SampleType FlexASIO::WaveFormatToSampleType(const WAVEFORMATEXTENSIBLE& waveFormat) {
-		const auto validBitsPerSample = waveFormat.Samples.wValidBitsPerSample != 0 ? waveFormat.Samples.wValidBitsPerSample : waveFormat.Format.wBitsPerSample;
+		// Windows puts samples in the most significant bits of their container, e.g. 24-bit samples in 32-bit containers have their
+		// least significant byte set to zero. The layout is therefore entirely determined by the container size: such a device can be
+		// opened as Int32 without any repacking, and the padding bits are just zero.
+		const auto containerBitsPerSample = waveFormat.Format.wBitsPerSample;
+		if (waveFormat.Samples.wValidBitsPerSample != 0 && waveFormat.Samples.wValidBitsPerSample != containerBitsPerSample)
+			Log() << "Wave format has " << waveFormat.Samples.wValidBitsPerSample << " valid bits in " << containerBitsPerSample << "-bit containers, selecting sample type based on container size";
 		for (const auto& [name, sampleType] : sampleTypes) {
-			if (sampleType.waveSubFormat == waveFormat.SubFormat && sampleType.size * 8 == validBitsPerSample) return sampleType;
+			if (sampleType.pa != 0 && sampleType.waveSubFormat == waveFormat.SubFormat && sampleType.size * 8 == containerBitsPerSample) return sampleType;
 		}
 		throw std::runtime_error(std::string("Unable to convert wave format to sample type: ") + DescribeWaveFormat(waveFormat));
 	}
 
-	FlexASIO::SampleType FlexASIO::SelectSampleType(const PaHostApiTypeId hostApiTypeId, const Device& device, const Config::Stream& streamConfig) {
+	FlexASIO::SampleType FlexASIO::SelectSampleType(const PaHostApiTypeId hostApiTypeId, const Device& device, const bool output, const int channelCount, const DWORD channelMask, const Config::Stream& streamConfig, const std::optional<uint64_t> deviceTopology) {
 		if (streamConfig.sampleType.has_value()) {
 			Log() << "Selecting sample type from configuration";
 			return ParseSampleType(*streamConfig.sampleType);
 		}
-		if (hostApiTypeId == paWASAPI && streamConfig.wasapiExclusiveMode) {
+		try {
+			const auto sampleType = NegotiateNativeSampleType(hostApiTypeId, device, output, channelCount, channelMask, streamConfig, deviceTopology);
+			if (sampleType.has_value()) return *sampleType;
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to negotiate native sample type: " << exception.what();
+		}
+		Log() << "Selecting default sample type";
+		return float32;
+	}
+
+	std::optional<FlexASIO::SampleType> FlexASIO::NegotiateNativeSampleType(const PaHostApiTypeId hostApiTypeId, const Device& device, const bool output, const int channelCount, const DWORD channelMask, const Config::Stream& streamConfig, const std::optional<uint64_t> deviceTopology) {
+		if (hostApiTypeId == paWASAPI && !streamConfig.wasapiExclusiveMode) {
+			const auto mixFormat = GetWasapiDeviceMixFormat(device.index);
+			Log() << "WASAPI device mix format: " << DescribeWaveFormat(mixFormat);
+			Log() << "WASAPI Shared mode detected, selecting sample type from WASAPI device mix format, which is the format the Windows audio engine processes samples in";
+			return WaveFormatToSampleType(mixFormat);
+		}
+		if (hostApiTypeId != paWASAPI && hostApiTypeId != paWDMKS) {
+			Log() << "Not negotiating sample type because this backend always goes through the Windows audio engine, which processes samples in 32-bit float";
+			return std::nullopt;
+		}
+
+		std::vector<SampleType> candidates;
+		unsigned long wasapiFlags = 0;
+		if (hostApiTypeId == paWASAPI) {
 			try {
-				Log() << "WASAPI Exclusive mode detected, selecting sample type from WASAPI device default format";
 				const auto deviceFormat = GetWasapiDeviceDefaultFormat(device.index);
 				Log() << "WASAPI device default format: " << DescribeWaveFormat(deviceFormat);
-				return WaveFormatToSampleType(deviceFormat);
+				candidates.push_back(WaveFormatToSampleType(deviceFormat));
 			}
 			catch (const std::exception& exception) {
-				Log() << "Unable to select sample type from WASAPI device default format: " << exception.what();
+				Log() << "Unable to use WASAPI device default format as a candidate: " << exception.what();
 			}
+			// Without an explicit sample format, PortAudio would silently fall back to another format, which is the very conversion
+			// negotiation is trying to avoid.
+			wasapiFlags = paWinWasapiExclusive | paWinWasapiExplicitSampleFormat;
+			if (channelMask != 0) wasapiFlags |= paWinWasapiUseChannelMask;
 		}
-		Log() << "Selecting default sample type";
-		return float32;
+		// Highest resolution first, so that nothing is lost if the device supports several types. Few devices handle 32-bit float
+		// natively.
+		for (const auto& candidate : { int32, int24, int16, float32 })
+			if (std::none_of(candidates.begin(), candidates.end(), [&](const SampleType& sampleType) { return sampleType.asio == candidate.asio; }))
+				candidates.push_back(candidate);
+
+		for (const auto& candidate : candidates) {
+			Log() << "Checking if device natively supports sample type " << DescribeSampleType(candidate);
+			if (!IsNativeSampleFormatSupported(hostApiTypeId, device, output, channelCount, candidate.pa, wasapiFlags, channelMask, deviceTopology)) continue;
+			Log() << "Selecting sample type " << DescribeSampleType(candidate) << " because the device supports it natively" << (candidate.asio == candidates.front().asio ? " and it is the preferred candidate" : "");
+			return candidate;
+		}
+		Log() << "Device does not natively support any candidate sample type";
+		return std::nullopt;
+	}
+
+	FlexASIO::SampleType FlexASIO::SelectDeviceSampleType(const SampleType& asioSampleType, const Config::Stream& streamConfig) {
+		if (!streamConfig.deviceSampleType.has_value()) {
+			if (asioSampleType.pa == 0) {
+				// Int32 holds the padded types without any loss of resolution, and only requires shifting samples.
+				Log() << "PortAudio does not support the ASIO sample type, using the closest type it supports for the device";
+				return asioSampleType.format == SampleFormat::FLOAT64 ? float32 : int32;
+			}
+			Log() << "Using the ASIO sample type for the device";
+			return asioSampleType;
+		}
+		Log() << "Selecting device sample type from configuration";
+		const auto sampleType = ParseSampleType(*streamConfig.deviceSampleType);
+		if (sampleType.pa == 0) throw std::runtime_error("'" + *streamConfig.deviceSampleType + "' cannot be used as a device sample type, because PortAudio does not support it");
+		return sampleType;
 	}
 
 	DWORD FlexASIO::SelectChannelMask(const PaHostApiTypeId hostApiTypeId, const Device& device, const Config::Stream& streamConfig) {
@@ -316,11 +625,10 @@ namespace flexasio {
 	}
 
 	std::string FlexASIO::DescribeSampleType(const SampleType& sampleType) {
-		return "ASIO " + ::dechamps_ASIOUtil::GetASIOSampleTypeString(sampleType.asio) + ", PortAudio " + GetSampleFormatString(sampleType.pa) + ", size " + std::to_string(sampleType.size);
+		return "ASIO " + ::dechamps_ASIOUtil::GetASIOSampleTypeString(sampleType.asio) + ", PortAudio " + (sampleType.pa == 0 ? "(none)" : GetSampleFormatString(sampleType.pa)) + ", size " + std::to_string(sampleType.size);
 	}
 
-	FlexASIO::FlexASIO(void* sysHandle) :
-		windowHandle(reinterpret_cast<decltype(windowHandle)>(sysHandle)),
+	FlexASIO::Devices::Devices(const Config& config, const std::optional<uint64_t> deviceTopology) :
 	portAudioDebugRedirector([](std::string_view str) { if (IsLoggingEnabled()) Log() << "[PortAudio] " << str; }),
 	hostApi([&] {
 		LogPortAudioApiList();
@@ -342,24 +650,108 @@ namespace flexasio {
 		if (device.has_value()) Log() << "Selected output device: " << *device;
 		else Log() << "No output device, proceeding without output";
 		return device;
+	}()),
+		inputChannelMask([&]() -> DWORD {
+		if (!inputDevice.has_value()) return 0;
+		try {
+			Log() << "Selecting input channel mask";
+			const auto channelMask = SelectChannelMask(hostApi.info.type, *inputDevice, config.input);
+			Log() << "Selected input channel mask: " << GetWaveFormatChannelMaskString(channelMask);
+			return channelMask;
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select input channel mask: ") + exception.what());
+			return 0;
+		}
+	}()),
+		outputChannelMask([&]() -> DWORD {
+		if (!outputDevice.has_value()) return 0;
+		try {
+			Log() << "Selecting output channel mask";
+			const auto channelMask = SelectChannelMask(hostApi.info.type, *outputDevice, config.output);
+			Log() << "Selected output channel mask: " << GetWaveFormatChannelMaskString(channelMask);
+			return channelMask;
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select output channel mask: ") + exception.what());
+			return 0;
+		}
+	}()),
+		inputChannelCount([&] {
+		if (!inputDevice.has_value()) return 0;
+		if (config.input.channels.has_value()) return *config.input.channels;
+		return inputDevice->info.maxInputChannels;
+	}()),
+		outputChannelCount([&] {
+		if (!outputDevice.has_value()) return 0;
+		if (config.output.channels.has_value()) return *config.output.channels;
+		return outputDevice->info.maxOutputChannels;
+	}()),
+		inputMixingMatrix([&]() -> std::optional<MixingMatrix> {
+		if (!inputDevice.has_value()) return std::nullopt;
+		try {
+			return SelectMixingMatrix(config.input, /*output=*/false, inputChannelCount, inputChannelMask);
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select input mixing matrix: ") + exception.what());
+		}
+	}()),
+		outputMixingMatrix([&]() -> std::optional<MixingMatrix> {
+		if (!outputDevice.has_value()) return std::nullopt;
+		try {
+			return SelectMixingMatrix(config.output, /*output=*/true, outputChannelCount, outputChannelMask);
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select output mixing matrix: ") + exception.what());
+		}
+	}()),
+		inputChannelMap([&]() -> std::vector<int> {
+		if (!inputDevice.has_value() || inputMixingMatrix.has_value()) return {};
+		try {
+			return SelectChannelMap(config.input, inputChannelCount);
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select input channel map: ") + exception.what());
+		}
+	}()),
+		outputChannelMap([&]() -> std::vector<int> {
+		if (!outputDevice.has_value() || outputMixingMatrix.has_value()) return {};
+		try {
+			return SelectChannelMap(config.output, outputChannelCount);
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select output channel map: ") + exception.what());
+		}
 	}()),
 		inputSampleType([&]() -> std::optional<SampleType> {
 		if (!inputDevice.has_value()) return std::nullopt;
 		try {
 			Log() << "Selecting input sample type";
-			const auto sampleType = SelectSampleType(hostApi.info.type, *inputDevice, config.input);
+			const auto sampleType = SelectSampleType(hostApi.info.type, *inputDevice, /*output=*/false, inputChannelCount, inputChannelMask, config.input, deviceTopology);
 			Log() << "Selected input sample type: " << DescribeSampleType(sampleType);
 			return sampleType;
 		}
 		catch (const std::exception& exception) {
 			throw std::runtime_error(std::string("Could not select input sample type: ") + exception.what());
 		}
+	}()),
+		inputDeviceSampleType([&]() -> std::optional<SampleType> {
+		if (!inputSampleType.has_value()) return std::nullopt;
+		try {
+			Log() << "Selecting input device sample type";
+			const auto sampleType = SelectDeviceSampleType(*inputSampleType, config.input);
+			Log() << "Selected input device sample type: " << DescribeSampleType(sampleType);
+			return sampleType;
+		}
+		catch (const std::exception& exception) {
+			throw std::runtime_error(std::string("Could not select input device sample type: ") + exception.what());
+		}
 	}()),
 		outputSampleType([&]() -> std::optional<SampleType> {
 		if (!outputDevice.has_value()) return std::nullopt;
 		try {
 			Log() << "Selecting output sample type";
-			const auto sampleType = SelectSampleType(hostApi.info.type, *outputDevice, config.output);
+			const auto sampleType = SelectSampleType(hostApi.info.type, *outputDevice, /*output=*/true, outputChannelCount, outputChannelMask, config.output, deviceTopology);
 			Log() << "Selected output sample type: " << DescribeSampleType(sampleType);
 			return sampleType;
 		}
@@ -367,56 +759,214 @@ namespace flexasio {
 			throw std::runtime_error(std::string("Could not select output sample type: ") + exception.what());
 		}
 	}()),
-		inputChannelMask([&]() -> DWORD {
-		if (!inputDevice.has_value()) return 0;
+		outputDeviceSampleType([&]() -> std::optional<SampleType> {
+		if (!outputSampleType.has_value()) return std::nullopt;
 		try {
-			Log() << "Selecting input channel mask";
-			const auto channelMask = SelectChannelMask(hostApi.info.type, *inputDevice, config.input);
-			Log() << "Selected input channel mask: " << GetWaveFormatChannelMaskString(channelMask);
-			return channelMask;
+			Log() << "Selecting output device sample type";
+			const auto sampleType = SelectDeviceSampleType(*outputSampleType, config.output);
+			Log() << "Selected output device sample type: " << DescribeSampleType(sampleType);
+			return sampleType;
 		}
 		catch (const std::exception& exception) {
-			throw std::runtime_error(std::string("Could not select input channel mask: ") + exception.what());
-			return 0;
-		}
-	}()),
-		outputChannelMask([&]() -> DWORD {
-		if (!outputDevice.has_value()) return 0;
-		try {
-			Log() << "Selecting output channel mask";
-			const auto channelMask = SelectChannelMask(hostApi.info.type, *outputDevice, config.output);
-			Log() << "Selected output channel mask: " << GetWaveFormatChannelMaskString(channelMask);
-			return channelMask;
+			throw std::runtime_error(std::string("Could not select output device sample type: ") + exception.what());
 		}
-		catch (const std::exception& exception) {
-			throw std::runtime_error(std::string("Could not select output channel mask: ") + exception.what());
-			return 0;
+	}())
+	{
+		if (inputDevice.has_value() && inputChannelCount > inputDevice->info.maxInputChannels)
+			Log() << "WARNING: input channel count is higher than the max channel count for this device. Input device initialization might fail.";
+		if (outputDevice.has_value() && outputChannelCount > outputDevice->info.maxOutputChannels)
+			Log() << "WARNING: output channel count is higher than the max channel count for this device. Output device initialization might fail.";
+	}
+
+	DeviceSnapshot FlexASIO::Devices::GetSnapshot() const {
+		const auto getStreamSnapshot = [&](const std::optional<SampleType>& sampleType, int channelCount, DWORD channelMask) -> std::optional<DeviceSnapshot::Stream> {
+			if (!sampleType.has_value()) return std::nullopt;
+			return DeviceSnapshot::Stream{ .channelCount = channelCount, .sampleType = sampleType->asio, .channelMask = channelMask };
+		};
+		return {
+			.hostApiType = hostApi.info.type,
+			.input = getStreamSnapshot(inputSampleType, inputMixingMatrix.has_value() ? int(inputMixingMatrix->GetOutputChannelCount()) : int(inputChannelMap.size()), inputChannelMask),
+			.output = getStreamSnapshot(outputSampleType, outputMixingMatrix.has_value() ? int(outputMixingMatrix->GetInputChannelCount()) : int(outputChannelMap.size()), outputChannelMask),
+			.defaultSampleRate = GetDeviceDefaultSampleRate(inputDevice, outputDevice),
+		};
+	}
+
+	FlexASIO::FlexASIO(void* sysHandle) :
+		windowHandle(reinterpret_cast<decltype(windowHandle)>(sysHandle)),
+		deviceSnapshotKey(GetDeviceSnapshotKey(configLoader.InitialText(), configLoader.InitialProfile())),
+		deviceSnapshot([&] {
+		if (deviceSnapshotKey.has_value()) {
+			auto cache = LoadDeviceCache(GetDeviceCachePath(), *deviceSnapshotKey);
+			if (cache.has_value()) {
+				Log() << "Using device snapshot, deferring PortAudio initialization until needed";
+				deviceCapabilities = std::move(cache->capabilities);
+				return cache->snapshot;
+			}
 		}
+		Log() << "No usable device snapshot, initializing PortAudio now";
+		devices.emplace(config, GetDeviceTopology());
+		return devices->GetSnapshot();
 	}()),
-		sampleRate(GetDefaultSampleRate(inputDevice, outputDevice))
+		forcedConcurrentFormatChecks(GetForcedConcurrentFormatChecks()),
+		sampleRate(GetDefaultSampleRate(deviceSnapshot.defaultSampleRate))
 	{
 		Log() << "sysHandle = " << sysHandle;
 
-		if (!inputDevice.has_value() && !outputDevice.has_value()) throw ASIOException(ASE_HWMalfunction, "No usable input nor output devices");
+		InstallRealtimeSanitizer();
 
-		Log() << "Input channel count: " << GetInputChannelCount();
-		if (inputDevice.has_value() && GetInputChannelCount() > inputDevice->info.maxInputChannels)
-			Log() << "WARNING: input channel count is higher than the max channel count for this device. Input device initialization might fail.";
+		if (!deviceSnapshot.input.has_value() && !deviceSnapshot.output.has_value()) throw ASIOException(ASE_HWMalfunction, "No usable input nor output devices");
+		if (devices.has_value()) StoreDeviceCache();
 
+		Log() << "Input channel count: " << GetInputChannelCount();
 		Log() << "Output channel count: " << GetOutputChannelCount();
-		if (outputDevice.has_value() && GetOutputChannelCount() > outputDevice->info.maxOutputChannels)
-			Log() << "WARNING: output channel count is higher than the max channel count for this device. Output device initialization might fail.";
+	}
+
+	void FlexASIO::StoreDeviceCache() const {
+		// The snapshot key is derived from the initial config, so it does not describe anything else.
+		if (!deviceSnapshotKey.has_value() || !(config == configLoader.Initial())) return;
+		try {
+			SaveDeviceCache(GetDeviceCachePath(), *deviceSnapshotKey, { .snapshot = deviceSnapshot, .capabilities = deviceCapabilities });
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to save device cache: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+		}
+	}
+
+	const FlexASIO::Devices& FlexASIO::GetDevices() const {
+		if (devices.has_value()) return *devices;
+
+		Log() << "Initializing PortAudio, which was deferred until now";
+		devices.emplace(config, GetDeviceTopology());
+		const auto snapshot = devices->GetSnapshot();
+		if (snapshot != deviceSnapshot) {
+			// The host application has already been told about channels and sample types that are not accurate anymore.
+			Log() << "WARNING: device snapshot was stale, updating it";
+			deviceSnapshot = snapshot;
+			deviceCapabilities = {};
+			StoreDeviceCache();
+			throw ASIOException(ASE_HWMalfunction, "Audio devices changed since the driver was initialized; reload the driver");
+		}
+		return *devices;
+	}
+
+	FlexASIO::ConfigChangeScope FlexASIO::ClassifyConfigChange(const Config& oldConfig, const Config& newConfig) {
+		if (newConfig == oldConfig) return ConfigChangeScope::NONE;
+
+		// Changing gains in the mixing matrix does not change the number of ASIO channels, but changing its size can.
+		const auto getMixingMatrixSize = [](const Config::Stream& stream) {
+			return std::make_pair(stream.mixingMatrix.size(), stream.mixingMatrix.empty() ? size_t(0) : stream.mixingMatrix.front().size());
+		};
+		const auto streamRequiresReset = [&](const Config::Stream& oldStream, const Config::Stream& newStream) {
+			return newStream.channels != oldStream.channels || newStream.sampleType != oldStream.sampleType || newStream.channelMap != oldStream.channelMap ||
+				newStream.mixingChannels != oldStream.mixingChannels || getMixingMatrixSize(newStream) != getMixingMatrixSize(oldStream);
+		};
+		if (newConfig.backend != oldConfig.backend || streamRequiresReset(oldConfig.input, newConfig.input) || streamRequiresReset(oldConfig.output, newConfig.output))
+			return ConfigChangeScope::RESET;
+
+		// Note that a different device (or WASAPI exclusive mode, which affects sample type selection) can also result in different
+		// channel counts or sample types. This can only be determined by selecting the new devices, which happens when the change is
+		// applied.
+		const auto withoutLiveParameters = [](Config::Stream stream) {
+			stream.mutedChannels.clear();
+			return stream;
+		};
+		if (!(withoutLiveParameters(newConfig.input) == withoutLiveParameters(oldConfig.input)) || !(withoutLiveParameters(newConfig.output) == withoutLiveParameters(oldConfig.output)))
+			return ConfigChangeScope::REOPEN_STREAM;
+
+		return ConfigChangeScope::LIVE;
+	}
+
+	FlexASIO::ConfigChangeScope FlexASIO::SetPendingConfig(Config newConfig) {
+		std::scoped_lock lock(configMutex);
+		const auto scope = ClassifyConfigChange(config, newConfig);
+		if (scope == ConfigChangeScope::NONE) pendingConfig.reset();
+		else pendingConfig = std::move(newConfig);
+		return scope;
+	}
+
+	void FlexASIO::ApplyPendingConfig() {
+		if (preparedState.has_value() && preparedState->IsRunning()) return;
+
+		std::optional<Config> newConfig;
+		{
+			std::scoped_lock lock(configMutex);
+			newConfig.swap(pendingConfig);
+		}
+		if (!newConfig.has_value()) return;
+
+		const auto scope = ClassifyConfigChange(config, *newConfig);
+		if (scope == ConfigChangeScope::RESET) {
+			// The config watcher requests a reset for these, so there is nothing else we can do.
+			Log() << "Not applying config change as it requires a reset";
+			return;
+		}
+
+		const auto setConfig = [&](Config newConfig) {
+			std::scoped_lock lock(configMutex);
+			config = std::move(newConfig);
+		};
+		if (scope == ConfigChangeScope::REOPEN_STREAM) deviceCapabilities = {};
+		if (scope == ConfigChangeScope::LIVE || !devices.has_value()) {
+			// If PortAudio has not been initialized yet, GetDevices() will take care of checking the devices against the snapshot.
+			Log() << "Applying config change";
+			setConfig(std::move(*newConfig));
+			return;
+		}
+
+		Log() << "Applying config change by reopening the stream";
+		if (preparedState.has_value()) preparedState->CloseStream();
+		auto oldConfig = config;
+		setConfig(std::move(*newConfig));
+		try {
+			devices.reset();
+			devices.emplace(config, GetDeviceTopology());
+			const auto snapshot = devices->GetSnapshot();
+			if (snapshot.hostApiType != deviceSnapshot.hostApiType || snapshot.input != deviceSnapshot.input || snapshot.output != deviceSnapshot.output)
+				throw std::runtime_error("new devices do not have the same channels and sample types as the old ones");
+			if (preparedState.has_value()) {
+				preparedState->ReopenStream();
+				preparedState->SendMessageIfSupported(kAsioLatenciesChanged);
+			}
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to apply config change in place: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			setConfig(std::move(oldConfig));
+			devices.reset();
+			if (!preparedState.has_value()) return;
+			try {
+				preparedState->ReopenWithPreviousConfig("config change");
+			}
+			catch (const std::exception& resetException) {
+				Log() << "Reset request failed: " << ::dechamps_cpputil::GetNestedExceptionMessage(resetException);
+			}
+		}
 	}
 
 	int FlexASIO::GetInputChannelCount() const {
-		if (!inputDevice.has_value()) return 0;
-		if (config.input.channels.has_value()) return *config.input.channels;
-		return inputDevice->info.maxInputChannels;
+		return deviceSnapshot.input.has_value() ? int(deviceSnapshot.input->channelCount) : 0;
 	}
 	int FlexASIO::GetOutputChannelCount() const {
-		if (!outputDevice.has_value()) return 0;
-		if (config.output.channels.has_value()) return *config.output.channels;
-		return outputDevice->info.maxOutputChannels;
+		return deviceSnapshot.output.has_value() ? int(deviceSnapshot.output->channelCount) : 0;
+	}
+
+	int FlexASIO::GetStreamChannelCount(const bool output, const int channelSpan) const {
+		const auto& devices = GetDevices();
+		const auto channelCount = output ? devices.outputChannelCount : devices.inputChannelCount;
+		if (channelSpan == 0) return 0;
+		if (channelSpan >= channelCount) return channelCount;
+
+		// Shared mode backends up/downmix a stream that has fewer channels than the device, which would make channels play out of
+		// (or be recorded from) the wrong speakers. This is not a concern if there is no mixing, or if each channel is given an
+		// explicit speaker position.
+		const auto hostApiType = devices.hostApi.info.type;
+		const auto& streamConfig = output ? config.output : config.input;
+		const auto channelMask = output ? devices.outputChannelMask : devices.inputChannelMask;
+		if (hostApiType != paWDMKS && !(hostApiType == paWASAPI && (streamConfig.wasapiExclusiveMode || channelMask != 0))) {
+			Log() << "Opening all " << channelCount << " " << (output ? "output" : "input") << " channels, as opening fewer channels could cause them to be remixed";
+			return channelCount;
+		}
+		Log() << "Only opening the first " << channelSpan << " out of " << channelCount << " " << (output ? "output" : "input") << " channels, as the remaining channels are not used";
+		return channelSpan;
 	}
 
 	FlexASIO::BufferSizes FlexASIO::ComputeBufferSizes() const
@@ -430,7 +980,7 @@ namespace flexasio {
 		else {
 			Log() << "Calculating default buffer size based on " << sampleRate << " Hz sample rate";
 			// We enforce a minimum of 32 samples as applications tend to choke on extremely small buffers - see https://github.com/dechamps/FlexASIO/issues/88
-			bufferSizes.minimum = (std::max<long>)(32, long(sampleRate * (hostApi.info.type == paDirectSound && inputDevice.has_value() ?
+			bufferSizes.minimum = (std::max<long>)(32, long(sampleRate * (deviceSnapshot.hostApiType == paDirectSound && deviceSnapshot.input.has_value() ?
 				0.010 :  // Cap the min buffer size to 10 ms when using DirectSound with an input device to work around https://github.com/dechamps/FlexASIO/issues/50
 				0.001    // 1 ms, there's basically no chance we'll get glitch-free streaming below this
 				)));
@@ -443,6 +993,7 @@ namespace flexasio {
 
 	void FlexASIO::GetBufferSize(long* minSize, long* maxSize, long* preferredSize, long* granularity)
 	{
+		ApplyPendingConfig();
 		const auto bufferSizes = ComputeBufferSizes();
 		*minSize = bufferSizes.minimum;
 		*maxSize = bufferSizes.maximum;
@@ -530,19 +1081,33 @@ namespace flexasio {
 
 		info->isActive = preparedState.has_value() && preparedState->IsChannelActive(info->isInput, info->channel);
 		info->channelGroup = 0;
-		info->type = info->isInput ? inputSampleType->asio : outputSampleType->asio;
+		const auto& streamSnapshot = *(info->isInput ? deviceSnapshot.input : deviceSnapshot.output);
+		info->type = streamSnapshot.sampleType;
+		// Note this doesn't go through Devices, so that PortAudio initialization can still be deferred.
+		const auto& streamConfig = info->isInput ? config.input : config.output;
+		const auto channelName = [&] {
+			const auto channel = size_t(info->channel);
+			// Mixed channels are not device channels, so they can only be named after their own speaker layout, if any.
+			if (streamConfig.mixingChannels.has_value()) return getChannelName(channel, GetDefaultChannelMask(*streamConfig.mixingChannels));
+			if (!streamConfig.mixingMatrix.empty()) return getChannelName(channel, 0);
+			return getChannelName(streamConfig.channelMap.empty() ? channel : size_t(streamConfig.channelMap[channel]), streamSnapshot.channelMask);
+		}();
 		std::stringstream channel_string;
-		channel_string << (info->isInput ? "IN" : "OUT") << " " << getChannelName(info->channel, info->isInput ? inputChannelMask : outputChannelMask);
+		channel_string << (info->isInput ? "IN" : "OUT") << " " << channelName;
 		strcpy_s(info->name, 32, channel_string.str().c_str());
 		Log() << "Returning: " << info->name << ", " << (info->isActive ? "active" : "inactive") << ", group " << info->channelGroup << ", type " << ::dechamps_ASIOUtil::GetASIOSampleTypeString(info->type);
 	}
 
 	template <typename Functor>
-	decltype(auto) FlexASIO::WithStreamParameters(bool inputEnabled, bool outputEnabled, double sampleRate, PaTime defaultSuggestedLatency, Functor functor) const
+	decltype(auto) FlexASIO::WithStreamParameters(int inputChannelCount, int outputChannelCount, double sampleRate, PaTime defaultSuggestedLatency, Functor functor) const
 	{
-		Log() << "FlexASIO::WithStreamParameters(inputEnabled = " << inputEnabled << ", outputEnabled = " << outputEnabled << ", sampleRate = " << sampleRate << ")";
+		Log() << "FlexASIO::WithStreamParameters(inputChannelCount = " << inputChannelCount << ", outputChannelCount = " << outputChannelCount << ", sampleRate = " << sampleRate << ")";
+		const bool inputEnabled = inputChannelCount > 0;
+		const bool outputEnabled = outputChannelCount > 0;
 
-		auto exclusivity = hostApi.info.type == paWDMKS ? StreamExclusivity::EXCLUSIVE : StreamExclusivity::SHARED;
+		const auto& devices = GetDevices();
+
+		auto exclusivity = devices.hostApi.info.type == paWDMKS ? StreamExclusivity::EXCLUSIVE : StreamExclusivity::SHARED;
 
 		PaStreamParameters common_parameters = { 0 };
 		common_parameters.sampleFormat = paNonInterleaved;
@@ -550,7 +1115,7 @@ namespace flexasio {
 		common_parameters.suggestedLatency = defaultSuggestedLatency;
 
 		PaWasapiStreamInfo common_wasapi_stream_info = { 0 };
-		if (hostApi.info.type == paWASAPI) {
+		if (devices.hostApi.info.type == paWASAPI) {
 			common_wasapi_stream_info.size = sizeof(common_wasapi_stream_info);
 			common_wasapi_stream_info.hostApiType = paWASAPI;
 			common_wasapi_stream_info.version = 1;
@@ -561,16 +1126,20 @@ namespace flexasio {
 		PaWasapiStreamInfo input_wasapi_stream_info = common_wasapi_stream_info;
 		if (inputEnabled)
 		{
-			input_parameters.device = inputDevice->index;
-			input_parameters.channelCount = GetInputChannelCount();
-			input_parameters.sampleFormat |= inputSampleType->pa;
+			input_parameters.device = devices.inputDevice->index;
+			input_parameters.channelCount = inputChannelCount;
+			input_parameters.sampleFormat |= devices.inputDeviceSampleType->pa;
+			if (config.input.interleaved) {
+				Log() << "Using interleaved buffers for input stream";
+				input_parameters.sampleFormat &= ~paNonInterleaved;
+			}
 			if (config.input.suggestedLatencySeconds.has_value()) input_parameters.suggestedLatency = *config.input.suggestedLatencySeconds;
-			if (hostApi.info.type == paWASAPI)
+			if (devices.hostApi.info.type == paWASAPI)
 			{
-				if (inputChannelMask != 0)
+				if (devices.inputChannelMask != 0)
 				{
 					input_wasapi_stream_info.flags |= paWinWasapiUseChannelMask;
-					input_wasapi_stream_info.channelMask = inputChannelMask;
+					input_wasapi_stream_info.channelMask = GetFirstChannelsMask(devices.inputChannelMask, inputChannelCount);
 				}
 				Log() << "Using " << (config.input.wasapiExclusiveMode ? "exclusive" : "shared") << " mode for input WASAPI stream";
 				if (config.input.wasapiExclusiveMode) {
@@ -593,16 +1162,20 @@ namespace flexasio {
 		PaWasapiStreamInfo output_wasapi_stream_info = common_wasapi_stream_info;
 		if (outputEnabled)
 		{
-			output_parameters.device = outputDevice->index;
-			output_parameters.channelCount = GetOutputChannelCount();
-			output_parameters.sampleFormat |= outputSampleType->pa;
+			output_parameters.device = devices.outputDevice->index;
+			output_parameters.channelCount = outputChannelCount;
+			output_parameters.sampleFormat |= devices.outputDeviceSampleType->pa;
+			if (config.output.interleaved) {
+				Log() << "Using interleaved buffers for output stream";
+				output_parameters.sampleFormat &= ~paNonInterleaved;
+			}
 			if (config.output.suggestedLatencySeconds.has_value()) output_parameters.suggestedLatency = *config.output.suggestedLatencySeconds;
-			if (hostApi.info.type == paWASAPI)
+			if (devices.hostApi.info.type == paWASAPI)
 			{
-				if (outputChannelMask != 0)
+				if (devices.outputChannelMask != 0)
 				{
 					output_wasapi_stream_info.flags |= paWinWasapiUseChannelMask;
-					output_wasapi_stream_info.channelMask = outputChannelMask;
+					output_wasapi_stream_info.channelMask = GetFirstChannelsMask(devices.outputChannelMask, outputChannelCount);
 				}
 				Log() << "Using " << (config.output.wasapiExclusiveMode ? "exclusive" : "shared") << " mode for output WASAPI stream";
 				if (config.output.wasapiExclusiveMode) {
@@ -652,36 +1225,101 @@ namespace flexasio {
 			return false;
 		}
 
-		const auto checkParameters = [&](const StreamParameters& streamParameters, StreamExclusivity) {
-			CheckFormatSupported(streamParameters);
-		};
+		const auto support = [&] {
+			if (forcedConcurrentFormatChecks.has_value()) return CheckSampleRateSupport(sampleRate);
+			if (const auto cachedSupport = deviceCapabilities.sampleRates.find(sampleRate); cachedSupport != deviceCapabilities.sampleRates.end()) {
+				Log() << "Using sample rate support from device cache: input " << cachedSupport->second.input << ", output " << cachedSupport->second.output;
+				return cachedSupport->second;
+			}
+			const auto support = CheckSampleRateSupport(sampleRate);
+			deviceCapabilities.sampleRates.emplace(sampleRate, support);
+			StoreDeviceCache();
+			return support;
+		}();
 
 		// We do not know whether the host application intends to use only input channels, only output channels, or both.
 		// This logic ensures the driver is usable for all three use cases.
-		bool available = false;
-		if (inputDevice.has_value())
-			try {
-				Log() << "Checking if input supports this sample rate";
-				WithStreamParameters(/*inputEnabled=*/true, /*outputEnabled=*/false, sampleRate, /*suggestedLatency*/0, checkParameters);
-				Log() << "Input supports this sample rate";
-				available = true;
-			}
-			catch (const std::exception& exception) {
-				Log() << "Input does not support this sample rate: " << exception.what();
-			}
-		if (outputDevice.has_value())
+		const auto available = support.input || support.output;
+		Log() << "Sample rate " << sampleRate << " is " << (available ? "available" : "unavailable");
+		return available;
+	}
+
+	DeviceCapabilities::SampleRateSupport FlexASIO::CheckSampleRateSupport(ASIOSampleRate sampleRate) const
+	{
+		const auto& devices = GetDevices();
+		const auto isSupported = [&](bool output) {
+			return WithStreamParameters(output ? 0 : devices.inputChannelCount, output ? devices.outputChannelCount : 0, sampleRate, /*suggestedLatency*/0, [&](const StreamParameters& streamParameters, StreamExclusivity streamExclusivity) {
+				const auto& parameters = *(output ? streamParameters.outputParameters : streamParameters.inputParameters);
+				const auto wasapiStreamInfo = devices.hostApi.info.type == paWASAPI ? static_cast<const PaWasapiStreamInfo*>(parameters.hostApiSpecificStreamInfo) : nullptr;
+				const CapabilityMatrix::Key key = {
+					.hostApiType = devices.hostApi.info.type,
+					.device = (output ? devices.outputDevice : devices.inputDevice)->info.name,
+					.output = output,
+					.sampleRate = sampleRate,
+					.channelCount = parameters.channelCount,
+					.sampleFormat = parameters.sampleFormat,
+					.wasapiFlags = wasapiStreamInfo == nullptr ? 0 : wasapiStreamInfo->flags,
+					.channelMask = wasapiStreamInfo == nullptr ? 0 : wasapiStreamInfo->channelMask,
+					.exclusive = streamExclusivity == StreamExclusivity::EXCLUSIVE,
+				};
+				const auto useCapabilityMatrix = deviceSnapshotKey.has_value() && !forcedConcurrentFormatChecks.has_value();
+				if (useCapabilityMatrix)
+					if (const auto supported = CapabilityMatrix::Find(deviceSnapshotKey->deviceTopology, key); supported.has_value()) {
+						Log() << "Using format support from capability matrix";
+						return *supported;
+					}
+
+				bool supported = true;
+				try {
+					CheckFormatSupported(streamParameters);
+				}
+				catch (const std::exception& exception) {
+					Log() << "Format is not supported: " << exception.what();
+					supported = false;
+				}
+				if (useCapabilityMatrix) CapabilityMatrix::Store(deviceSnapshotKey->deviceTopology, key, supported);
+				return supported;
+			});
+		};
+
+		const auto check = [&](bool output) {
+			const auto direction = output ? "Output" : "Input";
+			if (!(output ? devices.outputDevice : devices.inputDevice).has_value()) return false;
 			try {
-				Log() << "Checking if output supports this sample rate";
-				WithStreamParameters(/*inputEnabled=*/false, /*outputEnabled=*/true, sampleRate, /*suggestedLatency*/0, checkParameters);
-				Log() << "Output supports this sample rate";
-				available = true;
+				Log() << "Checking if " << (output ? "output" : "input") << " supports this sample rate";
+				const auto supported = isSupported(output);
+				Log() << direction << " " << (supported ? "supports" : "does not support") << " this sample rate";
+				return supported;
 			}
 			catch (const std::exception& exception) {
-				Log() << "Output does not support this sample rate: " << exception.what();
+				Log() << direction << " does not support this sample rate: " << exception.what();
+				return false;
 			}
+		};
 
-		Log() << "Sample rate " << sampleRate << " is " << (available ? "available" : "unavailable");
-		return available;
+		// With WASAPI and MME, checking a format involves a round trip to the device, and the two directions are independent
+		// endpoints, so they can be checked concurrently. Pa_IsFormatSupported() does not touch any global PortAudio state,
+		// unlike Pa_OpenStream() and Pa_CloseStream() which maintain the list of open streams without any synchronization; for
+		// this reason, stream probes are never run concurrently. WDM-KS input and output pins can belong to the same filter,
+		// so these are checked one after the other as well.
+		const auto concurrent = devices.inputDevice.has_value() && devices.outputDevice.has_value() &&
+			(devices.hostApi.info.type == paWASAPI || devices.hostApi.info.type == paMME) && forcedConcurrentFormatChecks.value_or(true);
+		const auto checkStart = std::chrono::steady_clock::now();
+		DeviceCapabilities::SampleRateSupport support = { .input = false, .output = false };
+		if (concurrent) {
+			auto outputSupported = std::async(std::launch::async, [&] {
+				COMInitializer comInitializer(COINIT_MULTITHREADED);
+				return check(/*output=*/true);
+			});
+			support.input = check(/*output=*/false);
+			support.output = outputSupported.get();
+		}
+		else {
+			support.input = check(/*output=*/false);
+			support.output = check(/*output=*/true);
+		}
+		Log() << "Sample rate " << (concurrent ? "concurrent" : "sequential") << " checks took " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - checkStart).count() << " ms";
+		return support;
 	}
 
 	void FlexASIO::GetSampleRate(ASIOSampleRate* sampleRateResult)
@@ -708,11 +1346,7 @@ namespace flexasio {
 		}
 
 		sampleRate = requestedSampleRate;
-		if (preparedState.has_value())
-		{
-			Log() << "Sending a reset request to the host as it's not possible to change sample rate while streaming";
-			preparedState->RequestReset();
-		}
+		if (preparedState.has_value()) preparedState->ChangeSampleRate(sampleRate);
 	}
 
 	void FlexASIO::CreateBuffers(ASIOBufferInfo* bufferInfos, long numChannels, long bufferSize, ASIOCallbacks* callbacks) {
@@ -728,6 +1362,10 @@ namespace flexasio {
 			// See https://github.com/dechamps/FlexASIO/issues/31
 			Log() << "WARNING: ASIO host application never enquired about sample rate, and therefore cannot know we are running at " << sampleRate << " Hz!";
 		}
+
+		ApplyPendingConfig();
+		// Initialize PortAudio now if that was deferred, so that a stale device snapshot is caught before any state is created.
+		GetDevices();
 		preparedState.emplace(*this, sampleRate, bufferInfos, numChannels, bufferSize, callbacks);
 	}
 
@@ -747,12 +1385,12 @@ namespace flexasio {
 	}
 
 	FlexASIO::PreparedState::PreparedState(FlexASIO& flexASIO, ASIOSampleRate sampleRate, ASIOBufferInfo* asioBufferInfos, long numChannels, long bufferSizeInFrames, ASIOCallbacks* callbacks) :
-		flexASIO(flexASIO), sampleRate(sampleRate), callbacks(*callbacks),
+		flexASIO(flexASIO), sampleRate(sampleRate), callbacks(*callbacks), hotStandby(flexASIO.config.hotStandby),
 		buffers(
 			2,
 			GetBufferInfosChannelCount(asioBufferInfos, numChannels, true), GetBufferInfosChannelCount(asioBufferInfos, numChannels, false),
 			bufferSizeInFrames,
-			flexASIO.inputSampleType.has_value() ? flexASIO.inputSampleType->size : 0, flexASIO.outputSampleType.has_value() ? flexASIO.outputSampleType->size : 0),
+			flexASIO.GetDevices().inputSampleType.has_value() ? flexASIO.GetDevices().inputSampleType->size : 0, flexASIO.GetDevices().outputSampleType.has_value() ? flexASIO.GetDevices().outputSampleType->size : 0),
 		bufferInfos([&] {
 		std::vector<ASIOBufferInfo> bufferInfos;
 		bufferInfos.reserve(numChannels);
@@ -786,16 +1424,115 @@ namespace flexasio {
 			bufferInfos.push_back(asioBufferInfo);
 		}
 		return bufferInfos;
-		}()), streamWithExclusivity(flexASIO.WithStreamParameters(
-			buffers.inputChannelCount > 0, buffers.outputChannelCount > 0, sampleRate, GetDefaultSuggestedLatency(bufferSizeInFrames, sampleRate),
-			[&](const StreamParameters& streamParameters, StreamExclusivity streamExclusivity) {
-				return StreamWithExclusivity{
-					.stream = flexASIO.OpenStream(streamParameters, static_cast<unsigned long>(bufferSizeInFrames), &PreparedState::StreamCallback, this),
-					.exclusivity = streamExclusivity,
-				};
-			})),
-		configWatcher(flexASIO.configLoader, [this] { OnConfigChange(); }) {
+		}()),
+		calibratedLatencies(flexASIO.CalibrateLatency(bufferSizeInFrames, /*measure=*/true)),
+		streamWithExclusivity(OpenStream()),
+		liveParameters([&] {
+		LiveParameters initialLiveParameters;
+		ApplyConfig(flexASIO.config, initialLiveParameters);
+		flexASIO.ApplyHostParameters(initialLiveParameters);
+		return initialLiveParameters;
+	}()),
+		configWatcher(flexASIO.configLoader, [this](const Config& newConfig) { OnConfigChange(newConfig); }) {
 		if (callbacks->asioMessage) ProbeHostMessages(callbacks->asioMessage);
+		if (hotStandby) {
+			Log() << "Starting stream in hot standby mode";
+			standbyStream = StartStream(streamWithExclusivity.stream.get());
+		}
+	}
+
+	FlexASIO::PreparedState::StreamWithExclusivity FlexASIO::PreparedState::OpenStream() {
+		const auto bufferSizeInFrames = long(buffers.bufferSizeInFrames);
+		const auto& devices = flexASIO.GetDevices();
+		const auto openStream = [&](int inputChannelCount, int outputChannelCount) {
+			return flexASIO.WithStreamParameters(
+				inputChannelCount, outputChannelCount, sampleRate, GetDefaultSuggestedLatency(bufferSizeInFrames, sampleRate),
+				[&](const StreamParameters& streamParameters, StreamExclusivity streamExclusivity) {
+					return StreamWithExclusivity{
+						.stream = flexASIO.OpenStream(streamParameters, static_cast<unsigned long>(bufferSizeInFrames), &PreparedState::StreamCallback, this),
+						.exclusivity = streamExclusivity,
+						.inputChannelCount = inputChannelCount,
+						.outputChannelCount = outputChannelCount,
+						.outputInterleaved = streamParameters.outputParameters != nullptr && (streamParameters.outputParameters->sampleFormat & paNonInterleaved) == 0,
+						.outputSampleSizeInBytes = devices.outputDeviceSampleType.has_value() ? devices.outputDeviceSampleType->size : 0,
+					};
+				});
+		};
+
+		// PortAudio can only open the first N channels of a device, so the stream has to start from the first device channel even
+		// if that one is not used.
+		const auto inputChannelCount = flexASIO.GetStreamChannelCount(/*output=*/false, devices.inputMixingMatrix.has_value() ?
+			GetMixingDeviceChannelSpan(bufferInfos, /*input=*/true, *devices.inputMixingMatrix) : GetDeviceChannelSpan(bufferInfos, /*input=*/true, devices.inputChannelMap));
+		const auto outputChannelCount = flexASIO.GetStreamChannelCount(/*output=*/true, devices.outputMixingMatrix.has_value() ?
+			GetMixingDeviceChannelSpan(bufferInfos, /*input=*/false, *devices.outputMixingMatrix) : GetDeviceChannelSpan(bufferInfos, /*input=*/false, devices.outputChannelMap));
+		const auto allInputChannelCount = inputChannelCount > 0 ? devices.inputChannelCount : 0;
+		const auto allOutputChannelCount = outputChannelCount > 0 ? devices.outputChannelCount : 0;
+		try {
+			return openStream(inputChannelCount, outputChannelCount);
+		}
+		catch (const std::exception& exception) {
+			if (inputChannelCount == allInputChannelCount && outputChannelCount == allOutputChannelCount) throw;
+			// Some devices (especially in exclusive mode) only accept their full channel count.
+			Log() << "Unable to open stream with a subset of device channels, opening all channels instead: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			return openStream(allInputChannelCount, allOutputChannelCount);
+		}
+	}
+
+	void FlexASIO::PreparedState::ChangeSampleRate(ASIOSampleRate newSampleRate) {
+		if (runningState.has_value()) {
+			Log() << "Sending a reset request to the host as the sample rate cannot be changed in place while streaming";
+			RequestReset();
+			return;
+		}
+
+		Log() << "Reopening stream at " << newSampleRate << " Hz, keeping the same ASIO buffers";
+		const auto oldSampleRate = sampleRate;
+		CloseStream();
+		try {
+			sampleRate = newSampleRate;
+			ReopenStream();
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to reopen stream at the new sample rate: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			sampleRate = oldSampleRate;
+			ReopenWithPreviousConfig("sample rate change");
+			return;
+		}
+
+		// The host asked for the new sample rate, so there is no need to call sampleRateDidChange(). However, latencies
+		// depend on the sample rate, and whatever timing information the host derived from the old stream is now invalid.
+		SendMessageIfSupported(kAsioLatenciesChanged);
+		SendMessageIfSupported(kAsioResyncRequest);
+	}
+
+	void FlexASIO::PreparedState::CloseStream() {
+		Log() << "Closing stream";
+		// The stream has to be closed before it is reopened, as exclusive mode devices cannot be opened twice.
+		standbyStream.reset();
+		streamWithExclusivity.stream.reset();
+	}
+
+	void FlexASIO::PreparedState::ReopenWithPreviousConfig(const std::string_view change) {
+		try {
+			ReopenStream();
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to reopen stream with the previous config: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+		}
+		Log() << "Sending a reset request to the host as the " << change << " could not be applied in place";
+		RequestReset();
+	}
+
+	void FlexASIO::PreparedState::ReopenStream() {
+		calibratedLatencies = flexASIO.CalibrateLatency(long(buffers.bufferSizeInFrames), /*measure=*/true);
+		streamWithExclusivity = OpenStream();
+		if (hotStandby) standbyStream = StartStream(streamWithExclusivity.stream.get());
+	}
+
+	FlexASIO::PreparedState::~PreparedState() {
+		// In hot standby mode the stream outlives the running state, so the running state needs to be detached from the stream
+		// before it goes away. This also covers hosts that call disposeBuffers() without calling stop() first.
+		if (runningState.has_value()) Stop();
 	}
 
 	bool FlexASIO::PreparedState::IsChannelActive(bool isInput, long channel) const {
@@ -822,70 +1559,155 @@ namespace flexasio {
 	}
 
 	long FlexASIO::ComputeLatencyFromStream(PaStream* stream, bool output, size_t bufferSizeInFrames) const
+	{
+		// See https://github.com/dechamps/FlexASIO/issues/10.
+		// The latency that PortAudio reports appears to take the buffer size into account already.
+		return ComputeLatency(GetStreamLatency(stream, output), output, bufferSizeInFrames);
+	}
+
+	long FlexASIO::GetStreamLatency(PaStream* stream, bool output) const
 	{
 		const PaStreamInfo* stream_info = Pa_GetStreamInfo(stream);
 		if (!stream_info) throw ASIOException(ASE_HWMalfunction, "unable to get stream info");
+		return long((output ? stream_info->outputLatency : stream_info->inputLatency) * sampleRate);
+	}
 
-		// See https://github.com/dechamps/FlexASIO/issues/10.
-		// The latency that PortAudio reports appears to take the buffer size into account already.
-		return ComputeLatency(long((output ? stream_info->outputLatency : stream_info->inputLatency) * sampleRate), output, bufferSizeInFrames);
+	std::optional<CalibratedLatencies> FlexASIO::CalibrateLatency(long bufferSizeInFrames, bool measure) const
+	{
+		if (!config.input.latencyCalibrationChannel.has_value() || !config.output.latencyCalibrationChannel.has_value()) return std::nullopt;
+		const auto& devices = GetDevices();
+		if (!devices.inputDevice.has_value() || !devices.outputDevice.has_value()) {
+			Log() << "Latency calibration requires both an input and an output device, not calibrating";
+			return std::nullopt;
+		}
+
+		try {
+			return WithStreamParameters(devices.inputChannelCount, devices.outputChannelCount, sampleRate, GetDefaultSuggestedLatency(bufferSizeInFrames, sampleRate),
+				[&](const StreamParameters& streamParameters, StreamExclusivity streamExclusivity) -> std::optional<CalibratedLatencies> {
+					const LatencyCalibrationKey key = {
+						.backend = devices.hostApi.info.name,
+						.inputDevice = devices.inputDevice->info.name,
+						.outputDevice = devices.outputDevice->info.name,
+						.sampleRate = sampleRate,
+						.bufferSizeInFrames = bufferSizeInFrames,
+						.inputSuggestedLatencySeconds = streamParameters.inputParameters->suggestedLatency,
+						.outputSuggestedLatencySeconds = streamParameters.outputParameters->suggestedLatency,
+						.exclusive = streamExclusivity == StreamExclusivity::EXCLUSIVE,
+					};
+					LatencyCalibrationCache cache(std::filesystem::path(GetUserDirectory()) / latencyCalibrationCacheFileName);
+					if (const auto cachedLatencies = cache.Find(key); cachedLatencies.has_value()) {
+						Log() << "Using previously calibrated latencies: " << cachedLatencies->input << " samples input, " << cachedLatencies->output << " samples output";
+						return cachedLatencies;
+					}
+					if (!measure) {
+						Log() << "No previously calibrated latencies for this configuration";
+						return std::nullopt;
+					}
+
+					LatencyCalibration calibration(
+						{ .index = *config.input.latencyCalibrationChannel, .count = streamParameters.inputParameters->channelCount, .sampleFormat = streamParameters.inputParameters->sampleFormat },
+						{ .index = *config.output.latencyCalibrationChannel, .count = streamParameters.outputParameters->channelCount, .sampleFormat = streamParameters.outputParameters->sampleFormat },
+						sampleRate);
+					const auto stream = OpenStream(streamParameters, static_cast<unsigned long>(bufferSizeInFrames), &LatencyCalibration::StreamCallback, &calibration);
+					const auto roundTripLatency = calibration.Run(stream.get());
+					if (!roundTripLatency.has_value()) return std::nullopt;
+
+					const auto streamInfo = Pa_GetStreamInfo(stream.get());
+					if (streamInfo == nullptr) throw std::runtime_error("unable to get stream info");
+					const auto latencies = SplitRoundTripLatency(*roundTripLatency, *streamInfo);
+					Log() << "Calibrated round-trip latency: " << *roundTripLatency << " samples (" << latencies.input << " input, " << latencies.output << " output), PortAudio reported "
+						<< long(streamInfo->inputLatency * sampleRate) << " input, " << long(streamInfo->outputLatency * sampleRate) << " output";
+					cache.Store(key, latencies);
+					return latencies;
+				});
+		}
+		catch (const std::exception& exception) {
+			Log() << "Latency calibration failed, falling back to PortAudio reported latencies: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			return std::nullopt;
+		}
 	}
 
 	void FlexASIO::GetLatencies(long* inputLatency, long* outputLatency) {
 		if (preparedState.has_value()) {
 			preparedState->GetLatencies(inputLatency, outputLatency);
 		} else {
-			// A GetLatencies() call before CreateBuffers() puts us in a difficult situation,
-			// but according to the ASIO SDK we have to come up with a number and some
-			// applications rely on it - see https://github.com/dechamps/FlexASIO/issues/122.
-			Log() << "GetLatencies() called before CreateBuffers() - attempting to probe streams";
-
 			const auto bufferSize = ComputeBufferSizes().preferred;
-			Log() << "Assuming " << bufferSize << " as the buffer size";
+			if (const auto calibratedLatencies = CalibrateLatency(bufferSize, /*measure=*/false); calibratedLatencies.has_value()) {
+				Log() << "GetLatencies() called before CreateBuffers() - using previously calibrated latencies assuming " << bufferSize << " as the buffer size";
+				*inputLatency = deviceSnapshot.input.has_value() ? ComputeLatency(calibratedLatencies->input, /*output=*/false, bufferSize) : 0;
+				*outputLatency = deviceSnapshot.output.has_value() ? ComputeLatency(calibratedLatencies->output, /*output=*/true, bufferSize) : 0;
+			} else {
+				// A GetLatencies() call before CreateBuffers() puts us in a difficult situation,
+				// but according to the ASIO SDK we have to come up with a number and some
+				// applications rely on it - see https://github.com/dechamps/FlexASIO/issues/122.
+				Log() << "GetLatencies() called before CreateBuffers() - attempting to probe streams";
+				Log() << "Assuming " << bufferSize << " as the buffer size";
+
+				const auto probedLatencies = [&] {
+					const auto probeKey = std::make_pair(double(sampleRate), bufferSize);
+					if (const auto cachedLatencies = deviceCapabilities.probedLatencies.find(probeKey); cachedLatencies != deviceCapabilities.probedLatencies.end()) {
+						Log() << "Using stream probe results from device cache";
+						return cachedLatencies->second;
+					}
+					const auto probedLatencies = ProbeLatencies(bufferSize);
+					deviceCapabilities.probedLatencies.emplace(probeKey, probedLatencies);
+					StoreDeviceCache();
+					return probedLatencies;
+				}();
+
+				const auto getLatency = [&](const std::optional<long>& probedLatency, bool output) {
+					if (probedLatency.has_value()) {
+						Log() << "Using " << (output ? "output" : "input") << " latency from successful stream probe";
+						return ComputeLatency(*probedLatency, output, bufferSize);
+					}
+					Log() << "Unable to open " << (output ? "output" : "input") << ", estimating latency";
+					return ComputeLatency(bufferSize, output, bufferSize);
+				};
+				*inputLatency = deviceSnapshot.input.has_value() ? getLatency(probedLatencies.input, /*output=*/false) : 0;
+				*outputLatency = deviceSnapshot.output.has_value() ? getLatency(probedLatencies.output, /*output=*/true) : 0;
+			}
+		}
+		Log() << "Returning input latency of " << *inputLatency << " samples and output latency of " << *outputLatency << " samples";
+	}
+
+	DeviceCapabilities::ProbedLatencies FlexASIO::ProbeLatencies(long bufferSizeInFrames) const
+	{
+		const auto& devices = GetDevices();
 
-			// Since CreateBuffers() has not been called yet, we do not know if the application intends
-			// to use only input channels, only output channels, or both. We arbitrarily decide to compute
-			// the input latency assuming an input-only stream, and the output latency assuming an
-			// output-only stream, because that makes this code least likely to fail. The tradeoff is this
-			// will likely return wrong latencies for full duplex streams (which tend to have higher
-			// latency due to the need for buffer adaptation).
+		// Since CreateBuffers() has not been called yet, we do not know if the application intends
+		// to use only input channels, only output channels, or both. We arbitrarily decide to compute
+		// the input latency assuming an input-only stream, and the output latency assuming an
+		// output-only stream, because that makes this code least likely to fail. The tradeoff is this
+		// will likely return wrong latencies for full duplex streams (which tend to have higher
+		// latency due to the need for buffer adaptation).
 
-			const auto getLatency = [&](bool output) {
+		const auto probe = [&](bool output) -> std::optional<long> {
+			try {
 				return WithStreamParameters(
-					/*inputEnabled=*/!output, /*outputEnabled=*/output, sampleRate, GetDefaultSuggestedLatency(bufferSize, sampleRate),
+					output ? 0 : devices.inputChannelCount, output ? devices.outputChannelCount : 0, sampleRate, GetDefaultSuggestedLatency(bufferSizeInFrames, sampleRate),
 					[&](const StreamParameters& streamParameters, StreamExclusivity) {
-						return ComputeLatencyFromStream(OpenStream(streamParameters, bufferSize, NoOpStreamCallback, nullptr).get(), output, bufferSize);
+						return GetStreamLatency(OpenStream(streamParameters, bufferSizeInFrames, NoOpStreamCallback, nullptr).get(), output);
 					});
-			};
-
-			if (!inputDevice.has_value())
-				*inputLatency = 0;
-			else
-				try {
-					*inputLatency = getLatency(/*output=*/false);
-					Log() << "Using input latency from successful stream probe";
-				}
-				catch (const std::exception& exception) {
-					Log() << "Unable to open input, estimating input latency: " << exception.what();
-					*inputLatency = ComputeLatency(bufferSize, /*output=*/false, bufferSize);
-				}
-			if (!outputDevice.has_value())
-				*outputLatency = 0;
-			else
-				try {
-					*outputLatency = getLatency(/*output=*/true);
-					Log() << "Using output latency from successful stream probe";
-				}
-				catch (const std::exception& exception) {
-					Log() << "Unable to open output, estimating output latency: " << exception.what();
-					*outputLatency = ComputeLatency(bufferSize, /*output=*/true, bufferSize);
-				}
-		}		
-		Log() << "Returning input latency of " << *inputLatency << " samples and output latency of " << *outputLatency << " samples";
+			}
+			catch (const std::exception& exception) {
+				Log() << "Unable to probe " << (output ? "output" : "input") << " stream: " << exception.what();
+				return std::nullopt;
+			}
+		};
+		return {
+			.input = devices.inputDevice.has_value() ? probe(/*output=*/false) : std::optional<long>(),
+			.output = devices.outputDevice.has_value() ? probe(/*output=*/true) : std::optional<long>(),
+		};
 	}
 
 	void FlexASIO::PreparedState::GetLatencies(long* inputLatency, long* outputLatency)
 	{
+		if (calibratedLatencies.has_value()) {
+			Log() << "Using calibrated latencies";
+			*inputLatency = flexASIO.ComputeLatency(calibratedLatencies->input, /*output=*/false, buffers.bufferSizeInFrames);
+			*outputLatency = flexASIO.ComputeLatency(calibratedLatencies->output, /*output=*/true, buffers.bufferSizeInFrames);
+			return;
+		}
 		*inputLatency = flexASIO.ComputeLatencyFromStream(streamWithExclusivity.stream.get(), /*output=*/false, buffers.bufferSizeInFrames);
 		*outputLatency = flexASIO.ComputeLatencyFromStream(streamWithExclusivity.stream.get(), /*output=*/true, buffers.bufferSizeInFrames);
 	}
@@ -898,7 +1720,14 @@ namespace flexasio {
 	void FlexASIO::PreparedState::Start()
 	{
 		if (runningState.has_value()) throw ASIOException(ASE_InvalidMode, "start() called twice");
+		flexASIO.ApplyPendingConfig();
 		runningState.emplace(*this);
+		started = true;
+		if (hotStandby) {
+			Log() << "Leaving hot standby";
+			standbyRunningState = &*runningState;
+			return;
+		}
 		runningState->Start();
 	}
 
@@ -914,7 +1743,330 @@ namespace flexasio {
 	}()),
 		outputReadyState([&]() -> std::optional<std::atomic<OutputReadyState>> {
 		if (preparedState.flexASIO.hostSupportsOutputReady) return OutputReadyState::READY; else return std::nullopt;
-	}()) {}
+	}()),
+		inputConverter([&]() -> std::optional<SampleConverter> {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		if (!devices.inputSampleType.has_value()) return std::nullopt;
+		return MakeSampleConverter("input", devices.inputDeviceSampleType->format, devices.inputSampleType->format, preparedState.flexASIO.config.input.dither);
+	}()),
+		outputConverter([&]() -> std::optional<SampleConverter> {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		if (!devices.outputSampleType.has_value()) return std::nullopt;
+		return MakeSampleConverter("output", devices.outputSampleType->format, devices.outputDeviceSampleType->format, preparedState.flexASIO.config.output.dither);
+	}()),
+		inputInterleaving([&]() -> std::optional<Interleaving> {
+		if (!inputConverter.has_value() || !preparedState.flexASIO.config.input.interleaved) return std::nullopt;
+		return Interleaving(size_t(preparedState.streamWithExclusivity.inputChannelCount), preparedState.buffers.bufferSizeInFrames, GetSampleFormatSize(inputConverter->GetInputFormat()));
+	}()),
+		outputInterleaving([&]() -> std::optional<Interleaving> {
+		if (!outputConverter.has_value() || !preparedState.flexASIO.config.output.interleaved) return std::nullopt;
+		return Interleaving(size_t(preparedState.streamWithExclusivity.outputChannelCount), preparedState.buffers.bufferSizeInFrames, GetSampleFormatSize(outputConverter->GetOutputFormat()));
+	}()),
+		inputMixing([&]() -> std::optional<Mixing> {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		if (!inputConverter.has_value() || !devices.inputMixingMatrix.has_value()) return std::nullopt;
+		return Mixing(*devices.inputMixingMatrix, preparedState.buffers.bufferSizeInFrames, inputConverter->GetInputFormat(), inputConverter->GetOutputFormat(), inputConverter->IsDithering());
+	}()),
+		outputMixing([&]() -> std::optional<Mixing> {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		if (!outputConverter.has_value() || !devices.outputMixingMatrix.has_value()) return std::nullopt;
+		return Mixing(*devices.outputMixingMatrix, preparedState.buffers.bufferSizeInFrames, outputConverter->GetInputFormat(), outputConverter->GetOutputFormat(), outputConverter->IsDithering());
+	}()),
+		inputMonitoring([&]() -> std::optional<InputMonitoring> {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		if (!devices.inputSampleType.has_value() || !devices.outputSampleType.has_value()) return std::nullopt;
+		return InputMonitoring(preparedState.buffers.bufferSizeInFrames, devices.inputSampleType->format, devices.outputSampleType->format);
+	}()) {
+		const auto& devices = preparedState.flexASIO.GetDevices();
+		const auto& config = preparedState.flexASIO.config;
+		if (devices.inputSampleType.has_value()) {
+			if (!config.input.equalizer.empty())
+				inputEqualizer.emplace(preparedState.bufferInfos, /*input=*/true, devices.inputSampleType->format, preparedState.buffers.bufferSizeInFrames, config.input.equalizer, preparedState.sampleRate);
+			inputGain.emplace(preparedState.bufferInfos, /*input=*/true, devices.inputSampleType->format, preparedState.sampleRate);
+			inputMetering.emplace(preparedState.bufferInfos, /*input=*/true, devices.inputSampleType->format);
+		}
+		if (devices.outputSampleType.has_value()) {
+			outputBufferBackup.emplace(preparedState.bufferInfos.size(), preparedState.buffers.bufferSizeInFrames * devices.outputSampleType->size);
+			outputGain.emplace(preparedState.bufferInfos, /*input=*/false, devices.outputSampleType->format, preparedState.sampleRate);
+			if (!config.output.equalizer.empty())
+				outputEqualizer.emplace(preparedState.bufferInfos, /*input=*/false, devices.outputSampleType->format, preparedState.buffers.bufferSizeInFrames, config.output.equalizer, preparedState.sampleRate);
+			outputMetering.emplace(preparedState.bufferInfos, /*input=*/false, devices.outputSampleType->format);
+		}
+	}
+
+	FlexASIO::PreparedState::RunningState::Interleaving::Interleaving(size_t channelCount, size_t bufferSizeInFrames, size_t deviceSampleSize) :
+		interleaver(channelCount, deviceSampleSize), scratchBufferSize(bufferSizeInFrames * deviceSampleSize),
+		scratchBuffers((channelCount + 1) * scratchBufferSize), channelBuffers(channelCount) {
+		Log() << "Using " << GetSimdImplementationName(interleaver.GetImplementation()) << " implementation to (de)interleave " << channelCount << " channels";
+	}
+
+	void FlexASIO::PreparedState::RunningState::Interleaving::DeinterleaveToAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, const long doubleBufferIndex, const std::byte* const interleaved, const size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters) {
+		std::fill(channelBuffers.begin(), channelBuffers.end(), GetScratchBuffer(channelBuffers.size()));
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			const auto deviceChannel = size_t(channelMap[bufferInfo.channelNum]);
+			channelBuffers[deviceChannel] = converter.IsIdentity() ? static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]) : GetScratchBuffer(deviceChannel);
+		}
+		interleaver.Deinterleave(interleaved, channelBuffers.data(), frameCount);
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput) continue;
+			const auto asioBuffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			if (liveParameters.IsMuted(bufferInfo.channelNum)) memset(asioBuffer, 0, frameCount * GetSampleFormatSize(converter.GetOutputFormat()));
+			else if (!converter.IsIdentity()) converter.Convert(channelBuffers[size_t(channelMap[bufferInfo.channelNum])], asioBuffer, frameCount);
+		}
+	}
+
+	void FlexASIO::PreparedState::RunningState::Interleaving::InterleaveFromAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, const long doubleBufferIndex, std::byte* const interleaved, const size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>& gains) {
+		std::fill(channelBuffers.begin(), channelBuffers.end(), GetScratchBuffer(channelBuffers.size()));
+		for (const auto& bufferInfo : bufferInfos) {
+			if (bufferInfo.isInput || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			const auto asioBuffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			const auto deviceChannel = size_t(channelMap[bufferInfo.channelNum]);
+			const auto& gain = gains[size_t(bufferInfo.channelNum)];
+			if (converter.IsIdentity() && gain.IsUnity()) {
+				channelBuffers[deviceChannel] = asioBuffer;
+				continue;
+			}
+			const auto scratchBuffer = GetScratchBuffer(deviceChannel);
+			ConvertWithGain(converter, asioBuffer, scratchBuffer, frameCount, gain);
+			channelBuffers[deviceChannel] = scratchBuffer;
+		}
+		interleaver.Interleave(channelBuffers.data(), interleaved, frameCount);
+	}
+
+	std::byte* const* FlexASIO::PreparedState::RunningState::Interleaving::DeinterleaveToScratchBuffers(const std::byte* const interleaved, const size_t frameCount) {
+		const auto channels = GetScratchBuffers();
+		interleaver.Deinterleave(interleaved, channels, frameCount);
+		return channels;
+	}
+
+	std::byte* const* FlexASIO::PreparedState::RunningState::Interleaving::GetScratchBuffers() {
+		for (size_t channel = 0; channel < channelBuffers.size(); ++channel) channelBuffers[channel] = GetScratchBuffer(channel);
+		return channelBuffers.data();
+	}
+
+	void FlexASIO::PreparedState::RunningState::Interleaving::InterleaveFromScratchBuffers(std::byte* const interleaved, const size_t frameCount) {
+		interleaver.Interleave(channelBuffers.data(), interleaved, frameCount);
+	}
+
+	FlexASIO::PreparedState::RunningState::Mixing::Mixing(const MixingMatrix& matrix, size_t bufferSizeInFrames, SampleFormat inputFormat, SampleFormat outputFormat, bool dither) :
+		matrix(matrix), bufferSizeInFrames(bufferSizeInFrames),
+		inputConverter(MakeSampleConverter("mixing matrix input", inputFormat, SampleFormat::FLOAT32, /*dither=*/false)),
+		outputConverter(MakeSampleConverter("mixing matrix output", SampleFormat::FLOAT32, outputFormat, dither)),
+		inputScratchBuffers(matrix.GetInputChannelCount() * bufferSizeInFrames),
+		outputScratchBuffers(outputConverter.IsIdentity() ? 0 : matrix.GetOutputChannelCount() * bufferSizeInFrames),
+		inputs(matrix.GetInputChannelCount()), outputs(matrix.GetOutputChannelCount()) {
+		Log() << "Using " << GetSimdImplementationName(matrix.GetImplementation()) << " implementation to mix " << matrix.GetInputChannelCount() << " channels into "
+			<< matrix.GetOutputChannelCount() << " channels, with " << matrix.GetNonZeroGainCount() << " non-zero gains";
+	}
+
+	void FlexASIO::PreparedState::RunningState::Mixing::MixToAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const std::byte* const* const deviceBuffers, const size_t deviceChannelCount, const size_t frameCount, const LiveParameters::Stream& liveParameters) {
+		std::fill(inputs.begin(), inputs.end(), nullptr);
+		for (size_t deviceChannel = 0; deviceChannel < deviceChannelCount; ++deviceChannel) {
+			if (inputConverter.IsIdentity()) {
+				inputs[deviceChannel] = reinterpret_cast<const float*>(deviceBuffers[deviceChannel]);
+				continue;
+			}
+			const auto scratchBuffer = GetInputScratchBuffer(deviceChannel);
+			inputConverter.Convert(deviceBuffers[deviceChannel], reinterpret_cast<std::byte*>(scratchBuffer), frameCount);
+			inputs[deviceChannel] = scratchBuffer;
+		}
+		std::fill(outputs.begin(), outputs.end(), nullptr);
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput) continue;
+			const auto asioBuffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			if (liveParameters.IsMuted(bufferInfo.channelNum)) memset(asioBuffer, 0, frameCount * GetSampleFormatSize(outputConverter.GetOutputFormat()));
+			else outputs[size_t(bufferInfo.channelNum)] = outputConverter.IsIdentity() ? reinterpret_cast<float*>(asioBuffer) : GetOutputScratchBuffer(size_t(bufferInfo.channelNum));
+		}
+		matrix.Mix(inputs.data(), outputs.data(), frameCount);
+		if (outputConverter.IsIdentity()) return;
+		for (const auto& bufferInfo : bufferInfos) {
+			const auto output = outputs[size_t(bufferInfo.channelNum)];
+			if (!bufferInfo.isInput || output == nullptr) continue;
+			outputConverter.Convert(reinterpret_cast<const std::byte*>(output), static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]), frameCount);
+		}
+	}
+
+	void FlexASIO::PreparedState::RunningState::Mixing::MixFromAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, std::byte* const* const deviceBuffers, const size_t deviceChannelCount, const size_t frameCount, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>& gains) {
+		std::fill(inputs.begin(), inputs.end(), nullptr);
+		for (const auto& bufferInfo : bufferInfos) {
+			if (bufferInfo.isInput || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			const auto asioBuffer = static_cast<const std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			const auto& gain = gains[size_t(bufferInfo.channelNum)];
+			if (inputConverter.IsIdentity() && gain.IsUnity()) {
+				inputs[size_t(bufferInfo.channelNum)] = reinterpret_cast<const float*>(asioBuffer);
+				continue;
+			}
+			const auto scratchBuffer = GetInputScratchBuffer(size_t(bufferInfo.channelNum));
+			ConvertWithGain(inputConverter, asioBuffer, reinterpret_cast<std::byte*>(scratchBuffer), frameCount, gain);
+			inputs[size_t(bufferInfo.channelNum)] = scratchBuffer;
+		}
+		std::fill(outputs.begin(), outputs.end(), nullptr);
+		for (size_t deviceChannel = 0; deviceChannel < deviceChannelCount; ++deviceChannel)
+			outputs[deviceChannel] = outputConverter.IsIdentity() ? reinterpret_cast<float*>(deviceBuffers[deviceChannel]) : GetOutputScratchBuffer(deviceChannel);
+		matrix.Mix(inputs.data(), outputs.data(), frameCount);
+		if (outputConverter.IsIdentity()) return;
+		for (size_t deviceChannel = 0; deviceChannel < deviceChannelCount; ++deviceChannel)
+			outputConverter.Convert(reinterpret_cast<const std::byte*>(outputs[deviceChannel]), deviceBuffers[deviceChannel], frameCount);
+	}
+
+	FlexASIO::PreparedState::RunningState::OutputBufferBackup::OutputBufferBackup(size_t bufferInfoCount, size_t bufferSizeInBytes) :
+		bufferSizeInBytes(bufferSizeInBytes), savedBuffers(bufferInfoCount * bufferSizeInBytes), savedSizesInBytes(bufferInfoCount) {}
+
+	void FlexASIO::PreparedState::RunningState::OutputBufferBackup::Save(const std::vector<ASIOBufferInfo>& bufferInfos, const size_t bufferInfoIndex, const long doubleBufferIndex, const size_t sizeInBytes) {
+		if (savedSizesInBytes[bufferInfoIndex] != 0) return;
+		memcpy(GetSavedBuffer(bufferInfoIndex), bufferInfos[bufferInfoIndex].buffers[doubleBufferIndex], sizeInBytes);
+		savedSizesInBytes[bufferInfoIndex] = sizeInBytes;
+	}
+
+	void FlexASIO::PreparedState::RunningState::OutputBufferBackup::Restore(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex) {
+		for (size_t bufferInfoIndex = 0; bufferInfoIndex < bufferInfos.size(); ++bufferInfoIndex) {
+			auto& savedSizeInBytes = savedSizesInBytes[bufferInfoIndex];
+			if (savedSizeInBytes == 0) continue;
+			memcpy(bufferInfos[bufferInfoIndex].buffers[doubleBufferIndex], GetSavedBuffer(bufferInfoIndex), savedSizeInBytes);
+			savedSizeInBytes = 0;
+		}
+	}
+
+	FlexASIO::PreparedState::RunningState::InputMonitoring::InputMonitoring(size_t bufferSizeInFrames, SampleFormat inputFormat, SampleFormat outputFormat) :
+		inputToFloatConverter(inputFormat, SampleFormat::FLOAT32, /*dither=*/false),
+		outputToFloatConverter(outputFormat, SampleFormat::FLOAT32, /*dither=*/false),
+		floatToOutputConverter(SampleFormat::FLOAT32, outputFormat, /*dither=*/false),
+		inputScratchBuffer(inputToFloatConverter.IsIdentity() ? 0 : bufferSizeInFrames),
+		outputScratchBuffer(outputToFloatConverter.IsIdentity() ? 0 : bufferSizeInFrames) {}
+
+	void FlexASIO::PreparedState::RunningState::InputMonitoring::AddToOutputBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long inputDoubleBufferIndex, const long outputDoubleBufferIndex, const size_t frameCount, const std::vector<LiveParameters::InputMonitor>& inputMonitors, OutputBufferBackup& outputBufferBackup) {
+		for (size_t outputBufferInfoIndex = 0; outputBufferInfoIndex < bufferInfos.size(); ++outputBufferInfoIndex) {
+			const auto& outputBufferInfo = bufferInfos[outputBufferInfoIndex];
+			if (outputBufferInfo.isInput) continue;
+			const auto outputBuffer = static_cast<std::byte*>(outputBufferInfo.buffers[outputDoubleBufferIndex]);
+			float* output = nullptr;
+			for (const auto& inputMonitor : inputMonitors) {
+				const auto gain =
+					(inputMonitor.leftOutputChannel == outputBufferInfo.channelNum ? inputMonitor.leftGain : 0.0f) +
+					(inputMonitor.rightOutputChannel == outputBufferInfo.channelNum ? inputMonitor.rightGain : 0.0f);
+				if (gain == 0.0f) continue;
+				// Input channels the host did not create buffers for cannot be monitored, as their samples are not kept.
+				const auto inputBufferInfo = std::find_if(bufferInfos.begin(), bufferInfos.end(), [&](const ASIOBufferInfo& bufferInfo) {
+					return bufferInfo.isInput && bufferInfo.channelNum == inputMonitor.inputChannel;
+				});
+				if (inputBufferInfo == bufferInfos.end()) continue;
+
+				if (output == nullptr) {
+					outputBufferBackup.Save(bufferInfos, outputBufferInfoIndex, outputDoubleBufferIndex, frameCount * GetSampleFormatSize(floatToOutputConverter.GetOutputFormat()));
+					if (outputToFloatConverter.IsIdentity()) output = reinterpret_cast<float*>(outputBuffer);
+					else {
+						output = outputScratchBuffer.data();
+						outputToFloatConverter.Convert(outputBuffer, reinterpret_cast<std::byte*>(output), frameCount);
+					}
+				}
+				const auto inputBuffer = static_cast<const std::byte*>(inputBufferInfo->buffers[inputDoubleBufferIndex]);
+				const float* input = reinterpret_cast<const float*>(inputBuffer);
+				if (!inputToFloatConverter.IsIdentity()) {
+					inputToFloatConverter.Convert(inputBuffer, reinterpret_cast<std::byte*>(inputScratchBuffer.data()), frameCount);
+					input = inputScratchBuffer.data();
+				}
+				for (size_t frame = 0; frame < frameCount; ++frame) output[frame] += gain * input[frame];
+			}
+			if (output != nullptr && !outputToFloatConverter.IsIdentity()) floatToOutputConverter.Convert(reinterpret_cast<const std::byte*>(output), outputBuffer, frameCount);
+		}
+	}
+
+	FlexASIO::PreparedState::RunningState::Gain::Gain(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input, const SampleFormat format, const ASIOSampleRate sampleRate) :
+		input(input),
+		converter(format, format, /*dither=*/false),
+		rampLengthInFrames((std::max)(size_t(sampleRate * gainRampLengthInSeconds), size_t(1))),
+		changes(GetBufferInfosChannelSpan(bufferInfos, input)) {
+		Log() << "Using " << GetSimdImplementationName(GainRamp().GetImplementation()) << " implementation for " << (input ? "input" : "output") << " gain, with changes ramped over " << rampLengthInFrames << " frames";
+	}
+
+	void FlexASIO::PreparedState::RunningState::Gain::Advance(const std::vector<ASIOBufferInfo>& bufferInfos, const size_t frameCount, const LiveParameters::Stream& liveParameters) {
+		const auto maxGainChange = float(frameCount) / float(rampLengthInFrames);
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput != !input) continue;
+			auto& change = changes[size_t(bufferInfo.channelNum)];
+			const auto currentGain = change.endGain;
+			const auto targetGain = liveParameters.GetGain(bufferInfo.channelNum);
+			// Muted channels are silent regardless of gain, so there is nothing to smooth.
+			if (liveParameters.IsMuted(bufferInfo.channelNum)) change = { .startGain = targetGain, .endGain = targetGain };
+			else change = { .startGain = currentGain, .endGain = std::clamp(targetGain, currentGain - maxGainChange, currentGain + maxGainChange) };
+		}
+	}
+
+	void FlexASIO::PreparedState::RunningState::Gain::Apply(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t frameCount, const LiveParameters::Stream& liveParameters) {
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput != !input || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			const auto& change = changes[size_t(bufferInfo.channelNum)];
+			if (change.IsUnity()) continue;
+			const auto buffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			converter.Convert(buffer, buffer, frameCount, change.startGain, change.endGain);
+		}
+	}
+
+	FlexASIO::PreparedState::RunningState::Equalizer::Equalizer(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input, const SampleFormat format, const size_t bufferSizeInFrames, const std::vector<Config::Stream::EqualizerFilter>& filters, const ASIOSampleRate sampleRate) :
+		input(input),
+		filterBank(GetEqualizerCascades(filters, GetBufferInfosChannelSpan(bufferInfos, input), sampleRate)),
+		toFloatConverter(format, SampleFormat::FLOAT32, /*dither=*/false),
+		fromFloatConverter(SampleFormat::FLOAT32, format, /*dither=*/false),
+		bufferSizeInFrames(bufferSizeInFrames),
+		scratchBuffers(toFloatConverter.IsIdentity() ? 0 : filterBank.GetChannelCount() * bufferSizeInFrames),
+		channels(filterBank.GetChannelCount()) {
+		Log() << "Using " << GetSimdImplementationName(filterBank.GetImplementation()) << " implementation to run " << filterBank.GetFilterCount() << " "
+			<< (input ? "input" : "output") << " equalizer filters over " << filterBank.GetChannelCount() << " channels";
+	}
+
+	void FlexASIO::PreparedState::RunningState::Equalizer::Apply(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t frameCount, const LiveParameters::Stream& liveParameters, OutputBufferBackup* const outputBufferBackup) {
+		std::fill(channels.begin(), channels.end(), nullptr);
+		for (size_t bufferInfoIndex = 0; bufferInfoIndex < bufferInfos.size(); ++bufferInfoIndex) {
+			const auto& bufferInfo = bufferInfos[bufferInfoIndex];
+			const auto channel = size_t(bufferInfo.channelNum);
+			// Muted channels are left as null, so that the filters ring out as if the channel went silent.
+			if (!bufferInfo.isInput != !input || !filterBank.IsFiltered(channel) || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			const auto buffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
+			if (outputBufferBackup != nullptr) outputBufferBackup->Save(bufferInfos, bufferInfoIndex, doubleBufferIndex, frameCount * GetSampleFormatSize(fromFloatConverter.GetOutputFormat()));
+			if (toFloatConverter.IsIdentity()) {
+				channels[channel] = reinterpret_cast<float*>(buffer);
+				continue;
+			}
+			const auto scratchBuffer = scratchBuffers.data() + channel * bufferSizeInFrames;
+			toFloatConverter.Convert(buffer, reinterpret_cast<std::byte*>(scratchBuffer), frameCount);
+			channels[channel] = scratchBuffer;
+		}
+		filterBank.Process(channels.data(), frameCount);
+		if (toFloatConverter.IsIdentity()) return;
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput != !input) continue;
+			const auto filtered = channels[size_t(bufferInfo.channelNum)];
+			if (filtered != nullptr) fromFloatConverter.Convert(reinterpret_cast<const std::byte*>(filtered), static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]), frameCount);
+		}
+	}
+
+	FlexASIO::PreparedState::RunningState::Metering::Metering(const std::vector<ASIOBufferInfo>& bufferInfos, const bool input, const SampleFormat format) :
+		input(input), peakDetector(format), peaks(GetBufferInfosChannelSpan(bufferInfos, input)) {}
+
+	void FlexASIO::PreparedState::RunningState::Metering::Measure(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t frameCount, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>* const pendingGains) {
+		if (!enabled.load(std::memory_order_relaxed)) return;
+		for (const auto& bufferInfo : bufferInfos) {
+			if (!bufferInfo.isInput != !input || liveParameters.IsMuted(bufferInfo.channelNum)) continue;
+			auto peak = peakDetector.GetPeak(static_cast<const std::byte*>(bufferInfo.buffers[doubleBufferIndex]), frameCount);
+			// Exact unless the gain is changing, in which case this is an upper bound.
+			if (pendingGains != nullptr) {
+				const auto& gain = (*pendingGains)[size_t(bufferInfo.channelNum)];
+				peak *= (std::max)(gain.startGain, gain.endGain);
+			}
+			// The host application resets the peak when it reads it, so the peak can only be raised here.
+			auto& channelPeak = peaks[size_t(bufferInfo.channelNum)];
+			auto currentPeak = channelPeak.load(std::memory_order_relaxed);
+			while (peak > currentPeak && !channelPeak.compare_exchange_weak(currentPeak, peak, std::memory_order_relaxed)) {}
+		}
+	}
+
+	float FlexASIO::PreparedState::RunningState::Metering::ReadPeak(const long channel) {
+		if (!enabled.exchange(true, std::memory_order_relaxed)) Log() << "Enabling " << (input ? "input" : "output") << " metering";
+		// Channels the host application did not create buffers for are silent.
+		if (channel < 0 || size_t(channel) >= peaks.size()) return 0;
+		return peaks[size_t(channel)].exchange(0, std::memory_order_relaxed);
+	}
 
 	FlexASIO::PreparedState::RunningState::~RunningState() {
 		if (outputReadyState.has_value()) {
@@ -926,11 +2078,17 @@ namespace flexasio {
 			// Note this code assumes that an application calls outputReady() *before* calling stop(), or that it calls
 			// it from within bufferSwitch(). If an application calls outputReady() after returning from bufferSwitch()
 			// *and* after calling stop(), then outputReady() will sadly race against RunningState teardown.
-			outputReady = OutputReadyState::STOPPING;
-			outputReady.notify_all();
+			ReleaseOutputReadyWait();
 		}
 	}
 
+	void FlexASIO::PreparedState::RunningState::ReleaseOutputReadyWait() {
+		if (!outputReadyState.has_value()) return;
+		auto& outputReady = *outputReadyState;
+		outputReady = OutputReadyState::STOPPING;
+		outputReady.notify_all();
+	}
+
 	void FlexASIO::PreparedState::RunningState::RunningState::Start() {
 		activeStream = StartStream(preparedState.streamWithExclusivity.stream.get());
 	}
@@ -943,18 +2101,32 @@ namespace flexasio {
 	void FlexASIO::PreparedState::Stop()
 	{
 		if (!runningState.has_value()) throw ASIOException(ASE_InvalidMode, "stop() called before start()");
+		if (hotStandby) {
+			Log() << "Returning to hot standby";
+			standbyRunningState = nullptr;
+			runningState->ReleaseOutputReadyWait();
+			// Wait for any stream callback that might still be using the running state.
+			for (auto callbacksInFlight = standbyCallbacksInFlight.load(); callbacksInFlight != 0; callbacksInFlight = standbyCallbacksInFlight.load())
+				standbyCallbacksInFlight.wait(callbacksInFlight);
+		}
 		runningState.reset();
+		started = false;
 	}
 
 	int FlexASIO::PreparedState::StreamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData) throw() {
+		// Logging is not real-time safe to begin with, so there is no point in checking while it is enabled.
+		const RealtimeScope realtimeScope(!IsLoggingEnabled());
 		if (IsLoggingEnabled()) Log() << "--- ENTERING STREAM CALLBACK";
 		PaStreamCallbackResult result = paContinue;
 		try {
 			auto& preparedState = *static_cast<PreparedState*>(userData);
-			if (!preparedState.runningState.has_value()) {
+			if (preparedState.hotStandby) {
+				result = preparedState.StandbyStreamCallback(input, output, frameCount, timeInfo, statusFlags);
+			}
+			else if (!preparedState.runningState.has_value()) {
 				throw std::runtime_error("PortAudio stream callback fired in non-started state");
 			}
-			result = preparedState.runningState->StreamCallback(input, output, frameCount, timeInfo, statusFlags);
+			else result = preparedState.runningState->StreamCallback(input, output, frameCount, timeInfo, statusFlags);
 		}
 		catch (const std::exception& exception) {
 			if (IsLoggingEnabled()) Log() << "Caught exception in stream callback: " << exception.what();
@@ -966,7 +2138,53 @@ namespace flexasio {
 		return result;
 	}
 
-	void FlexASIO::PreparedState::OnConfigChange() {
+	PaStreamCallbackResult FlexASIO::PreparedState::StandbyStreamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags) {
+		// Note the increment has to happen before standbyRunningState is read, so that Stop() cannot miss this callback.
+		++standbyCallbacksInFlight;
+		struct CallbackInFlight final {
+			std::atomic<int>& callbacksInFlight;
+			~CallbackInFlight() {
+				if (--callbacksInFlight == 0) callbacksInFlight.notify_all();
+			}
+		} callbackInFlight{ standbyCallbacksInFlight };
+
+		if (const auto runningState = standbyRunningState.load(); runningState != nullptr)
+			return runningState->StreamCallback(input, output, frameCount, timeInfo, statusFlags);
+
+		// Not started: discard input and play silence.
+		if (output != nullptr) {
+			// Only use what was captured when the stream was opened: the config can be replaced by host calls while this runs.
+			const auto outputSampleSizeInBytes = streamWithExclusivity.outputSampleSizeInBytes;
+			const auto outputChannelCount = streamWithExclusivity.outputChannelCount;
+			if (streamWithExclusivity.outputInterleaved) memset(output, 0, frameCount * outputChannelCount * outputSampleSizeInBytes);
+			else {
+				std::byte* const* output_samples = static_cast<std::byte* const*>(output);
+				for (int output_channel_index = 0; output_channel_index < outputChannelCount; ++output_channel_index)
+					memset(output_samples[output_channel_index], 0, frameCount * outputSampleSizeInBytes);
+			}
+		}
+		return paContinue;
+	}
+
+	void FlexASIO::PreparedState::OnConfigChange(const Config& newConfig) {
+		// Note this is called from the config watcher thread. Live parameters take effect immediately. Other changes that can be
+		// applied in place are applied by the next suitable host call instead, which avoids having to synchronize with every host call.
+		liveParameters.Update([&](LiveParameters& currentLiveParameters) { ApplyConfig(newConfig, currentLiveParameters); });
+		if (ClassifyConfigChange(flexASIO.configLoader.Initial(), newConfig) != ConfigChangeScope::RESET) {
+			if (flexASIO.SetPendingConfig(newConfig) != ConfigChangeScope::REOPEN_STREAM) {
+				Log() << "Config change will be applied the next time it is needed";
+				return;
+			}
+			if (!started) {
+				Log() << "Config change will be applied when streaming starts";
+				return;
+			}
+			// Hosts typically respond to this by stopping and restarting streaming, which is much faster than a reset.
+			Log() << "Issuing resync request so that the config change can be applied when streaming restarts";
+			if (SendMessageIfSupported(kAsioResyncRequest)) return;
+			Log() << "Host does not support resync requests";
+		}
+
 		Log() << "Issuing reset request due to config change";
 		try {
 			RequestReset();
@@ -1005,13 +2223,11 @@ namespace flexasio {
 		if (statusFlags & paOutputUnderflow && IsLoggingEnabled())
 			Log() << "OUTPUT UNDERFLOW detected (gaps were inserted in the output)";
 
-		const auto inputSampleSizeInBytes = preparedState.buffers.inputSampleSizeInBytes;
-		const auto outputSampleSizeInBytes = preparedState.buffers.outputSampleSizeInBytes;
-		const std::byte* const* input_samples = static_cast<const std::byte* const*> (input);
-		std::byte* const* output_samples = static_cast<std::byte* const*>(output);
-
-		if (output_samples) {
-			for (int output_channel_index = 0; output_channel_index < preparedState.flexASIO.GetOutputChannelCount(); ++output_channel_index)
+		// Interleaved buffers, and buffers that are mixed into, are entirely overwritten when output buffers are transferred.
+		if (output != nullptr && !outputInterleaving.has_value() && !outputMixing.has_value()) {
+			std::byte* const* output_samples = static_cast<std::byte* const*>(output);
+			const auto outputSampleSizeInBytes = GetSampleFormatSize(outputConverter->GetOutputFormat());
+			for (int output_channel_index = 0; output_channel_index < preparedState.streamWithExclusivity.outputChannelCount; ++output_channel_index)
 				memset(output_samples[output_channel_index], 0, frameCount * outputSampleSizeInBytes);
 		}
 
@@ -1019,9 +2235,27 @@ namespace flexasio {
 
 		// See dechamps_ASIOUtil/BUFFERS.md for the gory details of how ASIO buffer management works.
 
+		// Input monitoring mixes the input of this period into the output of this period, regardless of which buffers they are in.
+		const auto inputBufferIndex = driverBufferIndex;
 		if (state != State::PRIMING) {
 			if (IsLoggingEnabled()) Log() << "Transferring input buffers from PortAudio to ASIO buffer index #" << driverBufferIndex;
-			CopyFromPortAudioBuffers(preparedState.bufferInfos, driverBufferIndex, input_samples, frameCount * inputSampleSizeInBytes);
+			if (inputConverter.has_value()) {
+				const LiveParametersPublisher::ReadScope liveParameters(preparedState.liveParameters);
+				if (inputMixing.has_value()) {
+					const auto deviceBuffers = inputInterleaving.has_value() ?
+						inputInterleaving->DeinterleaveToScratchBuffers(static_cast<const std::byte*>(input), frameCount) : static_cast<const std::byte* const*>(input);
+					inputMixing->MixToAsioBuffers(preparedState.bufferInfos, driverBufferIndex, deviceBuffers, size_t(preparedState.streamWithExclusivity.inputChannelCount), frameCount, liveParameters->input);
+				}
+				else if (inputInterleaving.has_value())
+					inputInterleaving->DeinterleaveToAsioBuffers(preparedState.bufferInfos, preparedState.flexASIO.devices->inputChannelMap, driverBufferIndex, static_cast<const std::byte*>(input), frameCount, *inputConverter, liveParameters->input);
+				else
+					CopyFromPortAudioBuffers(preparedState.bufferInfos, preparedState.flexASIO.devices->inputChannelMap, driverBufferIndex, static_cast<const std::byte* const*>(input), frameCount, *inputConverter, liveParameters->input);
+				// The buffers were just written, so this is done while they are still in cache.
+				if (inputEqualizer.has_value()) inputEqualizer->Apply(preparedState.bufferInfos, driverBufferIndex, frameCount, liveParameters->input, /*outputBufferBackup=*/nullptr);
+				inputGain->Advance(preparedState.bufferInfos, frameCount, liveParameters->input);
+				inputGain->Apply(preparedState.bufferInfos, driverBufferIndex, frameCount, liveParameters->input);
+				inputMetering->Measure(preparedState.bufferInfos, driverBufferIndex, frameCount, liveParameters->input, /*pendingGains=*/nullptr);
+			}
 
 			if (outputReady != nullptr) {
 				// Reset OutputReady, but only if we are not STOPPING, atomically.
@@ -1031,6 +2265,7 @@ namespace flexasio {
 			if (!host_supports_timeinfo)
 			{
 				if (IsLoggingEnabled()) Log() << "Firing ASIO bufferSwitch() callback with buffer index: " << driverBufferIndex;
+				const NonRealtimeScope hostScope;
 				preparedState.callbacks.bufferSwitch(driverBufferIndex, ASIOTrue);
 				if (IsLoggingEnabled()) Log() << "bufferSwitch() complete";
 			}
@@ -1042,7 +2277,10 @@ namespace flexasio {
 				time.timeInfo.systemTime = currentSamplePosition.timestamp;
 				time.timeInfo.sampleRate = preparedState.sampleRate;
 				if (IsLoggingEnabled()) Log() << "Firing ASIO bufferSwitchTimeInfo() callback with buffer index: " << driverBufferIndex << ", time info: (" << ::dechamps_ASIOUtil::DescribeASIOTime(time) << ")";
-				const auto timeResult = preparedState.callbacks.bufferSwitchTimeInfo(&time, driverBufferIndex, ASIOTrue);
+				const auto timeResult = [&] {
+					const NonRealtimeScope hostScope;
+					return preparedState.callbacks.bufferSwitchTimeInfo(&time, driverBufferIndex, ASIOTrue);
+				}();
 				if (IsLoggingEnabled()) Log() << "bufferSwitchTimeInfo() complete, returned time info: " << (timeResult == nullptr ? "none" : ::dechamps_ASIOUtil::DescribeASIOTime(*timeResult));
 			}
 		}
@@ -1052,11 +2290,31 @@ namespace flexasio {
 		}
 		else if (*outputReady == OutputReadyState::NOT_READY) {
 			if (IsLoggingEnabled()) Log() << "Waiting for the ASIO Host Application to signal OutputReady or stop";
+			// Blocking on the host is inherent to the OutputReady protocol.
+			const NonRealtimeScope outputReadyScope;
 			outputReady->wait(OutputReadyState::NOT_READY);
 		}
 
 		if (IsLoggingEnabled()) Log() << "Transferring output buffers from buffer index #" << driverBufferIndex << " to PortAudio";
-		CopyToPortAudioBuffers(preparedState.bufferInfos, driverBufferIndex, output_samples, frameCount * outputSampleSizeInBytes);
+		if (outputConverter.has_value()) {
+			const LiveParametersPublisher::ReadScope liveParameters(preparedState.liveParameters);
+			const auto monitorInput = inputMonitoring.has_value() && state != State::PRIMING && !liveParameters->inputMonitors.empty();
+			if (monitorInput) inputMonitoring->AddToOutputBuffers(preparedState.bufferInfos, inputBufferIndex, driverBufferIndex, frameCount, liveParameters->inputMonitors, *outputBufferBackup);
+			if (outputEqualizer.has_value()) outputEqualizer->Apply(preparedState.bufferInfos, driverBufferIndex, frameCount, liveParameters->output, &*outputBufferBackup);
+			// Output gain is applied as part of the transfer to the device buffers, so that it does not cost an extra pass.
+			outputGain->Advance(preparedState.bufferInfos, frameCount, liveParameters->output);
+			outputMetering->Measure(preparedState.bufferInfos, driverBufferIndex, frameCount, liveParameters->output, &outputGain->GetChanges());
+			if (outputMixing.has_value()) {
+				const auto deviceBuffers = outputInterleaving.has_value() ? outputInterleaving->GetScratchBuffers() : static_cast<std::byte* const*>(output);
+				outputMixing->MixFromAsioBuffers(preparedState.bufferInfos, driverBufferIndex, deviceBuffers, size_t(preparedState.streamWithExclusivity.outputChannelCount), frameCount, liveParameters->output, outputGain->GetChanges());
+				if (outputInterleaving.has_value()) outputInterleaving->InterleaveFromScratchBuffers(static_cast<std::byte*>(output), frameCount);
+			}
+			else if (outputInterleaving.has_value())
+				outputInterleaving->InterleaveFromAsioBuffers(preparedState.bufferInfos, preparedState.flexASIO.devices->outputChannelMap, driverBufferIndex, static_cast<std::byte*>(output), frameCount, *outputConverter, liveParameters->output, outputGain->GetChanges());
+			else
+				CopyToPortAudioBuffers(preparedState.bufferInfos, preparedState.flexASIO.devices->outputChannelMap, driverBufferIndex, static_cast<std::byte* const*>(output), frameCount, *outputConverter, liveParameters->output, outputGain->GetChanges());
+			outputBufferBackup->Restore(preparedState.bufferInfos, driverBufferIndex);
+		}
 
 		if (outputReadyState.has_value()) driverBufferIndex = (driverBufferIndex + 1) % 2;
 
@@ -1120,12 +2378,96 @@ namespace flexasio {
 		}		
 	}
 
+	bool FlexASIO::PreparedState::SendMessageIfSupported(long selector) {
+		if (!callbacks.asioMessage || Message(callbacks.asioMessage, kAsioSelectorSupported, selector, nullptr, nullptr) != 1) return false;
+		Message(callbacks.asioMessage, selector, 0, nullptr, nullptr);
+		return true;
+	}
+
 	void FlexASIO::PreparedState::RequestReset() {
 		if (!callbacks.asioMessage || Message(callbacks.asioMessage, kAsioSelectorSupported, kAsioResetRequest, nullptr, nullptr) != 1)
 			throw ASIOException(ASE_InvalidMode, "reset requests are not supported");
 		Message(callbacks.asioMessage, kAsioResetRequest, 0, NULL, NULL);
 	}
 
+	void FlexASIO::SetInputMonitor(const ASIOInputMonitor& inputMonitor) {
+		Log() << "Input monitor request: input " << inputMonitor.input << ", output " << inputMonitor.output << ", gain " << inputMonitor.gain
+			<< ", state " << inputMonitor.state << ", pan " << inputMonitor.pan;
+		const auto inputChannelCount = GetInputChannelCount();
+		const auto outputChannelCount = GetOutputChannelCount();
+		if (inputMonitor.input < -1 || inputMonitor.input >= inputChannelCount) throw ASIOException(ASE_InvalidParameter, "invalid input channel for input monitoring");
+		const auto enabled = inputMonitor.state == ASIOTrue;
+		if (enabled && (inputMonitor.output < 0 || inputMonitor.output >= outputChannelCount)) throw ASIOException(ASE_InvalidParameter, "invalid output channel for input monitoring");
+		if (enabled && (inputMonitor.gain < 0 || inputMonitor.pan < 0)) throw ASIOException(ASE_InvalidParameter, "invalid gain or pan for input monitoring");
+
+		// An input channel is monitored on at most one output (pair) at a time. -1 means all input channels.
+		const auto isAffected = [&](long inputChannel) { return inputMonitor.input == -1 || inputChannel == inputMonitor.input; };
+		std::erase_if(inputMonitors, [&](const LiveParameters::InputMonitor& existing) { return isAffected(existing.inputChannel); });
+		if (enabled) {
+			// As per the ASIO SDK, 0x20000000 is 0 dB and 0x7FFFFFFF is +12 dB.
+			const auto gain = double(inputMonitor.gain) / 0x20000000;
+			// The pan goes from the requested output channel (0) to the next one (0x7FFFFFFF), with constant power.
+			const auto rightOutputChannel = inputMonitor.output + 1 < outputChannelCount ? inputMonitor.output + 1 : -1;
+			const auto panAngle = double(inputMonitor.pan) / 0x7FFFFFFF * std::numbers::pi / 2;
+			for (long inputChannel = 0; inputChannel < inputChannelCount; ++inputChannel) {
+				if (!isAffected(inputChannel)) continue;
+				inputMonitors.push_back({
+					.inputChannel = inputChannel,
+					.leftOutputChannel = inputMonitor.output,
+					.leftGain = float(rightOutputChannel == -1 ? gain : gain * std::cos(panAngle)),
+					.rightOutputChannel = rightOutputChannel,
+					.rightGain = float(rightOutputChannel == -1 ? 0 : gain * std::sin(panAngle)),
+				});
+			}
+		}
+		Log() << "Monitoring " << inputMonitors.size() << " input channels";
+
+		if (preparedState.has_value()) preparedState->OnHostParametersChange();
+	}
+
+	void FlexASIO::SetGain(const bool input, const ASIOChannelControls& channelControls) {
+		Log() << (input ? "Input" : "Output") << " gain request: channel " << channelControls.channel << ", gain " << channelControls.gain;
+		if (channelControls.channel < 0 || channelControls.channel >= (input ? GetInputChannelCount() : GetOutputChannelCount()))
+			throw ASIOException(ASE_InvalidParameter, "invalid channel for gain");
+		if (channelControls.gain < 0) throw ASIOException(ASE_InvalidParameter, "invalid gain");
+
+		auto& gains = input ? inputGains : outputGains;
+		if (gains.size() <= size_t(channelControls.channel)) gains.resize(size_t(channelControls.channel) + 1, 1.0f);
+		// Same scale as input monitoring: 0x20000000 is 0 dB and 0x7FFFFFFF is +12 dB.
+		gains[size_t(channelControls.channel)] = float(double(channelControls.gain) / 0x20000000);
+
+		if (preparedState.has_value()) preparedState->OnHostParametersChange();
+	}
+
+	void FlexASIO::ApplyHostParameters(LiveParameters& liveParameters) const {
+		liveParameters.inputMonitors = inputMonitors;
+		liveParameters.input.gains = inputGains;
+		liveParameters.output.gains = outputGains;
+	}
+
+	void FlexASIO::GetMeter(const bool input, ASIOChannelControls& channelControls) {
+		if (channelControls.channel < 0 || channelControls.channel >= (input ? GetInputChannelCount() : GetOutputChannelCount()))
+			throw ASIOException(ASE_InvalidParameter, "invalid channel for metering");
+		const auto peak = preparedState.has_value() ? preparedState->ReadPeak(input, channelControls.channel) : 0.0f;
+		// As per the ASIO SDK, meter values go from 0 to 0x7FFFFFFF, the latter being full scale.
+		channelControls.meter = long(std::clamp(double(peak), 0.0, 1.0) * 0x7FFFFFFF);
+		if (IsLoggingEnabled()) Log() << "Returning " << (input ? "input" : "output") << " channel " << channelControls.channel << " meter: " << channelControls.meter;
+	}
+
+	float FlexASIO::PreparedState::ReadPeak(const bool input, const long channel) {
+		if (!runningState.has_value()) return 0;
+		return runningState->ReadPeak(input, channel);
+	}
+
+	float FlexASIO::PreparedState::RunningState::ReadPeak(const bool input, const long channel) {
+		auto& metering = input ? inputMetering : outputMetering;
+		return metering.has_value() ? metering->ReadPeak(channel) : 0.0f;
+	}
+
+	void FlexASIO::PreparedState::OnHostParametersChange() {
+		liveParameters.Update([&](LiveParameters& currentLiveParameters) { flexASIO.ApplyHostParameters(currentLiveParameters); });
+	}
+
 	void FlexASIO::ControlPanel() {
 		return OpenControlPanel(windowHandle);
 	}
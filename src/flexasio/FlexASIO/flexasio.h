@@ -1,9 +1,19 @@
 #pragma once
 
 #include "config.h"
+#include "device_snapshot.h"
+#include "latency_calibration.h"
+#include "live_parameters.h"
 
 #include "portaudio.h"
+#include "portaudio_session.h"
+#include "../FlexASIOUtil/biquad.h"
+#include "../FlexASIOUtil/gain.h"
+#include "../FlexASIOUtil/interleaving.h"
+#include "../FlexASIOUtil/metering.h"
+#include "../FlexASIOUtil/mixing.h"
 #include "../FlexASIOUtil/portaudio.h"
+#include "../FlexASIOUtil/sample_conversion.h"
 
 #include <dechamps_ASIOUtil/asiosdk/asiosys.h>
 #include <dechamps_ASIOUtil/asiosdk/asio.h>
@@ -49,25 +59,38 @@ namespace flexasio {
 		void GetSamplePosition(ASIOSamples* sPos, ASIOTimeStamp* tStamp);
 		void OutputReady();
 
+		// Implements the kAsioSetInputMonitor future() selector.
+		void SetInputMonitor(const ASIOInputMonitor& inputMonitor);
+		// Implements the kAsioGetInputMeter and kAsioGetOutputMeter future() selectors.
+		void GetMeter(bool input, ASIOChannelControls& channelControls);
+		// Implements the kAsioSetInputGain and kAsioSetOutputGain future() selectors.
+		void SetGain(bool input, const ASIOChannelControls& channelControls);
+
 		void ControlPanel();
 
 	private:
 		struct SampleType {
 			ASIOSampleType asio;
+			// 0 if PortAudio does not support this type, in which case the device is opened with a different type.
 			PaSampleFormat pa;
 			size_t size;
 			GUID waveSubFormat;
+			SampleFormat format;
 		};
 
 		enum class StreamExclusivity { SHARED, EXCLUSIVE };
 
-		class PortAudioHandle {
-		public:
-			PortAudioHandle();
-			PortAudioHandle(const PortAudioHandle&) = delete;
-			PortAudioHandle(const PortAudioHandle&&) = delete;
-			~PortAudioHandle();
+		// What it takes for a config change to take effect, from least to most disruptive.
+		enum class ConfigChangeScope {
+			NONE,
+			// Does not affect the stream, e.g. the buffer sizes the driver suggests, or live parameters.
+			LIVE,
+			// The stream needs to be reopened, but the ASIO buffers can stay as they are.
+			REOPEN_STREAM,
+			// Changes what the host application has been told about the driver (e.g. channels, sample types).
+			RESET,
 		};
+		static ConfigChangeScope ClassifyConfigChange(const Config& oldConfig, const Config& newConfig);
 
 		class Win32HighResolutionTimer {
 		public:
@@ -83,8 +106,10 @@ namespace flexasio {
 			PreparedState(FlexASIO& flexASIO, ASIOSampleRate sampleRate, ASIOBufferInfo* asioBufferInfos, long numChannels, long bufferSizeInFrames, ASIOCallbacks* callbacks);
 			PreparedState(const PreparedState&) = delete;
 			PreparedState(PreparedState&&) = delete;
+			~PreparedState();
 
 			StreamExclusivity GetStreamExclusivity() const { return streamWithExclusivity.exclusivity;  }
+			bool IsRunning() const { return runningState.has_value(); }
 
 			bool IsChannelActive(bool isInput, long channel) const;
 
@@ -97,6 +122,22 @@ namespace flexasio {
 
 			void RequestReset();
 
+			// Reopens the stream at a different sample rate, keeping the same ASIO buffers. Only possible while stopped. If that does
+			// not work out, the host is asked to reset, which throws if the host does not support reset requests.
+			void ChangeSampleRate(ASIOSampleRate newSampleRate);
+
+			// Used to apply changes to the stream parameters in place. Only possible while stopped.
+			void CloseStream();
+			void ReopenStream();
+			// Called when a change (e.g. "config change") could not be applied in place, once the previous parameters are restored.
+			// The stream is reopened with these, so that the driver stays usable if the host does not honour the reset request that
+			// follows. Throws if the host does not support reset requests.
+			void ReopenWithPreviousConfig(std::string_view change);
+
+			// Publishes the parameters set by the host application.
+			void OnHostParametersChange();
+			float ReadPeak(bool input, long channel);
+
 		private:
 			struct Buffers
 			{
@@ -136,9 +177,14 @@ namespace flexasio {
 
 				void GetSamplePosition(ASIOSamples* sPos, ASIOTimeStamp* tStamp) const;
 				void OutputReady();
+				// Releases a stream callback that is waiting for OutputReady, and makes sure no further callback waits for it.
+				void ReleaseOutputReadyWait();
 
 				PaStreamCallbackResult StreamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags);
 
+				// Returns the peak level of the channel since the previous call, relative to full scale.
+				float ReadPeak(bool input, long channel);
+
 			private:
 				enum class State { PRIMING, PRIMED, STEADYSTATE };
 
@@ -156,17 +202,194 @@ namespace flexasio {
 				long driverBufferIndex = state == State::PRIMING ? 1 : 0;
 				std::atomic<SamplePosition> samplePosition;
 
+				// From device to ASIO buffers, and from ASIO to device buffers, respectively.
+				std::optional<SampleConverter> inputConverter;
+				std::optional<SampleConverter> outputConverter;
+
+				// Only used if the device buffers are interleaved.
+				struct Interleaving final {
+					Interleaving(size_t channelCount, size_t bufferSizeInFrames, size_t deviceSampleSize);
+
+					// Samples go straight from/to the ASIO buffers when no conversion is required, so that they are only copied once.
+					void DeinterleaveToAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, long doubleBufferIndex, const std::byte* interleaved, size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters);
+					void InterleaveFromAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const std::vector<int>& channelMap, long doubleBufferIndex, std::byte* interleaved, size_t frameCount, SampleConverter& converter, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>& gains);
+
+					// For processing stages that need every channel in a buffer of its own, such as mixing. InterleaveFromScratchBuffers() expects
+					// the buffers returned by GetScratchBuffers() to have been filled in.
+					std::byte* const* DeinterleaveToScratchBuffers(const std::byte* interleaved, size_t frameCount);
+					std::byte* const* GetScratchBuffers();
+					void InterleaveFromScratchBuffers(std::byte* interleaved, size_t frameCount);
+
+					std::byte* GetScratchBuffer(size_t channel) { return scratchBuffers.data() + channel * scratchBufferSize; }
+
+					Interleaver interleaver;
+					const size_t scratchBufferSize;
+					// One buffer per channel, in the device sample type, for channels that cannot be (de)interleaved directly from/to
+					// ASIO buffers (because they need to be converted, or because they have no ASIO buffer), plus one extra buffer
+					// which is always silent on output and discarded on input.
+					std::vector<std::byte> scratchBuffers;
+					// Where each channel is (de)interleaved from/to during the current callback.
+					std::vector<std::byte*> channelBuffers;
+				};
+				std::optional<Interleaving> inputInterleaving;
+				std::optional<Interleaving> outputInterleaving;
+
+				// Only used if channels are mixed. Mixing is done on 32-bit float samples, so samples are converted on both sides of the
+				// matrix. The matrix inputs are the device channels for input, and the ASIO channels for output.
+				struct Mixing final {
+					Mixing(const MixingMatrix& matrix, size_t bufferSizeInFrames, SampleFormat inputFormat, SampleFormat outputFormat, bool dither);
+
+					// `deviceBuffers` has one buffer per device channel the stream was opened with.
+					void MixToAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex, const std::byte* const* deviceBuffers, size_t deviceChannelCount, size_t frameCount, const LiveParameters::Stream& liveParameters);
+					void MixFromAsioBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex, std::byte* const* deviceBuffers, size_t deviceChannelCount, size_t frameCount, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>& gains);
+
+					float* GetInputScratchBuffer(size_t channel) { return inputScratchBuffers.data() + channel * bufferSizeInFrames; }
+					float* GetOutputScratchBuffer(size_t channel) { return outputScratchBuffers.data() + channel * bufferSizeInFrames; }
+
+					// Owned by Devices, which outlives the running state.
+					const MixingMatrix& matrix;
+					const size_t bufferSizeInFrames;
+					// From the matrix input sample type to float, and from float to the matrix output sample type, respectively.
+					SampleConverter inputConverter;
+					SampleConverter outputConverter;
+					// Only used for channels that need to be converted, or that have a gain applied on the way.
+					std::vector<float> inputScratchBuffers;
+					std::vector<float> outputScratchBuffers;
+					// What the matrix is fed with and writes to during the current callback.
+					std::vector<const float*> inputs;
+					std::vector<float*> outputs;
+				};
+				std::optional<Mixing> inputMixing;
+				std::optional<Mixing> outputMixing;
+
+				// Input monitoring and the output equalizer modify the ASIO output buffers in place, just before they are transferred. The
+				// original contents are restored afterwards, as the host application might not overwrite all of them in the next period.
+				struct OutputBufferBackup final {
+					OutputBufferBackup(size_t bufferInfoCount, size_t bufferSizeInBytes);
+
+					// Does nothing if the buffer was already saved.
+					void Save(const std::vector<ASIOBufferInfo>& bufferInfos, size_t bufferInfoIndex, long doubleBufferIndex, size_t sizeInBytes);
+					void Restore(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex);
+
+					std::byte* GetSavedBuffer(size_t bufferInfoIndex) { return savedBuffers.data() + bufferInfoIndex * bufferSizeInBytes; }
+
+					const size_t bufferSizeInBytes;
+					// Indexed by position in bufferInfos.
+					std::vector<std::byte> savedBuffers;
+					// Indexed by position in bufferInfos. Zero if the buffer was not saved.
+					std::vector<size_t> savedSizesInBytes;
+				};
+				std::optional<OutputBufferBackup> outputBufferBackup;
+
+				// Only used if there are both input and output channels. Input monitoring is applied to the ASIO output buffers, so that
+				// monitored input reaches the device in the same period it was recorded in.
+				struct InputMonitoring final {
+					InputMonitoring(size_t bufferSizeInFrames, SampleFormat inputFormat, SampleFormat outputFormat);
+
+					void AddToOutputBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, long inputDoubleBufferIndex, long outputDoubleBufferIndex, size_t frameCount, const std::vector<LiveParameters::InputMonitor>& inputMonitors, OutputBufferBackup& outputBufferBackup);
+
+					// Monitoring is done on 32-bit float samples. These convert from the ASIO input sample type, and from and to the ASIO
+					// output sample type.
+					SampleConverter inputToFloatConverter;
+					SampleConverter outputToFloatConverter;
+					SampleConverter floatToOutputConverter;
+					std::vector<float> inputScratchBuffer;
+					std::vector<float> outputScratchBuffer;
+				};
+				std::optional<InputMonitoring> inputMonitoring;
+
+				// Applies the gains set by the host application. Gain changes are spread over a few milliseconds. Channels that stay at
+				// unity gain are left alone, so that this costs nothing unless the host application changes gains.
+				struct Gain final {
+					Gain(const std::vector<ASIOBufferInfo>& bufferInfos, bool input, SampleFormat format, ASIOSampleRate sampleRate);
+
+					// Moves the gain of each channel towards its target by one buffer. Called once per buffer, before the gains are used.
+					void Advance(const std::vector<ASIOBufferInfo>& bufferInfos, size_t frameCount, const LiveParameters::Stream& liveParameters);
+					// Indexed by channel number. The gains over the course of the current buffer.
+					const std::vector<GainChange>& GetChanges() const { return changes; }
+
+					// Input only: applies the gains to the ASIO buffers, right after they are written. Output gains are applied while the
+					// ASIO buffers are transferred to the device instead, so that they do not have to be modified.
+					void Apply(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex, size_t frameCount, const LiveParameters::Stream& liveParameters);
+
+					const bool input;
+					// Gain is applied in place, on 32-bit float samples.
+					SampleConverter converter;
+					// A change from 0 to unity gain (or from unity to 0) takes this long. Other changes take proportionally long.
+					const size_t rampLengthInFrames;
+					std::vector<GainChange> changes;
+				};
+				std::optional<Gain> inputGain;
+				std::optional<Gain> outputGain;
+
+				// Only used if the `equalizer` option is set. Runs the ASIO buffers through the configured filters, right after they are
+				// written (input) or just before they are read (output).
+				struct Equalizer final {
+					Equalizer(const std::vector<ASIOBufferInfo>& bufferInfos, bool input, SampleFormat format, size_t bufferSizeInFrames, const std::vector<Config::Stream::EqualizerFilter>& filters, ASIOSampleRate sampleRate);
+
+					// `outputBufferBackup` is only used for output.
+					void Apply(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex, size_t frameCount, const LiveParameters::Stream& liveParameters, OutputBufferBackup* outputBufferBackup);
+
+					const bool input;
+					BiquadFilterBank filterBank;
+					// Filters run on 32-bit float samples.
+					SampleConverter toFloatConverter;
+					SampleConverter fromFloatConverter;
+					const size_t bufferSizeInFrames;
+					// One buffer per channel. Not used if the ASIO sample type is 32-bit float.
+					std::vector<float> scratchBuffers;
+					// Indexed by channel number. Null for channels that are not filtered in the current period.
+					std::vector<float*> channels;
+				};
+				std::optional<Equalizer> inputEqualizer;
+				std::optional<Equalizer> outputEqualizer;
+
+				// Measures the level of the ASIO buffers, on behalf of host applications that show meters but would rather not scan buffers
+				// themselves. Metering is only done once the host application has read a meter, so that it costs nothing otherwise.
+				struct Metering final {
+					Metering(const std::vector<ASIOBufferInfo>& bufferInfos, bool input, SampleFormat format);
+
+					// Called from the stream callback. `pendingGains` are the gains that have yet to be applied to the buffers, if any.
+					void Measure(const std::vector<ASIOBufferInfo>& bufferInfos, long doubleBufferIndex, size_t frameCount, const LiveParameters::Stream& liveParameters, const std::vector<GainChange>* pendingGains);
+					// Called from host calls.
+					float ReadPeak(long channel);
+
+					const bool input;
+					const PeakDetector peakDetector;
+					std::atomic<bool> enabled = false;
+					// Indexed by channel number. Peaks are held until the host application reads them.
+					std::vector<std::atomic<float>> peaks;
+				};
+				// Note these are constructed in place, as they are not movable.
+				std::optional<Metering> inputMetering;
+				std::optional<Metering> outputMetering;
+
 				Win32HighResolutionTimer win32HighResolutionTimer;
 				ActiveStream activeStream;
 			};
 
 			static int StreamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData) throw();
+			PaStreamCallbackResult StandbyStreamCallback(const void *input, void *output, unsigned long frameCount, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags);
 
-			void OnConfigChange();
+			void OnConfigChange(const Config& newConfig);
+			bool SendMessageIfSupported(long selector);
+
+			struct StreamWithExclusivity final {
+				Stream stream;
+				StreamExclusivity exclusivity;
+				// The number of device channels the stream was opened with, which can be less than the device channel count.
+				int inputChannelCount;
+				int outputChannelCount;
+				// Captured when the stream is opened, so that the stream callback does not have to read the config or the devices.
+				bool outputInterleaved;
+				size_t outputSampleSizeInBytes;
+			};
+			StreamWithExclusivity OpenStream();
 
 			FlexASIO& flexASIO;
-			const ASIOSampleRate sampleRate;
+			ASIOSampleRate sampleRate;
 			const ASIOCallbacks callbacks;
+			const bool hotStandby;
 
 			// PortAudio buffer addresses are dynamic and are only valid for the duration of the stream callback.
 			// In contrast, ASIO buffer addresses are static and are valid for as long as the stream is running.
@@ -174,29 +397,46 @@ namespace flexasio {
 			Buffers buffers;
 			const std::vector<ASIOBufferInfo> bufferInfos;
 
-			struct StreamWithExclusivity final {
-				Stream stream;
-				StreamExclusivity exclusivity;
-			};
-			const StreamWithExclusivity streamWithExclusivity;
+			// Note: this has to be initialized before the stream is opened, as calibration uses its own stream on the same devices.
+			std::optional<CalibratedLatencies> calibratedLatencies;
+
+			StreamWithExclusivity streamWithExclusivity;
 
 			std::optional<RunningState> runningState;
+			// Mirrors runningState.has_value() for the benefit of the config watcher thread.
+			std::atomic<bool> started = false;
+			LiveParametersPublisher liveParameters;
 			ConfigLoader::Watcher configWatcher;
+
+			// In hot standby mode, the stream keeps running between stop() and start(). The stream callback only
+			// forwards to the running state while it is published here.
+			std::atomic<RunningState*> standbyRunningState = nullptr;
+			std::atomic<int> standbyCallbacksInFlight = 0;
+			ActiveStream standbyStream;
 		};
 
 		static const SampleType float32;
 		static const SampleType int32;
 		static const SampleType int24;
 		static const SampleType int16;
+		static const SampleType int32LSB24;
+		static const SampleType int32LSB16;
+		static const SampleType float64;
 		static const std::pair<std::string_view, SampleType> sampleTypes[];
 		static SampleType ParseSampleType(std::string_view str);
 		static SampleType WaveFormatToSampleType(const WAVEFORMATEXTENSIBLE& waveFormat);
-		static SampleType SelectSampleType(PaHostApiTypeId hostApiTypeId, const Device& device, const Config::Stream& streamConfig);
+		static SampleType SelectSampleType(PaHostApiTypeId hostApiTypeId, const Device& device, bool output, int channelCount, DWORD channelMask, const Config::Stream& streamConfig, std::optional<uint64_t> deviceTopology);
+		// Looks for the sample type the device uses natively, so that the stream can be opened without PortAudio or the Windows audio engine converting samples.
+		static std::optional<SampleType> NegotiateNativeSampleType(PaHostApiTypeId hostApiTypeId, const Device& device, bool output, int channelCount, DWORD channelMask, const Config::Stream& streamConfig, std::optional<uint64_t> deviceTopology);
+		static SampleType SelectDeviceSampleType(const SampleType& asioSampleType, const Config::Stream& streamConfig);
 		static std::string DescribeSampleType(const SampleType&);
 		static DWORD SelectChannelMask(PaHostApiTypeId hostApiTypeId, const Device& device, const Config::Stream& streamConfig);
 
 		int GetInputChannelCount() const;
 		int GetOutputChannelCount() const;
+		// Returns how many device channels to open so that the first `channelSpan` device channels are covered. This is less than
+		// the device channel count if the backend can open a subset of the channels without remixing them.
+		int GetStreamChannelCount(bool output, int channelSpan) const;
 
 		struct BufferSizes {
 			long minimum;
@@ -208,29 +448,90 @@ namespace flexasio {
 
 		long ComputeLatency(long latencyInFrames, bool output, size_t bufferSizeInFrames) const;
 		long ComputeLatencyFromStream(PaStream* stream, bool output, size_t bufferSizeInFrames) const;
+		long GetStreamLatency(PaStream* stream, bool output) const;
+		DeviceCapabilities::SampleRateSupport CheckSampleRateSupport(ASIOSampleRate sampleRate) const;
+		DeviceCapabilities::ProbedLatencies ProbeLatencies(long bufferSizeInFrames) const;
+		// Returns nullopt if latency calibration is not enabled, or if no calibration is available.
+		// If `measure` is false, only previously measured latencies are returned.
+		std::optional<CalibratedLatencies> CalibrateLatency(long bufferSizeInFrames, bool measure) const;
 
 		template <typename Functor>
-		decltype(auto) WithStreamParameters(bool inputEnabled, bool outputEnabled, double sampleRate, PaTime suggestedLatency, Functor functor) const;
+		// A channel count of zero means the corresponding direction is not used.
+		decltype(auto) WithStreamParameters(int inputChannelCount, int outputChannelCount, double sampleRate, PaTime suggestedLatency, Functor functor) const;
 		Stream OpenStream(const StreamParameters&, unsigned long framesPerBuffer, PaStreamCallback callback, void* callbackUserData) const;
 
-		const HWND windowHandle = nullptr;
-		const ConfigLoader configLoader;
-		const Config& config = configLoader.Initial();
+		// Everything that requires PortAudio to be initialized.
+		class Devices final {
+		public:
+			// `deviceTopology` is used to look up format support in the capability matrix, if available.
+			Devices(const Config& config, std::optional<uint64_t> deviceTopology);
+
+			DeviceSnapshot GetSnapshot() const;
+
+			PortAudioDebugRedirector portAudioDebugRedirector;
+			// Must come before any member that calls into PortAudio: its constructor blocks until PortAudio is initialized.
+			PortAudioSession portAudioSession;
+
+			const HostApi hostApi;
+			const std::optional<Device> inputDevice;
+			const std::optional<Device> outputDevice;
+			// Selected before sample types, because sample type negotiation needs to know the channel layout.
+			const DWORD inputChannelMask;
+			const DWORD outputChannelMask;
+			const int inputChannelCount;
+			const int outputChannelCount;
+			// Set if ASIO channels are mixed from/to device channels, in which case the channel maps are empty.
+			const std::optional<MixingMatrix> inputMixingMatrix;
+			const std::optional<MixingMatrix> outputMixingMatrix;
+			// The device channel each ASIO channel is routed to. Also determines the number of ASIO channels.
+			const std::vector<int> inputChannelMap;
+			const std::vector<int> outputChannelMap;
+			const std::optional<SampleType> inputSampleType;
+			const std::optional<SampleType> outputSampleType;
+			// The sample types the streams are opened with. Samples are converted from/to the ASIO sample types in the stream callback.
+			const std::optional<SampleType> inputDeviceSampleType;
+			const std::optional<SampleType> outputDeviceSampleType;
+		};
+
+		// Initializes PortAudio if that was deferred. Throws if the devices do not match the snapshot that was used in the meantime.
+		const Devices& GetDevices() const;
+		std::optional<uint64_t> GetDeviceTopology() const { return deviceSnapshotKey.has_value() ? std::optional(deviceSnapshotKey->deviceTopology) : std::nullopt; }
+		void StoreDeviceCache() const;
 
-		PortAudioDebugRedirector portAudioDebugRedirector;
-		PortAudioHandle portAudioHandle;
+		// Called from the config watcher thread. The config is only applied later, from a host call made while stopped.
+		ConfigChangeScope SetPendingConfig(Config newConfig);
+		void ApplyPendingConfig();
 
-		const HostApi hostApi;
-		const std::optional<Device> inputDevice;
-		const std::optional<Device> outputDevice;
-		const std::optional<SampleType> inputSampleType;
-		const std::optional<SampleType> outputSampleType;
-		const DWORD inputChannelMask;
-		const DWORD outputChannelMask;
+		const HWND windowHandle = nullptr;
+		const ConfigLoader configLoader;
+		// Only ever modified from host calls, while holding configMutex. This means host calls can read it without locking.
+		Config config = configLoader.Initial();
+		std::mutex configMutex;
+		// A config that differs from the current one, waiting to be applied.
+		std::optional<Config> pendingConfig;
+
+		// Hosts often instantiate every driver just to query channel counts and sample rates. To make this cheap, these queries
+		// are answered from a snapshot of a previous PortAudio initialization, and PortAudio is only initialized when it is
+		// actually needed. If no valid snapshot is available, PortAudio is initialized immediately instead.
+		// The snapshot is persisted along with the results of expensive device queries, which are reused across instances.
+		const std::optional<DeviceSnapshotKey> deviceSnapshotKey;
+		mutable std::optional<Devices> devices;
+		mutable DeviceCapabilities deviceCapabilities;
+		mutable DeviceSnapshot deviceSnapshot;
+		// Set from the FLEXASIO_FORMAT_CHECKS environment variable, for benchmarking (see FlexASIOTest --sample-rate-queries), in
+		// builds configured with the FLEXASIO_FORMAT_CHECKS CMake option only. If set, canSampleRate() bypasses the device cache and
+		// the capability matrix, and checks input and output concurrently where the backend allows it (true) or always one after
+		// the other (false).
+		const std::optional<bool> forcedConcurrentFormatChecks;
 
 		ASIOSampleRate sampleRate = 0;
 		bool sampleRateWasAccessed = false;
 		bool hostSupportsOutputReady = false;
+		// Set by the host application. These outlive the prepared state, as hosts can set them at any time after init().
+		std::vector<LiveParameters::InputMonitor> inputMonitors;
+		std::vector<float> inputGains;
+		std::vector<float> outputGains;
+		void ApplyHostParameters(LiveParameters& liveParameters) const;
 
 		std::optional<PreparedState> preparedState;
 	};
@@ -0,0 +1,234 @@
+#define _CRT_SECURE_NO_WARNINGS  // Avoid issues with toml.h
+
+#include "latency_calibration.h"
+
+#include <dechamps_cpputil/exception.h>
+#include <toml/toml.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "log.h"
+#include "portaudio.h"
+#include "../FlexASIOUtil/loopback.h"
+#include "../FlexASIOUtil/portaudio.h"
+#include "../FlexASIOUtil/toml.h"
+
+namespace flexasio {
+
+	namespace {
+
+		// The test signal is only played after the stream has had time to settle.
+		constexpr unsigned long warmupCallbackCount = 16;
+		// 4095 samples, i.e. ~85 ms at 48 kHz.
+		constexpr int stimulusMlsOrder = 12;
+		constexpr float stimulusAmplitude = 0.5f;
+		// Round-trip latencies longer than this cannot be measured.
+		constexpr double maxRoundTripLatencySeconds = 1;
+		constexpr double minimumPeakToRms = 8;
+
+		PaSampleFormat GetSampleFormatWithoutFlags(PaSampleFormat sampleFormat) {
+			return sampleFormat & ~paNonInterleaved;
+		}
+
+		bool IsInterleaved(PaSampleFormat sampleFormat) {
+			return (sampleFormat & paNonInterleaved) == 0;
+		}
+
+		SampleFormat GetSampleFormat(PaSampleFormat sampleFormat) {
+			switch (GetSampleFormatWithoutFlags(sampleFormat)) {
+			case paFloat32: return SampleFormat::FLOAT32;
+			case paInt32: return SampleFormat::INT32;
+			case paInt24: return SampleFormat::INT24;
+			case paInt16: return SampleFormat::INT16;
+			}
+			throw std::runtime_error("sample format " + GetSampleFormatString(sampleFormat) + " is not supported for latency calibration");
+		}
+
+		std::vector<float> GenerateStimulus() {
+			auto stimulus = GenerateMaximumLengthSequence(stimulusMlsOrder);
+			for (auto& sample : stimulus) sample *= stimulusAmplitude;
+			return stimulus;
+		}
+
+		const toml::Value& GetTableValue(const toml::Table& table, const std::string& key) {
+			const auto value = table.find(key);
+			if (value == table.end()) throw std::runtime_error("missing '" + key + "' key");
+			return value->second;
+		}
+
+	}
+
+	LatencyCalibrationCache::LatencyCalibrationCache(std::filesystem::path path) : path(std::move(path)) {
+		Log() << "Loading latency calibration cache from " << this->path;
+
+		std::ifstream stream(this->path);
+		if (!stream.is_open()) {
+			Log() << "Unable to open latency calibration cache file, assuming empty cache";
+			return;
+		}
+
+		try {
+			const auto parseResult = toml::parse(stream);
+			if (!parseResult.valid()) throw std::runtime_error(parseResult.errorReason);
+			const auto& root = parseResult.value.as<toml::Table>();
+			const auto measurements = root.find("measurement");
+			if (measurements == root.end()) return;
+			for (const auto& measurement : measurements->second.as<toml::Array>()) {
+				const auto& table = measurement.as<toml::Table>();
+				entries.push_back({
+					.key = {
+						.backend = GetTableValue(table, "backend").as<std::string>(),
+						.inputDevice = GetTableValue(table, "inputDevice").as<std::string>(),
+						.outputDevice = GetTableValue(table, "outputDevice").as<std::string>(),
+						.sampleRate = GetTableValue(table, "sampleRate").as<double>(),
+						.bufferSizeInFrames = long(GetTableValue(table, "bufferSizeSamples").as<int64_t>()),
+						.inputSuggestedLatencySeconds = GetTableValue(table, "inputSuggestedLatencySeconds").as<double>(),
+						.outputSuggestedLatencySeconds = GetTableValue(table, "outputSuggestedLatencySeconds").as<double>(),
+						.exclusive = GetTableValue(table, "exclusive").as<bool>(),
+					},
+					.latencies = {
+						.input = long(GetTableValue(table, "inputLatencySamples").as<int64_t>()),
+						.output = long(GetTableValue(table, "outputLatencySamples").as<int64_t>()),
+					},
+				});
+			}
+		}
+		catch (const std::exception& exception) {
+			Log() << "Unable to parse latency calibration cache, ignoring it: " << ::dechamps_cpputil::GetNestedExceptionMessage(exception);
+			entries.clear();
+		}
+		Log() << "Loaded " << entries.size() << " latency calibration entries";
+	}
+
+	std::optional<CalibratedLatencies> LatencyCalibrationCache::Find(const LatencyCalibrationKey& key) const {
+		for (const auto& entry : entries)
+			if (entry.key == key) return entry.latencies;
+		return std::nullopt;
+	}
+
+	void LatencyCalibrationCache::Store(const LatencyCalibrationKey& key, CalibratedLatencies latencies) {
+		const auto entry = std::find_if(entries.begin(), entries.end(), [&](const Entry& entry) { return entry.key == key; });
+		if (entry != entries.end()) entry->latencies = latencies;
+		else entries.push_back({ .key = key, .latencies = latencies });
+		Save();
+	}
+
+	void LatencyCalibrationCache::Save() const {
+		Log() << "Saving latency calibration cache to " << path;
+
+		// Write to a temporary file first, so that a concurrent reader never observes a partially written file.
+		auto temporaryPath = path;
+		temporaryPath += L".tmp";
+		{
+			std::ofstream stream;
+			stream.exceptions(stream.badbit | stream.failbit);
+			stream.open(temporaryPath);
+			stream << "# FlexASIO latency calibration cache. This file is generated automatically; delete it to force recalibration." << std::endl;
+			stream << std::setprecision(17);
+			for (const auto& entry : entries) {
+				stream << std::endl << "[[measurement]]" << std::endl;
+				stream << "backend = " << EscapeTomlString(entry.key.backend) << std::endl;
+				stream << "inputDevice = " << EscapeTomlString(entry.key.inputDevice) << std::endl;
+				stream << "outputDevice = " << EscapeTomlString(entry.key.outputDevice) << std::endl;
+				stream << "sampleRate = " << std::showpoint << entry.key.sampleRate << std::noshowpoint << std::endl;
+				stream << "bufferSizeSamples = " << entry.key.bufferSizeInFrames << std::endl;
+				stream << "inputSuggestedLatencySeconds = " << std::showpoint << entry.key.inputSuggestedLatencySeconds << std::noshowpoint << std::endl;
+				stream << "outputSuggestedLatencySeconds = " << std::showpoint << entry.key.outputSuggestedLatencySeconds << std::noshowpoint << std::endl;
+				stream << "exclusive = " << (entry.key.exclusive ? "true" : "false") << std::endl;
+				stream << "inputLatencySamples = " << entry.latencies.input << std::endl;
+				stream << "outputLatencySamples = " << entry.latencies.output << std::endl;
+			}
+		}
+		std::filesystem::rename(temporaryPath, path);
+	}
+
+	LatencyCalibration::LatencyCalibration(Channel input, Channel output, double sampleRate) :
+		input(input), output(output), sampleRate(sampleRate),
+		inputConverter(GetSampleFormat(input.sampleFormat), SampleFormat::FLOAT32, /*dither=*/false),
+		outputConverter(SampleFormat::FLOAT32, GetSampleFormat(output.sampleFormat), /*dither=*/false),
+		stimulus(GenerateStimulus()), recording(stimulus.size() + size_t(maxRoundTripLatencySeconds * sampleRate)) {
+		if (input.index < 0 || input.index >= input.count) throw std::runtime_error("latency calibration input channel " + std::to_string(input.index) + " is out of range");
+		if (output.index < 0 || output.index >= output.count) throw std::runtime_error("latency calibration output channel " + std::to_string(output.index) + " is out of range");
+	}
+
+	int LatencyCalibration::StreamCallback(const void* input, void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void* userData) throw() {
+		return static_cast<LatencyCalibration*>(userData)->OnStreamCallback(input, output, frameCount);
+	}
+
+	// Both the test signal and the recording start at the first frame of callback number `warmupCallbackCount`.
+	// The index of the test signal in the recording is therefore the round-trip latency in frames.
+	int LatencyCalibration::OnStreamCallback(const void* inputBuffers, void* outputBuffers, unsigned long frameCount) {
+		const auto outputSampleSize = GetSampleFormatSize(outputConverter.GetOutputFormat());
+		if (outputBuffers != nullptr) {
+			if (IsInterleaved(output.sampleFormat)) memset(outputBuffers, 0, frameCount * output.count * outputSampleSize);
+			else
+				for (int channel = 0; channel < output.count; ++channel)
+					memset(static_cast<void* const*>(outputBuffers)[channel], 0, frameCount * outputSampleSize);
+		}
+
+		if (callbackCount < warmupCallbackCount) {
+			++callbackCount;
+			return paContinue;
+		}
+
+		// With interleaved buffers, the channel is found at a fixed offset within each frame. Samples are therefore converted one at a
+		// time.
+		const auto outputInterleaved = IsInterleaved(output.sampleFormat);
+		const auto outputBuffer = static_cast<std::byte*>(outputBuffers == nullptr || outputInterleaved ? outputBuffers : static_cast<void* const*>(outputBuffers)[output.index]);
+		const size_t outputStride = (outputInterleaved ? size_t(output.count) : 1) * outputSampleSize;
+		const size_t outputOffset = (outputInterleaved ? size_t(output.index) : 0) * outputSampleSize;
+		const auto inputInterleaved = IsInterleaved(input.sampleFormat);
+		const auto inputBuffer = static_cast<const std::byte*>(inputBuffers == nullptr || inputInterleaved ? inputBuffers : static_cast<const void* const*>(inputBuffers)[input.index]);
+		const auto inputSampleSize = GetSampleFormatSize(inputConverter.GetInputFormat());
+		const size_t inputStride = (inputInterleaved ? size_t(input.count) : 1) * inputSampleSize;
+		const size_t inputOffset = (inputInterleaved ? size_t(input.index) : 0) * inputSampleSize;
+		for (unsigned long frame = 0; frame < frameCount; ++frame, ++position) {
+			if (outputBuffer != nullptr && position < stimulus.size())
+				outputConverter.Convert(reinterpret_cast<const std::byte*>(&stimulus[position]), outputBuffer + frame * outputStride + outputOffset, 1);
+			if (inputBuffer != nullptr && position < recording.size())
+				inputConverter.Convert(inputBuffer + frame * inputStride + inputOffset, reinterpret_cast<std::byte*>(&recording[position]), 1);
+		}
+		if (position < recording.size()) return paContinue;
+
+		done.store(true, std::memory_order_release);
+		return paComplete;
+	}
+
+	std::optional<long> LatencyCalibration::Run(PaStream* stream) {
+		Log() << "Running latency calibration: playing a " << stimulus.size() << "-sample maximum length sequence on output channel " << output.index << " and recording input channel " << input.index;
+		{
+			const auto activeStream = StartStream(stream);
+			const auto expectedDuration = std::chrono::duration<double>(recording.size() / sampleRate);
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(2 * expectedDuration + std::chrono::seconds(2));
+			while (!done.load(std::memory_order_acquire)) {
+				if (std::chrono::steady_clock::now() > deadline) throw std::runtime_error("timed out waiting for latency calibration recording to complete");
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+
+		const auto detection = DetectLoopbackStimulus(recording, stimulus, minimumPeakToRms);
+		if (!detection.has_value()) {
+			Log() << "Latency calibration signal was not found in the recording";
+			return std::nullopt;
+		}
+		Log() << "Latency calibration signal found at offset " << detection->offset << " (peak to RMS ratio " << detection->peakToRms << (detection->inverted ? ", inverted" : "") << ")";
+		return long(detection->offset);
+	}
+
+	CalibratedLatencies SplitRoundTripLatency(long roundTripLatency, const PaStreamInfo& streamInfo) {
+		const auto reportedRoundTripLatency = streamInfo.inputLatency + streamInfo.outputLatency;
+		const auto inputLatency = reportedRoundTripLatency > 0 ?
+			long(std::lround(roundTripLatency * streamInfo.inputLatency / reportedRoundTripLatency)) :
+			roundTripLatency / 2;
+		return { .input = inputLatency, .output = roundTripLatency - inputLatency };
+	}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../FlexASIOUtil/sample_conversion.h"
+
+#include <portaudio.h>
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace flexasio {
+
+	// Identifies a device configuration whose latency has been measured.
+	struct LatencyCalibrationKey final {
+		std::string backend;
+		std::string inputDevice;
+		std::string outputDevice;
+		double sampleRate;
+		long bufferSizeInFrames;
+		double inputSuggestedLatencySeconds;
+		double outputSuggestedLatencySeconds;
+		bool exclusive;
+
+		bool operator==(const LatencyCalibrationKey&) const = default;
+	};
+
+	// Latencies in frames, as seen by a PortAudio stream callback (i.e. not including any ASIO-specific adjustments).
+	struct CalibratedLatencies final {
+		long input;
+		long output;
+	};
+
+	// Persists latency measurements so that calibration only needs to run once per device configuration.
+	class LatencyCalibrationCache final {
+	public:
+		explicit LatencyCalibrationCache(std::filesystem::path path);
+
+		std::optional<CalibratedLatencies> Find(const LatencyCalibrationKey&) const;
+		void Store(const LatencyCalibrationKey&, CalibratedLatencies);
+
+	private:
+		struct Entry final {
+			LatencyCalibrationKey key;
+			CalibratedLatencies latencies;
+		};
+
+		void Save() const;
+
+		const std::filesystem::path path;
+		std::vector<Entry> entries;
+	};
+
+	// Plays a test signal on one output channel of a full duplex, non-interleaved PortAudio stream and locates it on one input
+	// channel, which is expected to be looped back to the output channel.
+	class LatencyCalibration final {
+	public:
+		struct Channel final {
+			int index;
+			int count;
+			PaSampleFormat sampleFormat;
+		};
+
+		LatencyCalibration(Channel input, Channel output, double sampleRate);
+
+		LatencyCalibration(const LatencyCalibration&) = delete;
+		LatencyCalibration& operator=(const LatencyCalibration&) = delete;
+
+		// The stream must be opened with this callback, with a pointer to this object as the user data.
+		static int StreamCallback(const void* input, void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData) throw();
+
+		// Runs the stream until the recording is complete. Returns the round-trip latency in frames, or nullopt if the test signal
+		// could not be found in the recording.
+		std::optional<long> Run(PaStream*);
+
+	private:
+		int OnStreamCallback(const void* input, void* output, unsigned long frameCount);
+
+		const Channel input;
+		const Channel output;
+		const double sampleRate;
+		SampleConverter inputConverter;
+		SampleConverter outputConverter;
+		const std::vector<float> stimulus;
+		std::vector<float> recording;
+		unsigned long callbackCount = 0;
+		size_t position = 0;
+		std::atomic<bool> done = false;
+	};
+
+	// Splits a measured round-trip latency into input and output latencies, in proportion to what PortAudio reports for the stream.
+	CalibratedLatencies SplitRoundTripLatency(long roundTripLatency, const PaStreamInfo&);
+
+}
@@ -0,0 +1,62 @@
+#include "live_parameters.h"
+
+#include <algorithm>
+
+namespace flexasio {
+
+	namespace {
+
+		void ApplyStreamConfig(const Config::Stream& streamConfig, LiveParameters::Stream& stream) {
+			stream.muted.clear();
+			for (const auto channel : streamConfig.mutedChannels) {
+				if (size_t(channel) >= stream.muted.size()) stream.muted.resize(size_t(channel) + 1);
+				stream.muted[size_t(channel)] = true;
+			}
+		}
+
+		const LiveParameters* EnterReadScope(std::atomic<uint64_t>& readerGeneration, const std::atomic<const LiveParameters*>& current) {
+			// Note the generation has to be incremented before the snapshot is loaded, so that Publish() cannot miss this reader.
+			++readerGeneration;
+			return current.load();
+		}
+
+	}
+
+	void ApplyConfig(const Config& config, LiveParameters& liveParameters) {
+		ApplyStreamConfig(config.input, liveParameters.input);
+		ApplyStreamConfig(config.output, liveParameters.output);
+	}
+
+	LiveParametersPublisher::LiveParametersPublisher(LiveParameters initial) :
+		current(new LiveParameters(std::move(initial))) {}
+
+	LiveParametersPublisher::~LiveParametersPublisher() {
+		// The reader is expected to be gone by now, so all snapshots can be freed.
+		delete current.load();
+	}
+
+	void LiveParametersPublisher::Publish(LiveParameters liveParameters) {
+		std::unique_ptr<const LiveParameters> snapshot(new LiveParameters(std::move(liveParameters)));
+		std::unique_ptr<const LiveParameters> previous(current.exchange(snapshot.release()));
+		retired.push_back({ .snapshot = std::move(previous), .readerGeneration = readerGeneration.load() });
+		Reclaim();
+	}
+
+	void LiveParametersPublisher::Reclaim() {
+		const auto currentReaderGeneration = readerGeneration.load();
+		// If the reader was not holding a snapshot when it was replaced, it cannot be using it. Otherwise, it is done with it as
+		// soon as it leaves the ReadScope it was in at the time.
+		std::erase_if(retired, [&](const RetiredSnapshot& retiredSnapshot) {
+			return retiredSnapshot.readerGeneration % 2 == 0 || retiredSnapshot.readerGeneration != currentReaderGeneration;
+		});
+	}
+
+	LiveParametersPublisher::ReadScope::ReadScope(LiveParametersPublisher& publisher) :
+		readerGeneration(publisher.readerGeneration),
+		snapshot(EnterReadScope(readerGeneration, publisher.current)) {}
+
+	LiveParametersPublisher::ReadScope::~ReadScope() {
+		++readerGeneration;
+	}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flexasio {
+
+	// Settings that take effect immediately, even while streaming, without touching the stream.
+	// Most come from the configuration, but some are set by the host application through ASIO.
+	// Settings that change which device channels are opened, such as channel routing, cannot be applied without reopening the
+	// stream, and are deliberately not part of this.
+	struct LiveParameters final {
+		struct Stream final {
+			// Indexed by channel. Channels past the end are not muted.
+			std::vector<bool> muted;
+			// Indexed by channel, as set by the host application through kAsioSetInputGain and kAsioSetOutputGain. Channels past the
+			// end are at unity gain.
+			std::vector<float> gains;
+
+			bool IsMuted(long channel) const { return channel >= 0 && size_t(channel) < muted.size() && muted[size_t(channel)]; }
+			float GetGain(long channel) const { return channel >= 0 && size_t(channel) < gains.size() ? gains[size_t(channel)] : 1.0f; }
+		};
+
+		// Direct monitoring of an ASIO input channel on ASIO output channels, as requested by the host application through
+		// kAsioSetInputMonitor.
+		struct InputMonitor final {
+			long inputChannel;
+			long leftOutputChannel;
+			float leftGain;
+			// -1 if the input is monitored on a single output channel.
+			long rightOutputChannel;
+			float rightGain;
+		};
+
+		Stream input;
+		Stream output;
+		std::vector<InputMonitor> inputMonitors;
+	};
+
+	// Only sets the parameters that come from the configuration, leaving the ones set by the host application alone.
+	void ApplyConfig(const Config&, LiveParameters&);
+
+	// Makes LiveParameters available to the stream callback without any locking or allocation on the audio thread, in the style
+	// of read-copy-update: every update publishes a new immutable snapshot, and old snapshots are only freed by the publishing
+	// thread once the reader cannot be using them anymore.
+	//
+	// There can be any number of publishing threads, but only one reading thread at a time.
+	class LiveParametersPublisher final {
+	public:
+		explicit LiveParametersPublisher(LiveParameters initial);
+		~LiveParametersPublisher();
+
+		LiveParametersPublisher(const LiveParametersPublisher&) = delete;
+		LiveParametersPublisher& operator=(const LiveParametersPublisher&) = delete;
+
+		// Publishes a modified copy of the current snapshot. This makes it possible for different publishing threads to update
+		// different parameters without overwriting each other's changes.
+		template <typename Functor> void Update(Functor functor) {
+			std::scoped_lock lock(mutex);
+			LiveParameters liveParameters = *current.load();
+			functor(liveParameters);
+			Publish(std::move(liveParameters));
+		}
+
+		// Gives access to the current snapshot for the lifetime of the object. Wait-free.
+		class ReadScope final {
+		public:
+			explicit ReadScope(LiveParametersPublisher&);
+			~ReadScope();
+
+			ReadScope(const ReadScope&) = delete;
+			ReadScope& operator=(const ReadScope&) = delete;
+
+			const LiveParameters& operator*() const { return *snapshot; }
+			const LiveParameters* operator->() const { return snapshot; }
+
+		private:
+			std::atomic<uint64_t>& readerGeneration;
+			const LiveParameters* const snapshot;
+		};
+
+	private:
+		struct RetiredSnapshot final {
+			std::unique_ptr<const LiveParameters> snapshot;
+			// The value of readerGeneration right after the snapshot was replaced.
+			uint64_t readerGeneration;
+		};
+
+		// Must be called with the mutex held.
+		void Publish(LiveParameters);
+		void Reclaim();
+
+		std::atomic<const LiveParameters*> current;
+		// Incremented when the reader enters and leaves a ReadScope, so it is odd while the reader is holding a snapshot.
+		std::atomic<uint64_t> readerGeneration = 0;
+
+		std::mutex mutex;
+		std::vector<RetiredSnapshot> retired;
+	};
+
+}
@@ -0,0 +1,211 @@
+#include "portaudio_session.h"
+
+#include <windows.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <portaudio.h>
+
+#include "log.h"
+#include "../FlexASIOUtil/device_topology.h"
+#include "../FlexASIOUtil/windows_com.h"
+
+namespace flexasio {
+
+	namespace {
+
+		// Long enough to cover a host re-creating the driver, short enough not to hold on to devices for long after the host is done.
+		constexpr auto terminationDelay = std::chrono::seconds(10);
+
+		std::optional<uint64_t> TryGetDeviceTopologyFingerprint() {
+			try {
+				return GetDeviceTopologyFingerprint();
+			}
+			catch (const std::exception& exception) {
+				Log() << "Unable to determine device topology: " << exception.what();
+				return std::nullopt;
+			}
+		}
+
+		class Session final {
+		public:
+			void Acquire();
+			void Release();
+
+		private:
+			static DWORD WINAPI WorkerThreadProc(LPVOID module) throw();
+
+			void StartWorker();
+			void RunWorker();
+			void Serve(std::unique_lock<std::mutex>&);
+			void Refresh();
+			void Initialize();
+			void Terminate();
+
+			std::mutex mutex;
+			std::condition_variable stateChanged;
+			size_t referenceCount = 0;
+			bool workerRunning = false;
+			uint64_t requestedRefresh = 0;
+			uint64_t completedRefresh = 0;
+			bool initialized = false;
+			std::optional<uint64_t> deviceTopology;
+			std::string initializationError;
+		};
+
+		Session session;
+
+		void Session::Acquire() {
+			const auto start = std::chrono::steady_clock::now();
+			std::unique_lock lock(mutex);
+			++referenceCount;
+			Log() << "Acquiring PortAudio session (" << referenceCount << " references)";
+			try {
+				if (!workerRunning) StartWorker();
+			}
+			catch (...) {
+				--referenceCount;
+				throw;
+			}
+			const auto refresh = ++requestedRefresh;
+			stateChanged.notify_all();
+			// Join point with the session thread. Pa_Initialize() runs on the session thread, and no host thread may call into PortAudio
+			// before it returns. This wait is what guarantees it: PortAudioSession comes before every member of FlexASIO::Devices that
+			// needs PortAudio to be initialized, so its constructor (i.e. this function) returns before any of them, or any later host
+			// call, can use PortAudio. The session thread only calls into PortAudio again to terminate it, which it does not do while
+			// this reference is held.
+			stateChanged.wait(lock, [&] { return completedRefresh >= refresh; });
+			Log() << "Waited " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms for the PortAudio session";
+			if (!initialized) {
+				--referenceCount;
+				stateChanged.notify_all();
+				throw std::runtime_error("could not initialize PortAudio: " + initializationError);
+			}
+		}
+
+		void Session::Release() {
+			const std::lock_guard lock(mutex);
+			--referenceCount;
+			Log() << "Releasing PortAudio session (" << referenceCount << " references left)";
+			if (referenceCount == 0) Log() << "PortAudio will be terminated in " << terminationDelay.count() << " seconds unless it is used again";
+			stateChanged.notify_all();
+		}
+
+		void Session::StartWorker() {
+			HMODULE module = nullptr;
+			if (::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&WorkerThreadProc), &module) == 0)
+				throw std::system_error(::GetLastError(), std::system_category(), "Unable to reference the FlexASIO module");
+			const auto thread = ::CreateThread(nullptr, 0, WorkerThreadProc, module, 0, nullptr);
+			if (thread == NULL) {
+				const auto error = ::GetLastError();
+				::FreeLibrary(module);
+				throw std::system_error(error, std::system_category(), "Unable to start the PortAudio session thread");
+			}
+			::CloseHandle(thread);
+			workerRunning = true;
+		}
+
+		DWORD WINAPI Session::WorkerThreadProc(LPVOID module) throw() {
+			session.RunWorker();
+			::FreeLibraryAndExitThread(static_cast<HMODULE>(module), 0);
+		}
+
+		void Session::RunWorker() {
+			std::unique_lock lock(mutex);
+			try {
+				const COMInitializer comInitializer(COINIT_MULTITHREADED);
+				Serve(lock);
+			}
+			catch (const std::exception& exception) {
+				Log() << "PortAudio session thread failed: " << exception.what();
+				initializationError = exception.what();
+			}
+			completedRefresh = requestedRefresh;
+			workerRunning = false;
+			stateChanged.notify_all();
+		}
+
+		void Session::Serve(std::unique_lock<std::mutex>& lock) {
+			for (;;) {
+				if (completedRefresh != requestedRefresh) {
+					const auto refresh = requestedRefresh;
+					Refresh();
+					completedRefresh = refresh;
+					stateChanged.notify_all();
+					continue;
+				}
+				if (referenceCount > 0) {
+					stateChanged.wait(lock, [&] { return referenceCount == 0 || completedRefresh != requestedRefresh; });
+					continue;
+				}
+				if (stateChanged.wait_for(lock, terminationDelay, [&] { return referenceCount > 0 || completedRefresh != requestedRefresh; }))
+					continue;
+				Terminate();
+				return;
+			}
+		}
+
+		void Session::Refresh() {
+			const auto currentDeviceTopology = TryGetDeviceTopologyFingerprint();
+			if (initialized) {
+				if (currentDeviceTopology.has_value() && currentDeviceTopology == deviceTopology) {
+					Log() << "Reusing existing PortAudio initialization, device topology is unchanged";
+					return;
+				}
+				// Other instances might have streams open, so we can't pull the rug from under them.
+				if (referenceCount > 1) {
+					Log() << "Device topology may have changed, but PortAudio is in use by " << referenceCount - 1 << " other instance(s); reusing existing initialization";
+					return;
+				}
+				Log() << "Device topology may have changed, reinitializing PortAudio";
+				Terminate();
+			}
+			try {
+				Initialize();
+				deviceTopology = currentDeviceTopology;
+			}
+			catch (const std::exception& exception) {
+				initializationError = exception.what();
+			}
+		}
+
+		void Session::Initialize() {
+			Log() << "Initializing PortAudio";
+			const auto start = std::chrono::steady_clock::now();
+			PaError error = Pa_Initialize();
+			if (error != paNoError)
+				throw std::runtime_error(Pa_GetErrorText(error));
+			initialized = true;
+			Log() << "PortAudio initialization successful (took " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)";
+		}
+
+		void Session::Terminate() {
+			if (!initialized) return;
+			Log() << "Terminating PortAudio";
+			PaError error = Pa_Terminate();
+			if (error != paNoError)
+				Log() << "PortAudio termination failed with " << Pa_GetErrorText(error);
+			else
+				Log() << "PortAudio terminated successfully";
+			initialized = false;
+			deviceTopology.reset();
+		}
+
+	}
+
+	PortAudioSession::PortAudioSession() {
+		session.Acquire();
+	}
+
+	PortAudioSession::~PortAudioSession() {
+		session.Release();
+	}
+
+}
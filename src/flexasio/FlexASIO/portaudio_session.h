@@ -0,0 +1,24 @@
+#pragma once
+
+namespace flexasio {
+
+	// Keeps PortAudio initialized for as long as any instance of this class exists, and for a few seconds after the last one is
+	// destroyed.
+	//
+	// Initializing PortAudio enumerates every device of every host API, which can take seconds on systems with many endpoints. ASIO
+	// host applications typically re-create the driver in response to every reset request, so tying PortAudio initialization to the
+	// lifetime of the driver instance makes resets needlessly slow. Instead, the existing initialization is reused unless the device
+	// topology changed in the meantime (see GetDeviceTopologyFingerprint()).
+	//
+	// Initialization and termination happen on a dedicated thread that holds a reference to the FlexASIO module, so that PortAudio
+	// can outlive the driver instance (and the host releasing the DLL) without being tied to the COM apartment of any host thread.
+	class PortAudioSession final {
+	public:
+		PortAudioSession();
+		~PortAudioSession();
+
+		PortAudioSession(const PortAudioSession&) = delete;
+		PortAudioSession& operator=(const PortAudioSession&) = delete;
+	};
+
+}
@@ -0,0 +1,242 @@
+#include "realtime_sanitizer.h"
+
+#ifdef FLEXASIO_REALTIME_SANITIZER
+
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cwctype>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "log.h"
+
+namespace flexasio {
+
+	namespace {
+
+		thread_local int realtimeDepth = 0;
+		thread_local int nonRealtimeDepth = 0;
+
+		bool abortOnViolation = true;
+
+		std::string DescribeAddress(void* address) {
+			std::stringstream description;
+			HMODULE module = nullptr;
+			if (::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, static_cast<LPCSTR>(address), &module) == 0) {
+				description << address;
+				return description.str();
+			}
+			char modulePath[MAX_PATH];
+			const auto modulePathSize = ::GetModuleFileNameA(module, modulePath, MAX_PATH);
+			const std::string_view modulePathView(modulePath, modulePathSize);
+			const auto lastSeparator = modulePathView.find_last_of("\\/");
+			description << (lastSeparator == modulePathView.npos ? modulePathView : modulePathView.substr(lastSeparator + 1))
+				<< "+0x" << std::hex << (static_cast<const char*>(address) - reinterpret_cast<const char*>(module));
+			return description.str();
+		}
+
+		void ReportViolation(std::string_view function) {
+			void* frames[62];
+			const auto frameCount = ::CaptureStackBackTrace(1, DWORD(std::size(frames)), frames, nullptr);
+
+			std::stringstream report;
+			report << "REAL-TIME SAFETY VIOLATION: " << function << "() called from the audio thread (thread " << ::GetCurrentThreadId() << ")";
+			for (USHORT frameIndex = 0; frameIndex < frameCount; ++frameIndex)
+				report << "\n    #" << frameIndex << " " << DescribeAddress(frames[frameIndex]);
+			const auto reportString = report.str();
+
+			Log() << reportString;
+			::fprintf(stderr, "%s\n", reportString.c_str());
+			::fflush(stderr);
+			::OutputDebugStringA((reportString + "\n").c_str());
+
+			// Not std::abort(), as the debug runtime would then block on a message box.
+			if (abortOnViolation) ::TerminateProcess(::GetCurrentProcess(), 3);
+		}
+
+		void OnInterceptedCall(std::string_view function) {
+			if (realtimeDepth == 0 || nonRealtimeDepth > 0) return;
+			// Reporting is not real-time safe either, and must not recurse.
+			NonRealtimeScope nonRealtimeScope;
+			ReportViolation(function);
+		}
+
+		template <typename Function, const char* name> class Interceptor;
+		template <typename Result, typename... Args, const char* name>
+		class Interceptor<Result(WINAPI*)(Args...), name> final {
+		public:
+			static Result WINAPI Replacement(Args... args) {
+				OnInterceptedCall(name);
+				return original.load()(args...);
+			}
+
+			static inline std::atomic<Result(WINAPI*)(Args...)> original = nullptr;
+		};
+
+		struct Hook final {
+			std::string_view name;
+			void* replacement;
+			void (*setOriginal)(void*);
+		};
+
+		template <typename Function, const char* name>
+		Hook MakeHook() {
+			using FunctionInterceptor = Interceptor<Function, name>;
+			return {
+				.name = name,
+				.replacement = reinterpret_cast<void*>(&FunctionInterceptor::Replacement),
+				.setOriginal = [](void* original) {
+					Function expected = nullptr;
+					FunctionInterceptor::original.compare_exchange_strong(expected, reinterpret_cast<Function>(original));
+				},
+			};
+		}
+
+		constexpr char heapAlloc[] = "HeapAlloc";
+		constexpr char heapReAlloc[] = "HeapReAlloc";
+		constexpr char heapFree[] = "HeapFree";
+		constexpr char virtualAlloc[] = "VirtualAlloc";
+		constexpr char virtualFree[] = "VirtualFree";
+		constexpr char enterCriticalSection[] = "EnterCriticalSection";
+		constexpr char acquireSRWLockExclusive[] = "AcquireSRWLockExclusive";
+		constexpr char acquireSRWLockShared[] = "AcquireSRWLockShared";
+		constexpr char sleepConditionVariableCS[] = "SleepConditionVariableCS";
+		constexpr char sleepConditionVariableSRW[] = "SleepConditionVariableSRW";
+		constexpr char waitForSingleObject[] = "WaitForSingleObject";
+		constexpr char waitForSingleObjectEx[] = "WaitForSingleObjectEx";
+		constexpr char waitForMultipleObjects[] = "WaitForMultipleObjects";
+		constexpr char waitForMultipleObjectsEx[] = "WaitForMultipleObjectsEx";
+		constexpr char sleep[] = "Sleep";
+		constexpr char sleepEx[] = "SleepEx";
+		constexpr char createFileW[] = "CreateFileW";
+		constexpr char createFileA[] = "CreateFileA";
+		constexpr char readFile[] = "ReadFile";
+		constexpr char writeFile[] = "WriteFile";
+		constexpr char flushFileBuffers[] = "FlushFileBuffers";
+
+		const Hook hooks[] = {
+			// Memory allocation. The C runtime (malloc(), operator new) ultimately goes through these.
+			MakeHook<decltype(&::HeapAlloc), heapAlloc>(),
+			MakeHook<decltype(&::HeapReAlloc), heapReAlloc>(),
+			MakeHook<decltype(&::HeapFree), heapFree>(),
+			MakeHook<decltype(&::VirtualAlloc), virtualAlloc>(),
+			MakeHook<decltype(&::VirtualFree), virtualFree>(),
+			// Locks. std::mutex and friends are implemented on top of these.
+			MakeHook<decltype(&::EnterCriticalSection), enterCriticalSection>(),
+			MakeHook<decltype(&::AcquireSRWLockExclusive), acquireSRWLockExclusive>(),
+			MakeHook<decltype(&::AcquireSRWLockShared), acquireSRWLockShared>(),
+			MakeHook<decltype(&::SleepConditionVariableCS), sleepConditionVariableCS>(),
+			MakeHook<decltype(&::SleepConditionVariableSRW), sleepConditionVariableSRW>(),
+			// Blocking waits.
+			MakeHook<decltype(&::WaitForSingleObject), waitForSingleObject>(),
+			MakeHook<decltype(&::WaitForSingleObjectEx), waitForSingleObjectEx>(),
+			MakeHook<decltype(&::WaitForMultipleObjects), waitForMultipleObjects>(),
+			MakeHook<decltype(&::WaitForMultipleObjectsEx), waitForMultipleObjectsEx>(),
+			MakeHook<decltype(&::Sleep), sleep>(),
+			MakeHook<decltype(&::SleepEx), sleepEx>(),
+			// File I/O.
+			MakeHook<decltype(&::CreateFileW), createFileW>(),
+			MakeHook<decltype(&::CreateFileA), createFileA>(),
+			MakeHook<decltype(&::ReadFile), readFile>(),
+			MakeHook<decltype(&::WriteFile), writeFile>(),
+			MakeHook<decltype(&::FlushFileBuffers), flushFileBuffers>(),
+		};
+
+		// Redirects the matching entries of the module's import address table to our hooks. Returns the number of entries patched.
+		size_t PatchImports(HMODULE module) {
+			const auto base = reinterpret_cast<BYTE*>(module);
+			const auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+			const auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+			const auto& importDirectory = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+			if (importDirectory.VirtualAddress == 0) return 0;
+
+			size_t patchCount = 0;
+			for (auto descriptor = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(base + importDirectory.VirtualAddress); descriptor->Name != 0; ++descriptor) {
+				if (descriptor->OriginalFirstThunk == 0) continue;
+				auto nameThunk = reinterpret_cast<const IMAGE_THUNK_DATA*>(base + descriptor->OriginalFirstThunk);
+				auto addressThunk = reinterpret_cast<IMAGE_THUNK_DATA*>(base + descriptor->FirstThunk);
+				for (; nameThunk->u1.AddressOfData != 0; ++nameThunk, ++addressThunk) {
+					if (IMAGE_SNAP_BY_ORDINAL(nameThunk->u1.Ordinal)) continue;
+					const std::string_view name(reinterpret_cast<const IMAGE_IMPORT_BY_NAME*>(base + nameThunk->u1.AddressOfData)->Name);
+					const auto hook = std::find_if(std::begin(hooks), std::end(hooks), [&](const Hook& candidate) { return candidate.name == name; });
+					if (hook == std::end(hooks)) continue;
+
+					auto& function = addressThunk->u1.Function;
+					const auto replacement = reinterpret_cast<decltype(addressThunk->u1.Function)>(hook->replacement);
+					if (function == replacement) continue;
+					hook->setOriginal(reinterpret_cast<void*>(function));
+
+					DWORD oldProtect;
+					if (::VirtualProtect(&function, sizeof(function), PAGE_READWRITE, &oldProtect) == 0) {
+						Log() << "Unable to unprotect import entry for " << name << ", error " << ::GetLastError();
+						continue;
+					}
+					function = replacement;
+					::VirtualProtect(&function, sizeof(function), oldProtect, &oldProtect);
+					++patchCount;
+				}
+			}
+			return patchCount;
+		}
+
+		// Code that can run on the audio thread: FlexASIO itself, and the C/C++ runtime libraries it calls into.
+		bool ShouldPatchModule(HMODULE module, std::wstring moduleName) {
+			HMODULE selfModule = nullptr;
+			if (::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCWSTR>(&ShouldPatchModule), &selfModule) != 0 && module == selfModule)
+				return true;
+			std::transform(moduleName.begin(), moduleName.end(), moduleName.begin(), [](wchar_t character) { return wchar_t(std::towlower(character)); });
+			for (const std::wstring_view prefix : { L"msvcp", L"ucrtbase", L"vcruntime" })
+				if (moduleName.starts_with(prefix)) return true;
+			return false;
+		}
+
+		void Install() {
+			char mode[16];
+			const auto modeSize = ::GetEnvironmentVariableA("FLEXASIO_REALTIME_SANITIZER", mode, DWORD(std::size(mode)));
+			abortOnViolation = !(modeSize > 0 && modeSize < std::size(mode) && std::string_view(mode, modeSize) == "report");
+
+			const auto snapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, 0);
+			if (snapshot == INVALID_HANDLE_VALUE) {
+				Log() << "Unable to enumerate modules for the real-time sanitizer, error " << ::GetLastError();
+				return;
+			}
+			size_t patchCount = 0;
+			MODULEENTRY32W moduleEntry = { .dwSize = sizeof(moduleEntry) };
+			for (auto found = ::Module32FirstW(snapshot, &moduleEntry); found; found = ::Module32NextW(snapshot, &moduleEntry)) {
+				if (!ShouldPatchModule(moduleEntry.hModule, moduleEntry.szModule)) continue;
+				patchCount += PatchImports(moduleEntry.hModule);
+			}
+			::CloseHandle(snapshot);
+			Log() << "Real-time sanitizer installed (" << patchCount << " import entries intercepted, " << (abortOnViolation ? "aborting" : "reporting only") << " on violations)";
+		}
+
+	}
+
+	void InstallRealtimeSanitizer() {
+		static std::once_flag once;
+		std::call_once(once, Install);
+	}
+
+	RealtimeScope::RealtimeScope(bool enabled) : enabled(enabled) {
+		if (enabled) ++realtimeDepth;
+	}
+	RealtimeScope::~RealtimeScope() {
+		if (enabled) --realtimeDepth;
+	}
+
+	NonRealtimeScope::NonRealtimeScope() {
+		++nonRealtimeDepth;
+	}
+	NonRealtimeScope::~NonRealtimeScope() {
+		--nonRealtimeDepth;
+	}
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+namespace flexasio {
+
+	// Debugging aid that detects code that is not real-time safe (memory allocation, locking, blocking system calls) running on
+	// the audio thread, similar in spirit to Clang's RealtimeSanitizer. It is only compiled in if the FLEXASIO_REALTIME_SANITIZER
+	// CMake option is enabled; otherwise all of the below are no-ops.
+	//
+	// Violations are reported to the log and to standard error along with a stack trace. Unless the FLEXASIO_REALTIME_SANITIZER
+	// environment variable is set to "report", the process is then aborted so that violations cannot go unnoticed in tests.
+
+#ifdef FLEXASIO_REALTIME_SANITIZER
+
+	// Intercepts the relevant system functions for the whole process. Idempotent.
+	void InstallRealtimeSanitizer();
+
+	// Marks the current thread as running real-time code for the lifetime of the object.
+	class RealtimeScope final {
+	public:
+		explicit RealtimeScope(bool enabled = true);
+		~RealtimeScope();
+
+		RealtimeScope(const RealtimeScope&) = delete;
+		RealtimeScope& operator=(const RealtimeScope&) = delete;
+
+	private:
+		const bool enabled;
+	};
+
+	// Suspends checks on the current thread for the lifetime of the object, e.g. while calling into code we are not responsible for.
+	class NonRealtimeScope final {
+	public:
+		NonRealtimeScope();
+		~NonRealtimeScope();
+
+		NonRealtimeScope(const NonRealtimeScope&) = delete;
+		NonRealtimeScope& operator=(const NonRealtimeScope&) = delete;
+	};
+
+#else
+
+	inline void InstallRealtimeSanitizer() {}
+
+	class RealtimeScope final {
+	public:
+		explicit RealtimeScope(bool = true) {}
+	};
+
+	class NonRealtimeScope final {
+	public:
+		NonRealtimeScope() {}
+	};
+
+#endif
+
+}
@@ -0,0 +1,33 @@
+#include "driver.h"
+
+#include "..\FlexASIO\cflexasio.h"
+
+#include <dechamps_ASIOUtil/asio.h>
+
+#include <stdexcept>
+
+namespace flexasio {
+
+	Driver::Driver() : asio(CreateFlexASIO()) {
+		if (asio == nullptr) throw std::runtime_error("unable to create driver instance");
+		if (asio->init(nullptr) != ASIOTrue) {
+			const auto errorMessage = GetErrorMessage();
+			ReleaseFlexASIO(asio);
+			throw std::runtime_error("driver init() failed: " + errorMessage);
+		}
+	}
+
+	Driver::~Driver() { ReleaseFlexASIO(asio); }
+
+	void Driver::Check(ASIOError error, std::string_view call) const {
+		if (error == ASE_OK) return;
+		throw std::runtime_error(std::string(call) + " failed with " + ::dechamps_ASIOUtil::GetASIOErrorString(error) + ": " + GetErrorMessage());
+	}
+
+	std::string Driver::GetErrorMessage() const {
+		char errorMessage[124] = { 0 };
+		asio->getErrorMessage(errorMessage);
+		return errorMessage;
+	}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <dechamps_ASIOUtil/asiosdk/iasiodrv.h>
+
+#include <string>
+#include <string_view>
+
+namespace flexasio {
+
+	// Owns an initialized FlexASIO driver instance, for test programs that drive it directly.
+	class Driver final {
+	public:
+		Driver();
+		~Driver();
+
+		Driver(const Driver&) = delete;
+		Driver& operator=(const Driver&) = delete;
+
+		IASIO* Get() const { return asio; }
+		IASIO* operator->() const { return asio; }
+
+		// Throws if `error` is not ASE_OK, including the driver error message.
+		void Check(ASIOError error, std::string_view call) const;
+
+	private:
+		std::string GetErrorMessage() const;
+
+		IASIO* const asio;
+	};
+
+}
@@ -0,0 +1,371 @@
+#include "latency.h"
+
+#include "driver.h"
+
+#include "..\FlexASIOUtil\json.h"
+#include "..\FlexASIOUtil\loopback.h"
+#include "..\FlexASIOUtil\sample_conversion.h"
+#include "..\FlexASIOUtil\statistics.h"
+
+#include <windows.h>
+
+#include <dechamps_ASIOUtil/asiosdk/iasiodrv.h>
+#include <dechamps_ASIOUtil/asio.h>
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		using Clock = std::chrono::steady_clock;
+
+		constexpr std::string_view latencyFlag = "--latency";
+
+		// The stimulus is only played after the stream has had time to settle.
+		constexpr long warmupCallbackCount = 16;
+
+		enum class Signal { IMPULSE, MLS };
+
+		struct Options final {
+			long inputChannel = 0;
+			long outputChannel = 0;
+			std::optional<long> bufferSize;
+			std::optional<ASIOSampleRate> sampleRate;
+			Signal signal = Signal::MLS;
+			int mlsOrder = 12;
+			double amplitude = 0.5;
+			int runs = 10;
+			double maxLatencyMilliseconds = 1000;
+			double minimumPeakToRms = 8;
+			std::optional<std::string> outputPath;
+		};
+
+		Signal ParseSignal(const std::string& value) {
+			if (value == "impulse") return Signal::IMPULSE;
+			if (value == "mls") return Signal::MLS;
+			throw std::runtime_error("invalid value for --signal: '" + value + "' (expected impulse or mls)");
+		}
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			::cxxopts::Options commandLineOptions(argv[0], "Measures round trip latency through a physical loopback");
+			commandLineOptions.add_options()
+				(std::string(latencyFlag.substr(2)), "Run the latency test")
+				("input-channel", "ASIO input channel the loopback arrives on", ::cxxopts::value(options.inputChannel))
+				("output-channel", "ASIO output channel the stimulus is played on", ::cxxopts::value(options.outputChannel))
+				("buffer-size", "ASIO buffer size, in frames (default: the preferred size)", ::cxxopts::value(options.bufferSize))
+				("sample-rate", "Sample rate, in Hz (default: the current rate)", ::cxxopts::value(options.sampleRate))
+				("signal", "impulse or mls", ::cxxopts::value<std::string>())
+				("mls-order", "Order of the maximum length sequence", ::cxxopts::value(options.mlsOrder))
+				("amplitude", "Peak amplitude of the stimulus, in (0, 1]", ::cxxopts::value(options.amplitude))
+				("runs", "Number of measurements", ::cxxopts::value(options.runs))
+				("max-latency-ms", "Give up on a run if the stimulus has not come back after this long", ::cxxopts::value(options.maxLatencyMilliseconds))
+				("minimum-peak-to-rms", "Detection threshold, as the ratio of the correlation peak to its RMS", ::cxxopts::value(options.minimumPeakToRms))
+				("output", "Write the JSON report to this file instead of standard output", ::cxxopts::value(options.outputPath));
+			const auto result = commandLineOptions.parse(argc, argv);
+			if (result.count("signal") > 0) options.signal = ParseSignal(result["signal"].as<std::string>());
+
+			if (options.inputChannel < 0 || options.outputChannel < 0) throw std::runtime_error("channel indices cannot be negative");
+			if (options.bufferSize.has_value() && *options.bufferSize <= 0) throw std::runtime_error("--buffer-size must be strictly positive");
+			if (!(options.amplitude > 0 && options.amplitude <= 1)) throw std::runtime_error("--amplitude must be in (0, 1]");
+			if (options.runs < 1) throw std::runtime_error("--runs must be strictly positive");
+			if (!(options.maxLatencyMilliseconds > 0)) throw std::runtime_error("--max-latency-ms must be strictly positive");
+			return options;
+		}
+
+		SampleFormat GetSampleFormat(ASIOSampleType sampleType) {
+			switch (sampleType) {
+			case ASIOSTInt16LSB: return SampleFormat::INT16;
+			case ASIOSTInt24LSB: return SampleFormat::INT24;
+			case ASIOSTInt32LSB: return SampleFormat::INT32;
+			case ASIOSTInt32LSB16: return SampleFormat::INT32_LSB16;
+			case ASIOSTInt32LSB24: return SampleFormat::INT32_LSB24;
+			case ASIOSTFloat32LSB: return SampleFormat::FLOAT32;
+			case ASIOSTFloat64LSB: return SampleFormat::FLOAT64;
+			}
+			throw std::runtime_error("unsupported sample type " + ::dechamps_ASIOUtil::GetASIOSampleTypeString(sampleType));
+		}
+
+		// Plays the stimulus on one output channel and records one input channel, aligned on the same callback.
+		//
+		// ASIO callbacks do not carry any context pointer, so only one LoopbackHost can be active at any given time.
+		class LoopbackHost final {
+		public:
+			struct Channel final {
+				ASIOBufferInfo* bufferInfo;
+				ASIOSampleType sampleType;
+			};
+
+			LoopbackHost(long bufferSize, const std::vector<float>& stimulus, size_t recordingLength) :
+				bufferSize(bufferSize), stimulus(stimulus), recording(recordingLength) {
+				if (current != nullptr) abort();
+				current = this;
+			}
+			~LoopbackHost() { current = nullptr; }
+
+			LoopbackHost(const LoopbackHost&) = delete;
+			LoopbackHost& operator=(const LoopbackHost&) = delete;
+
+			ASIOCallbacks* GetCallbacks() { return &callbacks; }
+
+			// Must be called after createBuffers() and before start().
+			// GetSampleFormat() throws on unsupported sample types, which guarantees the callback will not.
+			void SetChannels(Channel input, Channel output) {
+				inputConverter.emplace(GetSampleFormat(input.sampleType), SampleFormat::FLOAT32, /*dither=*/false);
+				outputConverter.emplace(SampleFormat::FLOAT32, GetSampleFormat(output.sampleType), /*dither=*/false);
+				outputSampleSize = GetSampleFormatSize(outputConverter->GetOutputFormat());
+				for (const auto buffer : output.bufferInfo->buffers) ::memset(buffer, 0, bufferSize * outputSampleSize);
+				inputChannel = input;
+				outputChannel = output;
+			}
+
+			bool IsDone() const { return done.load(std::memory_order_acquire); }
+			int GetResetRequestCount() const { return resetRequestCount.load(); }
+
+			// Must only be accessed after IsDone() returns true, or after the stream is stopped.
+			const std::vector<float>& GetRecording() const { return recording; }
+
+		private:
+			static void BufferSwitch(long doubleBufferIndex, ASIOBool directProcess) {
+				current->OnBufferSwitch(doubleBufferIndex, directProcess);
+			}
+			static ASIOTime* BufferSwitchTimeInfo(ASIOTime* params, long doubleBufferIndex, ASIOBool directProcess) {
+				current->OnBufferSwitch(doubleBufferIndex, directProcess);
+				return params;
+			}
+			static void SampleRateDidChange(ASIOSampleRate) {}
+			static long AsioMessage(long selector, long value, void*, double*) {
+				switch (selector) {
+				case kAsioSelectorSupported:
+					return value == kAsioEngineVersion || value == kAsioResetRequest || value == kAsioResyncRequest || value == kAsioLatenciesChanged;
+				case kAsioEngineVersion:
+					return 2;
+				case kAsioResetRequest:
+					++current->resetRequestCount;
+					return 1;
+				case kAsioResyncRequest:
+				case kAsioLatenciesChanged:
+					return 1;
+				}
+				return 0;
+			}
+
+			// Both the stimulus and the recording start at the first sample of callback number `warmupCallbackCount`.
+			// The index of the stimulus in the recording is therefore the round-trip latency in samples.
+			void OnBufferSwitch(long doubleBufferIndex, ASIOBool) {
+				const auto callbackIndex = callbackCount++;
+				const auto output = static_cast<std::byte*>(outputChannel.bufferInfo->buffers[doubleBufferIndex]);
+				const auto input = static_cast<const std::byte*>(inputChannel.bufferInfo->buffers[doubleBufferIndex]);
+				const auto frameCount = size_t(bufferSize);
+				// All-zero bits are silence in every supported sample format.
+				::memset(output, 0, frameCount * outputSampleSize);
+				if (callbackIndex < warmupCallbackCount) return;
+
+				const auto position = size_t(callbackIndex - warmupCallbackCount) * frameCount;
+				if (position < stimulus.size())
+					outputConverter->Convert(reinterpret_cast<const std::byte*>(stimulus.data() + position), output, (std::min)(frameCount, stimulus.size() - position));
+				if (position < recording.size())
+					inputConverter->Convert(input, reinterpret_cast<std::byte*>(recording.data() + position), (std::min)(frameCount, recording.size() - position));
+				if (position + frameCount > recording.size()) done.store(true, std::memory_order_release);
+			}
+
+			static LoopbackHost* current;
+
+			const long bufferSize;
+			const std::vector<float>& stimulus;
+			std::vector<float> recording;
+			Channel inputChannel = { nullptr, ASIOSTFloat32LSB };
+			Channel outputChannel = { nullptr, ASIOSTFloat32LSB };
+			std::optional<SampleConverter> inputConverter;
+			std::optional<SampleConverter> outputConverter;
+			size_t outputSampleSize = 0;
+			long callbackCount = 0;
+			std::atomic<bool> done = false;
+			std::atomic<int> resetRequestCount = 0;
+			ASIOCallbacks callbacks = {
+				.bufferSwitch = &BufferSwitch,
+				.sampleRateDidChange = &SampleRateDidChange,
+				.asioMessage = &AsioMessage,
+				.bufferSwitchTimeInfo = &BufferSwitchTimeInfo,
+			};
+		};
+
+		LoopbackHost* LoopbackHost::current = nullptr;
+
+		ASIOSampleType GetChannelSampleType(Driver& driver, bool input, long channel) {
+			ASIOChannelInfo channelInfo = { .channel = channel, .isInput = input ? ASIOTrue : ASIOFalse };
+			driver.Check(driver->getChannelInfo(&channelInfo), "getChannelInfo()");
+			return channelInfo.type;
+		}
+
+		struct RunResult final {
+			long reportedInputLatency = 0;
+			long reportedOutputLatency = 0;
+			std::optional<LoopbackDetection> detection;
+			int resetRequestCount = 0;
+		};
+
+		RunResult RunLoopback(Driver& driver, const Options& options, long bufferSize, ASIOSampleRate sampleRate, const std::vector<float>& stimulus) {
+			const auto recordingLength = stimulus.size() + size_t(options.maxLatencyMilliseconds / 1000 * sampleRate);
+			LoopbackHost host(bufferSize, stimulus, recordingLength);
+
+			ASIOBufferInfo bufferInfos[] = {
+				{ .isInput = ASIOTrue, .channelNum = options.inputChannel },
+				{ .isInput = ASIOFalse, .channelNum = options.outputChannel },
+			};
+			driver.Check(driver->createBuffers(bufferInfos, 2, bufferSize, host.GetCallbacks()), "createBuffers()");
+
+			RunResult result;
+			try {
+				host.SetChannels(
+					{ .bufferInfo = &bufferInfos[0], .sampleType = GetChannelSampleType(driver, /*input=*/true, options.inputChannel) },
+					{ .bufferInfo = &bufferInfos[1], .sampleType = GetChannelSampleType(driver, /*input=*/false, options.outputChannel) });
+				driver.Check(driver->getLatencies(&result.reportedInputLatency, &result.reportedOutputLatency), "getLatencies()");
+
+				driver.Check(driver->start(), "start()");
+				const auto expectedSeconds = (warmupCallbackCount * bufferSize + recordingLength) / sampleRate;
+				const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(2 * expectedSeconds + 2));
+				while (!host.IsDone() && Clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				driver->stop();
+				if (!host.IsDone()) throw std::runtime_error("timed out waiting for the recording to complete");
+			}
+			catch (...) {
+				driver->disposeBuffers();
+				throw;
+			}
+			driver.Check(driver->disposeBuffers(), "disposeBuffers()");
+
+			result.detection = DetectLoopbackStimulus(host.GetRecording(), stimulus, options.minimumPeakToRms);
+			result.resetRequestCount = host.GetResetRequestCount();
+			return result;
+		}
+
+		std::vector<float> GenerateStimulus(const Options& options) {
+			auto stimulus = options.signal == Signal::IMPULSE ? std::vector<float>{ 1.0f } : GenerateMaximumLengthSequence(options.mlsOrder);
+			for (auto& sample : stimulus) sample *= float(options.amplitude);
+			return stimulus;
+		}
+
+		void RunLatencyTest(const Options& options, std::ostream& output) {
+			Driver driver;
+
+			if (options.sampleRate.has_value()) driver.Check(driver->setSampleRate(*options.sampleRate), "setSampleRate()");
+			ASIOSampleRate sampleRate;
+			driver.Check(driver->getSampleRate(&sampleRate), "getSampleRate()");
+
+			long bufferSize;
+			{
+				long minSize, maxSize, preferredSize, granularity;
+				driver.Check(driver->getBufferSize(&minSize, &maxSize, &preferredSize, &granularity), "getBufferSize()");
+				bufferSize = options.bufferSize.value_or(preferredSize);
+			}
+
+			const auto stimulus = GenerateStimulus(options);
+
+			JsonWriter writer(output);
+			writer.BeginObject();
+			{
+				char driverName[32] = { 0 };
+				driver->getDriverName(driverName);
+				writer.Key("driver").BeginObject()
+					.Key("name").Value(driverName)
+					.Key("version").Value(driver->getDriverVersion())
+					.Key("sampleRate").Value(sampleRate)
+					.EndObject();
+			}
+			writer.Key("parameters").BeginObject()
+				.Key("inputChannel").Value(options.inputChannel)
+				.Key("outputChannel").Value(options.outputChannel)
+				.Key("bufferSize").Value(bufferSize)
+				.Key("signal").Value(options.signal == Signal::IMPULSE ? "impulse" : "mls")
+				.Key("stimulusLength").Value(stimulus.size())
+				.Key("amplitude").Value(options.amplitude)
+				.Key("maxLatencyMilliseconds").Value(options.maxLatencyMilliseconds)
+				.Key("minimumPeakToRms").Value(options.minimumPeakToRms)
+				.EndObject();
+
+			std::vector<double> measuredLatencies;
+			std::vector<double> reportedLatencies;
+			std::vector<double> latencyErrors;
+			size_t failedDetectionCount = 0;
+			writer.Key("runs").BeginArray();
+			for (int run = 0; run < options.runs; ++run) {
+				std::cerr << "Measuring round-trip latency, run " << run + 1 << "/" << options.runs << std::endl;
+				const auto result = RunLoopback(driver, options, bufferSize, sampleRate, stimulus);
+				const auto reportedLatency = result.reportedInputLatency + result.reportedOutputLatency;
+				reportedLatencies.push_back(double(reportedLatency));
+
+				writer.BeginObject();
+				writer.Key("reportedInputLatency").Value(result.reportedInputLatency);
+				writer.Key("reportedOutputLatency").Value(result.reportedOutputLatency);
+				writer.Key("resetRequests").Value(result.resetRequestCount);
+				writer.Key("measuredLatency");
+				if (!result.detection.has_value()) {
+					writer.Null();
+					++failedDetectionCount;
+				}
+				else {
+					writer.Value(result.detection->offset);
+					writer.Key("peakToRms").Value(result.detection->peakToRms);
+					writer.Key("inverted").Value(result.detection->inverted);
+					measuredLatencies.push_back(double(result.detection->offset));
+					latencyErrors.push_back(double(result.detection->offset) - double(reportedLatency));
+				}
+				writer.EndObject();
+			}
+			writer.EndArray();
+
+			writer.Key("failedDetections").Value(failedDetectionCount);
+			writer.Key("measuredLatencySamples"); WriteDistribution(writer, ComputeDistribution(measuredLatencies));
+			writer.Key("reportedLatencySamples"); WriteDistribution(writer, ComputeDistribution(reportedLatencies));
+			writer.Key("measuredMinusReportedSamples"); WriteDistribution(writer, ComputeDistribution(latencyErrors));
+			writer.EndObject();
+
+			if (failedDetectionCount == size_t(options.runs)) throw std::runtime_error("the stimulus was not detected in any run - is the output channel looped back to the input channel?");
+		}
+
+	}
+
+	bool IsLatencyTestRequested(int argc, char** argv) {
+		for (int argumentIndex = 1; argumentIndex < argc; ++argumentIndex)
+			if (argv[argumentIndex] == latencyFlag) return true;
+		return false;
+	}
+
+	int RunLatencyTest(int argc, char** argv) {
+		try {
+			const auto options = ParseOptions(argc, argv);
+			if (!options.outputPath.has_value()) {
+				RunLatencyTest(options, std::cout);
+			}
+			else {
+				std::ofstream output;
+				output.exceptions(output.badbit | output.failbit);
+				output.open(*options.outputPath);
+				RunLatencyTest(options, output);
+			}
+		}
+		catch (const std::exception& exception) {
+			std::cerr << "ERROR: " << exception.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace flexasio {
+
+	// Returns true if the command line requests the round-trip latency measurement mode (`--latency`) instead of the regular ASIOTest run.
+	bool IsLatencyTestRequested(int argc, char** argv);
+
+	// Plays a stimulus on an output channel, locates it on an input channel that is looped back to it, and writes the measured
+	// round-trip latency alongside the latency reported by the driver as JSON.
+	// Returns a process exit code.
+	int RunLatencyTest(int argc, char** argv);
+
+}
@@ -1,10 +1,20 @@
 #include <ASIOTest/test.h>
 
 #include "..\FlexASIO\cflexasio.h"
+#include "latency.h"
+#include "performance.h"
+#include "sample_rate_queries.h"
 
 #include <cstdlib>
 
 int main(int argc, char** argv) {
+	if (::flexasio::IsPerformanceTestRequested(argc, argv))
+		return ::flexasio::RunPerformanceTest(argc, argv);
+	if (::flexasio::IsLatencyTestRequested(argc, argv))
+		return ::flexasio::RunLatencyTest(argc, argv);
+	if (::flexasio::IsSampleRateQueryBenchmarkRequested(argc, argv))
+		return ::flexasio::RunSampleRateQueryBenchmark(argc, argv);
+
 	auto* const asioDriver = CreateFlexASIO();
 	if (asioDriver == nullptr) abort();
 
@@ -0,0 +1,593 @@
+#include "performance.h"
+
+#include "driver.h"
+
+#include "..\FlexASIOUtil\json.h"
+#include "..\FlexASIOUtil\statistics.h"
+
+#include <windows.h>
+
+#include <dechamps_ASIOUtil/asiosdk/iasiodrv.h>
+#include <dechamps_ASIOUtil/asio.h>
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		using Clock = std::chrono::steady_clock;
+
+		constexpr std::string_view performanceFlag = "--performance";
+
+		// Callbacks that arrive within the first few periods are dominated by stream priming, not by steady state behaviour.
+		constexpr size_t warmupCallbackCount = 8;
+
+		// A callback that arrives more than this many periods after the previous one is counted as an xrun.
+		constexpr double xrunThresholdPeriods = 1.5;
+
+		struct Options final {
+			double durationSeconds = 10;
+			std::vector<long> bufferSizes;
+			std::optional<ASIOSampleRate> sampleRate;
+			std::optional<long> inputChannels;
+			std::optional<long> outputChannels;
+			double load = 0.25;
+			double loadJitter = 0;
+			bool outputReady = false;
+			bool pollSamplePosition = false;
+			double pollIntervalMilliseconds = 1;
+			bool sweep = false;
+			double sweepDurationSeconds = 2;
+			int sweepIterations = 6;
+			int cycles = 5;
+			double resetIdleSeconds = 0;
+			std::optional<std::string> outputPath;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			::cxxopts::Options commandLineOptions(argv[0], "Measures callback timing of the driver under a simulated host load");
+			commandLineOptions.add_options()
+				(std::string(performanceFlag.substr(2)), "Run the performance test")
+				("duration-seconds", "How long to stream for", ::cxxopts::value(options.durationSeconds))
+				("buffer-sizes", "Comma-separated list of ASIO buffer sizes, in frames (default: the preferred size)", ::cxxopts::value<std::vector<long>>())
+				("sample-rate", "Sample rate, in Hz (default: the current rate)", ::cxxopts::value(options.sampleRate))
+				("input-channels", "Number of input channels to use (default: all)", ::cxxopts::value(options.inputChannels))
+				("output-channels", "Number of output channels to use (default: all)", ::cxxopts::value(options.outputChannels))
+				("load", "Fraction of the buffer period the simulated host spends in bufferSwitch()", ::cxxopts::value(options.load))
+				("load-jitter", "Randomly vary the load by up to this relative amount", ::cxxopts::value(options.loadJitter))
+				("output-ready", "Call outputReady() after each bufferSwitch()", ::cxxopts::value(options.outputReady))
+				("poll-sample-position", "Call getSamplePosition() from bufferSwitch() and from a polling thread", ::cxxopts::value(options.pollSamplePosition))
+				("poll-interval-ms", "Interval between getSamplePosition() calls on the polling thread", ::cxxopts::value(options.pollIntervalMilliseconds))
+				("sweep", "Also search for the highest sustainable load for each buffer size", ::cxxopts::value(options.sweep))
+				("sweep-duration-seconds", "How long to run each step of the sweep for", ::cxxopts::value(options.sweepDurationSeconds))
+				("sweep-iterations", "Number of steps of the sweep", ::cxxopts::value(options.sweepIterations))
+				("cycles", "Number of start/stop and reset cycles to time", ::cxxopts::value(options.cycles))
+				("reset-idle-seconds", "Wait this long between destroying and re-creating the driver in reset cycles", ::cxxopts::value(options.resetIdleSeconds))
+				("output", "Write the JSON report to this file instead of standard output", ::cxxopts::value(options.outputPath));
+			const auto result = commandLineOptions.parse(argc, argv);
+			if (result.count("buffer-sizes") > 0) options.bufferSizes = result["buffer-sizes"].as<std::vector<long>>();
+
+			if (!(options.durationSeconds > 0)) throw std::runtime_error("--duration-seconds must be strictly positive");
+			if (!(options.load >= 0 && options.load < 1)) throw std::runtime_error("--load must be in [0, 1)");
+			if (!(options.loadJitter >= 0 && options.loadJitter <= 1)) throw std::runtime_error("--load-jitter must be in [0, 1]");
+			if (!(options.pollIntervalMilliseconds > 0)) throw std::runtime_error("--poll-interval-ms must be strictly positive");
+			if (options.sweepIterations < 1) throw std::runtime_error("--sweep-iterations must be strictly positive");
+			if (options.cycles < 0) throw std::runtime_error("--cycles cannot be negative");
+			if (!(options.resetIdleSeconds >= 0)) throw std::runtime_error("--reset-idle-seconds cannot be negative");
+			for (const auto bufferSize : options.bufferSizes)
+				if (bufferSize <= 0) throw std::runtime_error("--buffer-sizes must be strictly positive");
+			return options;
+		}
+
+		double ToMicroseconds(Clock::duration duration) { return std::chrono::duration<double, std::micro>(duration).count(); }
+		double ToMilliseconds(Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+		// Simulates the audio processing side of an ASIO host application.
+		//
+		// ASIO callbacks do not carry any context pointer, so only one Host can be active at any given time.
+		class Host final {
+		public:
+			struct Parameters final {
+				double periodSeconds;
+				double load;
+				double loadJitter;
+				bool outputReady;
+				bool pollSamplePosition;
+			};
+
+			Host(IASIO* driver, const Parameters& parameters, size_t maxCallbackCount) :
+				driver(driver), parameters(parameters) {
+				arrivals.reserve(maxCallbackCount);
+				durations.reserve(maxCallbackCount);
+				samplePositionCallDurations.reserve(parameters.pollSamplePosition ? maxCallbackCount : 0);
+				if (current != nullptr) abort();
+				current = this;
+			}
+			~Host() { current = nullptr; }
+
+			Host(const Host&) = delete;
+			Host& operator=(const Host&) = delete;
+
+			ASIOCallbacks* GetCallbacks() { return &callbacks; }
+
+			bool HasReceivedCallback() const { return callbackReceived.load(std::memory_order_acquire); }
+			std::optional<Clock::time_point> WaitForFirstCallback(Clock::duration timeout) const {
+				const auto deadline = Clock::now() + timeout;
+				while (!HasReceivedCallback()) {
+					if (Clock::now() > deadline) return std::nullopt;
+					std::this_thread::yield();
+				}
+				return firstCallback;
+			}
+
+			// The following must only be accessed after the stream is stopped.
+			const std::vector<Clock::time_point>& GetArrivals() const { return arrivals; }
+			const std::vector<Clock::duration>& GetDurations() const { return durations; }
+			const std::vector<Clock::duration>& GetSamplePositionCallDurations() const { return samplePositionCallDurations; }
+			size_t GetDroppedCallbackCount() const { return droppedCallbackCount; }
+			size_t GetSamplePositionErrorCount() const { return samplePositionErrorCount; }
+			size_t GetNonMonotonicSamplePositionCount() const { return nonMonotonicSamplePositionCount; }
+			int GetResetRequestCount() const { return resetRequestCount.load(); }
+
+		private:
+			static void BufferSwitch(long doubleBufferIndex, ASIOBool directProcess) {
+				current->OnBufferSwitch(doubleBufferIndex, directProcess);
+			}
+			static ASIOTime* BufferSwitchTimeInfo(ASIOTime* params, long doubleBufferIndex, ASIOBool directProcess) {
+				current->OnBufferSwitch(doubleBufferIndex, directProcess);
+				return params;
+			}
+			static void SampleRateDidChange(ASIOSampleRate) {}
+			static long AsioMessage(long selector, long value, void*, double*) {
+				switch (selector) {
+				case kAsioSelectorSupported:
+					return value == kAsioEngineVersion || value == kAsioResetRequest || value == kAsioResyncRequest || value == kAsioLatenciesChanged;
+				case kAsioEngineVersion:
+					return 2;
+				case kAsioResetRequest:
+					++current->resetRequestCount;
+					return 1;
+				case kAsioResyncRequest:
+				case kAsioLatenciesChanged:
+					return 1;
+				}
+				return 0;
+			}
+
+			void OnBufferSwitch(long, ASIOBool) {
+				const auto arrival = Clock::now();
+				if (!callbackReceived.load(std::memory_order_relaxed)) {
+					firstCallback = arrival;
+					callbackReceived.store(true, std::memory_order_release);
+				}
+
+				if (parameters.pollSamplePosition) {
+					ASIOSamples samples;
+					ASIOTimeStamp timestamp;
+					const auto callStart = Clock::now();
+					const auto error = driver->getSamplePosition(&samples, &timestamp);
+					const auto callEnd = Clock::now();
+					if (samplePositionCallDurations.size() < samplePositionCallDurations.capacity())
+						samplePositionCallDurations.push_back(callEnd - callStart);
+					if (error != ASE_OK) ++samplePositionErrorCount;
+					else {
+						const auto position = ::dechamps_ASIOUtil::ASIOToInt64(samples);
+						if (lastSamplePosition.has_value() && position < *lastSamplePosition) ++nonMonotonicSamplePositionCount;
+						lastSamplePosition = position;
+					}
+				}
+
+				auto budget = parameters.load * parameters.periodSeconds;
+				if (parameters.loadJitter > 0) budget *= 1 + parameters.loadJitter * std::uniform_real_distribution<double>(-1, 1)(random);
+				const auto deadline = arrival + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(budget));
+				while (Clock::now() < deadline) {}
+
+				if (parameters.outputReady) driver->outputReady();
+
+				if (arrivals.size() < arrivals.capacity()) {
+					arrivals.push_back(arrival);
+					durations.push_back(Clock::now() - arrival);
+				}
+				else ++droppedCallbackCount;
+			}
+
+			static Host* current;
+
+			IASIO* const driver;
+			const Parameters parameters;
+			ASIOCallbacks callbacks = {
+				.bufferSwitch = &BufferSwitch,
+				.sampleRateDidChange = &SampleRateDidChange,
+				.asioMessage = &AsioMessage,
+				.bufferSwitchTimeInfo = &BufferSwitchTimeInfo,
+			};
+
+			std::atomic<bool> callbackReceived = false;
+			Clock::time_point firstCallback;
+			std::vector<Clock::time_point> arrivals;
+			std::vector<Clock::duration> durations;
+			std::vector<Clock::duration> samplePositionCallDurations;
+			size_t droppedCallbackCount = 0;
+			size_t samplePositionErrorCount = 0;
+			size_t nonMonotonicSamplePositionCount = 0;
+			std::optional<int64_t> lastSamplePosition;
+			std::atomic<int> resetRequestCount = 0;
+			std::minstd_rand random;
+		};
+
+		Host* Host::current = nullptr;
+
+		class PreparedBuffers final {
+		public:
+			PreparedBuffers(Driver& driver, const Options& options, long bufferSize, ASIOCallbacks* callbacks) : driver(driver) {
+				long inputChannelCount, outputChannelCount;
+				driver.Check(driver->getChannels(&inputChannelCount, &outputChannelCount), "getChannels()");
+				if (options.inputChannels.has_value()) inputChannelCount = (std::min)(inputChannelCount, *options.inputChannels);
+				if (options.outputChannels.has_value()) outputChannelCount = (std::min)(outputChannelCount, *options.outputChannels);
+
+				for (long channel = 0; channel < inputChannelCount; ++channel)
+					bufferInfos.push_back({ .isInput = ASIOTrue, .channelNum = channel });
+				for (long channel = 0; channel < outputChannelCount; ++channel)
+					bufferInfos.push_back({ .isInput = ASIOFalse, .channelNum = channel });
+				if (bufferInfos.empty()) throw std::runtime_error("no channels to activate");
+
+				driver.Check(driver->createBuffers(bufferInfos.data(), long(bufferInfos.size()), bufferSize, callbacks), "createBuffers()");
+				if (options.outputReady) driver->outputReady();
+			}
+			~PreparedBuffers() {
+				driver->disposeBuffers();
+			}
+
+			PreparedBuffers(const PreparedBuffers&) = delete;
+			PreparedBuffers& operator=(const PreparedBuffers&) = delete;
+
+			size_t GetChannelCount(bool input) const {
+				return size_t(std::count_if(bufferInfos.begin(), bufferInfos.end(), [&](const ASIOBufferInfo& bufferInfo) { return !bufferInfo.isInput == !input; }));
+			}
+
+		private:
+			Driver& driver;
+			std::vector<ASIOBufferInfo> bufferInfos;
+		};
+
+		class RunningStream final {
+		public:
+			explicit RunningStream(Driver& driver) : driver(driver) {
+				driver.Check(driver->start(), "start()");
+			}
+			~RunningStream() {
+				driver->stop();
+			}
+
+			RunningStream(const RunningStream&) = delete;
+			RunningStream& operator=(const RunningStream&) = delete;
+
+		private:
+			Driver& driver;
+		};
+
+		Host::Parameters GetHostParameters(const Options& options, long bufferSize, ASIOSampleRate sampleRate, double load) {
+			return {
+				.periodSeconds = bufferSize / sampleRate,
+				.load = load,
+				.loadJitter = options.loadJitter,
+				.outputReady = options.outputReady,
+				.pollSamplePosition = options.pollSamplePosition,
+			};
+		}
+
+		size_t GetMaxCallbackCount(double durationSeconds, long bufferSize, ASIOSampleRate sampleRate) {
+			// Leave plenty of headroom for backends that fire callbacks faster than the nominal period.
+			return size_t(durationSeconds * sampleRate / bufferSize * 2) + 64;
+		}
+
+		struct StreamResult final {
+			long inputLatency = 0;
+			long outputLatency = 0;
+			size_t inputChannelCount = 0;
+			size_t outputChannelCount = 0;
+			size_t callbackCount = 0;
+			size_t droppedCallbackCount = 0;
+			size_t xrunCount = 0;
+			size_t missedPeriodCount = 0;
+			std::vector<double> intervalsMicroseconds;
+			std::vector<double> jitterMicroseconds;
+			std::vector<double> hostCallbackMicroseconds;
+			std::vector<double> callbackSamplePositionMicroseconds;
+			std::vector<double> pollSamplePositionMicroseconds;
+			size_t samplePositionErrorCount = 0;
+			size_t nonMonotonicSamplePositionCount = 0;
+			int resetRequestCount = 0;
+		};
+
+		StreamResult RunStream(Driver& driver, const Options& options, long bufferSize, ASIOSampleRate sampleRate, double load, double durationSeconds) {
+			const auto hostParameters = GetHostParameters(options, bufferSize, sampleRate, load);
+			Host host(driver.Get(), hostParameters, GetMaxCallbackCount(durationSeconds, bufferSize, sampleRate));
+			PreparedBuffers preparedBuffers(driver, options, bufferSize, host.GetCallbacks());
+
+			StreamResult result;
+			result.inputChannelCount = preparedBuffers.GetChannelCount(/*input=*/true);
+			result.outputChannelCount = preparedBuffers.GetChannelCount(/*input=*/false);
+			driver.Check(driver->getLatencies(&result.inputLatency, &result.outputLatency), "getLatencies()");
+
+			{
+				RunningStream runningStream(driver);
+				const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(durationSeconds));
+				if (!options.pollSamplePosition) std::this_thread::sleep_until(end);
+				else {
+					// Emulate a host UI thread polling the transport position concurrently with the audio thread.
+					const auto pollInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(options.pollIntervalMilliseconds));
+					for (auto nextPoll = Clock::now(); nextPoll < end; nextPoll += pollInterval) {
+						std::this_thread::sleep_until(nextPoll);
+						if (!host.HasReceivedCallback()) continue;
+						ASIOSamples samples;
+						ASIOTimeStamp timestamp;
+						const auto callStart = Clock::now();
+						const auto error = driver->getSamplePosition(&samples, &timestamp);
+						result.pollSamplePositionMicroseconds.push_back(ToMicroseconds(Clock::now() - callStart));
+						if (error != ASE_OK) ++result.samplePositionErrorCount;
+					}
+				}
+			}
+
+			const auto& arrivals = host.GetArrivals();
+			const auto& durations = host.GetDurations();
+			const auto periodMicroseconds = hostParameters.periodSeconds * 1e6;
+			result.callbackCount = arrivals.size();
+			result.droppedCallbackCount = host.GetDroppedCallbackCount();
+			for (size_t callbackIndex = warmupCallbackCount + 1; callbackIndex < arrivals.size(); ++callbackIndex) {
+				const auto interval = ToMicroseconds(arrivals[callbackIndex] - arrivals[callbackIndex - 1]);
+				result.intervalsMicroseconds.push_back(interval);
+				result.jitterMicroseconds.push_back(std::abs(interval - periodMicroseconds));
+				if (interval > xrunThresholdPeriods * periodMicroseconds) {
+					++result.xrunCount;
+					result.missedPeriodCount += size_t(std::lround(interval / periodMicroseconds)) - 1;
+				}
+			}
+			for (size_t callbackIndex = (std::min)(warmupCallbackCount, durations.size()); callbackIndex < durations.size(); ++callbackIndex)
+				result.hostCallbackMicroseconds.push_back(ToMicroseconds(durations[callbackIndex]));
+			for (const auto duration : host.GetSamplePositionCallDurations())
+				result.callbackSamplePositionMicroseconds.push_back(ToMicroseconds(duration));
+			result.samplePositionErrorCount += host.GetSamplePositionErrorCount();
+			result.nonMonotonicSamplePositionCount = host.GetNonMonotonicSamplePositionCount();
+			result.resetRequestCount = host.GetResetRequestCount();
+			return result;
+		}
+
+		void WriteStreamResult(JsonWriter& writer, StreamResult& result) {
+			writer.Key("latencies").BeginObject()
+				.Key("input").Value(result.inputLatency)
+				.Key("output").Value(result.outputLatency)
+				.EndObject();
+			writer.Key("activeChannels").BeginObject()
+				.Key("input").Value(result.inputChannelCount)
+				.Key("output").Value(result.outputChannelCount)
+				.EndObject();
+			writer.Key("callbacks").Value(result.callbackCount);
+			writer.Key("droppedCallbackRecords").Value(result.droppedCallbackCount);
+			writer.Key("xruns").Value(result.xrunCount);
+			writer.Key("missedPeriods").Value(result.missedPeriodCount);
+			writer.Key("resetRequests").Value(result.resetRequestCount);
+			writer.Key("intervalMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.intervalsMicroseconds));
+			writer.Key("jitterMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.jitterMicroseconds));
+			writer.Key("hostCallbackMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.hostCallbackMicroseconds));
+			if (!result.callbackSamplePositionMicroseconds.empty() || !result.pollSamplePositionMicroseconds.empty()) {
+				writer.Key("getSamplePosition").BeginObject();
+				writer.Key("errors").Value(result.samplePositionErrorCount);
+				writer.Key("nonMonotonic").Value(result.nonMonotonicSamplePositionCount);
+				writer.Key("inCallbackMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.callbackSamplePositionMicroseconds));
+				writer.Key("pollMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.pollSamplePositionMicroseconds));
+				writer.EndObject();
+			}
+		}
+
+		// Finds the highest host load (as a fraction of the buffer period) that runs without any xruns, using a binary search.
+		// This assumes xruns are monotonic with respect to load, which is true on average but not for any given run,
+		// so the result should be interpreted as an estimate.
+		void SweepLoad(JsonWriter& writer, Driver& driver, const Options& options, long bufferSize, ASIOSampleRate sampleRate) {
+			double sustainable = 0;
+			double unsustainable = 1;
+			writer.Key("sweep").BeginArray();
+			for (int iteration = 0; iteration < options.sweepIterations; ++iteration) {
+				const auto load = (sustainable + unsustainable) / 2;
+				std::cerr << "Sweep: buffer size " << bufferSize << ", load " << load << std::endl;
+				const auto result = RunStream(driver, options, bufferSize, sampleRate, load, options.sweepDurationSeconds);
+				writer.BeginObject()
+					.Key("load").Value(load)
+					.Key("xruns").Value(result.xrunCount)
+					.EndObject();
+				(result.xrunCount == 0 ? sustainable : unsustainable) = load;
+			}
+			writer.EndArray();
+			writer.Key("maxSustainableLoad").Value(sustainable);
+		}
+
+		struct CycleTimes final {
+			std::vector<double> createBuffersMilliseconds;
+			std::vector<double> startMilliseconds;
+			std::vector<double> startToFirstCallbackMilliseconds;
+			std::vector<double> stopMilliseconds;
+			std::vector<double> disposeBuffersMilliseconds;
+			std::vector<double> resetToRunningMilliseconds;
+			size_t missingFirstCallbackCount = 0;
+		};
+
+		constexpr auto firstCallbackTimeout = std::chrono::seconds(5);
+
+		// Measures a start/stop cycle on an existing driver instance, without the host load.
+		void RunStartStopCycle(Driver& driver, const Options& options, long bufferSize, ASIOSampleRate sampleRate, CycleTimes& cycleTimes) {
+			Host host(driver.Get(), GetHostParameters(options, bufferSize, sampleRate, /*load=*/0), GetMaxCallbackCount(1, bufferSize, sampleRate));
+
+			const auto createBuffersStart = Clock::now();
+			std::optional<PreparedBuffers> preparedBuffers;
+			preparedBuffers.emplace(driver, options, bufferSize, host.GetCallbacks());
+			cycleTimes.createBuffersMilliseconds.push_back(ToMilliseconds(Clock::now() - createBuffersStart));
+
+			const auto startStart = Clock::now();
+			driver.Check(driver->start(), "start()");
+			cycleTimes.startMilliseconds.push_back(ToMilliseconds(Clock::now() - startStart));
+			const auto firstCallback = host.WaitForFirstCallback(firstCallbackTimeout);
+			if (firstCallback.has_value()) cycleTimes.startToFirstCallbackMilliseconds.push_back(ToMilliseconds(*firstCallback - startStart));
+			else ++cycleTimes.missingFirstCallbackCount;
+
+			const auto stopStart = Clock::now();
+			driver.Check(driver->stop(), "stop()");
+			cycleTimes.stopMilliseconds.push_back(ToMilliseconds(Clock::now() - stopStart));
+
+			const auto disposeBuffersStart = Clock::now();
+			preparedBuffers.reset();
+			cycleTimes.disposeBuffersMilliseconds.push_back(ToMilliseconds(Clock::now() - disposeBuffersStart));
+		}
+
+		// Measures what a host goes through in response to kAsioResetRequest: tear down the driver instance entirely,
+		// then bring up a new one all the way to the first bufferSwitch().
+		// If --reset-idle-seconds is set, the driver is left alone for that long between the two (not included in the measurement),
+		// which makes it possible to measure resets that do not benefit from the driver reusing process-wide state.
+		void RunResetCycle(std::optional<Driver>& driver, const Options& options, long bufferSize, ASIOSampleRate sampleRate, CycleTimes& cycleTimes) {
+			const auto teardownStart = Clock::now();
+			driver.reset();
+			const auto teardownDuration = Clock::now() - teardownStart;
+			if (options.resetIdleSeconds > 0) std::this_thread::sleep_for(std::chrono::duration<double>(options.resetIdleSeconds));
+
+			const auto bringupStart = Clock::now();
+			driver.emplace();
+			if (options.sampleRate.has_value()) driver->Check((*driver)->setSampleRate(*options.sampleRate), "setSampleRate()");
+
+			Host host(driver->Get(), GetHostParameters(options, bufferSize, sampleRate, /*load=*/0), GetMaxCallbackCount(1, bufferSize, sampleRate));
+			PreparedBuffers preparedBuffers(*driver, options, bufferSize, host.GetCallbacks());
+			RunningStream runningStream(*driver);
+			if (host.WaitForFirstCallback(firstCallbackTimeout).has_value())
+				cycleTimes.resetToRunningMilliseconds.push_back(ToMilliseconds(teardownDuration + (Clock::now() - bringupStart)));
+			else ++cycleTimes.missingFirstCallbackCount;
+		}
+
+		void WriteCycleTimes(JsonWriter& writer, CycleTimes& cycleTimes) {
+			writer.BeginObject();
+			writer.Key("createBuffersMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.createBuffersMilliseconds));
+			writer.Key("startMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.startMilliseconds));
+			writer.Key("startToFirstCallbackMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.startToFirstCallbackMilliseconds));
+			writer.Key("stopMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.stopMilliseconds));
+			writer.Key("disposeBuffersMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.disposeBuffersMilliseconds));
+			writer.Key("resetToRunningMilliseconds"); WriteDistribution(writer, ComputeDistribution(cycleTimes.resetToRunningMilliseconds));
+			writer.Key("missingFirstCallbacks").Value(cycleTimes.missingFirstCallbackCount);
+			writer.EndObject();
+		}
+
+		void RunPerformanceTest(const Options& options, std::ostream& output) {
+			std::optional<Driver> driver;
+			driver.emplace();
+
+			if (options.sampleRate.has_value()) driver->Check((*driver)->setSampleRate(*options.sampleRate), "setSampleRate()");
+			ASIOSampleRate sampleRate;
+			driver->Check((*driver)->getSampleRate(&sampleRate), "getSampleRate()");
+
+			auto bufferSizes = options.bufferSizes;
+			if (bufferSizes.empty()) {
+				long minSize, maxSize, preferredSize, granularity;
+				driver->Check((*driver)->getBufferSize(&minSize, &maxSize, &preferredSize, &granularity), "getBufferSize()");
+				bufferSizes.push_back(preferredSize);
+			}
+
+			JsonWriter writer(output);
+			writer.BeginObject();
+
+			{
+				char driverName[32] = { 0 };
+				(*driver)->getDriverName(driverName);
+				long inputChannelCount, outputChannelCount;
+				driver->Check((*driver)->getChannels(&inputChannelCount, &outputChannelCount), "getChannels()");
+				writer.Key("driver").BeginObject()
+					.Key("name").Value(driverName)
+					.Key("version").Value((*driver)->getDriverVersion())
+					.Key("inputChannels").Value(inputChannelCount)
+					.Key("outputChannels").Value(outputChannelCount)
+					.Key("sampleRate").Value(sampleRate)
+					.EndObject();
+			}
+
+			writer.Key("parameters").BeginObject()
+				.Key("durationSeconds").Value(options.durationSeconds)
+				.Key("load").Value(options.load)
+				.Key("loadJitter").Value(options.loadJitter)
+				.Key("outputReady").Value(options.outputReady)
+				.Key("pollSamplePosition").Value(options.pollSamplePosition)
+				.Key("pollIntervalMilliseconds").Value(options.pollIntervalMilliseconds)
+				.Key("xrunThresholdPeriods").Value(xrunThresholdPeriods)
+				.Key("warmupCallbacks").Value(warmupCallbackCount)
+				.Key("resetIdleSeconds").Value(options.resetIdleSeconds)
+				.EndObject();
+
+			writer.Key("runs").BeginArray();
+			for (const auto bufferSize : bufferSizes) {
+				std::cerr << "Running buffer size " << bufferSize << " at load " << options.load << " for " << options.durationSeconds << " seconds" << std::endl;
+				auto result = RunStream(*driver, options, bufferSize, sampleRate, options.load, options.durationSeconds);
+				writer.BeginObject();
+				writer.Key("bufferSize").Value(bufferSize);
+				writer.Key("periodMicroseconds").Value(bufferSize / sampleRate * 1e6);
+				WriteStreamResult(writer, result);
+				if (options.sweep) SweepLoad(writer, *driver, options, bufferSize, sampleRate);
+				writer.EndObject();
+			}
+			writer.EndArray();
+
+			if (options.cycles > 0) {
+				const auto bufferSize = bufferSizes.front();
+				std::cerr << "Running " << options.cycles << " start/stop and reset cycles with buffer size " << bufferSize << std::endl;
+				CycleTimes cycleTimes;
+				for (int cycle = 0; cycle < options.cycles; ++cycle)
+					RunStartStopCycle(*driver, options, bufferSize, sampleRate, cycleTimes);
+				for (int cycle = 0; cycle < options.cycles; ++cycle)
+					RunResetCycle(driver, options, bufferSize, sampleRate, cycleTimes);
+				writer.Key("cycles");
+				WriteCycleTimes(writer, cycleTimes);
+			}
+
+			writer.EndObject();
+		}
+
+	}
+
+	bool IsPerformanceTestRequested(int argc, char** argv) {
+		for (int argumentIndex = 1; argumentIndex < argc; ++argumentIndex)
+			if (argv[argumentIndex] == performanceFlag) return true;
+		return false;
+	}
+
+	int RunPerformanceTest(int argc, char** argv) {
+		try {
+			const auto options = ParseOptions(argc, argv);
+			if (!options.outputPath.has_value()) {
+				RunPerformanceTest(options, std::cout);
+			}
+			else {
+				std::ofstream output;
+				output.exceptions(output.badbit | output.failbit);
+				output.open(*options.outputPath);
+				RunPerformanceTest(options, output);
+			}
+		}
+		catch (const std::exception& exception) {
+			std::cerr << "ERROR: " << exception.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace flexasio {
+
+	// Returns true if the command line requests the performance mode (`--performance`) instead of the regular ASIOTest run.
+	bool IsPerformanceTestRequested(int argc, char** argv);
+
+	// Runs the driver for a fixed duration under synthetic host load and writes the results as JSON.
+	// Returns a process exit code.
+	int RunPerformanceTest(int argc, char** argv);
+
+}
@@ -0,0 +1,195 @@
+#include "sample_rate_queries.h"
+
+#include "driver.h"
+
+#include "..\FlexASIOUtil\json.h"
+#include "..\FlexASIOUtil\statistics.h"
+
+#include <windows.h>
+
+#include <dechamps_ASIOUtil/asiosdk/iasiodrv.h>
+
+#include <cxxopts.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		using Clock = std::chrono::steady_clock;
+
+		constexpr std::string_view sampleRateQueriesFlag = "--sample-rate-queries";
+
+		struct Options final {
+			int rounds = 5;
+			int repeats = 3;
+			// The rates that host applications typically enumerate.
+			std::vector<double> sampleRates = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000, 384000 };
+			// Values for the FLEXASIO_FORMAT_CHECKS environment variable, each of which gets its own set of rounds. If empty, the
+			// variable is left alone, and the driver answers from its caches whenever it can.
+			std::vector<std::string> formatChecks;
+			std::optional<std::string> outputPath;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			::cxxopts::Options commandLineOptions(argv[0], "Measures how long the driver takes to answer sample rate queries");
+			commandLineOptions.add_options()
+				(std::string(sampleRateQueriesFlag.substr(2)), "Run the sample rate query benchmark")
+				("rounds", "Number of times the driver is instantiated", ::cxxopts::value(options.rounds))
+				("repeats", "Number of times every rate is queried again in each round", ::cxxopts::value(options.repeats))
+				("sample-rates", "Comma-separated list of sample rates to query, in Hz", ::cxxopts::value<std::vector<double>>())
+				("format-checks", "Comma-separated list of sequential and concurrent: bypass the driver caches and compare how input and output are checked", ::cxxopts::value<std::vector<std::string>>())
+				("output", "Write the JSON report to this file instead of standard output", ::cxxopts::value(options.outputPath));
+			const auto result = commandLineOptions.parse(argc, argv);
+			if (result.count("sample-rates") > 0) options.sampleRates = result["sample-rates"].as<std::vector<double>>();
+			if (result.count("format-checks") > 0) options.formatChecks = result["format-checks"].as<std::vector<std::string>>();
+
+			if (options.rounds < 1) throw std::runtime_error("--rounds must be strictly positive");
+			if (options.repeats < 0) throw std::runtime_error("--repeats cannot be negative");
+			if (options.sampleRates.empty()) throw std::runtime_error("--sample-rates cannot be empty");
+			for (const auto sampleRate : options.sampleRates)
+				if (!(sampleRate > 0)) throw std::runtime_error("--sample-rates must be strictly positive");
+			for (const auto& formatChecks : options.formatChecks)
+				if (formatChecks != "sequential" && formatChecks != "concurrent") throw std::runtime_error("invalid value for --format-checks: '" + formatChecks + "' (expected sequential or concurrent)");
+#ifndef FLEXASIO_FORMAT_CHECKS
+			if (!options.formatChecks.empty()) throw std::runtime_error("--format-checks requires FlexASIO to be built with -DFLEXASIO_FORMAT_CHECKS=ON");
+#endif
+			return options;
+		}
+
+		double ToMilliseconds(Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+		double ToMicroseconds(Clock::duration duration) { return std::chrono::duration<double, std::micro>(duration).count(); }
+
+		struct RoundResult final {
+			double initMilliseconds = 0;
+			double firstPassMilliseconds = 0;
+			std::vector<double> repeatQueryMicroseconds;
+			std::vector<double> availableSampleRates;
+		};
+
+		// One round is what a host does when it scans drivers or opens its audio preferences: instantiate the driver, enumerate the
+		// sample rates it supports, and keep asking about the same rates as the user interacts with the dialog.
+		RoundResult RunRound(const Options& options) {
+			RoundResult result;
+
+			const auto initStart = Clock::now();
+			std::optional<Driver> driver;
+			driver.emplace();
+			long inputChannelCount, outputChannelCount;
+			driver->Check((*driver)->getChannels(&inputChannelCount, &outputChannelCount), "getChannels()");
+			result.initMilliseconds = ToMilliseconds(Clock::now() - initStart);
+
+			const auto firstPassStart = Clock::now();
+			for (const auto sampleRate : options.sampleRates)
+				if ((*driver)->canSampleRate(sampleRate) == ASE_OK) result.availableSampleRates.push_back(sampleRate);
+			result.firstPassMilliseconds = ToMilliseconds(Clock::now() - firstPassStart);
+
+			for (int repeat = 0; repeat < options.repeats; ++repeat)
+				for (const auto sampleRate : options.sampleRates) {
+					const auto queryStart = Clock::now();
+					(*driver)->canSampleRate(sampleRate);
+					result.repeatQueryMicroseconds.push_back(ToMicroseconds(Clock::now() - queryStart));
+				}
+
+			return result;
+		}
+
+		// Writes the rounds and their distributions as keys of the current JSON object.
+		void RunRounds(const Options& options, JsonWriter& writer) {
+			std::vector<double> initMilliseconds;
+			std::vector<double> firstPassMilliseconds;
+			std::vector<double> repeatQueryMicroseconds;
+			writer.Key("rounds").BeginArray();
+			for (int round = 0; round < options.rounds; ++round) {
+				std::cerr << "Running round " << round + 1 << " of " << options.rounds << std::endl;
+				auto result = RunRound(options);
+				writer.BeginObject();
+				writer.Key("initMilliseconds").Value(result.initMilliseconds);
+				writer.Key("firstPassMilliseconds").Value(result.firstPassMilliseconds);
+				writer.Key("availableSampleRates").BeginArray();
+				for (const auto sampleRate : result.availableSampleRates) writer.Value(sampleRate);
+				writer.EndArray();
+				repeatQueryMicroseconds.insert(repeatQueryMicroseconds.end(), result.repeatQueryMicroseconds.begin(), result.repeatQueryMicroseconds.end());
+				writer.Key("repeatQueryMicroseconds"); WriteDistribution(writer, ComputeDistribution(result.repeatQueryMicroseconds));
+				writer.EndObject();
+
+				initMilliseconds.push_back(result.initMilliseconds);
+				firstPassMilliseconds.push_back(result.firstPassMilliseconds);
+			}
+			writer.EndArray();
+
+			writer.Key("initMilliseconds"); WriteDistribution(writer, ComputeDistribution(initMilliseconds));
+			writer.Key("firstPassMilliseconds"); WriteDistribution(writer, ComputeDistribution(firstPassMilliseconds));
+			writer.Key("repeatQueryMicroseconds"); WriteDistribution(writer, ComputeDistribution(repeatQueryMicroseconds));
+		}
+
+		void RunSampleRateQueryBenchmark(const Options& options, std::ostream& output) {
+			JsonWriter writer(output);
+			writer.BeginObject();
+
+			writer.Key("parameters").BeginObject()
+				.Key("rounds").Value(options.rounds)
+				.Key("repeats").Value(options.repeats);
+			writer.Key("sampleRates").BeginArray();
+			for (const auto sampleRate : options.sampleRates) writer.Value(sampleRate);
+			writer.EndArray();
+			writer.EndObject();
+
+			if (options.formatChecks.empty()) RunRounds(options, writer);
+			else {
+				// The driver is instantiated in this process, so it sees the variable as soon as it is set.
+				writer.Key("formatChecks").BeginArray();
+				for (const auto& formatChecks : options.formatChecks) {
+					std::cerr << "Running " << formatChecks << " format checks" << std::endl;
+					if (::SetEnvironmentVariableA("FLEXASIO_FORMAT_CHECKS", formatChecks.c_str()) == 0) throw std::runtime_error("unable to set FLEXASIO_FORMAT_CHECKS");
+					writer.BeginObject();
+					writer.Key("mode").Value(formatChecks);
+					RunRounds(options, writer);
+					writer.EndObject();
+				}
+				writer.EndArray();
+				::SetEnvironmentVariableA("FLEXASIO_FORMAT_CHECKS", nullptr);
+			}
+
+			writer.EndObject();
+		}
+
+	}
+
+	bool IsSampleRateQueryBenchmarkRequested(int argc, char** argv) {
+		for (int argumentIndex = 1; argumentIndex < argc; ++argumentIndex)
+			if (argv[argumentIndex] == sampleRateQueriesFlag) return true;
+		return false;
+	}
+
+	int RunSampleRateQueryBenchmark(int argc, char** argv) {
+		try {
+			const auto options = ParseOptions(argc, argv);
+			if (!options.outputPath.has_value()) {
+				RunSampleRateQueryBenchmark(options, std::cout);
+			}
+			else {
+				std::ofstream output;
+				output.exceptions(output.badbit | output.failbit);
+				output.open(*options.outputPath);
+				RunSampleRateQueryBenchmark(options, output);
+			}
+		}
+		catch (const std::exception& exception) {
+			std::cerr << "ERROR: " << exception.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+}
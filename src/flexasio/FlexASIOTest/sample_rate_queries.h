@@ -0,0 +1,13 @@
+#pragma once
+
+namespace flexasio {
+
+	// Returns true if the command line requests the sample rate query benchmark (`--sample-rate-queries`) instead of the regular
+	// ASIOTest run.
+	bool IsSampleRateQueryBenchmarkRequested(int argc, char** argv);
+
+	// Times canSampleRate() queries in the pattern typical of ASIO host applications, and writes the results as JSON.
+	// Returns a process exit code.
+	int RunSampleRateQueryBenchmark(int argc, char** argv);
+
+}
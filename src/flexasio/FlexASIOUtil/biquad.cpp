@@ -0,0 +1,260 @@
+#include "biquad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_BIQUAD_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		constexpr size_t laneCount = BiquadFilterBank::laneCount;
+		constexpr size_t coefficientsPerStage = 5;
+		constexpr size_t statePerStage = 2;
+
+		// y = b0 * x + s1; s1 = b1 * x - a1 * y + s2; s2 = b2 * x - a2 * y. Vector kernels compute it the exact same way, multiplying and
+		// adding separately (i.e. no FMA), so that results are identical.
+		void FilterScalar(float* block, size_t frameCount, const float* coefficients, float* state, size_t stageCount) {
+			for (size_t stage = 0; stage < stageCount; ++stage) {
+				const auto stageCoefficients = coefficients + stage * coefficientsPerStage * laneCount;
+				const auto stageState = state + stage * statePerStage * laneCount;
+				for (size_t lane = 0; lane < laneCount; ++lane) {
+					const auto b0 = stageCoefficients[0 * laneCount + lane];
+					const auto b1 = stageCoefficients[1 * laneCount + lane];
+					const auto b2 = stageCoefficients[2 * laneCount + lane];
+					const auto a1 = stageCoefficients[3 * laneCount + lane];
+					const auto a2 = stageCoefficients[4 * laneCount + lane];
+					auto s1 = stageState[0 * laneCount + lane];
+					auto s2 = stageState[1 * laneCount + lane];
+					for (size_t frame = 0; frame < frameCount; ++frame) {
+						auto& sample = block[frame * laneCount + lane];
+						const auto x = sample;
+						const auto y = b0 * x + s1;
+						s1 = b1 * x - a1 * y + s2;
+						s2 = b2 * x - a2 * y;
+						sample = y;
+					}
+					stageState[0 * laneCount + lane] = s1;
+					stageState[1 * laneCount + lane] = s2;
+				}
+			}
+		}
+
+#ifdef FLEXASIO_BIQUAD_X86
+
+		// Processes each half of the lanes separately.
+		void FilterSse2(float* block, size_t frameCount, const float* coefficients, float* state, size_t stageCount) {
+			for (size_t stage = 0; stage < stageCount; ++stage) {
+				const auto stageCoefficients = coefficients + stage * coefficientsPerStage * laneCount;
+				const auto stageState = state + stage * statePerStage * laneCount;
+				for (size_t lane = 0; lane < laneCount; lane += 4) {
+					const auto b0 = _mm_loadu_ps(stageCoefficients + 0 * laneCount + lane);
+					const auto b1 = _mm_loadu_ps(stageCoefficients + 1 * laneCount + lane);
+					const auto b2 = _mm_loadu_ps(stageCoefficients + 2 * laneCount + lane);
+					const auto a1 = _mm_loadu_ps(stageCoefficients + 3 * laneCount + lane);
+					const auto a2 = _mm_loadu_ps(stageCoefficients + 4 * laneCount + lane);
+					auto s1 = _mm_loadu_ps(stageState + 0 * laneCount + lane);
+					auto s2 = _mm_loadu_ps(stageState + 1 * laneCount + lane);
+					for (size_t frame = 0; frame < frameCount; ++frame) {
+						const auto samples = block + frame * laneCount + lane;
+						const auto x = _mm_loadu_ps(samples);
+						const auto y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+						s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+						s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+						_mm_storeu_ps(samples, y);
+					}
+					_mm_storeu_ps(stageState + 0 * laneCount + lane, s1);
+					_mm_storeu_ps(stageState + 1 * laneCount + lane, s2);
+				}
+			}
+		}
+
+		void FilterAvx2(float* block, size_t frameCount, const float* coefficients, float* state, size_t stageCount) {
+			static_assert(laneCount == 8);
+			for (size_t stage = 0; stage < stageCount; ++stage) {
+				const auto stageCoefficients = coefficients + stage * coefficientsPerStage * laneCount;
+				const auto stageState = state + stage * statePerStage * laneCount;
+				const auto b0 = _mm256_loadu_ps(stageCoefficients + 0 * laneCount);
+				const auto b1 = _mm256_loadu_ps(stageCoefficients + 1 * laneCount);
+				const auto b2 = _mm256_loadu_ps(stageCoefficients + 2 * laneCount);
+				const auto a1 = _mm256_loadu_ps(stageCoefficients + 3 * laneCount);
+				const auto a2 = _mm256_loadu_ps(stageCoefficients + 4 * laneCount);
+				auto s1 = _mm256_loadu_ps(stageState + 0 * laneCount);
+				auto s2 = _mm256_loadu_ps(stageState + 1 * laneCount);
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					const auto samples = block + frame * laneCount;
+					const auto x = _mm256_loadu_ps(samples);
+					const auto y = _mm256_add_ps(_mm256_mul_ps(b0, x), s1);
+					s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x), _mm256_mul_ps(a1, y)), s2);
+					s2 = _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y));
+					_mm256_storeu_ps(samples, y);
+				}
+				_mm256_storeu_ps(stageState + 0 * laneCount, s1);
+				_mm256_storeu_ps(stageState + 1 * laneCount, s2);
+			}
+			_mm256_zeroupper();
+		}
+
+		// Once the signal goes silent, filter state decays into denormal numbers, which are extremely slow to compute with on x86.
+		// Flushing them to zero makes no audible difference. This applies to the scalar implementation too, so results stay identical.
+		class FlushDenormalsScope final {
+		public:
+			FlushDenormalsScope() : mxcsr(_mm_getcsr()) { _mm_setcsr(mxcsr | flushToZero | denormalsAreZero); }
+			~FlushDenormalsScope() { _mm_setcsr(mxcsr); }
+
+			FlushDenormalsScope(const FlushDenormalsScope&) = delete;
+			FlushDenormalsScope& operator=(const FlushDenormalsScope&) = delete;
+
+		private:
+			static constexpr unsigned int flushToZero = 0x8000;
+			static constexpr unsigned int denormalsAreZero = 0x0040;
+
+			const unsigned int mxcsr;
+		};
+
+#endif
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			BiquadFilterBank::Kernel kernel;
+		};
+
+		KernelSelection SelectKernel([[maybe_unused]] SimdImplementation requestedImplementation) {
+#ifdef FLEXASIO_BIQUAD_X86
+			if (requestedImplementation >= SimdImplementation::AVX2) return { SimdImplementation::AVX2, &FilterAvx2 };
+			if (requestedImplementation >= SimdImplementation::SSE2) return { SimdImplementation::SSE2, &FilterSse2 };
+#endif
+			return { SimdImplementation::SCALAR, &FilterScalar };
+		}
+
+	}
+
+	std::optional<BiquadType> ParseBiquadType(std::string_view name) {
+		if (name == "peaking") return BiquadType::PEAKING;
+		if (name == "lowShelf") return BiquadType::LOW_SHELF;
+		if (name == "highShelf") return BiquadType::HIGH_SHELF;
+		if (name == "lowPass") return BiquadType::LOW_PASS;
+		if (name == "highPass") return BiquadType::HIGH_PASS;
+		return std::nullopt;
+	}
+
+	BiquadCoefficients DesignBiquad(BiquadType type, double sampleRate, double frequency, double q, double gainDecibels) {
+		if (!(frequency > 0 && frequency < sampleRate / 2)) throw std::runtime_error("filter frequency must be between 0 and half the sample rate");
+		if (!(q > 0)) throw std::runtime_error("filter Q must be strictly positive");
+
+		const auto a = std::pow(10.0, gainDecibels / 40);
+		const auto w0 = 2 * std::numbers::pi * frequency / sampleRate;
+		const auto cosW0 = std::cos(w0);
+		const auto alpha = std::sin(w0) / (2 * q);
+		const auto shelfAlpha = 2 * std::sqrt(a) * alpha;
+
+		double b0, b1, b2, a0, a1, a2;
+		switch (type) {
+		case BiquadType::PEAKING:
+			b0 = 1 + alpha * a;
+			b1 = -2 * cosW0;
+			b2 = 1 - alpha * a;
+			a0 = 1 + alpha / a;
+			a1 = -2 * cosW0;
+			a2 = 1 - alpha / a;
+			break;
+		case BiquadType::LOW_SHELF:
+			b0 = a * ((a + 1) - (a - 1) * cosW0 + shelfAlpha);
+			b1 = 2 * a * ((a - 1) - (a + 1) * cosW0);
+			b2 = a * ((a + 1) - (a - 1) * cosW0 - shelfAlpha);
+			a0 = (a + 1) + (a - 1) * cosW0 + shelfAlpha;
+			a1 = -2 * ((a - 1) + (a + 1) * cosW0);
+			a2 = (a + 1) + (a - 1) * cosW0 - shelfAlpha;
+			break;
+		case BiquadType::HIGH_SHELF:
+			b0 = a * ((a + 1) + (a - 1) * cosW0 + shelfAlpha);
+			b1 = -2 * a * ((a - 1) + (a + 1) * cosW0);
+			b2 = a * ((a + 1) + (a - 1) * cosW0 - shelfAlpha);
+			a0 = (a + 1) - (a - 1) * cosW0 + shelfAlpha;
+			a1 = 2 * ((a - 1) - (a + 1) * cosW0);
+			a2 = (a + 1) - (a - 1) * cosW0 - shelfAlpha;
+			break;
+		case BiquadType::LOW_PASS:
+			b0 = (1 - cosW0) / 2;
+			b1 = 1 - cosW0;
+			b2 = (1 - cosW0) / 2;
+			a0 = 1 + alpha;
+			a1 = -2 * cosW0;
+			a2 = 1 - alpha;
+			break;
+		case BiquadType::HIGH_PASS:
+			b0 = (1 + cosW0) / 2;
+			b1 = -(1 + cosW0);
+			b2 = (1 + cosW0) / 2;
+			a0 = 1 + alpha;
+			a1 = -2 * cosW0;
+			a2 = 1 - alpha;
+			break;
+		default:
+			throw std::invalid_argument("invalid biquad type");
+		}
+		return { .b0 = float(b0 / a0), .b1 = float(b1 / a0), .b2 = float(b2 / a0), .a1 = float(a1 / a0), .a2 = float(a2 / a0) };
+	}
+
+	BiquadFilterBank::BiquadFilterBank(const std::vector<std::vector<BiquadCoefficients>>& cascades, SimdImplementation requestedImplementation) :
+		channelCount(cascades.size()), filtered(channelCount), interleaver(laneCount, sizeof(float), requestedImplementation),
+		block(blockFrameCount * laneCount), silence(blockFrameCount), discarded(blockFrameCount) {
+		const auto selection = SelectKernel(requestedImplementation);
+		implementation = selection.implementation;
+		kernel = selection.kernel;
+
+		for (size_t firstChannel = 0; firstChannel < channelCount; firstChannel += laneCount) {
+			Group group{ .firstChannel = firstChannel, .stageCount = 0, .laneFiltered = {}, .coefficients = {}, .state = {} };
+			for (size_t lane = 0; lane < laneCount && firstChannel + lane < channelCount; ++lane) {
+				const auto& cascade = cascades[firstChannel + lane];
+				filtered[firstChannel + lane] = group.laneFiltered[lane] = !cascade.empty();
+				group.stageCount = (std::max)(group.stageCount, cascade.size());
+				filterCount += cascade.size();
+			}
+			if (group.stageCount == 0) continue;
+
+			group.coefficients.resize(group.stageCount * coefficientsPerStage * laneCount);
+			group.state.resize(group.stageCount * statePerStage * laneCount);
+			for (size_t stage = 0; stage < group.stageCount; ++stage)
+				for (size_t lane = 0; lane < laneCount; ++lane) {
+					const auto channel = firstChannel + lane;
+					const auto stageCoefficients = channel < channelCount && stage < cascades[channel].size() ? cascades[channel][stage] : BiquadCoefficients();
+					const auto coefficients = group.coefficients.data() + stage * coefficientsPerStage * laneCount + lane;
+					coefficients[0 * laneCount] = stageCoefficients.b0;
+					coefficients[1 * laneCount] = stageCoefficients.b1;
+					coefficients[2 * laneCount] = stageCoefficients.b2;
+					coefficients[3 * laneCount] = stageCoefficients.a1;
+					coefficients[4 * laneCount] = stageCoefficients.a2;
+				}
+			groups.push_back(std::move(group));
+		}
+	}
+
+	void BiquadFilterBank::Process(float* const* channels, size_t frameCount) {
+#ifdef FLEXASIO_BIQUAD_X86
+		const FlushDenormalsScope flushDenormalsScope;
+#endif
+		std::array<const std::byte*, laneCount> inputs;
+		std::array<std::byte*, laneCount> outputs;
+		for (auto& group : groups) {
+			for (size_t firstFrame = 0; firstFrame < frameCount; firstFrame += blockFrameCount) {
+				const auto blockFrames = (std::min)(blockFrameCount, frameCount - firstFrame);
+				for (size_t lane = 0; lane < laneCount; ++lane) {
+					const auto channel = group.laneFiltered[lane] ? channels[group.firstChannel + lane] : nullptr;
+					inputs[lane] = reinterpret_cast<const std::byte*>(channel == nullptr ? silence.data() : channel + firstFrame);
+					outputs[lane] = reinterpret_cast<std::byte*>(channel == nullptr ? discarded.data() : channel + firstFrame);
+				}
+				interleaver.Interleave(inputs.data(), reinterpret_cast<std::byte*>(block.data()), blockFrames);
+				kernel(block.data(), blockFrames, group.coefficients.data(), group.state.data(), group.stageCount);
+				interleaver.Deinterleave(reinterpret_cast<const std::byte*>(block.data()), outputs.data(), blockFrames);
+			}
+		}
+	}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "interleaving.h"
+#include "simd.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	enum class BiquadType { PEAKING, LOW_SHELF, HIGH_SHELF, LOW_PASS, HIGH_PASS };
+
+	// Accepts "peaking", "lowShelf", "highShelf", "lowPass" and "highPass".
+	std::optional<BiquadType> ParseBiquadType(std::string_view name);
+
+	// Normalized so that a0 is 1. The default coefficients pass the signal through unchanged.
+	struct BiquadCoefficients final {
+		float b0 = 1;
+		float b1 = 0;
+		float b2 = 0;
+		float a1 = 0;
+		float a2 = 0;
+	};
+
+	// Uses the formulas from Robert Bristow-Johnson's Audio EQ Cookbook. `gainDecibels` is ignored by low and high pass filters.
+	// Throws if `frequency` is not strictly between 0 and half the sample rate, or if `q` is not strictly positive.
+	BiquadCoefficients DesignBiquad(BiquadType type, double sampleRate, double frequency, double q, double gainDecibels);
+
+	// Runs each channel through its own cascade of biquad filters, on 32-bit float samples, using the transposed direct form II.
+	// Channels are processed in groups of `laneCount`, one channel per vector lane; the coefficients and state of each group are
+	// stored lane by lane (structure of arrays), so that a whole group is filtered with one sequence of vector operations. Groups
+	// that only contain channels without filters are skipped. The result does not depend on the implementation.
+	class BiquadFilterBank final {
+	public:
+		static constexpr size_t laneCount = 8;
+
+		// One cascade per channel. Cascades can have different lengths, including zero.
+		explicit BiquadFilterBank(const std::vector<std::vector<BiquadCoefficients>>& cascades, SimdImplementation implementation = GetBestSimdImplementation());
+
+		size_t GetChannelCount() const { return channelCount; }
+		// Whether the cascade of the given channel is not empty. Channels without filters are left alone.
+		bool IsFiltered(size_t channel) const { return filtered[channel]; }
+		size_t GetFilterCount() const { return filterCount; }
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		// `channels` points to one buffer per channel, which are filtered in place. Null buffers are treated as silence (so that
+		// the filters can ring out) and are not written to. Real-time safe.
+		void Process(float* const* channels, size_t frameCount);
+
+		// `block` contains `frameCount` frames of `laneCount` samples. `coefficients` contains b0, b1, b2, a1 and a2 for every lane
+		// of every stage, and `state` the two state variables for every lane of every stage.
+		using Kernel = void(*)(float* block, size_t frameCount, const float* coefficients, float* state, size_t stageCount);
+
+	private:
+		struct Group final {
+			size_t firstChannel;
+			// The length of the longest cascade in the group. Shorter cascades are padded with pass-through stages.
+			size_t stageCount;
+			std::array<bool, laneCount> laneFiltered;
+			std::vector<float> coefficients;
+			std::vector<float> state;
+		};
+
+		static constexpr size_t blockFrameCount = 64;
+
+		size_t channelCount;
+		std::vector<bool> filtered;
+		size_t filterCount = 0;
+		std::vector<Group> groups;
+		Interleaver interleaver;
+		SimdImplementation implementation;
+		Kernel kernel;
+		std::vector<float> block;
+		// Stands in for null and unfiltered channels.
+		std::vector<float> silence;
+		std::vector<float> discarded;
+	};
+
+}
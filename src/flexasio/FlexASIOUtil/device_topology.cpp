@@ -0,0 +1,80 @@
+#include "device_topology.h"
+
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+namespace flexasio {
+
+	namespace {
+
+		void CheckHResult(HRESULT result, const char* what) {
+			if (FAILED(result)) throw std::system_error(result, std::system_category(), what);
+		}
+
+		// FNV-1a
+		class Hasher final {
+		public:
+			void Add(const void* data, size_t size) {
+				for (const auto byte : std::string_view(static_cast<const char*>(data), size)) {
+					hash ^= static_cast<unsigned char>(byte);
+					hash *= 0x100000001b3;
+				}
+			}
+			void Add(std::wstring_view string) { Add(string.data(), string.size() * sizeof(wchar_t)); Add(L"", sizeof(wchar_t)); }
+			template <typename Value> void Add(const Value& value) { Add(&value, sizeof(value)); }
+
+			uint64_t Get() const { return hash; }
+
+		private:
+			uint64_t hash = 0xcbf29ce484222325;
+		};
+
+		void AddDeviceId(Hasher& hasher, IMMDevice* device) {
+			LPWSTR id = nullptr;
+			CheckHResult(device->GetId(&id), "IMMDevice::GetId() failed");
+			hasher.Add(std::wstring_view(id));
+			::CoTaskMemFree(id);
+		}
+
+	}
+
+	uint64_t GetDeviceTopologyFingerprint() {
+		CComPtr<IMMDeviceEnumerator> enumerator;
+		CheckHResult(enumerator.CoCreateInstance(__uuidof(MMDeviceEnumerator)), "Unable to create MMDeviceEnumerator");
+
+		Hasher hasher;
+
+		CComPtr<IMMDeviceCollection> devices;
+		CheckHResult(enumerator->EnumAudioEndpoints(eAll, DEVICE_STATEMASK_ALL, &devices), "IMMDeviceEnumerator::EnumAudioEndpoints() failed");
+		UINT deviceCount = 0;
+		CheckHResult(devices->GetCount(&deviceCount), "IMMDeviceCollection::GetCount() failed");
+		hasher.Add(deviceCount);
+		for (UINT deviceIndex = 0; deviceIndex < deviceCount; ++deviceIndex) {
+			CComPtr<IMMDevice> device;
+			CheckHResult(devices->Item(deviceIndex, &device), "IMMDeviceCollection::Item() failed");
+			AddDeviceId(hasher, device);
+			DWORD state = 0;
+			CheckHResult(device->GetState(&state), "IMMDevice::GetState() failed");
+			hasher.Add(state);
+		}
+
+		for (const auto dataFlow : { eRender, eCapture })
+			for (const auto role : { eConsole, eMultimedia, eCommunications }) {
+				CComPtr<IMMDevice> device;
+				const auto result = enumerator->GetDefaultAudioEndpoint(dataFlow, role, &device);
+				if (result == HRESULT_FROM_WIN32(ERROR_NOT_FOUND)) {
+					hasher.Add(std::wstring_view());
+					continue;
+				}
+				CheckHResult(result, "IMMDeviceEnumerator::GetDefaultAudioEndpoint() failed");
+				AddDeviceId(hasher, device);
+			}
+
+		return hasher.Get();
+	}
+
+}
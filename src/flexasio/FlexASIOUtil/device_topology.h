@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace flexasio {
+
+	// Returns a hash of the set of audio endpoints (including their state) and of the default endpoints. It changes whenever a
+	// device is added, removed, enabled, disabled or made default, which are the events that invalidate a PortAudio device
+	// enumeration, but is much cheaper to compute than the enumeration itself.
+	// COM must be initialized on the calling thread.
+	uint64_t GetDeviceTopologyFingerprint();
+
+}
@@ -0,0 +1,84 @@
+#include "gain.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_GAIN_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		// The gain of sample N is startGain + step * (N + 1), so that the last sample gets `endGain`, give or take rounding. Vector
+		// kernels compute it the exact same way, multiplying and adding separately (i.e. no FMA), so that results are identical.
+		float GetStep(size_t sampleCount, float startGain, float endGain) {
+			return sampleCount == 0 ? 0.0f : (endGain - startGain) / float(sampleCount);
+		}
+
+		void RampScalar(float* samples, size_t firstSampleIndex, size_t sampleCount, float startGain, float step) {
+			for (size_t sampleIndex = firstSampleIndex; sampleIndex < sampleCount; ++sampleIndex)
+				samples[sampleIndex] *= startGain + step * float(sampleIndex + 1);
+		}
+
+		void GainRampScalar(float* samples, size_t sampleCount, float startGain, float endGain) {
+			RampScalar(samples, 0, sampleCount, startGain, GetStep(sampleCount, startGain, endGain));
+		}
+
+#ifdef FLEXASIO_GAIN_X86
+
+		void GainRampSse2(float* samples, size_t sampleCount, float startGain, float endGain) {
+			const auto step = GetStep(sampleCount, startGain, endGain);
+			const auto startVector = _mm_set1_ps(startGain);
+			const auto stepVector = _mm_set1_ps(step);
+			const auto laneCountVector = _mm_set1_ps(4.0f);
+			// Sample indices are small enough to be represented exactly, so incrementing them does not accumulate errors.
+			auto positionVector = _mm_setr_ps(1.0f, 2.0f, 3.0f, 4.0f);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4) {
+				const auto gainVector = _mm_add_ps(startVector, _mm_mul_ps(stepVector, positionVector));
+				_mm_storeu_ps(samples + sampleIndex, _mm_mul_ps(_mm_loadu_ps(samples + sampleIndex), gainVector));
+				positionVector = _mm_add_ps(positionVector, laneCountVector);
+			}
+			RampScalar(samples, sampleIndex, sampleCount, startGain, step);
+		}
+
+		void GainRampAvx2(float* samples, size_t sampleCount, float startGain, float endGain) {
+			const auto step = GetStep(sampleCount, startGain, endGain);
+			const auto startVector = _mm256_set1_ps(startGain);
+			const auto stepVector = _mm256_set1_ps(step);
+			const auto laneCountVector = _mm256_set1_ps(8.0f);
+			auto positionVector = _mm256_setr_ps(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto gainVector = _mm256_add_ps(startVector, _mm256_mul_ps(stepVector, positionVector));
+				_mm256_storeu_ps(samples + sampleIndex, _mm256_mul_ps(_mm256_loadu_ps(samples + sampleIndex), gainVector));
+				positionVector = _mm256_add_ps(positionVector, laneCountVector);
+			}
+			_mm256_zeroupper();
+			RampScalar(samples, sampleIndex, sampleCount, startGain, step);
+		}
+
+#endif
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			GainRamp::Kernel kernel;
+		};
+
+		KernelSelection SelectKernel([[maybe_unused]] SimdImplementation requestedImplementation) {
+#ifdef FLEXASIO_GAIN_X86
+			if (requestedImplementation >= SimdImplementation::AVX2) return { SimdImplementation::AVX2, &GainRampAvx2 };
+			if (requestedImplementation >= SimdImplementation::SSE2) return { SimdImplementation::SSE2, &GainRampSse2 };
+#endif
+			return { SimdImplementation::SCALAR, &GainRampScalar };
+		}
+
+	}
+
+	GainRamp::GainRamp(SimdImplementation requestedImplementation) {
+		const auto selection = SelectKernel(requestedImplementation);
+		implementation = selection.implementation;
+		kernel = selection.kernel;
+	}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+
+namespace flexasio {
+
+	// The gain of a channel over the course of a buffer, going linearly from `startGain` to `endGain`.
+	struct GainChange final {
+		float startGain = 1.0f;
+		float endGain = 1.0f;
+
+		bool IsUnity() const { return startGain == 1.0f && endGain == 1.0f; }
+	};
+
+	// Applies a gain to 32-bit float samples in place, going linearly from `startGain` to `endGain` over the course of the buffer, so
+	// that gain changes do not cause audible discontinuities. The result does not depend on the implementation. Real-time safe.
+	class GainRamp final {
+	public:
+		explicit GainRamp(SimdImplementation implementation = GetBestSimdImplementation());
+
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		void Apply(float* samples, size_t sampleCount, float startGain, float endGain) const { kernel(samples, sampleCount, startGain, endGain); }
+
+		using Kernel = void(*)(float* samples, size_t sampleCount, float startGain, float endGain);
+
+	private:
+		SimdImplementation implementation;
+		Kernel kernel;
+	};
+
+}
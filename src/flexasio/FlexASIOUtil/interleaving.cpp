@@ -0,0 +1,289 @@
+#include "interleaving.h"
+
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_INTERLEAVING_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		struct Kernels final {
+			Interleaver::DeinterleaveKernel deinterleave;
+			Interleaver::InterleaveKernel interleave;
+		};
+
+		// Processes channels [beginChannel, endChannel) and frames [beginFrame, endFrame), one sample at a time. This is also used by
+		// vector kernels for whatever does not fit in whole vectors.
+		template <size_t sampleSize>
+		void DeinterleaveRange(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t beginChannel, size_t endChannel, size_t beginFrame, size_t endFrame) {
+			const auto frameSize = channelCount * sampleSize;
+			for (auto channelIndex = beginChannel; channelIndex < endChannel; ++channelIndex) {
+				const auto input = interleaved + channelIndex * sampleSize;
+				const auto output = channels[channelIndex];
+				for (auto frameIndex = beginFrame; frameIndex < endFrame; ++frameIndex)
+					memcpy(output + frameIndex * sampleSize, input + frameIndex * frameSize, sampleSize);
+			}
+		}
+
+		template <size_t sampleSize>
+		void InterleaveRange(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t beginChannel, size_t endChannel, size_t beginFrame, size_t endFrame) {
+			const auto frameSize = channelCount * sampleSize;
+			for (auto channelIndex = beginChannel; channelIndex < endChannel; ++channelIndex) {
+				const auto input = channels[channelIndex];
+				const auto output = interleaved + channelIndex * sampleSize;
+				for (auto frameIndex = beginFrame; frameIndex < endFrame; ++frameIndex)
+					memcpy(output + frameIndex * frameSize, input + frameIndex * sampleSize, sampleSize);
+			}
+		}
+
+		template <size_t sampleSize>
+		void DeinterleaveScalar(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount) {
+			DeinterleaveRange<sampleSize>(interleaved, channels, channelCount, 0, channelCount, 0, frameCount);
+		}
+
+		template <size_t sampleSize>
+		void InterleaveScalar(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount) {
+			InterleaveRange<sampleSize>(channels, interleaved, channelCount, 0, channelCount, 0, frameCount);
+		}
+
+		template <size_t sampleSize> constexpr Kernels scalarKernels = { &DeinterleaveScalar<sampleSize>, &InterleaveScalar<sampleSize> };
+
+		Kernels SelectScalarKernels(size_t sampleSize) {
+			switch (sampleSize) {
+			case 2: return scalarKernels<2>;
+			case 3: return scalarKernels<3>;
+			case 4: return scalarKernels<4>;
+			case 8: return scalarKernels<8>;
+			}
+			throw std::invalid_argument("unsupported sample size for interleaving: " + std::to_string(sampleSize));
+		}
+
+		// With a single channel, both layouts are the same.
+		template <size_t sampleSize>
+		void DeinterleaveMono(const std::byte* interleaved, std::byte* const* channels, size_t, size_t frameCount) {
+			memcpy(channels[0], interleaved, frameCount * sampleSize);
+		}
+
+		template <size_t sampleSize>
+		void InterleaveMono(const std::byte* const* channels, std::byte* interleaved, size_t, size_t frameCount) {
+			memcpy(interleaved, channels[0], frameCount * sampleSize);
+		}
+
+		template <size_t sampleSize> constexpr Kernels monoKernels = { &DeinterleaveMono<sampleSize>, &InterleaveMono<sampleSize> };
+
+		Kernels SelectMonoKernels(size_t sampleSize) {
+			switch (sampleSize) {
+			case 2: return monoKernels<2>;
+			case 3: return monoKernels<3>;
+			case 4: return monoKernels<4>;
+			case 8: return monoKernels<8>;
+			}
+			throw std::invalid_argument("unsupported sample size for interleaving: " + std::to_string(sampleSize));
+		}
+
+#ifdef FLEXASIO_INTERLEAVING_X86
+
+		// Note: 32-bit integer samples are moved around as floats. This is fine as shuffles do not alter the bits.
+
+		void DeinterleaveStereo32Sse2(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 4 <= frameCount; frameIndex += 4) {
+				const auto input = reinterpret_cast<const float*>(interleaved) + frameIndex * 2;
+				const auto first = _mm_loadu_ps(input);
+				const auto second = _mm_loadu_ps(input + 4);
+				_mm_storeu_ps(reinterpret_cast<float*>(channels[0]) + frameIndex, _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(reinterpret_cast<float*>(channels[1]) + frameIndex, _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+			}
+			DeinterleaveRange<4>(interleaved, channels, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		void InterleaveStereo32Sse2(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 4 <= frameCount; frameIndex += 4) {
+				const auto left = _mm_loadu_ps(reinterpret_cast<const float*>(channels[0]) + frameIndex);
+				const auto right = _mm_loadu_ps(reinterpret_cast<const float*>(channels[1]) + frameIndex);
+				const auto output = reinterpret_cast<float*>(interleaved) + frameIndex * 2;
+				_mm_storeu_ps(output, _mm_unpacklo_ps(left, right));
+				_mm_storeu_ps(output + 4, _mm_unpackhi_ps(left, right));
+			}
+			InterleaveRange<4>(channels, interleaved, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		void DeinterleaveStereo16Sse2(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 8 <= frameCount; frameIndex += 8) {
+				const auto input = interleaved + frameIndex * 4;
+				const auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+				const auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 16));
+				// Each frame is a 32-bit lane. Sign-extend each half of the lane, so that packing does not saturate.
+				const auto left = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(first, 16), 16), _mm_srai_epi32(_mm_slli_epi32(second, 16), 16));
+				const auto right = _mm_packs_epi32(_mm_srai_epi32(first, 16), _mm_srai_epi32(second, 16));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(channels[0] + frameIndex * 2), left);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(channels[1] + frameIndex * 2), right);
+			}
+			DeinterleaveRange<2>(interleaved, channels, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		void InterleaveStereo16Sse2(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 8 <= frameCount; frameIndex += 8) {
+				const auto left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[0] + frameIndex * 2));
+				const auto right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[1] + frameIndex * 2));
+				const auto output = interleaved + frameIndex * 4;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_unpacklo_epi16(left, right));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 16), _mm_unpackhi_epi16(left, right));
+			}
+			InterleaveRange<2>(channels, interleaved, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		// Transposes a 4x4 block of samples. A matrix transpose is its own inverse, so this works in both directions.
+		void Transpose4x4x32(const std::byte* const (&inputRows)[4], std::byte* const (&outputRows)[4]) {
+			auto row0 = _mm_loadu_ps(reinterpret_cast<const float*>(inputRows[0]));
+			auto row1 = _mm_loadu_ps(reinterpret_cast<const float*>(inputRows[1]));
+			auto row2 = _mm_loadu_ps(reinterpret_cast<const float*>(inputRows[2]));
+			auto row3 = _mm_loadu_ps(reinterpret_cast<const float*>(inputRows[3]));
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(reinterpret_cast<float*>(outputRows[0]), row0);
+			_mm_storeu_ps(reinterpret_cast<float*>(outputRows[1]), row1);
+			_mm_storeu_ps(reinterpret_cast<float*>(outputRows[2]), row2);
+			_mm_storeu_ps(reinterpret_cast<float*>(outputRows[3]), row3);
+		}
+
+		void Transpose4x4x16(const std::byte* const (&inputRows)[4], std::byte* const (&outputRows)[4]) {
+			const auto row0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(inputRows[0]));
+			const auto row1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(inputRows[1]));
+			const auto row2 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(inputRows[2]));
+			const auto row3 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(inputRows[3]));
+			const auto rows01 = _mm_unpacklo_epi16(row0, row1);
+			const auto rows23 = _mm_unpacklo_epi16(row2, row3);
+			const auto columns01 = _mm_unpacklo_epi32(rows01, rows23);
+			const auto columns23 = _mm_unpackhi_epi32(rows01, rows23);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(outputRows[0]), columns01);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(outputRows[1]), _mm_srli_si128(columns01, 8));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(outputRows[2]), columns23);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(outputRows[3]), _mm_srli_si128(columns23, 8));
+		}
+
+		// Handles any channel count by transposing blocks of 4 channels by 4 frames. Channels that do not fit in a block (e.g. the
+		// last 2 channels of a 5.1 stream) are handled one sample at a time.
+		template <size_t sampleSize, auto transpose>
+		void DeinterleaveBlocksSse2(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount) {
+			const auto frameSize = channelCount * sampleSize;
+			const auto blockChannelCount = channelCount - channelCount % 4;
+			size_t frameIndex = 0;
+			for (; frameIndex + 4 <= frameCount; frameIndex += 4) {
+				const auto frames = interleaved + frameIndex * frameSize;
+				for (size_t channelIndex = 0; channelIndex < blockChannelCount; channelIndex += 4) {
+					const auto input = frames + channelIndex * sampleSize;
+					const auto output = frameIndex * sampleSize;
+					transpose(
+						{ input, input + frameSize, input + 2 * frameSize, input + 3 * frameSize },
+						{ channels[channelIndex] + output, channels[channelIndex + 1] + output, channels[channelIndex + 2] + output, channels[channelIndex + 3] + output });
+				}
+			}
+			DeinterleaveRange<sampleSize>(interleaved, channels, channelCount, 0, blockChannelCount, frameIndex, frameCount);
+			DeinterleaveRange<sampleSize>(interleaved, channels, channelCount, blockChannelCount, channelCount, 0, frameCount);
+		}
+
+		template <size_t sampleSize, auto transpose>
+		void InterleaveBlocksSse2(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount) {
+			const auto frameSize = channelCount * sampleSize;
+			const auto blockChannelCount = channelCount - channelCount % 4;
+			size_t frameIndex = 0;
+			for (; frameIndex + 4 <= frameCount; frameIndex += 4) {
+				const auto frames = interleaved + frameIndex * frameSize;
+				for (size_t channelIndex = 0; channelIndex < blockChannelCount; channelIndex += 4) {
+					const auto input = frameIndex * sampleSize;
+					const auto output = frames + channelIndex * sampleSize;
+					transpose(
+						{ channels[channelIndex] + input, channels[channelIndex + 1] + input, channels[channelIndex + 2] + input, channels[channelIndex + 3] + input },
+						{ output, output + frameSize, output + 2 * frameSize, output + 3 * frameSize });
+				}
+			}
+			InterleaveRange<sampleSize>(channels, interleaved, channelCount, 0, blockChannelCount, frameIndex, frameCount);
+			InterleaveRange<sampleSize>(channels, interleaved, channelCount, blockChannelCount, channelCount, 0, frameCount);
+		}
+
+		void DeinterleaveStereo32Avx2(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 8 <= frameCount; frameIndex += 8) {
+				const auto input = reinterpret_cast<const float*>(interleaved) + frameIndex * 2;
+				const auto first = _mm256_loadu_ps(input);
+				const auto second = _mm256_loadu_ps(input + 8);
+				// Shuffles work within 128-bit lanes, so the result needs to be put back in order.
+				const auto left = _mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+				const auto right = _mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_pd(reinterpret_cast<double*>(channels[0] + frameIndex * 4), left);
+				_mm256_storeu_pd(reinterpret_cast<double*>(channels[1] + frameIndex * 4), right);
+			}
+			_mm256_zeroupper();
+			DeinterleaveRange<4>(interleaved, channels, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		void InterleaveStereo32Avx2(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount) {
+			size_t frameIndex = 0;
+			for (; frameIndex + 8 <= frameCount; frameIndex += 8) {
+				const auto left = _mm256_loadu_ps(reinterpret_cast<const float*>(channels[0]) + frameIndex);
+				const auto right = _mm256_loadu_ps(reinterpret_cast<const float*>(channels[1]) + frameIndex);
+				const auto low = _mm256_unpacklo_ps(left, right);
+				const auto high = _mm256_unpackhi_ps(left, right);
+				const auto output = reinterpret_cast<float*>(interleaved) + frameIndex * 2;
+				_mm256_storeu_ps(output, _mm256_permute2f128_ps(low, high, 0x20));
+				_mm256_storeu_ps(output + 8, _mm256_permute2f128_ps(low, high, 0x31));
+			}
+			_mm256_zeroupper();
+			InterleaveRange<4>(channels, interleaved, channelCount, 0, channelCount, frameIndex, frameCount);
+		}
+
+		// Returns std::nullopt if there are no vector kernels for this layout.
+		std::optional<Kernels> SelectSse2Kernels(size_t channelCount, size_t sampleSize) {
+			if (channelCount == 2 && sampleSize == 4) return Kernels{ &DeinterleaveStereo32Sse2, &InterleaveStereo32Sse2 };
+			if (channelCount == 2 && sampleSize == 2) return Kernels{ &DeinterleaveStereo16Sse2, &InterleaveStereo16Sse2 };
+			if (channelCount >= 4 && sampleSize == 4) return Kernels{ &DeinterleaveBlocksSse2<4, &Transpose4x4x32>, &InterleaveBlocksSse2<4, &Transpose4x4x32> };
+			if (channelCount >= 4 && sampleSize == 2) return Kernels{ &DeinterleaveBlocksSse2<2, &Transpose4x4x16>, &InterleaveBlocksSse2<2, &Transpose4x4x16> };
+			return std::nullopt;
+		}
+
+		std::optional<Kernels> SelectAvx2Kernels(size_t channelCount, size_t sampleSize) {
+			if (channelCount == 2 && sampleSize == 4) return Kernels{ &DeinterleaveStereo32Avx2, &InterleaveStereo32Avx2 };
+			return std::nullopt;
+		}
+
+#endif
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			Kernels kernels;
+		};
+
+		KernelSelection SelectKernels(size_t channelCount, size_t sampleSize, [[maybe_unused]] SimdImplementation requestedImplementation) {
+			if (channelCount < 1) throw std::invalid_argument("cannot interleave zero channels");
+			if (channelCount == 1) return { SimdImplementation::SCALAR, SelectMonoKernels(sampleSize) };
+
+#ifdef FLEXASIO_INTERLEAVING_X86
+			if (requestedImplementation >= SimdImplementation::AVX2)
+				if (const auto kernels = SelectAvx2Kernels(channelCount, sampleSize); kernels.has_value()) return { SimdImplementation::AVX2, *kernels };
+			if (requestedImplementation >= SimdImplementation::SSE2)
+				if (const auto kernels = SelectSse2Kernels(channelCount, sampleSize); kernels.has_value()) return { SimdImplementation::SSE2, *kernels };
+#endif
+			return { SimdImplementation::SCALAR, SelectScalarKernels(sampleSize) };
+		}
+
+	}
+
+	Interleaver::Interleaver(size_t channelCount, size_t sampleSize, SimdImplementation requestedImplementation) :
+		channelCount(channelCount), sampleSize(sampleSize) {
+		const auto selection = SelectKernels(channelCount, sampleSize, requestedImplementation);
+		implementation = selection.implementation;
+		deinterleave = selection.kernels.deinterleave;
+		interleave = selection.kernels.interleave;
+	}
+
+}
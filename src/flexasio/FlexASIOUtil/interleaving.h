@@ -0,0 +1,36 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+
+namespace flexasio {
+
+	// Converts between interleaved buffers (one frame after the other) and one buffer per channel, for samples of any size.
+	// 16-bit and 32-bit samples are transposed with vector instructions where the CPU allows it; this is most effective for stereo
+	// and for channel counts that are a multiple of 4.
+	class Interleaver final {
+	public:
+		// If the requested implementation has no kernel for this layout, a slower one is used instead.
+		Interleaver(size_t channelCount, size_t sampleSize, SimdImplementation implementation = GetBestSimdImplementation());
+
+		size_t GetChannelCount() const { return channelCount; }
+		size_t GetSampleSize() const { return sampleSize; }
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		// `channels` points to one buffer per channel. Real-time safe.
+		void Deinterleave(const std::byte* interleaved, std::byte* const* channels, size_t frameCount) const { deinterleave(interleaved, channels, channelCount, frameCount); }
+		void Interleave(const std::byte* const* channels, std::byte* interleaved, size_t frameCount) const { interleave(channels, interleaved, channelCount, frameCount); }
+
+		using DeinterleaveKernel = void(*)(const std::byte* interleaved, std::byte* const* channels, size_t channelCount, size_t frameCount);
+		using InterleaveKernel = void(*)(const std::byte* const* channels, std::byte* interleaved, size_t channelCount, size_t frameCount);
+
+	private:
+		const size_t channelCount;
+		const size_t sampleSize;
+		SimdImplementation implementation;
+		DeinterleaveKernel deinterleave;
+		InterleaveKernel interleave;
+	};
+
+}
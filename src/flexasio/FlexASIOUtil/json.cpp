@@ -0,0 +1,112 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace flexasio {
+
+	JsonWriter::~JsonWriter() {
+		if (firstElement.empty()) stream << std::endl;
+	}
+
+	JsonWriter& JsonWriter::BeginObject() { Begin('{'); return *this; }
+	JsonWriter& JsonWriter::EndObject() { End('}'); return *this; }
+	JsonWriter& JsonWriter::BeginArray() { Begin('['); return *this; }
+	JsonWriter& JsonWriter::EndArray() { End(']'); return *this; }
+
+	JsonWriter& JsonWriter::Key(std::string_view key) {
+		BeforeValue();
+		WriteString(key);
+		stream << ": ";
+		afterKey = true;
+		return *this;
+	}
+
+	JsonWriter& JsonWriter::Value(std::string_view value) {
+		BeforeValue();
+		WriteString(value);
+		return *this;
+	}
+
+	JsonWriter& JsonWriter::Value(double value) {
+		// JSON has no representation for NaN or infinities.
+		if (!std::isfinite(value)) return Null();
+		BeforeValue();
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.9g", value);
+		stream << buffer;
+		return *this;
+	}
+
+	JsonWriter& JsonWriter::Value(long long value) {
+		BeforeValue();
+		stream << value;
+		return *this;
+	}
+
+	JsonWriter& JsonWriter::Value(bool value) {
+		BeforeValue();
+		stream << (value ? "true" : "false");
+		return *this;
+	}
+
+	JsonWriter& JsonWriter::Null() {
+		BeforeValue();
+		stream << "null";
+		return *this;
+	}
+
+	void JsonWriter::BeforeValue() {
+		if (afterKey) {
+			afterKey = false;
+			return;
+		}
+		if (firstElement.empty()) return;
+		if (!firstElement.back()) stream << ",";
+		firstElement.back() = false;
+		stream << "\n";
+		Indent();
+	}
+
+	void JsonWriter::Begin(char bracket) {
+		BeforeValue();
+		stream << bracket;
+		firstElement.push_back(true);
+	}
+
+	void JsonWriter::End(char bracket) {
+		const auto empty = firstElement.back();
+		firstElement.pop_back();
+		if (!empty) {
+			stream << "\n";
+			Indent();
+		}
+		stream << bracket;
+	}
+
+	void JsonWriter::Indent() {
+		for (size_t level = 0; level < firstElement.size(); ++level) stream << "  ";
+	}
+
+	void JsonWriter::WriteString(std::string_view str) {
+		stream << '"';
+		for (const auto character : str) {
+			switch (character) {
+			case '"': stream << "\\\""; break;
+			case '\\': stream << "\\\\"; break;
+			case '\n': stream << "\\n"; break;
+			case '\r': stream << "\\r"; break;
+			case '\t': stream << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20) {
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned int>(character));
+					stream << buffer;
+				}
+				else stream << character;
+			}
+		}
+		stream << '"';
+	}
+
+}
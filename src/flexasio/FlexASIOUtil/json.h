@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	// Minimal streaming JSON writer for machine-readable tool output.
+	// The writer does not validate the document structure; callers are expected to balance Begin/End calls
+	// and to call Key() before each value written inside an object.
+	class JsonWriter final {
+	public:
+		explicit JsonWriter(std::ostream& stream) : stream(stream) {}
+		~JsonWriter();
+
+		JsonWriter(const JsonWriter&) = delete;
+		JsonWriter& operator=(const JsonWriter&) = delete;
+
+		JsonWriter& BeginObject();
+		JsonWriter& EndObject();
+		JsonWriter& BeginArray();
+		JsonWriter& EndArray();
+
+		JsonWriter& Key(std::string_view key);
+
+		JsonWriter& Value(std::string_view value);
+		JsonWriter& Value(const char* value) { return Value(std::string_view(value)); }
+		JsonWriter& Value(double value);
+		JsonWriter& Value(long long value);
+		JsonWriter& Value(int value) { return Value((long long)(value)); }
+		JsonWriter& Value(long value) { return Value((long long)(value)); }
+		JsonWriter& Value(unsigned int value) { return Value((long long)(value)); }
+		JsonWriter& Value(unsigned long value) { return Value((long long)(value)); }
+		JsonWriter& Value(unsigned long long value) { return Value((long long)(value)); }
+		JsonWriter& Value(bool value);
+		JsonWriter& Null();
+
+	private:
+		void BeforeValue();
+		void Begin(char bracket);
+		void End(char bracket);
+		void Indent();
+		void WriteString(std::string_view);
+
+		std::ostream& stream;
+		// One entry per open object/array; true if no element has been written into it yet.
+		std::vector<bool> firstElement;
+		bool afterKey = false;
+	};
+
+}
@@ -0,0 +1,80 @@
+#include "loopback.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace flexasio {
+
+	namespace {
+
+		// Feedback taps (1-based bit positions) of a maximal length linear feedback shift register for each order.
+		// Source: Xilinx XAPP052, table 3.
+		std::vector<int> GetMaximumLengthSequenceTaps(int order) {
+			switch (order) {
+			case 3: return { 3, 2 };
+			case 4: return { 4, 3 };
+			case 5: return { 5, 3 };
+			case 6: return { 6, 5 };
+			case 7: return { 7, 6 };
+			case 8: return { 8, 6, 5, 4 };
+			case 9: return { 9, 5 };
+			case 10: return { 10, 7 };
+			case 11: return { 11, 9 };
+			case 12: return { 12, 6, 4, 1 };
+			case 13: return { 13, 4, 3, 1 };
+			case 14: return { 14, 5, 3, 1 };
+			case 15: return { 15, 14 };
+			case 16: return { 16, 15, 13, 4 };
+			case 17: return { 17, 14 };
+			case 18: return { 18, 11 };
+			case 19: return { 19, 6, 2, 1 };
+			case 20: return { 20, 17 };
+			}
+			throw std::invalid_argument("unsupported maximum length sequence order " + std::to_string(order));
+		}
+
+	}
+
+	std::vector<float> GenerateMaximumLengthSequence(int order) {
+		const auto taps = GetMaximumLengthSequenceTaps(order);
+		const auto length = (size_t(1) << order) - 1;
+
+		std::vector<float> sequence;
+		sequence.reserve(length);
+		unsigned long state = 1;
+		for (size_t index = 0; index < length; ++index) {
+			sequence.push_back(state & 1 ? 1.0f : -1.0f);
+			unsigned long feedback = 0;
+			for (const auto tap : taps) feedback ^= state >> (order - tap);
+			state = (state >> 1) | ((feedback & 1) << (order - 1));
+		}
+		return sequence;
+	}
+
+	std::optional<LoopbackDetection> DetectLoopbackStimulus(std::span<const float> recording, std::span<const float> stimulus, double minimumPeakToRms) {
+		if (stimulus.empty() || recording.size() < stimulus.size()) return std::nullopt;
+
+		const auto offsetCount = recording.size() - stimulus.size() + 1;
+		size_t peakOffset = 0;
+		double peak = 0;
+		double sumOfSquares = 0;
+		for (size_t offset = 0; offset < offsetCount; ++offset) {
+			double correlation = 0;
+			for (size_t index = 0; index < stimulus.size(); ++index)
+				correlation += double(stimulus[index]) * recording[offset + index];
+			sumOfSquares += correlation * correlation;
+			if (std::abs(correlation) > std::abs(peak)) {
+				peak = correlation;
+				peakOffset = offset;
+			}
+		}
+
+		const auto rms = std::sqrt(sumOfSquares / offsetCount);
+		if (!(rms > 0)) return std::nullopt;
+		const auto peakToRms = std::abs(peak) / rms;
+		if (peakToRms < minimumPeakToRms) return std::nullopt;
+		return LoopbackDetection{ .offset = peakOffset, .peakToRms = peakToRms, .inverted = peak < 0 };
+	}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace flexasio {
+
+	// Generates a maximum length sequence of length 2^order - 1, with values -1 and +1.
+	// Supported orders are 3 to 20.
+	std::vector<float> GenerateMaximumLengthSequence(int order);
+
+	struct LoopbackDetection final {
+		// Index in the recording at which the stimulus starts.
+		size_t offset;
+		// Peak of the cross-correlation, divided by the RMS of the cross-correlation. Higher values mean a more reliable detection.
+		double peakToRms;
+		// True if the stimulus was found with reversed polarity.
+		bool inverted;
+	};
+
+	// Locates `stimulus` in `recording` by cross-correlation.
+	// Returns nullopt if the correlation peak is not at least `minimumPeakToRms` times the RMS of the correlation,
+	// i.e. if the stimulus cannot be reliably distinguished from noise.
+	//
+	// This is a direct (non-FFT) implementation; complexity is proportional to recording.size() * stimulus.size().
+	std::optional<LoopbackDetection> DetectLoopbackStimulus(std::span<const float> recording, std::span<const float> stimulus, double minimumPeakToRms);
+
+}
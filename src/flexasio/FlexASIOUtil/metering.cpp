@@ -0,0 +1,190 @@
+#include "metering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_METERING_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		template <typename Float> float PeakFloatScalar(const std::byte* samples, size_t sampleCount) {
+			Float peak = 0;
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex) {
+				Float sample;
+				memcpy(&sample, samples + sampleIndex * sizeof(sample), sizeof(sample));
+				peak = (std::max)(peak, std::abs(sample));
+			}
+			return float(peak);
+		}
+
+		// `valueBits` is the number of significant bits, which can be less than the container size (e.g. INT32_LSB24).
+		template <typename Int, int valueBits> float PeakIntScalar(const std::byte* samples, size_t sampleCount) {
+			// Note the use of 64-bit integers, as the absolute value of the most negative sample does not fit in the sample type.
+			int64_t peak = 0;
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex) {
+				Int sample;
+				memcpy(&sample, samples + sampleIndex * sizeof(sample), sizeof(sample));
+				peak = (std::max)(peak, sample < 0 ? -int64_t(sample) : int64_t(sample));
+			}
+			return float(double(peak) / double(int64_t(1) << (valueBits - 1)));
+		}
+
+		float PeakInt24Scalar(const std::byte* samples, size_t sampleCount) {
+			int64_t peak = 0;
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex) {
+				const auto sampleBytes = samples + sampleIndex * 3;
+				// Shifting the 24-bit value into the high bits of a 32-bit integer and back sign-extends it.
+				const auto sample = int32_t(uint32_t(sampleBytes[0]) << 8 | uint32_t(sampleBytes[1]) << 16 | uint32_t(sampleBytes[2]) << 24) >> 8;
+				peak = (std::max)(peak, sample < 0 ? -int64_t(sample) : int64_t(sample));
+			}
+			return float(double(peak) / double(1 << 23));
+		}
+
+		// Integer peaks are tracked as separate maximum and minimum values, which avoids having to deal with the absolute value of the
+		// most negative sample in vector registers.
+		float IntPeakFromRange(int64_t maximum, int64_t minimum, int valueBits) {
+			return float(double((std::max)(maximum, -minimum)) / double(int64_t(1) << (valueBits - 1)));
+		}
+
+#ifdef FLEXASIO_METERING_X86
+
+		float PeakFloat32Sse2(const std::byte* samples, size_t sampleCount) {
+			const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			auto peakVector = _mm_setzero_ps();
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				peakVector = _mm_max_ps(peakVector, _mm_and_ps(_mm_loadu_ps(reinterpret_cast<const float*>(samples) + sampleIndex), absMask));
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, peakVector);
+			return (std::max)({ lanes[0], lanes[1], lanes[2], lanes[3], PeakFloatScalar<float>(samples + sampleIndex * sizeof(float), sampleCount - sampleIndex) });
+		}
+
+		float PeakInt16Sse2(const std::byte* samples, size_t sampleCount) {
+			auto maximumVector = _mm_setzero_si128();
+			auto minimumVector = _mm_setzero_si128();
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto sampleVector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + sampleIndex * sizeof(int16_t)));
+				maximumVector = _mm_max_epi16(maximumVector, sampleVector);
+				minimumVector = _mm_min_epi16(minimumVector, sampleVector);
+			}
+			alignas(16) int16_t maximumLanes[8];
+			alignas(16) int16_t minimumLanes[8];
+			_mm_store_si128(reinterpret_cast<__m128i*>(maximumLanes), maximumVector);
+			_mm_store_si128(reinterpret_cast<__m128i*>(minimumLanes), minimumVector);
+			return (std::max)(
+				IntPeakFromRange(*std::max_element(std::begin(maximumLanes), std::end(maximumLanes)), *std::min_element(std::begin(minimumLanes), std::end(minimumLanes)), 16),
+				PeakIntScalar<int16_t, 16>(samples + sampleIndex * sizeof(int16_t), sampleCount - sampleIndex));
+		}
+
+		float PeakFloat32Avx2(const std::byte* samples, size_t sampleCount) {
+			const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+			auto peakVector = _mm256_setzero_ps();
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8)
+				peakVector = _mm256_max_ps(peakVector, _mm256_and_ps(_mm256_loadu_ps(reinterpret_cast<const float*>(samples) + sampleIndex), absMask));
+			alignas(32) float lanes[8];
+			_mm256_store_ps(lanes, peakVector);
+			_mm256_zeroupper();
+			return (std::max)(*std::max_element(std::begin(lanes), std::end(lanes)), PeakFloatScalar<float>(samples + sampleIndex * sizeof(float), sampleCount - sampleIndex));
+		}
+
+		float PeakInt16Avx2(const std::byte* samples, size_t sampleCount) {
+			auto maximumVector = _mm256_setzero_si256();
+			auto minimumVector = _mm256_setzero_si256();
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 16 <= sampleCount; sampleIndex += 16) {
+				const auto sampleVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + sampleIndex * sizeof(int16_t)));
+				maximumVector = _mm256_max_epi16(maximumVector, sampleVector);
+				minimumVector = _mm256_min_epi16(minimumVector, sampleVector);
+			}
+			alignas(32) int16_t maximumLanes[16];
+			alignas(32) int16_t minimumLanes[16];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(maximumLanes), maximumVector);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(minimumLanes), minimumVector);
+			_mm256_zeroupper();
+			return (std::max)(
+				IntPeakFromRange(*std::max_element(std::begin(maximumLanes), std::end(maximumLanes)), *std::min_element(std::begin(minimumLanes), std::end(minimumLanes)), 16),
+				PeakIntScalar<int16_t, 16>(samples + sampleIndex * sizeof(int16_t), sampleCount - sampleIndex));
+		}
+
+		// SSE2 has no 32-bit integer minimum and maximum instructions, so 32-bit containers are only vectorized with AVX2.
+		template <int valueBits> float PeakInt32Avx2(const std::byte* samples, size_t sampleCount) {
+			auto maximumVector = _mm256_setzero_si256();
+			auto minimumVector = _mm256_setzero_si256();
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto sampleVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + sampleIndex * sizeof(int32_t)));
+				maximumVector = _mm256_max_epi32(maximumVector, sampleVector);
+				minimumVector = _mm256_min_epi32(minimumVector, sampleVector);
+			}
+			alignas(32) int32_t maximumLanes[8];
+			alignas(32) int32_t minimumLanes[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(maximumLanes), maximumVector);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(minimumLanes), minimumVector);
+			_mm256_zeroupper();
+			return (std::max)(
+				IntPeakFromRange(*std::max_element(std::begin(maximumLanes), std::end(maximumLanes)), *std::min_element(std::begin(minimumLanes), std::end(minimumLanes)), valueBits),
+				PeakIntScalar<int32_t, valueBits>(samples + sampleIndex * sizeof(int32_t), sampleCount - sampleIndex));
+		}
+
+#endif
+
+		PeakDetector::Kernel GetScalarKernel(SampleFormat format) {
+			switch (format) {
+			case SampleFormat::INT16: return &PeakIntScalar<int16_t, 16>;
+			case SampleFormat::INT24: return &PeakInt24Scalar;
+			case SampleFormat::INT32: return &PeakIntScalar<int32_t, 32>;
+			case SampleFormat::INT32_LSB16: return &PeakIntScalar<int32_t, 16>;
+			case SampleFormat::INT32_LSB24: return &PeakIntScalar<int32_t, 24>;
+			case SampleFormat::FLOAT32: return &PeakFloatScalar<float>;
+			case SampleFormat::FLOAT64: return &PeakFloatScalar<double>;
+			}
+			throw std::invalid_argument("unknown sample format");
+		}
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			PeakDetector::Kernel kernel;
+		};
+
+		KernelSelection SelectKernel(SampleFormat format, [[maybe_unused]] SimdImplementation requestedImplementation) {
+#ifdef FLEXASIO_METERING_X86
+			if (requestedImplementation >= SimdImplementation::AVX2) {
+				switch (format) {
+				case SampleFormat::INT16: return { SimdImplementation::AVX2, &PeakInt16Avx2 };
+				case SampleFormat::INT32: return { SimdImplementation::AVX2, &PeakInt32Avx2<32> };
+				case SampleFormat::INT32_LSB16: return { SimdImplementation::AVX2, &PeakInt32Avx2<16> };
+				case SampleFormat::INT32_LSB24: return { SimdImplementation::AVX2, &PeakInt32Avx2<24> };
+				case SampleFormat::FLOAT32: return { SimdImplementation::AVX2, &PeakFloat32Avx2 };
+				default: break;
+				}
+			}
+			if (requestedImplementation >= SimdImplementation::SSE2) {
+				switch (format) {
+				case SampleFormat::INT16: return { SimdImplementation::SSE2, &PeakInt16Sse2 };
+				case SampleFormat::FLOAT32: return { SimdImplementation::SSE2, &PeakFloat32Sse2 };
+				default: break;
+				}
+			}
+#endif
+			return { SimdImplementation::SCALAR, GetScalarKernel(format) };
+		}
+
+	}
+
+	PeakDetector::PeakDetector(SampleFormat format, SimdImplementation requestedImplementation) : format(format) {
+		const auto selection = SelectKernel(format, requestedImplementation);
+		implementation = selection.implementation;
+		kernel = selection.kernel;
+	}
+
+}
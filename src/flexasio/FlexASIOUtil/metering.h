@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sample_conversion.h"
+#include "simd.h"
+
+#include <cstddef>
+
+namespace flexasio {
+
+	// Finds the largest absolute sample value in a buffer, relative to full scale, for level metering. Real-time safe.
+	class PeakDetector final {
+	public:
+		// If the requested implementation has no kernel for this format, a slower one is used instead.
+		explicit PeakDetector(SampleFormat format, SimdImplementation implementation = GetBestSimdImplementation());
+
+		SampleFormat GetFormat() const { return format; }
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		// Floating point samples can exceed full scale, in which case the result is larger than 1.
+		float GetPeak(const std::byte* samples, size_t sampleCount) const { return kernel(samples, sampleCount); }
+
+		using Kernel = float(*)(const std::byte* samples, size_t sampleCount);
+
+	private:
+		SampleFormat format;
+		SimdImplementation implementation;
+		Kernel kernel;
+	};
+
+}
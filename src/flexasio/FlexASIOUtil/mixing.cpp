@@ -0,0 +1,196 @@
+#include "mixing.h"
+
+#include <MMReg.h>
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_MIXING_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		struct Kernels final {
+			MixingMatrix::ScaleKernel scale;
+			MixingMatrix::MultiplyAddKernel multiplyAdd;
+		};
+
+		// Note: vector kernels multiply and add separately (i.e. no FMA), so that they produce the exact same results as the scalar
+		// kernels.
+
+		void ScaleScalar(const float* input, float gain, float* output, size_t sampleCount) {
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+				output[sampleIndex] = input[sampleIndex] * gain;
+		}
+
+		void MultiplyAddScalar(const float* input, float gain, float* output, size_t sampleCount) {
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+				output[sampleIndex] += input[sampleIndex] * gain;
+		}
+
+#ifdef FLEXASIO_MIXING_X86
+
+		void ScaleSse2(const float* input, float gain, float* output, size_t sampleCount) {
+			const auto gainVector = _mm_set1_ps(gain);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm_storeu_ps(output + sampleIndex, _mm_mul_ps(_mm_loadu_ps(input + sampleIndex), gainVector));
+			ScaleScalar(input + sampleIndex, gain, output + sampleIndex, sampleCount - sampleIndex);
+		}
+
+		void MultiplyAddSse2(const float* input, float gain, float* output, size_t sampleCount) {
+			const auto gainVector = _mm_set1_ps(gain);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm_storeu_ps(output + sampleIndex, _mm_add_ps(_mm_loadu_ps(output + sampleIndex), _mm_mul_ps(_mm_loadu_ps(input + sampleIndex), gainVector)));
+			MultiplyAddScalar(input + sampleIndex, gain, output + sampleIndex, sampleCount - sampleIndex);
+		}
+
+		void ScaleAvx2(const float* input, float gain, float* output, size_t sampleCount) {
+			const auto gainVector = _mm256_set1_ps(gain);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8)
+				_mm256_storeu_ps(output + sampleIndex, _mm256_mul_ps(_mm256_loadu_ps(input + sampleIndex), gainVector));
+			_mm256_zeroupper();
+			ScaleScalar(input + sampleIndex, gain, output + sampleIndex, sampleCount - sampleIndex);
+		}
+
+		void MultiplyAddAvx2(const float* input, float gain, float* output, size_t sampleCount) {
+			const auto gainVector = _mm256_set1_ps(gain);
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8)
+				_mm256_storeu_ps(output + sampleIndex, _mm256_add_ps(_mm256_loadu_ps(output + sampleIndex), _mm256_mul_ps(_mm256_loadu_ps(input + sampleIndex), gainVector)));
+			_mm256_zeroupper();
+			MultiplyAddScalar(input + sampleIndex, gain, output + sampleIndex, sampleCount - sampleIndex);
+		}
+
+#endif
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			Kernels kernels;
+		};
+
+		KernelSelection SelectKernels([[maybe_unused]] SimdImplementation requestedImplementation) {
+#ifdef FLEXASIO_MIXING_X86
+			if (requestedImplementation >= SimdImplementation::AVX2) return { SimdImplementation::AVX2, { &ScaleAvx2, &MultiplyAddAvx2 } };
+			if (requestedImplementation >= SimdImplementation::SSE2) return { SimdImplementation::SSE2, { &ScaleSse2, &MultiplyAddSse2 } };
+#endif
+			return { SimdImplementation::SCALAR, { &ScaleScalar, &MultiplyAddScalar } };
+		}
+
+		// One of the ways a speaker can be rendered: on all of `speakers`, each with `gain`.
+		struct Fold final {
+			DWORD speakers;
+			float gain;
+		};
+
+		// -3 dB, which preserves power when a signal is split over two speakers.
+		constexpr float halfPower = 0.70710678f;
+
+		// In order of preference. The first fold whose speakers are all present in the output layout is used.
+		std::vector<Fold> GetFolds(DWORD speaker) {
+			switch (speaker) {
+			case SPEAKER_FRONT_LEFT: return { { SPEAKER_FRONT_LEFT, 1.0f }, { SPEAKER_FRONT_CENTER, halfPower } };
+			case SPEAKER_FRONT_RIGHT: return { { SPEAKER_FRONT_RIGHT, 1.0f }, { SPEAKER_FRONT_CENTER, halfPower } };
+			case SPEAKER_FRONT_CENTER: return { { SPEAKER_FRONT_CENTER, 1.0f }, { SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT, halfPower } };
+			case SPEAKER_LOW_FREQUENCY: return { { SPEAKER_LOW_FREQUENCY, 1.0f } };
+			case SPEAKER_BACK_LEFT: return { { SPEAKER_BACK_LEFT, 1.0f }, { SPEAKER_SIDE_LEFT, 1.0f }, { SPEAKER_FRONT_LEFT, halfPower }, { SPEAKER_FRONT_CENTER, 0.5f } };
+			case SPEAKER_BACK_RIGHT: return { { SPEAKER_BACK_RIGHT, 1.0f }, { SPEAKER_SIDE_RIGHT, 1.0f }, { SPEAKER_FRONT_RIGHT, halfPower }, { SPEAKER_FRONT_CENTER, 0.5f } };
+			case SPEAKER_FRONT_LEFT_OF_CENTER: return { { SPEAKER_FRONT_LEFT_OF_CENTER, 1.0f }, { SPEAKER_FRONT_LEFT, 1.0f }, { SPEAKER_FRONT_CENTER, halfPower } };
+			case SPEAKER_FRONT_RIGHT_OF_CENTER: return { { SPEAKER_FRONT_RIGHT_OF_CENTER, 1.0f }, { SPEAKER_FRONT_RIGHT, 1.0f }, { SPEAKER_FRONT_CENTER, halfPower } };
+			case SPEAKER_BACK_CENTER: return {
+				{ SPEAKER_BACK_CENTER, 1.0f }, { SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT, halfPower }, { SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT, halfPower },
+				{ SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT, 0.5f }, { SPEAKER_FRONT_CENTER, 0.5f } };
+			case SPEAKER_SIDE_LEFT: return { { SPEAKER_SIDE_LEFT, 1.0f }, { SPEAKER_BACK_LEFT, 1.0f }, { SPEAKER_FRONT_LEFT, halfPower }, { SPEAKER_FRONT_CENTER, 0.5f } };
+			case SPEAKER_SIDE_RIGHT: return { { SPEAKER_SIDE_RIGHT, 1.0f }, { SPEAKER_BACK_RIGHT, 1.0f }, { SPEAKER_FRONT_RIGHT, halfPower }, { SPEAKER_FRONT_CENTER, 0.5f } };
+			}
+			// Top speakers are only ever rendered as is.
+			return { { speaker, 1.0f } };
+		}
+
+		size_t GetSpeakerChannelIndex(DWORD channelMask, DWORD speaker) {
+			return size_t(std::popcount(channelMask & (speaker - 1)));
+		}
+
+	}
+
+	MixingMatrix::MixingMatrix(MixingGains gains, SimdImplementation requestedImplementation) :
+		gains(std::move(gains)), inputChannelCount(this->gains.empty() ? 0 : this->gains.front().size()) {
+		if (inputChannelCount == 0) throw std::invalid_argument("mixing matrix cannot be empty");
+		rows.reserve(this->gains.size());
+		for (const auto& row : this->gains) {
+			if (row.size() != inputChannelCount)
+				throw std::invalid_argument("mixing matrix rows must all have the same size (expected " + std::to_string(inputChannelCount) + " gains, got " + std::to_string(row.size()) + ")");
+			auto& terms = rows.emplace_back();
+			for (size_t inputChannel = 0; inputChannel < row.size(); ++inputChannel)
+				if (row[inputChannel] != 0.0f) terms.push_back({ .inputChannel = inputChannel, .gain = row[inputChannel] });
+		}
+
+		const auto selection = SelectKernels(requestedImplementation);
+		implementation = selection.implementation;
+		scale = selection.kernels.scale;
+		multiplyAdd = selection.kernels.multiplyAdd;
+	}
+
+	size_t MixingMatrix::GetNonZeroGainCount() const {
+		size_t count = 0;
+		for (const auto& terms : rows) count += terms.size();
+		return count;
+	}
+
+	void MixingMatrix::Mix(const float* const* inputs, float* const* outputs, size_t frameCount) const {
+		for (size_t outputChannel = 0; outputChannel < rows.size(); ++outputChannel) {
+			const auto output = outputs[outputChannel];
+			if (output == nullptr) continue;
+			bool written = false;
+			for (const auto& term : rows[outputChannel]) {
+				const auto input = inputs[term.inputChannel];
+				if (input == nullptr) continue;
+				if (written) multiplyAdd(input, term.gain, output, frameCount);
+				else if (term.gain == 1.0f) memcpy(output, input, frameCount * sizeof(float));
+				else scale(input, term.gain, output, frameCount);
+				written = true;
+			}
+			if (!written) memset(output, 0, frameCount * sizeof(float));
+		}
+	}
+
+	DWORD GetDefaultChannelMask(int channelCount) {
+		switch (channelCount) {
+		case 1: return SPEAKER_FRONT_CENTER;
+		case 2: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
+		case 3: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER;
+		case 4: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT;
+		case 5: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT;
+		case 6: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT;
+		case 8: return SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT | SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT;
+		}
+		return 0;
+	}
+
+	MixingGains GetDefaultMixingGains(DWORD inputChannelMask, DWORD outputChannelMask) {
+		if (inputChannelMask == 0 || outputChannelMask == 0) throw std::invalid_argument("cannot mix without speaker positions");
+		MixingGains gains(size_t(std::popcount(outputChannelMask)), std::vector<float>(size_t(std::popcount(inputChannelMask)), 0.0f));
+		for (DWORD speaker = 1; speaker != 0; speaker <<= 1) {
+			if ((inputChannelMask & speaker) == 0) continue;
+			const auto inputChannel = GetSpeakerChannelIndex(inputChannelMask, speaker);
+			for (const auto& fold : GetFolds(speaker)) {
+				if ((outputChannelMask & fold.speakers) != fold.speakers) continue;
+				for (DWORD outputSpeaker = 1; outputSpeaker != 0; outputSpeaker <<= 1)
+					if ((fold.speakers & outputSpeaker) != 0)
+						gains[GetSpeakerChannelIndex(outputChannelMask, outputSpeaker)][inputChannel] += fold.gain;
+				break;
+			}
+		}
+		return gains;
+	}
+
+}
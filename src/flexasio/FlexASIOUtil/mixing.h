@@ -0,0 +1,59 @@
+#pragma once
+
+#include "simd.h"
+
+#include <windows.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace flexasio {
+
+	// One row per output channel, each containing one gain per input channel.
+	using MixingGains = std::vector<std::vector<float>>;
+
+	// Computes each output channel as a weighted sum of input channels, on 32-bit float samples. Zero gains are skipped, so that
+	// the sparse matrices typical of up- and downmixing only cost as much as their non-zero gains, and an output channel that takes
+	// a single input channel at unity gain is a plain copy.
+	class MixingMatrix final {
+	public:
+		// Throws if the matrix is empty or if rows have different sizes.
+		explicit MixingMatrix(MixingGains gains, SimdImplementation implementation = GetBestSimdImplementation());
+
+		size_t GetInputChannelCount() const { return inputChannelCount; }
+		size_t GetOutputChannelCount() const { return gains.size(); }
+		float GetGain(size_t outputChannel, size_t inputChannel) const { return gains[outputChannel][inputChannel]; }
+		size_t GetNonZeroGainCount() const;
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		// `inputs` and `outputs` point to one buffer per channel. Null input buffers are treated as silence, and null output buffers
+		// are not computed. Output buffers must not overlap input buffers. Real-time safe.
+		void Mix(const float* const* inputs, float* const* outputs, size_t frameCount) const;
+
+		using ScaleKernel = void(*)(const float* input, float gain, float* output, size_t sampleCount);
+		using MultiplyAddKernel = void(*)(const float* input, float gain, float* output, size_t sampleCount);
+
+	private:
+		struct Term final {
+			size_t inputChannel;
+			float gain;
+		};
+
+		MixingGains gains;
+		size_t inputChannelCount;
+		// The non-zero gains of each row.
+		std::vector<std::vector<Term>> rows;
+		SimdImplementation implementation;
+		ScaleKernel scale;
+		MultiplyAddKernel multiplyAdd;
+	};
+
+	// The conventional speaker layout for a given channel count (e.g. 5.1 for 6 channels), or 0 if there is none.
+	DWORD GetDefaultChannelMask(int channelCount);
+
+	// Maps channels laid out according to the `inputChannelMask` speaker positions to channels laid out according to
+	// `outputChannelMask`. Speakers missing from the output are folded into the closest ones, with the customary -3 dB gains;
+	// speakers that have no reasonable counterpart (e.g. LFE when downmixing to stereo) are dropped.
+	MixingGains GetDefaultMixingGains(DWORD inputChannelMask, DWORD outputChannelMask);
+
+}
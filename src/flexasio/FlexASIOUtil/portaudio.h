@@ -8,11 +8,19 @@
 
 #include <functional>
 #include <mutex>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 
 namespace flexasio {
 
+	// Passes through non-negative results (including device and host API indices); throws on PortAudio error codes.
+	template <typename Result>
+	auto ThrowOnPaError(Result result) {
+		if (result >= 0) return result;
+		throw std::runtime_error(std::string("PortAudio error ") + Pa_GetErrorText(result));
+	}
+
 	class PortAudioDebugRedirector final {
 	public:
 		using Write = void(std::string_view);
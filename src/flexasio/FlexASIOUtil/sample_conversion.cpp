@@ -0,0 +1,576 @@
+#include "sample_conversion.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_SAMPLE_CONVERSION_X86
+#include <immintrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+		using Kernel = SampleConverter::Kernel;
+		using DitherState = SampleConverter::DitherState;
+
+		constexpr size_t GetSize(SampleFormat format) {
+			switch (format) {
+			case SampleFormat::INT16: return 2;
+			case SampleFormat::INT24: return 3;
+			case SampleFormat::INT32: return 4;
+			case SampleFormat::INT32_LSB16: return 4;
+			case SampleFormat::INT32_LSB24: return 4;
+			case SampleFormat::FLOAT32: return 4;
+			case SampleFormat::FLOAT64: return 8;
+			}
+			return 0;
+		}
+
+		constexpr bool IsFloat(SampleFormat format) {
+			return format == SampleFormat::FLOAT32 || format == SampleFormat::FLOAT64;
+		}
+
+		template <SampleFormat format> using FloatType = std::conditional_t<format == SampleFormat::FLOAT64, double, float>;
+
+		// Resolution of integer formats, in bits.
+		constexpr int GetBits(SampleFormat format) {
+			if (format == SampleFormat::INT32_LSB16) return 16;
+			if (format == SampleFormat::INT32_LSB24) return 24;
+			return int(GetSize(format) * 8);
+		}
+
+		constexpr float GetFullScale(SampleFormat format) {
+			return float(uint64_t(1) << (GetBits(format) - 1));
+		}
+
+		// The largest value that does not exceed the maximum value of the integer format. In single precision, that is 2^31 - 128
+		// for Int32.
+		template <typename Float = float> constexpr Float GetMaximum(SampleFormat format) {
+			if constexpr (std::is_same_v<Float, float>)
+				if (format == SampleFormat::INT32) return 2147483520.0f;
+			return Float(GetFullScale(format)) - 1;
+		}
+
+		constexpr bool ReducesResolution(SampleFormat input, SampleFormat output) {
+			if (IsFloat(output)) return false;
+			// Float32 has 24 bits of precision, so dithering is pointless when converting it to 32-bit integers.
+			if (input == SampleFormat::FLOAT32) return GetBits(output) < 32;
+			if (input == SampleFormat::FLOAT64) return true;
+			return GetBits(output) < GetBits(input);
+		}
+
+		uint32_t NextRandom(uint32_t& state) {
+			// xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// Triangular probability density noise between -1 and 1.
+		float NextTpdf(DitherState& ditherState) {
+			constexpr auto scale = 1.0f / 16777216.0f;
+			auto& state = ditherState.lanes[0];
+			const auto first = float(NextRandom(state) >> 8) * scale;
+			const auto second = float(NextRandom(state) >> 8) * scale;
+			return first - second;
+		}
+
+		// Integer samples are handled as left-justified 32-bit values, so that conversions between integer formats are exact.
+		template <SampleFormat format> int32_t LoadInteger(const std::byte* sample) {
+			if constexpr (format == SampleFormat::INT16) {
+				int16_t value;
+				memcpy(&value, sample, sizeof(value));
+				return int32_t(uint32_t(uint16_t(value)) << 16);
+			}
+			else if constexpr (format == SampleFormat::INT24) {
+				return int32_t(std::to_integer<uint32_t>(sample[0]) << 8 | std::to_integer<uint32_t>(sample[1]) << 16 | std::to_integer<uint32_t>(sample[2]) << 24);
+			}
+			else {
+				static_assert(format == SampleFormat::INT32 || format == SampleFormat::INT32_LSB16 || format == SampleFormat::INT32_LSB24);
+				int32_t value;
+				memcpy(&value, sample, sizeof(value));
+				// Any bits above the value in the container are discarded, so it does not matter whether the value is sign-extended.
+				return int32_t(uint32_t(value) << (32 - GetBits(format)));
+			}
+		}
+
+		// Least significant bits that do not fit in the format are dropped.
+		template <SampleFormat format> void StoreInteger(std::byte* sample, int32_t value) {
+			const auto bits = uint32_t(value);
+			if constexpr (format == SampleFormat::INT16) {
+				const auto truncated = uint16_t(bits >> 16);
+				memcpy(sample, &truncated, sizeof(truncated));
+			}
+			else if constexpr (format == SampleFormat::INT24) {
+				sample[0] = std::byte(bits >> 8);
+				sample[1] = std::byte(bits >> 16);
+				sample[2] = std::byte(bits >> 24);
+			}
+			else {
+				static_assert(format == SampleFormat::INT32 || format == SampleFormat::INT32_LSB16 || format == SampleFormat::INT32_LSB24);
+				// Sign-extended, as the ASIO SDK expects.
+				const auto shifted = int32_t(value >> (32 - GetBits(format)));
+				memcpy(sample, &shifted, sizeof(shifted));
+			}
+		}
+
+		template <SampleFormat format> FloatType<format> LoadFloat(const std::byte* sample) {
+			FloatType<format> value;
+			memcpy(&value, sample, sizeof(value));
+			return value;
+		}
+
+		template <SampleFormat format> void StoreFloat(std::byte* sample, FloatType<format> value) {
+			memcpy(sample, &value, sizeof(value));
+		}
+
+		template <SampleFormat input, SampleFormat output, bool dither>
+		void ConvertSample(const std::byte* inputSample, std::byte* outputSample, DitherState& ditherState) {
+			if constexpr (IsFloat(input) && IsFloat(output)) {
+				StoreFloat<output>(outputSample, FloatType<output>(LoadFloat<input>(inputSample)));
+			}
+			else if constexpr (IsFloat(output)) {
+				StoreFloat<output>(outputSample, FloatType<output>(LoadInteger<input>(inputSample)) * FloatType<output>(1.0 / 2147483648.0));
+			}
+			else if constexpr (IsFloat(input)) {
+				using Float = FloatType<input>;
+				auto value = LoadFloat<input>(inputSample) * Float(GetFullScale(output));
+				if constexpr (dither) value += Float(NextTpdf(ditherState));
+				value = std::clamp(value, -Float(GetFullScale(output)), GetMaximum<Float>(output));
+				StoreInteger<output>(outputSample, int32_t(uint32_t(std::lrint(value)) << (32 - GetBits(output))));
+			}
+			else if constexpr (GetBits(output) >= GetBits(input)) {
+				StoreInteger<output>(outputSample, LoadInteger<input>(inputSample));
+			}
+			else {
+				// Round to nearest instead of truncating. This needs some headroom.
+				constexpr auto leastSignificantBit = int64_t(1) << (32 - GetBits(output));
+				auto value = int64_t(LoadInteger<input>(inputSample)) + leastSignificantBit / 2;
+				if constexpr (dither) value += int64_t(NextTpdf(ditherState) * float(leastSignificantBit));
+				StoreInteger<output>(outputSample, int32_t(std::clamp<int64_t>(value, (std::numeric_limits<int32_t>::min)(), (std::numeric_limits<int32_t>::max)())));
+			}
+		}
+
+		template <SampleFormat input, SampleFormat output, bool dither>
+		void ConvertScalar(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			if constexpr (input == output) {
+				memcpy(outputSamples, inputSamples, sampleCount * GetSize(input));
+			}
+			else {
+				for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+					ConvertSample<input, output, dither>(inputSamples + sampleIndex * GetSize(input), outputSamples + sampleIndex * GetSize(output), ditherState);
+			}
+		}
+
+		template <SampleFormat input, SampleFormat output> Kernel SelectScalarKernel(bool dither) {
+			if (dither) return &ConvertScalar<input, output, true>;
+			return &ConvertScalar<input, output, false>;
+		}
+
+		template <SampleFormat input> Kernel SelectScalarKernel(SampleFormat output, bool dither) {
+			switch (output) {
+			case SampleFormat::INT16: return SelectScalarKernel<input, SampleFormat::INT16>(dither);
+			case SampleFormat::INT24: return SelectScalarKernel<input, SampleFormat::INT24>(dither);
+			case SampleFormat::INT32: return SelectScalarKernel<input, SampleFormat::INT32>(dither);
+			case SampleFormat::INT32_LSB16: return SelectScalarKernel<input, SampleFormat::INT32_LSB16>(dither);
+			case SampleFormat::INT32_LSB24: return SelectScalarKernel<input, SampleFormat::INT32_LSB24>(dither);
+			case SampleFormat::FLOAT32: return SelectScalarKernel<input, SampleFormat::FLOAT32>(dither);
+			case SampleFormat::FLOAT64: return SelectScalarKernel<input, SampleFormat::FLOAT64>(dither);
+			}
+			throw std::invalid_argument("unsupported output sample format");
+		}
+
+		Kernel SelectScalarKernel(SampleFormat input, SampleFormat output, bool dither) {
+			switch (input) {
+			case SampleFormat::INT16: return SelectScalarKernel<SampleFormat::INT16>(output, dither);
+			case SampleFormat::INT24: return SelectScalarKernel<SampleFormat::INT24>(output, dither);
+			case SampleFormat::INT32: return SelectScalarKernel<SampleFormat::INT32>(output, dither);
+			case SampleFormat::INT32_LSB16: return SelectScalarKernel<SampleFormat::INT32_LSB16>(output, dither);
+			case SampleFormat::INT32_LSB24: return SelectScalarKernel<SampleFormat::INT32_LSB24>(output, dither);
+			case SampleFormat::FLOAT32: return SelectScalarKernel<SampleFormat::FLOAT32>(output, dither);
+			case SampleFormat::FLOAT64: return SelectScalarKernel<SampleFormat::FLOAT64>(output, dither);
+			}
+			throw std::invalid_argument("unsupported input sample format");
+		}
+
+#ifdef FLEXASIO_SAMPLE_CONVERSION_X86
+
+		// Note: vector kernels hand the remaining samples over to the scalar kernel, so that they can process whole vectors only.
+
+		// Uniform noise between 0 and 1, one xorshift32 generator per lane.
+		__m128 NextUniformSse2(__m128i& state) {
+			state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+			state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+			state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+			// Use the random bits as the mantissa of a float between 1 and 2.
+			return _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), _mm_set1_epi32(0x3F800000))), _mm_set1_ps(1.0f));
+		}
+
+		__m128 NextTpdfSse2(__m128i& state) {
+			const auto first = NextUniformSse2(state);
+			return _mm_sub_ps(first, NextUniformSse2(state));
+		}
+
+		template <bool dither>
+		void ConvertFloat32ToInt16Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm_set1_ps(GetFullScale(SampleFormat::INT16));
+			const auto minimum = _mm_set1_ps(-GetFullScale(SampleFormat::INT16));
+			const auto maximum = _mm_set1_ps(GetMaximum(SampleFormat::INT16));
+			auto random = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ditherState.lanes.data()));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto input = reinterpret_cast<const float*>(inputSamples) + sampleIndex;
+				auto low = _mm_mul_ps(_mm_loadu_ps(input), scale);
+				auto high = _mm_mul_ps(_mm_loadu_ps(input + 4), scale);
+				if constexpr (dither) {
+					low = _mm_add_ps(low, NextTpdfSse2(random));
+					high = _mm_add_ps(high, NextTpdfSse2(random));
+				}
+				// Out of range values would not survive the conversion to 32-bit integers.
+				low = _mm_min_ps(_mm_max_ps(low, minimum), maximum);
+				high = _mm_min_ps(_mm_max_ps(high, minimum), maximum);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outputSamples + sampleIndex * 2), _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ditherState.lanes.data()), random);
+			ConvertScalar<SampleFormat::FLOAT32, SampleFormat::INT16, dither>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 2, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertInt16ToFloat32Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm_set1_ps(1.0f / GetFullScale(SampleFormat::INT16));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputSamples + sampleIndex * 2));
+				// Sign extension, the SSE2 way.
+				const auto low = _mm_srai_epi32(_mm_unpacklo_epi16(input, input), 16);
+				const auto high = _mm_srai_epi32(_mm_unpackhi_epi16(input, input), 16);
+				const auto output = reinterpret_cast<float*>(outputSamples) + sampleIndex;
+				_mm_storeu_ps(output, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+				_mm_storeu_ps(output + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+			}
+			ConvertScalar<SampleFormat::INT16, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 2, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		// For right-justified formats, converting to integers at the scale of the format directly results in the sign-extended value.
+		template <SampleFormat output, bool dither>
+		void ConvertFloat32ToInt32ContainerSse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm_set1_ps(GetFullScale(output));
+			const auto minimum = _mm_set1_ps(-GetFullScale(output));
+			const auto maximum = _mm_set1_ps(GetMaximum(output));
+			[[maybe_unused]] auto random = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ditherState.lanes.data()));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4) {
+				auto input = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(inputSamples) + sampleIndex), scale);
+				if constexpr (dither) input = _mm_add_ps(input, NextTpdfSse2(random));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outputSamples + sampleIndex * 4), _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(input, minimum), maximum)));
+			}
+			if constexpr (dither) _mm_storeu_si128(reinterpret_cast<__m128i*>(ditherState.lanes.data()), random);
+			ConvertScalar<SampleFormat::FLOAT32, output, dither>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		// Bits above the value are shifted out, as they do not have to be a sign extension.
+		template <SampleFormat input> __m128i LoadInt32ContainerSse2(const std::byte* inputSamples) {
+			const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputSamples));
+			if constexpr (input == SampleFormat::INT32) return value;
+			else return _mm_srai_epi32(_mm_slli_epi32(value, 32 - GetBits(input)), 32 - GetBits(input));
+		}
+
+		template <SampleFormat input>
+		void ConvertInt32ContainerToFloat32Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm_set1_ps(1.0f / GetFullScale(input));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm_storeu_ps(reinterpret_cast<float*>(outputSamples) + sampleIndex, _mm_mul_ps(_mm_cvtepi32_ps(LoadInt32ContainerSse2<input>(inputSamples + sampleIndex * 4)), scale));
+			ConvertScalar<input, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		template <SampleFormat input>
+		void ConvertInt32ContainerToInt32Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outputSamples + sampleIndex * 4), _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputSamples + sampleIndex * 4)), 32 - GetBits(input)));
+			ConvertScalar<input, SampleFormat::INT32, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		// Rounds to nearest, like the scalar kernel.
+		template <SampleFormat output>
+		void ConvertInt32ToInt32ContainerSse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			constexpr auto shift = 32 - GetBits(output);
+			const auto maximum = _mm_set1_epi32(int32_t(GetMaximum(output)));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4) {
+				const auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputSamples + sampleIndex * 4));
+				const auto rounded = _mm_add_epi32(_mm_srai_epi32(input, shift), _mm_srli_epi32(_mm_slli_epi32(input, 32 - shift), 31));
+				// Rounding up the maximum value overflows. The comparison mask is -1 in that case, which brings it back in range.
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(outputSamples + sampleIndex * 4), _mm_add_epi32(rounded, _mm_cmpgt_epi32(rounded, maximum)));
+			}
+			ConvertScalar<SampleFormat::INT32, output, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertFloat32ToFloat64Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4) {
+				const auto input = _mm_loadu_ps(reinterpret_cast<const float*>(inputSamples) + sampleIndex);
+				const auto output = reinterpret_cast<double*>(outputSamples) + sampleIndex;
+				_mm_storeu_pd(output, _mm_cvtps_pd(input));
+				_mm_storeu_pd(output + 2, _mm_cvtps_pd(_mm_movehl_ps(input, input)));
+			}
+			ConvertScalar<SampleFormat::FLOAT32, SampleFormat::FLOAT64, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 8, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertFloat64ToFloat32Sse2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4) {
+				const auto input = reinterpret_cast<const double*>(inputSamples) + sampleIndex;
+				_mm_storeu_ps(reinterpret_cast<float*>(outputSamples) + sampleIndex, _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(input)), _mm_cvtpd_ps(_mm_loadu_pd(input + 2))));
+			}
+			ConvertScalar<SampleFormat::FLOAT64, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 8, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		__m256 NextUniformAvx2(__m256i& state) {
+			state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+			state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+			state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+			return _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_srli_epi32(state, 9), _mm256_set1_epi32(0x3F800000))), _mm256_set1_ps(1.0f));
+		}
+
+		__m256 NextTpdfAvx2(__m256i& state) {
+			const auto first = NextUniformAvx2(state);
+			return _mm256_sub_ps(first, NextUniformAvx2(state));
+		}
+
+		template <bool dither>
+		void ConvertFloat32ToInt16Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm256_set1_ps(GetFullScale(SampleFormat::INT16));
+			const auto minimum = _mm256_set1_ps(-GetFullScale(SampleFormat::INT16));
+			const auto maximum = _mm256_set1_ps(GetMaximum(SampleFormat::INT16));
+			auto random = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ditherState.lanes.data()));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 16 <= sampleCount; sampleIndex += 16) {
+				const auto input = reinterpret_cast<const float*>(inputSamples) + sampleIndex;
+				auto low = _mm256_mul_ps(_mm256_loadu_ps(input), scale);
+				auto high = _mm256_mul_ps(_mm256_loadu_ps(input + 8), scale);
+				if constexpr (dither) {
+					low = _mm256_add_ps(low, NextTpdfAvx2(random));
+					high = _mm256_add_ps(high, NextTpdfAvx2(random));
+				}
+				low = _mm256_min_ps(_mm256_max_ps(low, minimum), maximum);
+				high = _mm256_min_ps(_mm256_max_ps(high, minimum), maximum);
+				// Packing works within 128-bit lanes, so the result needs to be put back in order.
+				const auto packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputSamples + sampleIndex * 2), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(ditherState.lanes.data()), random);
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::FLOAT32, SampleFormat::INT16, dither>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 2, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertInt16ToFloat32Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm256_set1_ps(1.0f / GetFullScale(SampleFormat::INT16));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto input = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(inputSamples + sampleIndex * 2)));
+				_mm256_storeu_ps(reinterpret_cast<float*>(outputSamples) + sampleIndex, _mm256_mul_ps(_mm256_cvtepi32_ps(input), scale));
+			}
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::INT16, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 2, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		template <SampleFormat output, bool dither>
+		void ConvertFloat32ToInt32ContainerAvx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm256_set1_ps(GetFullScale(output));
+			const auto minimum = _mm256_set1_ps(-GetFullScale(output));
+			const auto maximum = _mm256_set1_ps(GetMaximum(output));
+			[[maybe_unused]] auto random = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ditherState.lanes.data()));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				auto input = _mm256_mul_ps(_mm256_loadu_ps(reinterpret_cast<const float*>(inputSamples) + sampleIndex), scale);
+				if constexpr (dither) input = _mm256_add_ps(input, NextTpdfAvx2(random));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputSamples + sampleIndex * 4), _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(input, minimum), maximum)));
+			}
+			if constexpr (dither) _mm256_storeu_si256(reinterpret_cast<__m256i*>(ditherState.lanes.data()), random);
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::FLOAT32, output, dither>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		template <SampleFormat input> __m256i LoadInt32ContainerAvx2(const std::byte* inputSamples) {
+			const auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputSamples));
+			if constexpr (input == SampleFormat::INT32) return value;
+			else return _mm256_srai_epi32(_mm256_slli_epi32(value, 32 - GetBits(input)), 32 - GetBits(input));
+		}
+
+		template <SampleFormat input>
+		void ConvertInt32ContainerToFloat32Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			const auto scale = _mm256_set1_ps(1.0f / GetFullScale(input));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8)
+				_mm256_storeu_ps(reinterpret_cast<float*>(outputSamples) + sampleIndex, _mm256_mul_ps(_mm256_cvtepi32_ps(LoadInt32ContainerAvx2<input>(inputSamples + sampleIndex * 4)), scale));
+			_mm256_zeroupper();
+			ConvertScalar<input, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		template <SampleFormat input>
+		void ConvertInt32ContainerToInt32Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputSamples + sampleIndex * 4), _mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputSamples + sampleIndex * 4)), 32 - GetBits(input)));
+			_mm256_zeroupper();
+			ConvertScalar<input, SampleFormat::INT32, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		template <SampleFormat output>
+		void ConvertInt32ToInt32ContainerAvx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			constexpr auto shift = 32 - GetBits(output);
+			const auto maximum = _mm256_set1_epi32(int32_t(GetMaximum(output)));
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 8 <= sampleCount; sampleIndex += 8) {
+				const auto input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inputSamples + sampleIndex * 4));
+				const auto rounded = _mm256_add_epi32(_mm256_srai_epi32(input, shift), _mm256_srli_epi32(_mm256_slli_epi32(input, 32 - shift), 31));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputSamples + sampleIndex * 4), _mm256_min_epi32(rounded, maximum));
+			}
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::INT32, output, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertFloat32ToFloat64Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm256_storeu_pd(reinterpret_cast<double*>(outputSamples) + sampleIndex, _mm256_cvtps_pd(_mm_loadu_ps(reinterpret_cast<const float*>(inputSamples) + sampleIndex)));
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::FLOAT32, SampleFormat::FLOAT64, false>(inputSamples + sampleIndex * 4, outputSamples + sampleIndex * 8, sampleCount - sampleIndex, ditherState);
+		}
+
+		void ConvertFloat64ToFloat32Avx2(const std::byte* inputSamples, std::byte* outputSamples, size_t sampleCount, DitherState& ditherState) {
+			size_t sampleIndex = 0;
+			for (; sampleIndex + 4 <= sampleCount; sampleIndex += 4)
+				_mm_storeu_ps(reinterpret_cast<float*>(outputSamples) + sampleIndex, _mm256_cvtpd_ps(_mm256_loadu_pd(reinterpret_cast<const double*>(inputSamples) + sampleIndex)));
+			_mm256_zeroupper();
+			ConvertScalar<SampleFormat::FLOAT64, SampleFormat::FLOAT32, false>(inputSamples + sampleIndex * 8, outputSamples + sampleIndex * 4, sampleCount - sampleIndex, ditherState);
+		}
+
+		// Calls `select` with the format as a std::integral_constant, if it is stored in a 32-bit container. Returns nullptr otherwise.
+		template <typename Select> Kernel WithInt32Container(SampleFormat format, Select select) {
+			switch (format) {
+			case SampleFormat::INT32: return select(std::integral_constant<SampleFormat, SampleFormat::INT32>());
+			case SampleFormat::INT32_LSB16: return select(std::integral_constant<SampleFormat, SampleFormat::INT32_LSB16>());
+			case SampleFormat::INT32_LSB24: return select(std::integral_constant<SampleFormat, SampleFormat::INT32_LSB24>());
+			}
+			return nullptr;
+		}
+
+		// Packed 24-bit samples do not lend themselves well to vectorization, and neither do conversions between Float64 and
+		// integers, so only the other formats have vector kernels. Conversions between integer formats are only vectorized where
+		// samples stay in 32-bit containers, as they only need to be shifted.
+		// Returns nullptr if there is no vector kernel for these formats.
+		Kernel SelectSse2Kernel(SampleFormat input, SampleFormat output, bool dither) {
+			if (input == SampleFormat::FLOAT32 && output == SampleFormat::INT16) return dither ? &ConvertFloat32ToInt16Sse2<true> : &ConvertFloat32ToInt16Sse2<false>;
+			if (input == SampleFormat::INT16 && output == SampleFormat::FLOAT32) return &ConvertInt16ToFloat32Sse2;
+			if (input == SampleFormat::FLOAT32 && output == SampleFormat::FLOAT64) return &ConvertFloat32ToFloat64Sse2;
+			if (input == SampleFormat::FLOAT64 && output == SampleFormat::FLOAT32) return &ConvertFloat64ToFloat32Sse2;
+			if (input == SampleFormat::FLOAT32) return WithInt32Container(output, [&](auto format) -> Kernel {
+				return dither ? &ConvertFloat32ToInt32ContainerSse2<decltype(format)::value, true> : &ConvertFloat32ToInt32ContainerSse2<decltype(format)::value, false>;
+			});
+			if (output == SampleFormat::FLOAT32) return WithInt32Container(input, [](auto format) -> Kernel { return &ConvertInt32ContainerToFloat32Sse2<decltype(format)::value>; });
+			if (output == SampleFormat::INT32) return WithInt32Container(input, [](auto format) -> Kernel { return &ConvertInt32ContainerToInt32Sse2<decltype(format)::value>; });
+			if (input == SampleFormat::INT32 && !dither) return WithInt32Container(output, [](auto format) -> Kernel { return &ConvertInt32ToInt32ContainerSse2<decltype(format)::value>; });
+			return nullptr;
+		}
+
+		Kernel SelectAvx2Kernel(SampleFormat input, SampleFormat output, bool dither) {
+			if (input == SampleFormat::FLOAT32 && output == SampleFormat::INT16) return dither ? &ConvertFloat32ToInt16Avx2<true> : &ConvertFloat32ToInt16Avx2<false>;
+			if (input == SampleFormat::INT16 && output == SampleFormat::FLOAT32) return &ConvertInt16ToFloat32Avx2;
+			if (input == SampleFormat::FLOAT32 && output == SampleFormat::FLOAT64) return &ConvertFloat32ToFloat64Avx2;
+			if (input == SampleFormat::FLOAT64 && output == SampleFormat::FLOAT32) return &ConvertFloat64ToFloat32Avx2;
+			if (input == SampleFormat::FLOAT32) return WithInt32Container(output, [&](auto format) -> Kernel {
+				return dither ? &ConvertFloat32ToInt32ContainerAvx2<decltype(format)::value, true> : &ConvertFloat32ToInt32ContainerAvx2<decltype(format)::value, false>;
+			});
+			if (output == SampleFormat::FLOAT32) return WithInt32Container(input, [](auto format) -> Kernel { return &ConvertInt32ContainerToFloat32Avx2<decltype(format)::value>; });
+			if (output == SampleFormat::INT32) return WithInt32Container(input, [](auto format) -> Kernel { return &ConvertInt32ContainerToInt32Avx2<decltype(format)::value>; });
+			if (input == SampleFormat::INT32 && !dither) return WithInt32Container(output, [](auto format) -> Kernel { return &ConvertInt32ToInt32ContainerAvx2<decltype(format)::value>; });
+			return nullptr;
+		}
+
+#endif
+
+		struct KernelSelection final {
+			SimdImplementation implementation;
+			Kernel kernel;
+		};
+
+		KernelSelection SelectKernel(SampleFormat input, SampleFormat output, bool dither, [[maybe_unused]] SimdImplementation requestedImplementation) {
+#ifdef FLEXASIO_SAMPLE_CONVERSION_X86
+			if (requestedImplementation >= SimdImplementation::AVX2)
+				if (const auto avx2Kernel = SelectAvx2Kernel(input, output, dither); avx2Kernel != nullptr) return { SimdImplementation::AVX2, avx2Kernel };
+			if (requestedImplementation >= SimdImplementation::SSE2)
+				if (const auto sse2Kernel = SelectSse2Kernel(input, output, dither); sse2Kernel != nullptr) return { SimdImplementation::SSE2, sse2Kernel };
+#endif
+			return { SimdImplementation::SCALAR, SelectScalarKernel(input, output, dither) };
+		}
+
+	}
+
+	size_t GetSampleFormatSize(SampleFormat format) {
+		return GetSize(format);
+	}
+
+	std::string_view GetSampleFormatName(SampleFormat format) {
+		switch (format) {
+		case SampleFormat::INT16: return "Int16";
+		case SampleFormat::INT24: return "Int24";
+		case SampleFormat::INT32: return "Int32";
+		case SampleFormat::INT32_LSB16: return "Int32LSB16";
+		case SampleFormat::INT32_LSB24: return "Int32LSB24";
+		case SampleFormat::FLOAT32: return "Float32";
+		case SampleFormat::FLOAT64: return "Float64";
+		}
+		return "(unknown)";
+	}
+
+	SampleConverter::SampleConverter(SampleFormat inputFormat, SampleFormat outputFormat, bool dither, SimdImplementation requestedImplementation) :
+		inputFormat(inputFormat), outputFormat(outputFormat),
+		dithering(dither && ReducesResolution(inputFormat, outputFormat)),
+		implementation(SimdImplementation::SCALAR),
+		kernel(SelectScalarKernel(inputFormat, outputFormat, dithering)),
+		toFloatKernel(SelectKernel(inputFormat, SampleFormat::FLOAT32, /*dither=*/false, requestedImplementation).kernel),
+		// Once a gain is applied, samples have more resolution than the input format, so they are dithered if the output has less.
+		fromFloatKernel(SelectKernel(SampleFormat::FLOAT32, outputFormat, dither && ReducesResolution(SampleFormat::FLOAT32, outputFormat), requestedImplementation).kernel),
+		gainRamp(requestedImplementation) {
+		// Any odd multiplier results in distinct, non-zero seeds.
+		for (size_t laneIndex = 0; laneIndex < ditherState.lanes.size(); ++laneIndex)
+			ditherState.lanes[laneIndex] = uint32_t(0x9E3779B9u * (laneIndex + 1));
+
+		// Nothing beats memcpy() for identity conversions.
+		if (IsIdentity()) return;
+
+		const auto selection = SelectKernel(inputFormat, outputFormat, dithering, requestedImplementation);
+		implementation = selection.implementation;
+		kernel = selection.kernel;
+	}
+
+	void SampleConverter::Convert(const std::byte* input, std::byte* output, size_t sampleCount, float startGain, float endGain) {
+		if (inputFormat == SampleFormat::FLOAT32 && outputFormat == SampleFormat::FLOAT32) {
+			if (output != input) memcpy(output, input, sampleCount * GetSize(SampleFormat::FLOAT32));
+			gainRamp.Apply(reinterpret_cast<float*>(output), sampleCount, startGain, endGain);
+			return;
+		}
+
+		// Small enough to stay in L1 cache between the three steps.
+		alignas(32) std::array<float, 256> chunk;
+		const auto step = sampleCount == 0 ? 0.0f : (endGain - startGain) / float(sampleCount);
+		for (size_t sampleIndex = 0; sampleIndex < sampleCount; sampleIndex += chunk.size()) {
+			const auto chunkSampleCount = (std::min)(chunk.size(), sampleCount - sampleIndex);
+			const auto chunkBytes = reinterpret_cast<std::byte*>(chunk.data());
+			toFloatKernel(input + sampleIndex * GetSize(inputFormat), chunkBytes, chunkSampleCount, ditherState);
+			gainRamp.Apply(chunk.data(), chunkSampleCount, startGain + step * float(sampleIndex), startGain + step * float(sampleIndex + chunkSampleCount));
+			fromFloatKernel(chunkBytes, output + sampleIndex * GetSize(outputFormat), chunkSampleCount, ditherState);
+		}
+	}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gain.h"
+#include "simd.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace flexasio {
+
+	// Little-endian sample formats. Integer formats use the full range of the type, i.e. 1.0 maps to 2^(N-1). INT32_LSB16 and
+	// INT32_LSB24 hold 16-bit and 24-bit values, respectively, in the least significant bits of a 32-bit container.
+	enum class SampleFormat { INT16, INT24, INT32, INT32_LSB16, INT32_LSB24, FLOAT32, FLOAT64 };
+
+	size_t GetSampleFormatSize(SampleFormat);
+	std::string_view GetSampleFormatName(SampleFormat);
+
+	// Converts buffers of samples from one format to another. Out of range floating point samples are clipped.
+	// Conversions are real-time safe, and are vectorized where the CPU allows it.
+	class SampleConverter final {
+	public:
+		// If `dither` is true, TPDF dither is applied when converting to a format with less resolution.
+		// If the requested implementation has no kernel for these formats, a slower one is used instead.
+		SampleConverter(SampleFormat inputFormat, SampleFormat outputFormat, bool dither, SimdImplementation implementation = GetBestSimdImplementation());
+
+		SampleFormat GetInputFormat() const { return inputFormat; }
+		SampleFormat GetOutputFormat() const { return outputFormat; }
+		bool IsIdentity() const { return inputFormat == outputFormat; }
+		bool IsDithering() const { return dithering; }
+		SimdImplementation GetImplementation() const { return implementation; }
+
+		// Not thread-safe, as dither is stateful.
+		void Convert(const std::byte* input, std::byte* output, size_t sampleCount) { kernel(input, output, sampleCount, ditherState); }
+		// Also applies a gain going linearly from `startGain` to `endGain` over the course of the buffer, like GainRamp does. Samples
+		// go through 32-bit float a few at a time, so that they still only go through the cache once. `input` and `output` must not
+		// overlap, except for identity conversions, which can be done in place.
+		void Convert(const std::byte* input, std::byte* output, size_t sampleCount, float startGain, float endGain);
+
+		// State of the pseudo-random generator used for dither, one per vector lane.
+		struct DitherState final {
+			alignas(32) std::array<uint32_t, 8> lanes;
+		};
+		using Kernel = void(*)(const std::byte* input, std::byte* output, size_t sampleCount, DitherState&);
+
+	private:
+		const SampleFormat inputFormat;
+		const SampleFormat outputFormat;
+		bool dithering;
+		SimdImplementation implementation;
+		Kernel kernel;
+		// From the input format to 32-bit float, and back to the output format, for conversions that apply a gain.
+		Kernel toFloatKernel;
+		Kernel fromFloatKernel;
+		GainRamp gainRamp;
+		DitherState ditherState;
+	};
+
+}
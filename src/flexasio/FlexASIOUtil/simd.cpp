@@ -0,0 +1,58 @@
+#include "simd.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define FLEXASIO_SIMD_X86
+#include <intrin.h>
+#endif
+
+namespace flexasio {
+
+	namespace {
+
+#ifdef FLEXASIO_SIMD_X86
+		SimdImplementation DetectBestSimdImplementation() {
+			int info[4];
+			__cpuid(info, 0);
+			const auto maxLeaf = info[0];
+			__cpuid(info, 1);
+			const auto sse2 = (info[3] & (1 << 26)) != 0;
+			const auto osxsave = (info[2] & (1 << 27)) != 0;
+			const auto avx = (info[2] & (1 << 28)) != 0;
+			// AVX2 also requires the OS to preserve the upper halves of the YMM registers.
+			if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+				__cpuidex(info, 7, 0);
+				if ((info[1] & (1 << 5)) != 0) return SimdImplementation::AVX2;
+			}
+			if (sse2) return SimdImplementation::SSE2;
+			return SimdImplementation::SCALAR;
+		}
+#endif
+
+	}
+
+	std::string_view GetSimdImplementationName(SimdImplementation implementation) {
+		switch (implementation) {
+		case SimdImplementation::SCALAR: return "scalar";
+		case SimdImplementation::SSE2: return "SSE2";
+		case SimdImplementation::AVX2: return "AVX2";
+		}
+		return "(unknown)";
+	}
+
+	SimdImplementation GetBestSimdImplementation() {
+#ifdef FLEXASIO_SIMD_X86
+		static const auto bestImplementation = DetectBestSimdImplementation();
+		return bestImplementation;
+#else
+		return SimdImplementation::SCALAR;
+#endif
+	}
+
+	std::vector<SimdImplementation> GetSupportedSimdImplementations() {
+		std::vector<SimdImplementation> implementations;
+		for (auto implementation = SimdImplementation::SCALAR; implementation <= GetBestSimdImplementation(); implementation = SimdImplementation(int(implementation) + 1))
+			implementations.push_back(implementation);
+		return implementations;
+	}
+
+}
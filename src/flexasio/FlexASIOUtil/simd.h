@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	// Instruction sets that vectorized code can be written for, from least to most capable.
+	enum class SimdImplementation { SCALAR, SSE2, AVX2 };
+
+	std::string_view GetSimdImplementationName(SimdImplementation);
+
+	// The most capable implementation the CPU (and OS) supports.
+	SimdImplementation GetBestSimdImplementation();
+	// Every implementation the CPU supports, in increasing order.
+	std::vector<SimdImplementation> GetSupportedSimdImplementations();
+
+}
@@ -0,0 +1,54 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace flexasio {
+
+	namespace {
+
+		// Nearest-rank percentile on sorted samples.
+		double Percentile(std::span<const double> sortedSamples, double percentile) {
+			const auto rank = size_t(std::ceil(percentile / 100 * sortedSamples.size()));
+			return sortedSamples[(std::min)((std::max<size_t>)(rank, 1), sortedSamples.size()) - 1];
+		}
+
+	}
+
+	Distribution ComputeDistribution(std::span<double> samples) {
+		Distribution distribution;
+		distribution.count = samples.size();
+		if (samples.empty()) return distribution;
+
+		std::sort(samples.begin(), samples.end());
+		distribution.minimum = samples.front();
+		distribution.maximum = samples.back();
+		distribution.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		double sumOfSquaredDeviations = 0;
+		for (const auto sample : samples) sumOfSquaredDeviations += (sample - distribution.mean) * (sample - distribution.mean);
+		distribution.standardDeviation = std::sqrt(sumOfSquaredDeviations / samples.size());
+		distribution.p50 = Percentile(samples, 50);
+		distribution.p90 = Percentile(samples, 90);
+		distribution.p99 = Percentile(samples, 99);
+		distribution.p999 = Percentile(samples, 99.9);
+		return distribution;
+	}
+
+	void WriteDistribution(JsonWriter& writer, const Distribution& distribution) {
+		writer.BeginObject();
+		writer.Key("count").Value(distribution.count);
+		if (distribution.count > 0) {
+			writer.Key("min").Value(distribution.minimum);
+			writer.Key("max").Value(distribution.maximum);
+			writer.Key("mean").Value(distribution.mean);
+			writer.Key("stddev").Value(distribution.standardDeviation);
+			writer.Key("p50").Value(distribution.p50);
+			writer.Key("p90").Value(distribution.p90);
+			writer.Key("p99").Value(distribution.p99);
+			writer.Key("p99.9").Value(distribution.p999);
+		}
+		writer.EndObject();
+	}
+
+}
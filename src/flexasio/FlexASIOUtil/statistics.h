@@ -0,0 +1,28 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstddef>
+#include <span>
+
+namespace flexasio {
+
+	struct Distribution final {
+		size_t count = 0;
+		double minimum = 0;
+		double maximum = 0;
+		double mean = 0;
+		double standardDeviation = 0;
+		double p50 = 0;
+		double p90 = 0;
+		double p99 = 0;
+		double p999 = 0;
+	};
+
+	// Note: reorders the samples in place.
+	Distribution ComputeDistribution(std::span<double> samples);
+
+	// Writes the distribution as a JSON object value (the caller is responsible for writing the key, if any).
+	void WriteDistribution(JsonWriter&, const Distribution&);
+
+}
@@ -0,0 +1,29 @@
+#include "toml.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace flexasio {
+
+	std::string EscapeTomlString(std::string_view str) {
+		std::stringstream result;
+		result << "\"";
+		for (const auto character : str) {
+			switch (character) {
+			case '"': result << "\\\""; break;
+			case '\\': result << "\\\\"; break;
+			case '\n': result << "\\n"; break;
+			case '\r': result << "\\r"; break;
+			case '\t': result << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20)
+					result << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(character) << std::dec;
+				else
+					result << character;
+			}
+		}
+		result << "\"";
+		return result.str();
+	}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace flexasio {
+
+	// Returns `str` as a quoted TOML basic string, for code that writes TOML files by hand.
+	std::string EscapeTomlString(std::string_view str);
+
+}
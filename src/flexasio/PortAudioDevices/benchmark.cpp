@@ -0,0 +1,378 @@
+#include "benchmark.h"
+
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/portaudio.h"
+#include "../FlexASIOUtil/statistics.h"
+
+#include <portaudio.h>
+#include <pa_win_wasapi.h>
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		using Clock = std::chrono::steady_clock;
+
+		// Callbacks that arrive before the stream has settled are not representative of steady state behaviour.
+		constexpr size_t warmupCallbackCount = 8;
+		// An interval longer than this many nominal periods is counted as a late callback.
+		constexpr double lateCallbackThreshold = 1.5;
+
+		enum class Mode { INPUT, OUTPUT, DUPLEX };
+
+		struct Options final {
+			std::optional<std::string> backend;
+			std::optional<std::string> inputDevice;
+			std::optional<std::string> outputDevice;
+			Mode mode = Mode::OUTPUT;
+			std::vector<long> bufferSizes = { 64, 128, 256, 512 };
+			std::vector<PaSampleFormat> sampleFormats = { paFloat32 };
+			std::optional<double> sampleRate;
+			int channels = 2;
+			std::optional<double> suggestedLatencySeconds;
+			bool wasapiExclusive = false;
+			double durationSeconds = 3;
+		};
+
+		std::string_view GetModeString(Mode mode) {
+			switch (mode) {
+			case Mode::INPUT: return "input";
+			case Mode::OUTPUT: return "output";
+			case Mode::DUPLEX: return "duplex";
+			}
+			return "unknown";
+		}
+
+		Mode ParseMode(const std::string& value) {
+			if (value == "input") return Mode::INPUT;
+			if (value == "output") return Mode::OUTPUT;
+			if (value == "duplex") return Mode::DUPLEX;
+			throw std::runtime_error("invalid value for --mode: '" + value + "' (expected input, output or duplex)");
+		}
+
+		std::vector<PaSampleFormat> ParseSampleFormats(const std::vector<std::string>& names) {
+			static const std::map<std::string, PaSampleFormat> sampleFormats = {
+				{"Float32", paFloat32},
+				{"Int32", paInt32},
+				{"Int24", paInt24},
+				{"Int16", paInt16},
+			};
+			std::vector<PaSampleFormat> result;
+			for (const auto& name : names) {
+				const auto sampleFormat = sampleFormats.find(name);
+				if (sampleFormat == sampleFormats.end()) throw std::runtime_error("invalid sample format for --sample-formats: '" + name + "'");
+				result.push_back(sampleFormat->second);
+			}
+			return result;
+		}
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			::cxxopts::Options commandLineOptions(argv[0], "Measures callback timing of a PortAudio stream");
+			commandLineOptions.add_options()
+				("backend", "Name of the PortAudio host API to use (default: the default host API)", ::cxxopts::value(options.backend))
+				("input-device", "Name of the input device (default: the default input device)", ::cxxopts::value(options.inputDevice))
+				("output-device", "Name of the output device (default: the default output device)", ::cxxopts::value(options.outputDevice))
+				("mode", "input, output or duplex", ::cxxopts::value<std::string>())
+				("buffer-sizes", "Comma-separated list of buffer sizes, in frames (0 lets PortAudio choose)", ::cxxopts::value<std::vector<long>>())
+				("sample-formats", "Comma-separated list of Float32, Int32, Int24 and Int16", ::cxxopts::value<std::vector<std::string>>())
+				("sample-rate", "Sample rate, in Hz (default: the default sample rate of the device)", ::cxxopts::value(options.sampleRate))
+				("channels", "Number of channels", ::cxxopts::value(options.channels))
+				("suggested-latency-seconds", "Suggested latency passed to PortAudio (default: the default low latency of the device)", ::cxxopts::value(options.suggestedLatencySeconds))
+				("wasapi-exclusive", "Open WASAPI devices in exclusive mode", ::cxxopts::value(options.wasapiExclusive))
+				("duration-seconds", "How long to run each stream for", ::cxxopts::value(options.durationSeconds));
+			const auto result = commandLineOptions.parse(argc, argv);
+			if (result.count("mode") > 0) options.mode = ParseMode(result["mode"].as<std::string>());
+			if (result.count("buffer-sizes") > 0) options.bufferSizes = result["buffer-sizes"].as<std::vector<long>>();
+			if (result.count("sample-formats") > 0) options.sampleFormats = ParseSampleFormats(result["sample-formats"].as<std::vector<std::string>>());
+
+			if (!(options.durationSeconds > 0)) throw std::runtime_error("--duration-seconds must be strictly positive");
+			if (options.channels < 1) throw std::runtime_error("--channels must be strictly positive");
+			for (const auto bufferSize : options.bufferSizes)
+				if (bufferSize < 0) throw std::runtime_error("--buffer-sizes cannot be negative");
+			return options;
+		}
+
+		std::optional<Device> FindDevice(const HostApi& hostApi, const std::optional<std::string>& name, PaDeviceIndex defaultDeviceIndex) {
+			if (!name.has_value()) {
+				if (defaultDeviceIndex == paNoDevice) return std::nullopt;
+				return Device(defaultDeviceIndex);
+			}
+			const auto deviceCount = Pa_GetDeviceCount();
+			for (PaDeviceIndex deviceIndex = 0; deviceIndex < deviceCount; ++deviceIndex) {
+				const Device device(deviceIndex);
+				if (device.info.hostApi == hostApi.index && device.info.name == *name) return device;
+			}
+			return std::nullopt;
+		}
+
+		struct CallbackRecord final {
+			Clock::time_point arrival;
+			unsigned long frameCount;
+			PaStreamCallbackFlags statusFlags;
+			PaTime currentTime;
+			PaTime inputBufferAdcTime;
+			PaTime outputBufferDacTime;
+		};
+
+		// Records are preallocated so that the callback does not allocate; the stream completes once the buffer is full.
+		class Recorder final {
+		public:
+			Recorder(size_t capacity, size_t outputBytesPerFrame) : records(capacity), outputBytesPerFrame(outputBytesPerFrame) {}
+
+			static int StreamCallback(const void*, void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData) {
+				return static_cast<Recorder*>(userData)->OnCallback(output, frameCount, *timeInfo, statusFlags);
+			}
+
+			std::span<const CallbackRecord> GetRecords() const { return std::span(records).first(recordCount.load()); }
+
+		private:
+			int OnCallback(void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo& timeInfo, PaStreamCallbackFlags statusFlags) {
+				const auto arrival = Clock::now();
+				if (output != nullptr) ::memset(output, 0, frameCount * outputBytesPerFrame);
+				const auto index = recordCount.load(std::memory_order_relaxed);
+				if (index >= records.size()) return paComplete;
+				records[index] = { arrival, frameCount, statusFlags, timeInfo.currentTime, timeInfo.inputBufferAdcTime, timeInfo.outputBufferDacTime };
+				recordCount.store(index + 1, std::memory_order_release);
+				return paContinue;
+			}
+
+			std::vector<CallbackRecord> records;
+			std::atomic<size_t> recordCount = 0;
+			const size_t outputBytesPerFrame;
+		};
+
+		struct Configuration final {
+			const HostApi& hostApi;
+			std::optional<Device> inputDevice;
+			std::optional<Device> outputDevice;
+			unsigned long bufferSize;
+			PaSampleFormat sampleFormat;
+			double sampleRate;
+		};
+
+		PaStreamParameters GetStreamParameters(const Options& options, const Device& device, int maxChannelCount, PaSampleFormat sampleFormat, PaTime defaultLatency, PaWasapiStreamInfo* wasapiStreamInfo) {
+			PaStreamParameters parameters = { 0 };
+			parameters.device = device.index;
+			parameters.channelCount = (std::min)(options.channels, maxChannelCount);
+			parameters.sampleFormat = sampleFormat;
+			parameters.suggestedLatency = options.suggestedLatencySeconds.value_or(defaultLatency);
+			parameters.hostApiSpecificStreamInfo = wasapiStreamInfo;
+			return parameters;
+		}
+
+		void WriteFrameCounts(JsonWriter& json, std::span<const CallbackRecord> records) {
+			std::map<unsigned long, size_t> frameCounts;
+			for (const auto& record : records) ++frameCounts[record.frameCount];
+			json.BeginObject();
+			for (const auto& [frameCount, count] : frameCounts) json.Key(std::to_string(frameCount)).Value(count);
+			json.EndObject();
+		}
+
+		void WriteStatusFlags(JsonWriter& json, std::span<const CallbackRecord> records) {
+			static const std::pair<PaStreamCallbackFlags, std::string_view> statusFlags[] = {
+				{paInputUnderflow, "inputUnderflow"},
+				{paInputOverflow, "inputOverflow"},
+				{paOutputUnderflow, "outputUnderflow"},
+				{paOutputOverflow, "outputOverflow"},
+				{paPrimingOutput, "primingOutput"},
+			};
+			json.BeginObject();
+			for (const auto& [flag, name] : statusFlags)
+				json.Key(name).Value(size_t(std::count_if(records.begin(), records.end(), [flag = flag](const CallbackRecord& record) { return (record.statusFlags & flag) != 0; })));
+			json.EndObject();
+		}
+
+		void WriteObservedLatency(JsonWriter& json, std::span<const CallbackRecord> records, PaTime CallbackRecord::* bufferTime, bool isOutput) {
+			std::vector<double> latencies;
+			for (const auto& record : records) {
+				// Some host APIs do not provide timing information, in which case the times are zero.
+				if (record.*bufferTime == 0 || record.currentTime == 0) continue;
+				latencies.push_back(1000 * (isOutput ? record.*bufferTime - record.currentTime : record.currentTime - record.*bufferTime));
+			}
+			if (latencies.empty()) json.Null();
+			else WriteDistribution(json, ComputeDistribution(latencies));
+		}
+
+		void WriteResults(JsonWriter& json, const Configuration& configuration, const PaStreamInfo& streamInfo, std::span<const CallbackRecord> allRecords) {
+			json.Key("streamInfo").BeginObject();
+			json.Key("inputLatencyMilliseconds").Value(1000 * streamInfo.inputLatency);
+			json.Key("outputLatencyMilliseconds").Value(1000 * streamInfo.outputLatency);
+			json.Key("sampleRate").Value(streamInfo.sampleRate);
+			json.EndObject();
+
+			json.Key("callbackCount").Value(allRecords.size());
+			const auto records = allRecords.subspan((std::min)(allRecords.size(), warmupCallbackCount));
+			json.Key("warmupCallbackCount").Value(allRecords.size() - records.size());
+
+			json.Key("frameCounts");
+			WriteFrameCounts(json, records);
+			json.Key("variableSizeCallbacks").Value(configuration.bufferSize == paFramesPerBufferUnspecified ?
+				size_t(records.size() - std::count_if(records.begin(), records.end(), [&](const CallbackRecord& record) { return record.frameCount == records.front().frameCount; })) :
+				size_t(std::count_if(records.begin(), records.end(), [&](const CallbackRecord& record) { return record.frameCount != configuration.bufferSize; })));
+
+			std::vector<double> intervals;
+			std::vector<double> jitter;
+			size_t lateCallbacks = 0;
+			for (size_t recordIndex = 1; recordIndex < records.size(); ++recordIndex) {
+				const auto interval = std::chrono::duration<double, std::micro>(records[recordIndex].arrival - records[recordIndex - 1].arrival).count();
+				const auto expectedInterval = 1e6 * records[recordIndex - 1].frameCount / streamInfo.sampleRate;
+				intervals.push_back(interval);
+				jitter.push_back(interval - expectedInterval);
+				if (interval > lateCallbackThreshold * expectedInterval) ++lateCallbacks;
+			}
+			json.Key("intervalMicroseconds");
+			WriteDistribution(json, ComputeDistribution(intervals));
+			json.Key("jitterMicroseconds");
+			WriteDistribution(json, ComputeDistribution(jitter));
+			json.Key("lateCallbacks").Value(lateCallbacks);
+
+			json.Key("statusFlags");
+			WriteStatusFlags(json, records);
+
+			json.Key("observedInputLatencyMilliseconds");
+			if (configuration.inputDevice.has_value()) WriteObservedLatency(json, records, &CallbackRecord::inputBufferAdcTime, /*isOutput=*/false);
+			else json.Null();
+			json.Key("observedOutputLatencyMilliseconds");
+			if (configuration.outputDevice.has_value()) WriteObservedLatency(json, records, &CallbackRecord::outputBufferDacTime, /*isOutput=*/true);
+			else json.Null();
+		}
+
+		void RunConfiguration(JsonWriter& json, const Options& options, const Configuration& configuration) {
+			PaWasapiStreamInfo wasapiStreamInfo = { 0 };
+			const auto useWasapiStreamInfo = configuration.hostApi.info.type == paWASAPI && options.wasapiExclusive;
+			if (useWasapiStreamInfo) {
+				wasapiStreamInfo.size = sizeof(wasapiStreamInfo);
+				wasapiStreamInfo.hostApiType = paWASAPI;
+				wasapiStreamInfo.version = 1;
+				wasapiStreamInfo.flags = paWinWasapiExclusive;
+			}
+
+			std::optional<PaStreamParameters> inputParameters;
+			if (configuration.inputDevice.has_value()) {
+				inputParameters = GetStreamParameters(options, *configuration.inputDevice, configuration.inputDevice->info.maxInputChannels, configuration.sampleFormat, configuration.inputDevice->info.defaultLowInputLatency, useWasapiStreamInfo ? &wasapiStreamInfo : nullptr);
+			}
+			std::optional<PaStreamParameters> outputParameters;
+			if (configuration.outputDevice.has_value()) {
+				outputParameters = GetStreamParameters(options, *configuration.outputDevice, configuration.outputDevice->info.maxOutputChannels, configuration.sampleFormat, configuration.outputDevice->info.defaultLowOutputLatency, useWasapiStreamInfo ? &wasapiStreamInfo : nullptr);
+			}
+
+			json.Key("inputChannels").Value(inputParameters.has_value() ? inputParameters->channelCount : 0);
+			json.Key("outputChannels").Value(outputParameters.has_value() ? outputParameters->channelCount : 0);
+			json.Key("suggestedInputLatencySeconds");
+			if (inputParameters.has_value()) json.Value(inputParameters->suggestedLatency); else json.Null();
+			json.Key("suggestedOutputLatencySeconds");
+			if (outputParameters.has_value()) json.Value(outputParameters->suggestedLatency); else json.Null();
+
+			// Size the record buffer for the worst case of one callback per 16 frames, plus some slack.
+			const auto capacity = size_t(options.durationSeconds * configuration.sampleRate / (configuration.bufferSize == paFramesPerBufferUnspecified ? 16 : configuration.bufferSize)) + 1024;
+			Recorder recorder(capacity, outputParameters.has_value() ? size_t(outputParameters->channelCount) * size_t(Pa_GetSampleSize(configuration.sampleFormat)) : 0);
+
+			PaStream* stream = nullptr;
+			ThrowOnPaError(Pa_OpenStream(&stream,
+				inputParameters.has_value() ? &*inputParameters : nullptr,
+				outputParameters.has_value() ? &*outputParameters : nullptr,
+				configuration.sampleRate, configuration.bufferSize, paNoFlag, &Recorder::StreamCallback, &recorder));
+			try {
+				const auto streamInfo = Pa_GetStreamInfo(stream);
+				if (streamInfo == nullptr) throw std::runtime_error("Pa_GetStreamInfo() returned NULL");
+				std::cerr << "Benchmarking " << DescribeStreamInfo(*streamInfo) << std::endl;
+
+				ThrowOnPaError(Pa_StartStream(stream));
+				std::this_thread::sleep_for(std::chrono::duration<double>(options.durationSeconds));
+				ThrowOnPaError(Pa_StopStream(stream));
+
+				WriteResults(json, configuration, *streamInfo, recorder.GetRecords());
+			}
+			catch (...) {
+				Pa_CloseStream(stream);
+				throw;
+			}
+			ThrowOnPaError(Pa_CloseStream(stream));
+		}
+
+		void RunHostApi(JsonWriter& json, const Options& options, const HostApi& hostApi) {
+			const auto inputDevice = options.mode == Mode::OUTPUT ? std::nullopt : FindDevice(hostApi, options.inputDevice, hostApi.info.defaultInputDevice);
+			const auto outputDevice = options.mode == Mode::INPUT ? std::nullopt : FindDevice(hostApi, options.outputDevice, hostApi.info.defaultOutputDevice);
+			if ((options.mode != Mode::OUTPUT && !inputDevice.has_value()) || (options.mode != Mode::INPUT && !outputDevice.has_value())) {
+				std::cerr << "Skipping host API " << hostApi << " because no suitable device was found" << std::endl;
+				return;
+			}
+
+			const auto& referenceDevice = outputDevice.has_value() ? *outputDevice : *inputDevice;
+			const auto sampleRate = options.sampleRate.value_or(referenceDevice.info.defaultSampleRate);
+
+			for (const auto sampleFormat : options.sampleFormats)
+				for (const auto bufferSize : options.bufferSizes) {
+					const Configuration configuration = {
+						.hostApi = hostApi,
+						.inputDevice = inputDevice,
+						.outputDevice = outputDevice,
+						.bufferSize = bufferSize == 0 ? paFramesPerBufferUnspecified : (unsigned long)(bufferSize),
+						.sampleFormat = sampleFormat,
+						.sampleRate = sampleRate,
+					};
+
+					json.BeginObject();
+					json.Key("backend").Value(hostApi.info.name);
+					json.Key("inputDevice");
+					if (inputDevice.has_value()) json.Value(inputDevice->info.name); else json.Null();
+					json.Key("outputDevice");
+					if (outputDevice.has_value()) json.Value(outputDevice->info.name); else json.Null();
+					json.Key("mode").Value(GetModeString(options.mode));
+					json.Key("bufferSize").Value(bufferSize);
+					json.Key("sampleFormat").Value(GetSampleFormatString(sampleFormat));
+					json.Key("sampleRate").Value(sampleRate);
+					try {
+						RunConfiguration(json, options, configuration);
+					}
+					catch (const std::exception& exception) {
+						std::cerr << "Benchmark failed on host API " << hostApi << ": " << exception.what() << std::endl;
+						json.Key("error").Value(exception.what());
+					}
+					json.EndObject();
+				}
+		}
+
+	}
+
+	void RunBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+
+		JsonWriter json(output);
+		json.BeginObject();
+		json.Key("portAudioVersion").Value(Pa_GetVersionInfo()->versionText);
+		json.Key("durationSeconds").Value(options.durationSeconds);
+		json.Key("runs").BeginArray();
+
+		bool foundBackend = false;
+		const auto hostApiCount = ThrowOnPaError(Pa_GetHostApiCount());
+		for (PaHostApiIndex hostApiIndex = 0; hostApiIndex < hostApiCount; ++hostApiIndex) {
+			const HostApi hostApi(hostApiIndex);
+			if (options.backend.has_value() && hostApi.info.name != *options.backend) continue;
+			foundBackend = true;
+			RunHostApi(json, options, hostApi);
+		}
+
+		json.EndArray();
+		json.EndObject();
+
+		if (!foundBackend) throw std::runtime_error("PortAudio host API '" + *options.backend + "' not found");
+	}
+
+}
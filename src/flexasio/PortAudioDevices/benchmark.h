@@ -0,0 +1,11 @@
+#pragma once
+
+#include <ostream>
+
+namespace flexasio {
+
+	// Opens devices with the requested parameters, records callback behaviour, and writes the results as JSON.
+	// PortAudio must be initialized. `argv[0]` is the subcommand name.
+	void RunBenchmark(int argc, char** argv, std::ostream& output);
+
+}
@@ -0,0 +1,113 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/sample_conversion.h"
+#include "../FlexASIOUtil/simd.h"
+
+#include <cxxopts.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		struct Options final {
+			std::vector<SampleFormat> inputFormats = { std::begin(allSampleFormats), std::end(allSampleFormats) };
+			std::vector<SampleFormat> outputFormats = { std::begin(allSampleFormats), std::end(allSampleFormats) };
+			bool dither = false;
+			KernelBenchmarkOptions kernel;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			options.kernel = ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every sample conversion kernel", {},
+				[&](::cxxopts::OptionAdder& adder) {
+					adder
+						("input-formats", "Comma-separated list of input sample formats (default: all)", ::cxxopts::value<std::vector<std::string>>())
+						("output-formats", "Comma-separated list of output sample formats (default: all)", ::cxxopts::value<std::vector<std::string>>())
+						("dither", "Dither conversions to integer formats", ::cxxopts::value(options.dither));
+				},
+				[&](const ::cxxopts::ParseResult& result) {
+					if (result.count("input-formats") > 0) options.inputFormats = ParseSampleFormats("input-formats", result["input-formats"].as<std::vector<std::string>>());
+					if (result.count("output-formats") > 0) options.outputFormats = ParseSampleFormats("output-formats", result["output-formats"].as<std::vector<std::string>>());
+				});
+			return options;
+		}
+
+		int GetIntegerBits(SampleFormat format) {
+			switch (format) {
+			case SampleFormat::INT16: case SampleFormat::INT32_LSB16: return 16;
+			case SampleFormat::INT24: case SampleFormat::INT32_LSB24: return 24;
+			case SampleFormat::INT32: return 32;
+			default: throw std::invalid_argument("not an integer sample format");
+			}
+		}
+
+		// Each implementation draws dither noise from its own generators, so dithered outputs cannot be compared bit for bit. Dither
+		// moves each sample by at most one least significant bit, though, so correct implementations are never more than two apart.
+		void CheckDitheredMatchesScalar(SampleFormat format, const std::vector<std::byte>& reference, const std::vector<std::byte>& output, std::string_view description) {
+			const auto sampleCount = reference.size() / GetSampleFormatSize(format);
+			const auto decode = [&](const std::vector<std::byte>& samples) {
+				std::vector<double> decoded(sampleCount);
+				SampleConverter(format, SampleFormat::FLOAT64, /*dither=*/false, SimdImplementation::SCALAR).Convert(samples.data(), reinterpret_cast<std::byte*>(decoded.data()), sampleCount);
+				return decoded;
+			};
+			const auto decodedReference = decode(reference);
+			const auto decodedOutput = decode(output);
+			const auto tolerance = 2 * std::ldexp(1.0, 1 - GetIntegerBits(format));
+			for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+				if (std::abs(decodedOutput[sampleIndex] - decodedReference[sampleIndex]) > tolerance)
+					throw std::runtime_error(std::string(description) + ": output is further than dither allows from the scalar implementation at sample " + std::to_string(sampleIndex));
+		}
+
+		void RunFormats(JsonWriter& json, const Options& options, SampleFormat inputFormat, SampleFormat outputFormat, size_t bufferSize) {
+			const auto input = MakeSampleNoise(inputFormat, bufferSize);
+			std::vector<std::byte> output(bufferSize * GetSampleFormatSize(outputFormat));
+			const auto dithering = SampleConverter(inputFormat, outputFormat, options.dither, SimdImplementation::SCALAR).IsDithering();
+			// The scalar implementation processes one sample at a time, the same way PortAudio's own converters do, so it serves as
+			// the baseline.
+			MeasureImplementations(json, {
+					.description = std::string(GetSampleFormatName(inputFormat)) + " to " + std::string(GetSampleFormatName(outputFormat)) + " conversion of " + std::to_string(bufferSize) + " samples",
+					.writeParameters = [&](JsonWriter& json) {
+						json.Key("inputFormat").Value(GetSampleFormatName(inputFormat));
+						json.Key("outputFormat").Value(GetSampleFormatName(outputFormat));
+						json.Key("bufferSize").Value(bufferSize);
+						json.Key("dither").Value(dithering);
+					},
+				},
+				[&](SimdImplementation implementation) { return SampleConverter(inputFormat, outputFormat, options.dither, implementation); },
+				[&](SampleConverter& converter) {
+					converter.Convert(input.data(), output.data(), bufferSize);
+					return output;
+				},
+				[&](SampleConverter& converter) { return MeasureNanosecondsPerSample(bufferSize, options.kernel.iterations, [&] { converter.Convert(input.data(), output.data(), bufferSize); }); },
+				[&](const std::vector<std::byte>& reference, const std::vector<std::byte>& result, std::string_view description) {
+					if (dithering) CheckDitheredMatchesScalar(outputFormat, reference, result, description);
+					else CheckMatchesScalar(reference, result, description);
+				});
+		}
+
+	}
+
+	void RunConversionBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options.kernel, [&](JsonWriter& json) {
+			for (const auto inputFormat : options.inputFormats)
+				for (const auto outputFormat : options.outputFormats) {
+					if (inputFormat == outputFormat) continue;
+					for (const auto bufferSize : options.kernel.bufferSizes)
+						RunFormats(json, options, inputFormat, outputFormat, size_t(bufferSize));
+				}
+		});
+	}
+
+}
@@ -0,0 +1,120 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/biquad.h"
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/simd.h"
+#include "../FlexASIOUtil/statistics.h"
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		struct Options final {
+			std::vector<long> channelCounts = { 1, 2, 8, 16 };
+			std::vector<long> filterCounts = { 1, 4, 10 };
+			KernelBenchmarkOptions kernel = { .bufferSizes = { 32, 64 } };
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			options.kernel = ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every biquad equalizer kernel", options.kernel,
+				[&](::cxxopts::OptionAdder& adder) {
+					adder
+						("channels", "Comma-separated list of channel counts", ::cxxopts::value<std::vector<long>>())
+						("filters", "Comma-separated list of filter counts per channel", ::cxxopts::value<std::vector<long>>());
+				},
+				[&](const ::cxxopts::ParseResult& result) {
+					if (result.count("channels") > 0) options.channelCounts = result["channels"].as<std::vector<long>>();
+					if (result.count("filters") > 0) options.filterCounts = result["filters"].as<std::vector<long>>();
+					CheckStrictlyPositive("channels", options.channelCounts);
+					CheckStrictlyPositive("filters", options.filterCounts);
+				});
+			return options;
+		}
+
+		// Peaking filters spread over the spectrum, which is what room correction typically looks like. The coefficients do not
+		// affect the speed of the kernels anyway.
+		std::vector<std::vector<BiquadCoefficients>> MakeCascades(size_t channelCount, size_t filterCount) {
+			std::vector<std::vector<BiquadCoefficients>> cascades(channelCount);
+			for (auto& cascade : cascades)
+				for (size_t filterIndex = 0; filterIndex < filterCount; ++filterIndex)
+					cascade.push_back(DesignBiquad(BiquadType::PEAKING, 48000, 40.0 * double(filterIndex + 1), 2.0, filterIndex % 2 == 0 ? -3.0 : 2.0));
+			return cascades;
+		}
+
+		void RunShape(JsonWriter& json, const Options& options, size_t channelCount, size_t filterCount, size_t bufferSize) {
+			const auto cascades = MakeCascades(channelCount, filterCount);
+			std::mt19937 random;
+			std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+			std::vector<float> input(channelCount * bufferSize);
+			for (auto& sample : input) sample = distribution(random);
+
+			// Filters process their buffers in place. `samples` holds a copy of the input for each of `callCount` calls, and `channels`
+			// the channel pointers of each call.
+			std::vector<float> samples;
+			std::vector<float*> channels;
+			const auto prepare = [&](size_t callCount) {
+				samples.resize(callCount * input.size());
+				channels.resize(callCount * channelCount);
+				for (size_t callIndex = 0; callIndex < callCount; ++callIndex) {
+					std::copy(input.begin(), input.end(), samples.begin() + callIndex * input.size());
+					for (size_t channel = 0; channel < channelCount; ++channel)
+						channels[callIndex * channelCount + channel] = samples.data() + callIndex * input.size() + channel * bufferSize;
+				}
+			};
+
+			MeasureImplementations(json, {
+					.description = std::to_string(filterCount) + " filters on each of " + std::to_string(channelCount) + " channels, " + std::to_string(bufferSize) + " frames at a time,",
+					.writeParameters = [&](JsonWriter& json) {
+						json.Key("channels").Value(channelCount);
+						json.Key("filtersPerChannel").Value(filterCount);
+						json.Key("bufferSize").Value(bufferSize);
+					},
+					.writeResults = [&](JsonWriter& json, const std::vector<double>& nanosecondsPerSample) {
+						// What it costs to add one channel, for a whole buffer.
+						std::vector<double> nanosecondsPerChannel;
+						for (const auto nanoseconds : nanosecondsPerSample) nanosecondsPerChannel.push_back(nanoseconds * double(bufferSize));
+						json.Key("nanosecondsPerChannel");
+						WriteDistribution(json, ComputeDistribution(nanosecondsPerChannel));
+					},
+				},
+				[&](SimdImplementation implementation) { return BiquadFilterBank(cascades, implementation); },
+				[&](BiquadFilterBank& filterBank) {
+					// A few calls, so that the state carried over from one buffer to the next is checked as well.
+					constexpr size_t checkedCallCount = 4;
+					prepare(checkedCallCount);
+					for (size_t callIndex = 0; callIndex < checkedCallCount; ++callIndex) filterBank.Process(channels.data() + callIndex * channelCount, bufferSize);
+					return samples;
+				},
+				[&](BiquadFilterBank& filterBank) {
+					return MeasureNanosecondsPerSampleInPlace(channelCount * bufferSize, options.kernel.iterations, prepare,
+						[&](size_t callIndex) { filterBank.Process(channels.data() + callIndex * channelCount, bufferSize); });
+				});
+		}
+
+	}
+
+	void RunEqualizerBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options.kernel, [&](JsonWriter& json) {
+			for (const auto channelCount : options.channelCounts)
+				for (const auto filterCount : options.filterCounts)
+					for (const auto bufferSize : options.kernel.bufferSizes)
+						RunShape(json, options, size_t(channelCount), size_t(filterCount), size_t(bufferSize));
+		});
+	}
+
+}
@@ -0,0 +1,66 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/gain.h"
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/simd.h"
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		KernelBenchmarkOptions ParseOptions(int argc, char** argv) {
+			return ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every gain ramp kernel", {}, [](::cxxopts::OptionAdder&) {}, [](const ::cxxopts::ParseResult&) {});
+		}
+
+		void RunBufferSize(JsonWriter& json, const KernelBenchmarkOptions& options, size_t bufferSize) {
+			// A fade from unity to -6 dB, which is the kind of change a host application makes when the user moves a fader.
+			constexpr float startGain = 1.0f;
+			constexpr float endGain = 0.5f;
+
+			std::mt19937 random;
+			std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+			std::vector<float> input(bufferSize);
+			for (auto& sample : input) sample = distribution(random);
+
+			std::vector<float> samples;
+			MeasureImplementations(json, {
+					.description = "gain ramp over " + std::to_string(bufferSize) + " samples",
+					.writeParameters = [&](JsonWriter& json) { json.Key("bufferSize").Value(bufferSize); },
+				},
+				[&](SimdImplementation implementation) { return GainRamp(implementation); },
+				[&](const GainRamp& gainRamp) {
+					auto output = input;
+					gainRamp.Apply(output.data(), bufferSize, startGain, endGain);
+					return output;
+				},
+				[&](const GainRamp& gainRamp) {
+					return MeasureNanosecondsPerSampleInPlace(bufferSize, options.iterations,
+						[&](size_t callCount) {
+							samples.resize(callCount * bufferSize);
+							for (size_t callIndex = 0; callIndex < callCount; ++callIndex) std::copy(input.begin(), input.end(), samples.begin() + callIndex * bufferSize);
+						},
+						[&](size_t callIndex) { gainRamp.Apply(samples.data() + callIndex * bufferSize, bufferSize, startGain, endGain); });
+				});
+		}
+
+	}
+
+	void RunGainBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options, [&](JsonWriter& json) {
+			for (const auto bufferSize : options.bufferSizes)
+				RunBufferSize(json, options, size_t(bufferSize));
+		});
+	}
+
+}
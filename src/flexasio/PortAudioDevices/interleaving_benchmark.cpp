@@ -0,0 +1,158 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/interleaving.h"
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/simd.h"
+
+#include <cxxopts.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		struct Options final {
+			std::vector<long> channelCounts = { 1, 2, 4, 8, 16, 32 };
+			std::vector<long> sampleSizes = { 2, 3, 4 };
+			KernelBenchmarkOptions kernel;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			options.kernel = ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every interleaving kernel", options.kernel,
+				[&](::cxxopts::OptionAdder& adder) {
+					adder("channel-counts", "Comma-separated list of channel counts", ::cxxopts::value<std::vector<long>>());
+					adder("sample-sizes", "Comma-separated list of sample sizes, in bytes", ::cxxopts::value<std::vector<long>>());
+				},
+				[&](const ::cxxopts::ParseResult& result) {
+					if (result.count("channel-counts") > 0) options.channelCounts = result["channel-counts"].as<std::vector<long>>();
+					if (result.count("sample-sizes") > 0) options.sampleSizes = result["sample-sizes"].as<std::vector<long>>();
+				});
+			CheckStrictlyPositive("channel-counts", options.channelCounts);
+			CheckStrictlyPositive("sample-sizes", options.sampleSizes);
+			return options;
+		}
+
+		struct Buffers final {
+			Buffers(size_t channelCount, size_t sampleSize, size_t frameCount) :
+				interleaved(channelCount * frameCount * sampleSize), channels(channelCount * frameCount * sampleSize), scratch(channelCount * frameCount * sampleSize),
+				channelPointers(channelCount), scratchPointers(channelCount) {
+				std::mt19937 random;
+				std::uniform_int_distribution<int> distribution(0, 255);
+				for (auto& byte : interleaved) byte = std::byte(distribution(random));
+				for (auto& byte : channels) byte = std::byte(distribution(random));
+				for (size_t channel = 0; channel < channelCount; ++channel) {
+					channelPointers[channel] = channels.data() + channel * frameCount * sampleSize;
+					scratchPointers[channel] = scratch.data() + channel * frameCount * sampleSize;
+				}
+			}
+
+			std::vector<std::byte> interleaved;
+			std::vector<std::byte> channels;
+			std::vector<std::byte> scratch;
+			std::vector<std::byte*> channelPointers;
+			std::vector<std::byte*> scratchPointers;
+		};
+
+		void WriteTwoPassRun(JsonWriter& json, const std::function<void(JsonWriter&)>& writeParameters, std::vector<double>& nanosecondsPerSample) {
+			const auto distribution = ComputeDistribution(nanosecondsPerSample);
+			json.BeginObject();
+			writeParameters(json);
+			json.Key("implementation").Value("twoPass");
+			json.Key("nanosecondsPerSample");
+			WriteDistribution(json, distribution);
+			json.Key("speedupOverTwoPass").Value(1.0);
+			json.EndObject();
+		}
+
+		void RunLayout(JsonWriter& json, const KernelBenchmarkOptions& options, size_t channelCount, size_t sampleSize, size_t bufferSize) {
+			Buffers buffers(channelCount, sampleSize, bufferSize);
+			const auto sampleCount = channelCount * bufferSize;
+			const auto channelSize = bufferSize * sampleSize;
+
+			// The baseline is what happens when PortAudio (de)interleaves into its own per-channel buffers, and FlexASIO then copies these
+			// to or from the ASIO buffers: a scalar (de)interleave followed by one copy per channel.
+			const Interleaver scalarInterleaver(channelCount, sampleSize, SimdImplementation::SCALAR);
+
+			// The timed runs below overwrite each other's input, so the outputs are checked on copies of the original buffers.
+			const auto interleavedInput = buffers.interleaved;
+			const auto channelsInput = buffers.channels;
+			const auto deinterleaveChecked = [&](const Interleaver& interleaver) {
+				std::vector<std::byte> channels(channelsInput.size());
+				std::vector<std::byte*> channelPointers(channelCount);
+				for (size_t channel = 0; channel < channelCount; ++channel) channelPointers[channel] = channels.data() + channel * channelSize;
+				interleaver.Deinterleave(interleavedInput.data(), channelPointers.data(), bufferSize);
+				return channels;
+			};
+			const auto interleaveChecked = [&](const Interleaver& interleaver) {
+				std::vector<const std::byte*> channelPointers(channelCount);
+				for (size_t channel = 0; channel < channelCount; ++channel) channelPointers[channel] = channelsInput.data() + channel * channelSize;
+				std::vector<std::byte> interleaved(interleavedInput.size());
+				interleaver.Interleave(channelPointers.data(), interleaved.data(), bufferSize);
+				return interleaved;
+			};
+			std::cerr << "Benchmarking two-pass (de)interleaving of " << channelCount << " channels of " << sampleSize << "-byte samples, " << bufferSize << " frames" << std::endl;
+			auto twoPassDeinterleave = MeasureNanosecondsPerSample(sampleCount, options.iterations, [&] {
+				scalarInterleaver.Deinterleave(buffers.interleaved.data(), buffers.scratchPointers.data(), bufferSize);
+				for (size_t channel = 0; channel < channelCount; ++channel) memcpy(buffers.channelPointers[channel], buffers.scratchPointers[channel], channelSize);
+			});
+			auto twoPassInterleave = MeasureNanosecondsPerSample(sampleCount, options.iterations, [&] {
+				for (size_t channel = 0; channel < channelCount; ++channel) memcpy(buffers.scratchPointers[channel], buffers.channelPointers[channel], channelSize);
+				scalarInterleaver.Interleave(buffers.scratchPointers.data(), buffers.interleaved.data(), bufferSize);
+			});
+
+			const auto layout = std::to_string(channelCount) + " channels of " + std::to_string(sampleSize) + "-byte samples, " + std::to_string(bufferSize) + " frames";
+			const auto writeParameters = [&](std::string_view operation) {
+				return [=](JsonWriter& json) {
+					json.Key("operation").Value(operation);
+					json.Key("channelCount").Value(channelCount);
+					json.Key("sampleSize").Value(sampleSize);
+					json.Key("bufferSize").Value(bufferSize);
+				};
+			};
+			const auto makeInterleaver = [&](SimdImplementation implementation) { return Interleaver(channelCount, sampleSize, implementation); };
+
+			WriteTwoPassRun(json, writeParameters("deinterleave"), twoPassDeinterleave);
+			MeasureImplementations(json, {
+					.description = "deinterleaving of " + layout,
+					.writeParameters = writeParameters("deinterleave"),
+					.speedupKey = "speedupOverTwoPass",
+					.baselineMedian = ComputeDistribution(twoPassDeinterleave).p50,
+				},
+				makeInterleaver, deinterleaveChecked,
+				[&](const Interleaver& interleaver) { return MeasureNanosecondsPerSample(sampleCount, options.iterations, [&] { interleaver.Deinterleave(buffers.interleaved.data(), buffers.channelPointers.data(), bufferSize); }); });
+
+			WriteTwoPassRun(json, writeParameters("interleave"), twoPassInterleave);
+			MeasureImplementations(json, {
+					.description = "interleaving of " + layout,
+					.writeParameters = writeParameters("interleave"),
+					.speedupKey = "speedupOverTwoPass",
+					.baselineMedian = ComputeDistribution(twoPassInterleave).p50,
+				},
+				makeInterleaver, interleaveChecked,
+				[&](const Interleaver& interleaver) { return MeasureNanosecondsPerSample(sampleCount, options.iterations, [&] { interleaver.Interleave(buffers.channelPointers.data(), buffers.interleaved.data(), bufferSize); }); });
+		}
+
+	}
+
+	void RunInterleavingBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options.kernel, [&](JsonWriter& json) {
+			for (const auto channelCount : options.channelCounts)
+				for (const auto sampleSize : options.sampleSizes)
+					for (const auto bufferSize : options.kernel.bufferSizes)
+						RunLayout(json, options.kernel, size_t(channelCount), size_t(sampleSize), size_t(bufferSize));
+		});
+	}
+
+}
@@ -6,22 +6,19 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <io.h>
 #include <fcntl.h>
 
 #include <dechamps_cpputil/string.h>
 
 #include "../FlexASIOUtil/portaudio.h"
+#include "benchmark.h"
+#include "standalone_benchmarks.h"
 
 namespace flexasio {
 	namespace {
 
-		template <typename Result>
-		auto ThrowOnPaError(Result result) {
-			if (result >= 0) return result;
-			throw std::runtime_error(std::string("PortAudio error ") + Pa_GetErrorText(result));
-		}
-
 		void SetUTF8Mode(FILE* file, std::wstring_view label) {
 			const auto fileno = _fileno(file);
 			if (fileno < 0) {
@@ -91,10 +88,8 @@ namespace flexasio {
 			}
 		}
 
-		void InitAndListDevices() {
-			SetUTF8Mode(stderr, L"standard error");
-			SetUTF8Mode(stdout, L"standard output");
-
+		template <typename Functor>
+		void WithPortAudio(Functor functor) {
 			PortAudioDebugRedirector portAudioLogger([](std::string_view str) { std::wcerr << "[PortAudio] " << UTF8ToWideString(str) << std::endl; });
 
 			try {
@@ -104,7 +99,7 @@ namespace flexasio {
 				throw std::runtime_error(std::string("failed to initialize PortAudio: ") + exception.what());
 			}
 
-			ListDevices();
+			functor();
 
 			try {
 				ThrowOnPaError(Pa_Terminate());
@@ -114,12 +109,42 @@ namespace flexasio {
 			}
 		}
 
+		void InitAndListDevices() {
+			SetUTF8Mode(stderr, L"standard error");
+			SetUTF8Mode(stdout, L"standard output");
+
+			WithPortAudio(ListDevices);
+		}
+
+		void InitAndRunBenchmark(int argc, char** argv) {
+			// The benchmark writes UTF-8 JSON and progress messages through narrow streams, which is incompatible with _O_U8TEXT mode.
+			// Standard streams are therefore left in their default mode.
+			WithPortAudio([&] { RunBenchmark(argc, argv, std::cout); });
+		}
+
 	}
 }
 
-int main(int, char**) {
+int main(int argc, char** argv) {
 	try {
-		::flexasio::InitAndListDevices();
+		if (argc >= 2 && std::string_view(argv[1]) == "benchmark")
+			::flexasio::InitAndRunBenchmark(argc - 1, argv + 1);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-conversion")
+			::flexasio::RunConversionBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-equalizer")
+			::flexasio::RunEqualizerBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-gain")
+			::flexasio::RunGainBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-interleaving")
+			::flexasio::RunInterleavingBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-live-parameters")
+			::flexasio::RunLiveParametersBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-metering")
+			::flexasio::RunMeteringBenchmark(argc - 1, argv + 1, std::cout);
+		else if (argc >= 2 && std::string_view(argv[1]) == "benchmark-mixing")
+			::flexasio::RunMixingBenchmark(argc - 1, argv + 1, std::cout);
+		else
+			::flexasio::InitAndListDevices();
 	}
 	catch (const std::exception& exception) {
 		std::wcerr << "ERROR: " << exception.what() << std::endl;
@@ -0,0 +1,215 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIO/live_parameters.h"
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/statistics.h"
+
+#include <cxxopts.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		using Clock = std::chrono::steady_clock;
+
+		struct Options final {
+			long iterations = 1000;
+			long channels = 8;
+			long updaterThreads = 2;
+			double stressSeconds = 5;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			::cxxopts::Options commandLineOptions(argv[0], "Measures live parameter access and checks snapshot integrity under concurrent updates");
+			commandLineOptions.add_options()
+				("iterations", "Number of timed batches per measurement", ::cxxopts::value(options.iterations))
+				("channels", "Number of channels in each snapshot", ::cxxopts::value(options.channels))
+				("updater-threads", "Number of threads publishing updates concurrently", ::cxxopts::value(options.updaterThreads))
+				("stress-seconds", "How long to run the snapshot integrity check for", ::cxxopts::value(options.stressSeconds));
+			commandLineOptions.parse(argc, argv);
+
+			if (options.iterations < 1) throw std::runtime_error("--iterations must be strictly positive");
+			if (options.channels < 1) throw std::runtime_error("--channels must be strictly positive");
+			if (options.updaterThreads < 1) throw std::runtime_error("--updater-threads must be strictly positive");
+			if (!(options.stressSeconds >= 0)) throw std::runtime_error("--stress-seconds cannot be negative");
+			return options;
+		}
+
+		// What the driver typically publishes: per-channel mutes and gains, and a few input monitors.
+		LiveParameters MakeLiveParameters(size_t channelCount) {
+			LiveParameters liveParameters;
+			liveParameters.input.muted.assign(channelCount, false);
+			liveParameters.input.gains.assign(channelCount, 1.0f);
+			liveParameters.output.muted.assign(channelCount, false);
+			liveParameters.output.gains.assign(channelCount, 1.0f);
+			liveParameters.inputMonitors.push_back({ .inputChannel = 0, .leftOutputChannel = 0, .leftGain = 1.0f, .rightOutputChannel = 1, .rightGain = 1.0f });
+			return liveParameters;
+		}
+
+		// Every field of a stress snapshot is derived from its generation, so that a reader can tell whether a snapshot it is given
+		// is intact. Sizes vary too, so that a snapshot that was freed and reused is unlikely to look consistent.
+		LiveParameters MakeStressSnapshot(long generation) {
+			const auto size = size_t(generation % 16) + 1;
+			const auto value = float(generation % 4096);
+			LiveParameters liveParameters;
+			liveParameters.input.muted.assign(size, generation % 2 == 1);
+			liveParameters.input.gains.assign(size, value);
+			liveParameters.output.muted.assign(size, generation % 2 == 0);
+			liveParameters.output.gains.assign(size, value);
+			liveParameters.inputMonitors.assign(size_t(generation % 4) + 1, { .inputChannel = generation, .leftOutputChannel = generation, .leftGain = value, .rightOutputChannel = -1, .rightGain = value });
+			return liveParameters;
+		}
+
+		// Returns the generation of the snapshot, or nullopt if the snapshot is not consistent with any generation.
+		std::optional<long> CheckStressSnapshot(const LiveParameters& liveParameters) {
+			if (liveParameters.inputMonitors.empty()) return std::nullopt;
+			const auto generation = liveParameters.inputMonitors.front().inputChannel;
+			if (generation < 0) return std::nullopt;
+			const auto size = size_t(generation % 16) + 1;
+			const auto value = float(generation % 4096);
+			const auto checkStream = [&](const LiveParameters::Stream& stream, bool muted) {
+				if (stream.muted.size() != size || stream.gains.size() != size) return false;
+				for (const auto channelMuted : stream.muted) if (channelMuted != muted) return false;
+				for (const auto gain : stream.gains) if (gain != value) return false;
+				return true;
+			};
+			if (!checkStream(liveParameters.input, generation % 2 == 1) || !checkStream(liveParameters.output, generation % 2 == 0)) return std::nullopt;
+			if (liveParameters.inputMonitors.size() != size_t(generation % 4) + 1) return std::nullopt;
+			for (const auto& inputMonitor : liveParameters.inputMonitors)
+				if (inputMonitor.inputChannel != generation || inputMonitor.leftOutputChannel != generation || inputMonitor.leftGain != value ||
+					inputMonitor.rightOutputChannel != -1 || inputMonitor.rightGain != value)
+					return std::nullopt;
+			return generation;
+		}
+
+		// Publishes updates from `threadCount` threads until destroyed.
+		class Updaters final {
+		public:
+			template <typename Functor>
+			Updaters(LiveParametersPublisher& publisher, size_t threadCount, Functor functor) {
+				for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+					threads.emplace_back([&publisher, functor, this] {
+						while (!stop.load(std::memory_order_relaxed)) {
+							publisher.Update(functor);
+							updateCount.fetch_add(1, std::memory_order_relaxed);
+						}
+					});
+			}
+			~Updaters() {
+				stop = true;
+				for (auto& thread : threads) thread.join();
+			}
+
+			Updaters(const Updaters&) = delete;
+			Updaters& operator=(const Updaters&) = delete;
+
+			size_t GetUpdateCount() const { return updateCount.load(); }
+
+		private:
+			std::atomic<bool> stop = false;
+			std::atomic<size_t> updateCount = 0;
+			std::vector<std::thread> threads;
+		};
+
+		// Enters a ReadScope and reads one channel, the way the stream callback does once per period.
+		void MeasureReadScope(JsonWriter& json, const Options& options, LiveParametersPublisher& publisher, std::string_view updates) {
+			std::cerr << "Benchmarking ReadScope with " << updates << " updates" << std::endl;
+			float sink = 0;
+			long channel = 0;
+			auto nanosecondsPerReadScope = MeasureNanosecondsPerSample(1, options.iterations, [&] {
+				const LiveParametersPublisher::ReadScope liveParameters(publisher);
+				sink += liveParameters->output.GetGain(channel);
+				channel = (channel + 1) % options.channels;
+			});
+
+			json.BeginObject();
+			json.Key("updates").Value(updates);
+			json.Key("nanosecondsPerReadScope");
+			WriteDistribution(json, ComputeDistribution(nanosecondsPerReadScope));
+			// Prevents the reads from being optimized away.
+			json.Key("checksum").Value(double(sink));
+			json.EndObject();
+		}
+
+		void RunStress(JsonWriter& json, const Options& options) {
+			std::cerr << "Checking snapshot integrity with " << options.updaterThreads << " updater threads for " << options.stressSeconds << " seconds" << std::endl;
+			LiveParametersPublisher publisher(MakeStressSnapshot(0));
+			size_t readCount = 0;
+			size_t tornSnapshotCount = 0;
+			size_t outOfOrderSnapshotCount = 0;
+			long lastGeneration = 0;
+			size_t updateCount;
+			{
+				const Updaters updaters(publisher, size_t(options.updaterThreads), [](LiveParameters& liveParameters) {
+					// Updates are serialized, so every snapshot is one generation ahead of the one it replaces.
+					liveParameters = MakeStressSnapshot(liveParameters.inputMonitors.front().inputChannel + 1);
+				});
+				const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.stressSeconds));
+				while (Clock::now() < deadline) {
+					for (int readIndex = 0; readIndex < 1024; ++readIndex, ++readCount) {
+						const LiveParametersPublisher::ReadScope liveParameters(publisher);
+						const auto generation = CheckStressSnapshot(*liveParameters);
+						if (!generation.has_value()) {
+							++tornSnapshotCount;
+							continue;
+						}
+						if (*generation < lastGeneration) ++outOfOrderSnapshotCount;
+						lastGeneration = *generation;
+					}
+				}
+				updateCount = updaters.GetUpdateCount();
+			}
+
+			json.BeginObject();
+			json.Key("updaterThreads").Value(options.updaterThreads);
+			json.Key("seconds").Value(options.stressSeconds);
+			json.Key("reads").Value(readCount);
+			json.Key("updates").Value(updateCount);
+			json.Key("tornSnapshots").Value(tornSnapshotCount);
+			json.Key("outOfOrderSnapshots").Value(outOfOrderSnapshotCount);
+			json.EndObject();
+
+			if (tornSnapshotCount > 0 || outOfOrderSnapshotCount > 0)
+				throw std::runtime_error("live parameters integrity check failed: " + std::to_string(tornSnapshotCount) + " torn and " + std::to_string(outOfOrderSnapshotCount) + " out of order snapshots in " + std::to_string(readCount) + " reads");
+		}
+
+	}
+
+	void RunLiveParametersBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+
+		JsonWriter json(output);
+		json.BeginObject();
+		json.Key("iterations").Value(options.iterations);
+		json.Key("channels").Value(options.channels);
+		json.Key("runs").BeginArray();
+		{
+			LiveParametersPublisher publisher(MakeLiveParameters(size_t(options.channels)));
+			MeasureReadScope(json, options, publisher, "no");
+			{
+				// Publishing the same parameters over and over is the worst case for the reader, as it keeps the shared pointer and
+				// generation counter cache lines bouncing between cores.
+				const Updaters updaters(publisher, size_t(options.updaterThreads), [](LiveParameters&) {});
+				MeasureReadScope(json, options, publisher, "continuous");
+			}
+		}
+		json.EndArray();
+		json.Key("stress");
+		RunStress(json, options);
+		json.EndObject();
+	}
+
+}
@@ -0,0 +1,62 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/metering.h"
+#include "../FlexASIOUtil/simd.h"
+
+#include <cxxopts.hpp>
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		struct Options final {
+			std::vector<SampleFormat> formats = { std::begin(allSampleFormats), std::end(allSampleFormats) };
+			KernelBenchmarkOptions kernel;
+		};
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			options.kernel = ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every peak metering kernel", {},
+				[&](::cxxopts::OptionAdder& adder) { adder("formats", "Comma-separated list of sample formats (default: all)", ::cxxopts::value<std::vector<std::string>>()); },
+				[&](const ::cxxopts::ParseResult& result) {
+					if (result.count("formats") > 0) options.formats = ParseSampleFormats("formats", result["formats"].as<std::vector<std::string>>());
+				});
+			return options;
+		}
+
+		void RunFormat(JsonWriter& json, const Options& options, SampleFormat format, size_t bufferSize) {
+			const auto samples = MakeSampleNoise(format, bufferSize);
+			MeasureImplementations(json, {
+					.description = std::string(GetSampleFormatName(format)) + " metering of " + std::to_string(bufferSize) + " samples",
+					.writeParameters = [&](JsonWriter& json) {
+						json.Key("format").Value(GetSampleFormatName(format));
+						json.Key("bufferSize").Value(bufferSize);
+					},
+				},
+				[&](SimdImplementation implementation) { return PeakDetector(format, implementation); },
+				[&](const PeakDetector& peakDetector) { return peakDetector.GetPeak(samples.data(), bufferSize); },
+				[&](const PeakDetector& peakDetector) {
+					return MeasureNanosecondsPerSample(bufferSize, options.kernel.iterations, [&] { peakDetector.GetPeak(samples.data(), bufferSize); });
+				});
+		}
+
+	}
+
+	void RunMeteringBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options.kernel, [&](JsonWriter& json) {
+			for (const auto format : options.formats)
+				for (const auto bufferSize : options.kernel.bufferSizes)
+					RunFormat(json, options, format, size_t(bufferSize));
+		});
+	}
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/sample_conversion.h"
+#include "../FlexASIOUtil/simd.h"
+#include "../FlexASIOUtil/statistics.h"
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace flexasio {
+
+	inline constexpr SampleFormat allSampleFormats[] = {
+		SampleFormat::FLOAT32, SampleFormat::INT32, SampleFormat::INT24, SampleFormat::INT16,
+		SampleFormat::INT32_LSB24, SampleFormat::INT32_LSB16, SampleFormat::FLOAT64,
+	};
+
+	// Parses the values of a command line option that lists sample formats, using the same names as the `sampleType` option.
+	inline std::vector<SampleFormat> ParseSampleFormats(std::string_view optionName, const std::vector<std::string>& names) {
+		std::vector<SampleFormat> result;
+		for (const auto& name : names) {
+			const auto sampleFormat = std::find_if(std::begin(allSampleFormats), std::end(allSampleFormats), [&](SampleFormat candidate) { return GetSampleFormatName(candidate) == name; });
+			if (sampleFormat == std::end(allSampleFormats)) throw std::runtime_error("invalid sample format for --" + std::string(optionName) + ": '" + name + "'");
+			result.push_back(*sampleFormat);
+		}
+		return result;
+	}
+
+	template <typename Float> void FillWithFloatNoise(std::mt19937& random, std::vector<std::byte>& input) {
+		std::uniform_real_distribution<Float> distribution(Float(-1.1), Float(1.1));
+		for (size_t sampleIndex = 0; sampleIndex < input.size() / sizeof(Float); ++sampleIndex) {
+			const auto sample = distribution(random);
+			memcpy(input.data() + sampleIndex * sizeof(sample), &sample, sizeof(sample));
+		}
+	}
+
+	// Full scale noise, so that clipping and rounding paths are exercised as they would be with real signals. Floating point samples
+	// go slightly beyond full scale, but are always finite. The same format and size always result in the same samples.
+	inline std::vector<std::byte> MakeSampleNoise(SampleFormat format, size_t sampleCount) {
+		std::mt19937 random;
+		std::vector<std::byte> input(sampleCount * GetSampleFormatSize(format));
+		if (format == SampleFormat::FLOAT32) FillWithFloatNoise<float>(random, input);
+		else if (format == SampleFormat::FLOAT64) FillWithFloatNoise<double>(random, input);
+		else {
+			std::uniform_int_distribution<int> distribution(0, 255);
+			for (auto& byte : input) byte = std::byte(distribution(random));
+		}
+		return input;
+	}
+
+	// Same as MeasureNanosecondsPerSample below, for functors that process their buffers in place, and would therefore end up processing
+	// their own output over and over again (e.g. a gain that keeps getting applied until the signal is denormal). Before every batch,
+	// outside of the timed region, `prepare(callCount)` is expected to set up pristine input for each of the next `callCount` calls;
+	// `functor(callIndex)` then processes the input of the given call.
+	template <typename Prepare, typename Functor>
+	std::vector<double> MeasureNanosecondsPerSampleInPlace(size_t samplesPerCall, long iterations, Prepare prepare, Functor functor) {
+		using Clock = std::chrono::steady_clock;
+		constexpr size_t minimumBatchSampleCount = 4096;
+		const auto batchSize = (std::max)(size_t(1), minimumBatchSampleCount / (std::max)(size_t(1), samplesPerCall));
+
+		// Warm up caches and branch predictors.
+		prepare(batchSize);
+		for (size_t callIndex = 0; callIndex < batchSize; ++callIndex) functor(callIndex);
+
+		std::vector<double> nanosecondsPerSample;
+		nanosecondsPerSample.reserve(size_t(iterations));
+		for (long iteration = 0; iteration < iterations; ++iteration) {
+			prepare(batchSize);
+			const auto start = Clock::now();
+			for (size_t callIndex = 0; callIndex < batchSize; ++callIndex) functor(callIndex);
+			const auto end = Clock::now();
+			nanosecondsPerSample.push_back(std::chrono::duration<double, std::nano>(end - start).count() / double(batchSize * samplesPerCall));
+		}
+		return nanosecondsPerSample;
+	}
+
+	// Calls `functor`, which is expected to process `samplesPerCall` samples, in batches of at least `minimumBatchSampleCount`
+	// samples so that clock overhead does not dominate. Returns the time it took to process each sample, in nanoseconds, for every
+	// batch.
+	template <typename Functor>
+	std::vector<double> MeasureNanosecondsPerSample(size_t samplesPerCall, long iterations, Functor functor) {
+		return MeasureNanosecondsPerSampleInPlace(samplesPerCall, iterations, [](size_t) {}, [&](size_t) { functor(); });
+	}
+
+	// Throws if `output` is not bit-identical to `reference`, which is what the scalar implementation produced from the same input.
+	// `sampleSize` is only used to report which sample differs.
+	inline void CheckMatchesScalar(std::span<const std::byte> reference, std::span<const std::byte> output, size_t sampleSize, std::string_view description) {
+		if (output.size() != reference.size())
+			throw std::runtime_error(std::string(description) + ": output size " + std::to_string(output.size()) + " does not match scalar output size " + std::to_string(reference.size()));
+		if (memcmp(output.data(), reference.data(), reference.size()) == 0) return;
+		size_t byteIndex = 0;
+		while (output[byteIndex] == reference[byteIndex]) ++byteIndex;
+		throw std::runtime_error(std::string(description) + ": output differs from the scalar implementation, starting at sample " + std::to_string(byteIndex / sampleSize));
+	}
+
+	// For kernels that compute a single value, such as a peak.
+	inline void CheckMatchesScalar(float reference, float output, std::string_view description) {
+		if (memcmp(&output, &reference, sizeof(reference)) != 0)
+			throw std::runtime_error(std::string(description) + ": result " + std::to_string(output) + " differs from the scalar implementation result " + std::to_string(reference));
+	}
+
+	template <typename Sample>
+	void CheckMatchesScalar(const std::vector<Sample>& reference, const std::vector<Sample>& output, std::string_view description) {
+		CheckMatchesScalar(std::as_bytes(std::span(reference)), std::as_bytes(std::span(output)), sizeof(Sample), description);
+	}
+
+	struct CheckMatchesScalarFunctor final {
+		template <typename Output> void operator()(const Output& reference, const Output& output, std::string_view description) const {
+			CheckMatchesScalar(reference, output, description);
+		}
+	};
+
+	// Options that every kernel benchmark has.
+	struct KernelBenchmarkOptions final {
+		std::vector<long> bufferSizes = { 64, 256, 1024 };
+		long iterations = 1000;
+	};
+
+	inline void CheckStrictlyPositive(std::string_view optionName, const std::vector<long>& values) {
+		for (const auto value : values)
+			if (value < 1) throw std::runtime_error("--" + std::string(optionName) + " must be strictly positive");
+	}
+
+	// Parses the command line of a kernel benchmark, starting from the defaults in `options`. `addOptions(adder)` declares the options
+	// that are specific to the benchmark, which `readOptions(result)` then reads and validates.
+	template <typename AddOptions, typename ReadOptions>
+	KernelBenchmarkOptions ParseKernelBenchmarkOptions(int argc, char** argv, const std::string& description, KernelBenchmarkOptions options, AddOptions addOptions, ReadOptions readOptions) {
+		::cxxopts::Options commandLineOptions(argv[0], description);
+		auto adder = commandLineOptions.add_options();
+		adder
+			("buffer-sizes", "Comma-separated list of buffer sizes, in frames", ::cxxopts::value<std::vector<long>>())
+			("iterations", "Number of timed calls per measurement", ::cxxopts::value(options.iterations));
+		addOptions(adder);
+		const auto result = commandLineOptions.parse(argc, argv);
+		if (result.count("buffer-sizes") > 0) options.bufferSizes = result["buffer-sizes"].as<std::vector<long>>();
+
+		if (options.iterations < 1) throw std::runtime_error("--iterations must be strictly positive");
+		CheckStrictlyPositive("buffer-sizes", options.bufferSizes);
+		readOptions(result);
+		return options;
+	}
+
+	// Writes the results of a kernel benchmark as JSON. `writeRuns(json)` writes one object per run, typically through
+	// MeasureImplementations().
+	template <typename WriteRuns>
+	void WriteKernelBenchmark(std::ostream& output, const KernelBenchmarkOptions& options, WriteRuns writeRuns) {
+		JsonWriter json(output);
+		json.BeginObject();
+		json.Key("bestImplementation").Value(GetSimdImplementationName(GetBestSimdImplementation()));
+		json.Key("iterations").Value(options.iterations);
+		json.Key("runs").BeginArray();
+		writeRuns(json);
+		json.EndArray();
+		json.EndObject();
+	}
+
+	// One set of parameters of a kernel benchmark.
+	struct KernelRun final {
+		// Identifies the run in progress messages and errors, e.g. "Float32 to Int16 conversion of 64 samples".
+		std::string description = {};
+		// Writes the keys that describe the run, other than the implementation.
+		std::function<void(JsonWriter&)> writeParameters = {};
+		std::string_view timeKey = "nanosecondsPerSample";
+		// Optional. Writes additional results derived from the time per sample (e.g. time per channel).
+		std::function<void(JsonWriter&, const std::vector<double>& nanosecondsPerSample)> writeResults = {};
+		// Speedups are relative to the scalar implementation, unless the median time of another baseline is given.
+		std::string_view speedupKey = "speedupOverScalar";
+		std::optional<double> baselineMedian = {};
+	};
+
+	// Runs a kernel with each implementation the CPU supports, starting with the scalar one, and writes one JSON object per
+	// implementation. `makeKernel(implementation)` constructs the kernel, which is skipped if it falls back to another implementation,
+	// as that one would end up being measured twice. Before anything is timed, `compute(kernel)` runs the kernel on pristine input and
+	// returns the result, and `check(scalarResult, result, description)` throws if it differs from the result of the scalar
+	// implementation. `measure(kernel)` then returns the time per sample of each batch, e.g. from MeasureNanosecondsPerSample().
+	template <typename MakeKernel, typename Compute, typename Measure, typename Check = CheckMatchesScalarFunctor>
+	void MeasureImplementations(JsonWriter& json, const KernelRun& run, MakeKernel makeKernel, Compute compute, Measure measure, Check check = {}) {
+		using Kernel = std::invoke_result_t<MakeKernel, SimdImplementation>;
+		using Result = std::decay_t<std::invoke_result_t<Compute, Kernel&>>;
+		std::optional<Result> scalarResult;
+		auto baselineMedian = run.baselineMedian;
+		for (const auto requestedImplementation : GetSupportedSimdImplementations()) {
+			auto kernel = makeKernel(requestedImplementation);
+			if (kernel.GetImplementation() != requestedImplementation) continue;
+
+			const auto description = run.description + " using " + std::string(GetSimdImplementationName(requestedImplementation)) + " implementation";
+			std::cerr << "Benchmarking " << description << std::endl;
+			auto result = compute(kernel);
+			if (!scalarResult.has_value()) scalarResult.emplace(std::move(result));
+			else check(*scalarResult, result, description);
+
+			auto nanosecondsPerSample = measure(kernel);
+			const auto distribution = ComputeDistribution(nanosecondsPerSample);
+			if (!baselineMedian.has_value()) baselineMedian = distribution.p50;
+
+			json.BeginObject();
+			if (run.writeParameters) run.writeParameters(json);
+			json.Key("implementation").Value(GetSimdImplementationName(kernel.GetImplementation()));
+			json.Key(run.timeKey);
+			WriteDistribution(json, distribution);
+			if (run.writeResults) run.writeResults(json, nanosecondsPerSample);
+			json.Key(run.speedupKey).Value(distribution.p50 > 0 ? *baselineMedian / distribution.p50 : 0.0);
+			json.EndObject();
+		}
+	}
+
+}
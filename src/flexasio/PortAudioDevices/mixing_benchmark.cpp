@@ -0,0 +1,109 @@
+#include "standalone_benchmarks.h"
+
+#include "microbenchmark.h"
+
+#include "../FlexASIOUtil/json.h"
+#include "../FlexASIOUtil/mixing.h"
+#include "../FlexASIOUtil/simd.h"
+
+#include <cxxopts.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flexasio {
+
+	namespace {
+
+		struct Shape final {
+			long inputChannelCount;
+			long outputChannelCount;
+		};
+
+		struct Options final {
+			std::vector<Shape> shapes = { { 2, 2 }, { 2, 6 }, { 2, 8 }, { 6, 2 }, { 8, 2 }, { 8, 8 } };
+			KernelBenchmarkOptions kernel;
+		};
+
+		std::vector<Shape> ParseShapes(const std::vector<std::string>& items) {
+			std::vector<Shape> result;
+			for (const auto& item : items) {
+				const auto separator = item.find('x');
+				if (separator == item.npos) throw std::runtime_error("invalid shape for --shapes: '" + item + "' (expected INPUTxOUTPUT)");
+				try {
+					result.push_back({ .inputChannelCount = std::stol(item.substr(0, separator)), .outputChannelCount = std::stol(item.substr(separator + 1)) });
+				}
+				catch (const std::exception&) {
+					throw std::runtime_error("invalid shape for --shapes: '" + item + "' (expected INPUTxOUTPUT)");
+				}
+			}
+			return result;
+		}
+
+		Options ParseOptions(int argc, char** argv) {
+			Options options;
+			options.kernel = ParseKernelBenchmarkOptions(argc, argv, "Measures the speed of every channel mixing kernel", options.kernel,
+				[&](::cxxopts::OptionAdder& adder) { adder("shapes", "Comma-separated list of INPUTxOUTPUT channel counts", ::cxxopts::value<std::vector<std::string>>()); },
+				[&](const ::cxxopts::ParseResult& result) { if (result.count("shapes") > 0) options.shapes = ParseShapes(result["shapes"].as<std::vector<std::string>>()); });
+
+			for (const auto& shape : options.shapes)
+				if (GetDefaultChannelMask(int(shape.inputChannelCount)) == 0 || GetDefaultChannelMask(int(shape.outputChannelCount)) == 0)
+					throw std::runtime_error("--shapes must use channel counts that have a conventional speaker layout (1, 2, 3, 4, 5, 6 or 8)");
+			return options;
+		}
+
+		void RunShape(JsonWriter& json, const KernelBenchmarkOptions& options, const Shape& shape, size_t bufferSize) {
+			const auto inputChannelCount = size_t(shape.inputChannelCount);
+			const auto outputChannelCount = size_t(shape.outputChannelCount);
+			// The same gains the driver uses with the `mixingChannels` option, so that the sparsity is representative.
+			const auto gains = GetDefaultMixingGains(GetDefaultChannelMask(int(inputChannelCount)), GetDefaultChannelMask(int(outputChannelCount)));
+
+			std::mt19937 random;
+			std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+			std::vector<float> inputBuffers(inputChannelCount * bufferSize);
+			for (auto& sample : inputBuffers) sample = distribution(random);
+			std::vector<float> outputBuffers(outputChannelCount * bufferSize);
+			std::vector<const float*> inputs;
+			for (size_t channel = 0; channel < inputChannelCount; ++channel) inputs.push_back(inputBuffers.data() + channel * bufferSize);
+			std::vector<float*> outputs;
+			for (size_t channel = 0; channel < outputChannelCount; ++channel) outputs.push_back(outputBuffers.data() + channel * bufferSize);
+
+			const auto nonZeroGains = MixingMatrix(gains, SimdImplementation::SCALAR).GetNonZeroGainCount();
+			// Time is reported per output frame, which is what the audio callback budget is expressed in.
+			MeasureImplementations(json, {
+					.description = "mixing of " + std::to_string(inputChannelCount) + " channels into " + std::to_string(outputChannelCount) + " channels, " + std::to_string(bufferSize) + " frames",
+					.writeParameters = [&](JsonWriter& json) {
+						json.Key("inputChannelCount").Value(inputChannelCount);
+						json.Key("outputChannelCount").Value(outputChannelCount);
+						json.Key("nonZeroGains").Value(nonZeroGains);
+						json.Key("bufferSize").Value(bufferSize);
+					},
+					.timeKey = "nanosecondsPerFrame",
+				},
+				[&](SimdImplementation implementation) { return MixingMatrix(gains, implementation); },
+				[&](const MixingMatrix& matrix) {
+					// Garbage left over from the previous implementation must not hide output samples that were not written.
+					std::fill(outputBuffers.begin(), outputBuffers.end(), std::numeric_limits<float>::quiet_NaN());
+					matrix.Mix(inputs.data(), outputs.data(), bufferSize);
+					return outputBuffers;
+				},
+				[&](const MixingMatrix& matrix) { return MeasureNanosecondsPerSample(bufferSize, options.iterations, [&] { matrix.Mix(inputs.data(), outputs.data(), bufferSize); }); });
+		}
+
+	}
+
+	void RunMixingBenchmark(int argc, char** argv, std::ostream& output) {
+		const auto options = ParseOptions(argc, argv);
+		WriteKernelBenchmark(output, options.kernel, [&](JsonWriter& json) {
+			for (const auto& shape : options.shapes)
+				for (const auto bufferSize : options.kernel.bufferSizes)
+					RunShape(json, options.kernel, shape, size_t(bufferSize));
+		});
+	}
+
+}
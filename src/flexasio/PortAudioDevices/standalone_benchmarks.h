@@ -0,0 +1,26 @@
+#pragma once
+
+#include <ostream>
+
+namespace flexasio {
+
+	// Subcommands that measure parts of the driver in isolation, and therefore do not require PortAudio. Each takes the command line of
+	// its subcommand, where `argv[0]` is the subcommand name, writes its results as JSON to `output`, and throws if the command line is
+	// invalid or if the code under test produces wrong results.
+
+	// Sample type conversion, for the `sampleType` and `dither` options.
+	void RunConversionBenchmark(int argc, char** argv, std::ostream& output);
+	// Biquad filters, for the `equalizer` option.
+	void RunEqualizerBenchmark(int argc, char** argv, std::ostream& output);
+	// Gain ramps, applied when the host application changes channel gains.
+	void RunGainBenchmark(int argc, char** argv, std::ostream& output);
+	// Interleaving and deinterleaving, for the `interleaved` option.
+	void RunInterleavingBenchmark(int argc, char** argv, std::ostream& output);
+	// Access to the live parameters from the stream callback, as well as their integrity under concurrent updates.
+	void RunLiveParametersBenchmark(int argc, char** argv, std::ostream& output);
+	// Peak level meters, for hosts that use driver-side metering.
+	void RunMeteringBenchmark(int argc, char** argv, std::ostream& output);
+	// Channel mixing matrices, for the `mixingChannels` and `mixingMatrix` options.
+	void RunMixingBenchmark(int argc, char** argv, std::ostream& output);
+
+}